@@ -1,3 +1,11 @@
 C:/VulkanSDK/1.3.268.0/Bin/glslc.exe shader.vert -o shader.vert.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe shader_packed.vert -o shader_packed.vert.spv
 C:/VulkanSDK/1.3.268.0/Bin/glslc.exe shader.frag -o shader.frag.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe shader_bindless.frag -o shader_bindless.frag.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe shader_virtual.frag -o shader_virtual.frag.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe shader_atlas.frag -o shader_atlas.frag.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe cull.comp -o cull.comp.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe downsample.comp -o downsample.comp.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe --target-env=vulkan1.2 meshlet.task -o meshlet.task.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe --target-env=vulkan1.2 meshlet.mesh -o meshlet.mesh.spv
 pause
\ No newline at end of file
@@ -23,6 +23,7 @@ layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterial; // per-draw data for shader_bindless.frag, the other fragment shader ignores it
 
 void main() {
 	gl_Position =  ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0); // clip-coordinates ie -w to w
@@ -31,4 +32,5 @@ void main() {
 	fragColor = inColor;
 
 	fragTexCoord = inTexCoord;
+	fragMaterial = uint(gl_InstanceIndex); // one instance per draw, so this is the draw's firstInstance
 }
\ No newline at end of file
@@ -0,0 +1,32 @@
+#version 450
+
+// shader.frag for --material-textures: binding 1 is the material's group of textures, an array whose layers are either
+// whole textures or atlas pages, and the region buffer says where in it the draw's texture is (see texturePacker.h)
+
+layout(location = 0) out vec4 outColor;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterial; // the draw's firstInstance: the texture's index in the region buffer
+
+layout(binding = 1) uniform sampler2DArray textureGroup;
+
+struct TextureRegion {
+	vec4 scaleOffset; // uv * scale + offset, in the layer
+	uint layer;
+};
+
+layout(std430, binding = 5) readonly buffer Regions {
+	TextureRegion regions[];
+};
+
+void main() {
+	TextureRegion region = regions[fragMaterial];
+
+	// Repeat inside the region, not across the atlas page. The gradients come from the unwrapped coordinates, so the
+	// seam where fract jumps does not pick the smallest mip
+	vec2 uv = region.scaleOffset.zw + fract(fragTexCoord) * region.scaleOffset.xy;
+	vec2 dx = dFdx(fragTexCoord) * region.scaleOffset.xy;
+	vec2 dy = dFdy(fragTexCoord) * region.scaleOffset.xy;
+	outColor = textureGrad(textureGroup, vec3(uv, float(region.layer)), dx, dy);
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// shader.frag for --bindless: texture and sampler come out of tables, picked per draw (see bindless.h)
+
+layout(location = 0) out vec4 outColor;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterial; // the draw's firstInstance: texture slot | sampler slot << 16
+
+layout(binding = 1) uniform texture2D textures[]; // partially bound, only the materials' slots are written
+layout(binding = 2) uniform sampler samplers[2];
+
+void main() {
+	uint textureSlot = fragMaterial & 0xFFFFu;
+	uint samplerSlot = fragMaterial >> 16;
+	// A multi-draw can mix materials in one wave, so the indices are not uniform
+	outColor = texture(sampler2D(textures[nonuniformEXT(textureSlot)], samplers[nonuniformEXT(samplerSlot)]), fragTexCoord);
+}
\ No newline at end of file
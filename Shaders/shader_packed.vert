@@ -0,0 +1,33 @@
+#version 450
+
+// shader.vert for PackedVertex (--packed-vertices)
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+// Undoes packVertices: value = offset + scale * unorm. Mesh bounds change per mesh, not per frame, so push constants
+layout(push_constant) uniform Dequantize {
+    vec4 positionOffset;
+    vec4 positionScale;
+    vec4 texCoordOffsetScale; // xy offset, zw scale
+} dequantize;
+
+// unorm16 attributes arrive already divided down to 0..1
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterial; // see shader.vert
+
+void main() {
+	vec3 position = dequantize.positionOffset.xyz + inPosition * dequantize.positionScale.xyz;
+	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
+
+	fragColor = vec3(1.0); // no color stream, it was always white
+	fragTexCoord = dequantize.texCoordOffsetScale.xy + inTexCoord * dequantize.texCoordOffsetScale.zw;
+	fragMaterial = uint(gl_InstanceIndex);
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#version 450
+
+// shader.frag for --virtual-texture: binding 1 is the page cache, and the page table says which of its slots holds each page
+// of the texture, or the closest coarser page that is resident. The sizes are virtualTexture.h's
+
+layout(location = 0) out vec4 outColor;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(binding = 1) uniform sampler2D pageCache;
+
+layout(std430, binding = 3) readonly buffer PageTable {
+	uint width;
+	uint height;
+	uint levelCount;
+	uint slotsPerRow;
+	uint feedbackPixel; // x | y << 8
+	uint padding[3];
+	uint levelFirstPage[16];
+	uint levelPagesX[16];
+	uint levelPagesY[16];
+	uint entries[]; // slot x | slot y << 8 | level << 16 | valid << 31
+} pageTable;
+
+// A flag per page this frame sampled, read and cleared by the CPU once the frame is done
+layout(std430, binding = 4) writeonly buffer Feedback {
+	uint requested[];
+} feedback;
+
+const uint PAGE_SIZE = 128;
+const uint PAGE_BORDER = 4;
+const uint PAGE_PAYLOAD = 120;
+const uint FEEDBACK_STRIDE = 8;
+const uint ENTRY_VALID = 0x80000000u;
+
+uvec2 levelSize(uint level) {
+	return max(uvec2(pageTable.width, pageTable.height) >> level, uvec2(1));
+}
+
+void main() {
+	// Hardware mip selection, done by hand: the cache has a single level
+	vec2 texel = fragTexCoord * vec2(pageTable.width, pageTable.height);
+	vec2 dx = dFdx(texel), dy = dFdy(texel);
+	float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+	uint level = uint(clamp(floor(lod), 0.0, float(pageTable.levelCount - 1u)));
+
+	// REPEAT by hand too, the slots' borders already wrap around the texture's edges
+	vec2 uv = fract(fragTexCoord);
+	uvec2 pages = uvec2(pageTable.levelPagesX[level], pageTable.levelPagesY[level]);
+	uvec2 page = min(uvec2(uv * vec2(levelSize(level))) / PAGE_PAYLOAD, pages - 1u);
+	uint pageId = pageTable.levelFirstPage[level] + page.y * pages.x + page.x;
+
+	// Only one pixel of every 8 x 8 asks, a different one each frame
+	uvec2 pixel = uvec2(gl_FragCoord.xy) % FEEDBACK_STRIDE;
+	if (pixel == uvec2(pageTable.feedbackPixel & 0xFFu, pageTable.feedbackPixel >> 8)) {
+		feedback.requested[pageId] = 1;
+	}
+
+	uint entry = pageTable.entries[pageId];
+	if ((entry & ENTRY_VALID) == 0) {
+		outColor = vec4(1.0, 0.0, 1.0, 1.0); // the tail is always resident, so never
+		return;
+	}
+
+	// The page standing in is the wanted one's coordinates shifted down, clamped to its level's grid (the CPU picks it the same way)
+	uint residentLevel = (entry >> 16) & 0xFFu;
+	uvec2 residentPages = uvec2(pageTable.levelPagesX[residentLevel], pageTable.levelPagesY[residentLevel]);
+	uvec2 residentPage = min(page >> (residentLevel - level), residentPages - 1u);
+	vec2 inPage = uv * vec2(levelSize(residentLevel)) - vec2(residentPage * PAGE_PAYLOAD) + float(PAGE_BORDER);
+	inPage = clamp(inPage, vec2(0.5), vec2(PAGE_SIZE - 0.5));
+
+	vec2 slot = vec2(entry & 0xFFu, (entry >> 8) & 0xFFu);
+	outColor = textureLod(pageCache, (slot * float(PAGE_SIZE) + inPage) / float(pageTable.slotsPerRow * PAGE_SIZE), 0.0);
+}
\ No newline at end of file
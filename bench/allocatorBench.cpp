@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "deviceMemory.h"
+#include "profiling.h"
+
+
+// The device allocator's block policy without the device: TLSF heaps of DEVICE_MEMORY_BLOCK_SIZE, a new one when none has
+// room, buffers and optimal images apart as for a bufferImageGranularity over 1. Each block stands for one vkAllocateMemory
+struct Pool {
+    std::vector<TlsfHeap> blocks;
+    std::vector<bool> images;
+};
+
+struct Live {
+    uint32_t block;
+    uint32_t node;
+};
+
+
+// Sizes like a scene's: mostly small uniform/vertex/index buffers, some textures at 64 KB alignment, a few big ones
+static void randomRequirements(std::mt19937& random, uint64_t& size, uint64_t& alignment, bool& image) {
+    uint32_t kind = random() % 100;
+    image = kind >= 80;
+    if (kind < 60) {
+        size = 256 + random() % (16 * 1024);
+        alignment = 256;
+    }
+    else if (kind < 80) {
+        size = 16 * 1024 + random() % (256 * 1024);
+        alignment = 16;
+    }
+    else if (kind < 99) {
+        uint32_t side = 32u << (random() % 4);
+        size = (uint64_t(side) * side * 4 * 4 / 3 + 0xffff) & ~uint64_t(0xffff); // drivers round optimal images up to their alignment
+        alignment = 64 * 1024;
+    }
+    else {
+        size = 1024 * 1024 + random() % (3 * 1024 * 1024);
+        alignment = 64 * 1024;
+    }
+}
+
+
+static Live allocate(Pool& pool, uint64_t size, uint64_t alignment, bool image) {
+    uint64_t offset;
+    for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+        if (pool.images[i] != image) continue;
+        uint32_t node = pool.blocks[i].allocate(size, alignment, offset);
+        if (node != TLSF_NONE) return { i, node };
+    }
+    pool.blocks.emplace_back();
+    pool.blocks.back().reset(DEVICE_MEMORY_BLOCK_SIZE);
+    pool.images.push_back(image);
+    return { static_cast<uint32_t>(pool.blocks.size() - 1), pool.blocks.back().allocate(size, alignment, offset) };
+}
+
+
+static void report(const char* phase, const Pool& pool, std::vector<double>& nanoseconds, size_t live) {
+    uint64_t capacity = 0, freeBytes = 0, largestFree = 0;
+    for (const TlsfHeap& heap : pool.blocks) {
+        capacity += heap.capacity();
+        freeBytes += heap.freeBytes();
+        largestFree += heap.largestFree();
+    }
+    std::sort(nanoseconds.begin(), nanoseconds.end());
+    double total = 0.0;
+    for (double each : nanoseconds) total += each;
+    std::cout << phase << ": " << nanoseconds.size() << " calls, " << total / nanoseconds.size() << " ns average, "
+        << nanoseconds[nanoseconds.size() * 99 / 100] << " ns p99, " << nanoseconds.back() << " ns max. " << live << " live in "
+        << pool.blocks.size() << " blocks (vkAllocateMemory calls) of " << capacity / (1024 * 1024) << " MB, "
+        << (capacity - freeBytes) / (1024 * 1024) << " MB used, "
+        << (freeBytes > 0 ? 100.0 * (1.0 - double(largestFree) / double(freeBytes)) : 0.0) << "% fragmented" << std::endl;
+    nanoseconds.clear();
+}
+
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::atoi(argv[1]) : 100000;
+    uint32_t rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+    std::mt19937 random(1);
+    Pool pool;
+    std::vector<Live> live;
+    std::vector<double> nanoseconds;
+    live.reserve(count);
+    nanoseconds.reserve(count);
+
+    // Everything up front, as at startup
+    for (size_t i = 0; i < count; i++) {
+        uint64_t size, alignment;
+        bool image;
+        randomRequirements(random, size, alignment, image);
+        auto start = Clock::now();
+        live.push_back(allocate(pool, size, alignment, image));
+        nanoseconds.push_back(millisecondsSince(start) * 1e6);
+    }
+    report("allocate", pool, nanoseconds, live.size());
+
+    // Then churn, as streaming and resizes do: a random half freed and as many new ones made, round after round
+    std::vector<double> freeNanoseconds;
+    for (uint32_t round = 0; round < rounds; round++) {
+        std::shuffle(live.begin(), live.end(), random);
+        for (size_t i = live.size() / 2; i < live.size(); i++) {
+            auto start = Clock::now();
+            pool.blocks[live[i].block].free(live[i].node);
+            freeNanoseconds.push_back(millisecondsSince(start) * 1e6);
+        }
+        for (size_t i = live.size() / 2; i < live.size(); i++) {
+            uint64_t size, alignment;
+            bool image;
+            randomRequirements(random, size, alignment, image);
+            auto start = Clock::now();
+            live[i] = allocate(pool, size, alignment, image);
+            nanoseconds.push_back(millisecondsSince(start) * 1e6);
+        }
+    }
+    if (rounds > 0) {
+        report("free", pool, freeNanoseconds, live.size());
+        report("churn", pool, nanoseconds, live.size());
+    }
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+@echo off
+rem CPU command recording time against material count: a descriptor set per material (a bind, and a split indirect call, per
+rem material) vs one bindless texture table bound once. Run from the app's working directory, eg bindlessBench.bat VulkanTutorial.exe,
+rem and compare the "Record:" lines. Every material uses the same texture, only the descriptor traffic differs
+set APP=%1
+if "%APP%"=="" set APP=VulkanTutorial.exe
+
+for %%n in (1 10 100 1000 5000) do (
+    echo === %%n materials, descriptor set per material
+    %APP% --frames 500 --lod 0 --mesh-copies 5000 --materials %%n | findstr /b "Record:"
+    echo === %%n materials, bindless
+    %APP% --frames 500 --lod 0 --mesh-copies 5000 --materials %%n --bindless | findstr /b "Record:"
+)
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "imageDecoder.h"
+#include "mappedFile.h"
+#include "options.h"
+#include "parallel.h"
+#include "profiling.h"
+
+
+// Stands in for mapped staging memory: a fixed set of image-sized slots, each reused once its image is "uploaded"
+class StagingSlots {
+public:
+    StagingSlots(size_t count, size_t slotSize) : memory(count * slotSize), slotSize(slotSize) {
+        for (size_t i = 0; i < count; i++) free.push_back(memory.data() + i * slotSize);
+    }
+
+    uint8_t* acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        released.wait(lock, [&]() { return !free.empty(); });
+        uint8_t* slot = free.back();
+        free.pop_back();
+        return slot;
+    }
+
+    void release(uint8_t* slot) {
+        std::lock_guard<std::mutex> lock(mutex);
+        free.push_back(slot);
+        released.notify_one();
+    }
+
+    size_t size() const { return slotSize; }
+
+private:
+    std::vector<uint8_t> memory;
+    size_t slotSize;
+    std::vector<uint8_t*> free;
+    std::mutex mutex;
+    std::condition_variable released;
+};
+
+
+// Decodes the same encoded image `count` times through one ImageDecoder and reports wall time and the memory it held.
+// heap: stb allocates, the image is copied into a staging slot, as createTextureImage used to. direct: stb writes into the slot
+static void run(const std::string& mode, const MappedFile& file, size_t count, unsigned threads, size_t budget, StagingSlots& staging) {
+    ImageDecoder decoder(threads, budget);
+    ImageDestination destination;
+    if (mode == "direct") {
+        destination = [&](uint32_t width, uint32_t height) { return size_t(width) * height * 4 <= staging.size() ? staging.acquire() : nullptr; };
+    }
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        decoder.add({ file.data(), file.size() }, "texture " + std::to_string(i), destination);
+    }
+
+    DecodedImage image;
+    size_t copiedBytes = 0;
+    while (decoder.next(image)) {
+        if (!image.pixels) {
+            throw std::runtime_error(image.error);
+        }
+        size_t size = size_t(image.width) * image.height * 4;
+        if (image.pixels.get_deleter().owned) {
+            uint8_t* slot = staging.acquire();
+            memcpy(slot, image.pixels.get(), size);
+            staging.release(slot);
+            copiedBytes += size;
+        }
+        else {
+            copiedBytes += image.copied ? size : 0;
+            staging.release(image.pixels.get());
+        }
+        image = DecodedImage();
+    }
+    double milliseconds = millisecondsSince(start);
+
+    std::cout << mode << ", " << count << " textures, " << threads << " threads: " << milliseconds << " ms ("
+        << count * 1000.0 / milliseconds << " textures/s), " << copiedBytes / (1024.0 * 1024.0) << " MB copied, peak "
+        << decoder.peakBytesInFlight() / (1024.0 * 1024.0) << " MB decoded on the heap" << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 1 ? argv[1] : "all";
+    std::string path = argc > 2 ? argv[2] : Options().texturePath;
+    size_t budgetMegabytes = argc > 3 ? std::atoi(argv[3]) : 256;
+
+    // Peak RSS is per process, so every mode gets its own
+    if (mode == "all") {
+        int result = 0;
+        for (const char* each : { "heap", "direct" }) {
+            std::string command = std::string("\"") + argv[0] + "\" " + each + " \"" + path + "\" " + std::to_string(budgetMegabytes);
+            result |= std::system(command.c_str());
+        }
+        return result;
+    }
+
+    try {
+        if (mode != "heap" && mode != "direct") {
+            throw std::runtime_error("unknown mode: " + mode);
+        }
+        MappedFile file;
+        if (!file.open(path)) {
+            throw std::runtime_error("failed to open " + path + "!");
+        }
+
+        // One slot per worker plus one being uploaded, each big enough for the image
+        DecodedImage probe;
+        ImageDecoder prober(1);
+        prober.add({ file.data(), file.size() }, path);
+        prober.next(probe);
+        if (!probe.pixels) {
+            throw std::runtime_error(probe.error);
+        }
+        StagingSlots staging(workerCount() + 1, size_t(probe.width) * probe.height * 4);
+        probe = DecodedImage();
+        size_t baseBytes = peakResidentBytes();
+
+        // Thread counts double up to the core count, texture counts go up by 4x
+        for (size_t count : { 1, 4, 16, 64 }) {
+            for (unsigned threads = 1;; threads = (std::min)(threads * 2, workerCount())) {
+                run(mode, file, count, threads, budgetMegabytes * 1024 * 1024, staging);
+                if (threads == workerCount()) break;
+            }
+        }
+        std::cout << mode << ": peak RSS +" << (peakResidentBytes() - baseBytes) / (1024.0 * 1024.0) << " MB over the staging slots" << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+@echo off
+rem Soak test for device memory defragmentation: thousands of buffers of random sizes churned every frame for a long
+rem session, without (--defrag 0) and with it at a few step sizes (KB per frame). Run from the app's working directory, eg
+rem defragSoak.bat VulkanTutorial.exe 20000, and compare block counts and fragmentation over time on the "Soak frame" lines,
+rem and the moves and step times on the "Defragmentation:" line
+set APP=%1
+if "%APP%"=="" set APP=VulkanTutorial.exe
+set FRAMES=%2
+if "%FRAMES%"=="" set FRAMES=10000
+
+for %%d in (0 1024 4096 16384) do (
+    echo === --defrag %%d
+    %APP% --frames %FRAMES% --memory-soak 4096 --defrag %%d | findstr /c:"Soak" /c:"Defragmentation" /c:"Device memory"
+)
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "mipmap.h"
+#include "parallel.h"
+#include "profiling.h"
+
+
+// downsample.comp on the CPU, thread by thread in the order its barriers allow, against buildMipChain. Exits non-zero if a
+// level is further off than the tolerance below
+const uint32_t TILE = 64; // as in downsample.cpp
+const uint32_t MAX_LEVELS = 12;
+const uint32_t MAX_TAIL_SOURCE = TILE << 6;
+
+// Both average in float from the source, so a level only differs by how each rounds its sRGB encode (pow on the GPU, a
+// table in buildMipChain): 1. The shader's tail (levels past 6 of a dispatch) and every dispatch after the first start from
+// a level that was stored as 8 bits, where buildMipChain keeps carrying floats, and each such restart can add about 1 more
+const int TOLERANCE = 1;
+const int TOLERANCE_PER_RESTART = 1;
+
+using Texel = std::array<float, 4>;
+
+struct Level {
+    int width;
+    int height;
+    std::vector<uint8_t> texels; // the UNORM storage view's view of it
+};
+
+struct Constants { // downsample.comp's push constants
+    int sourceWidth;
+    int sourceHeight;
+    uint32_t levelCount;
+    bool srgb;
+};
+
+
+static Texel toLinear(const Constants& constants, Texel c) {
+    if (!constants.srgb) return c;
+    for (int i = 0; i < 3; i++) c[i] = c[i] <= 0.04045f ? c[i] / 12.92f : std::pow((c[i] + 0.055f) / 1.055f, 2.4f);
+    return c;
+}
+
+static Texel fromLinear(const Constants& constants, Texel c) {
+    if (!constants.srgb) return c;
+    for (int i = 0; i < 3; i++) c[i] = c[i] <= 0.0031308f ? c[i] * 12.92f : 1.055f * std::pow(c[i], 1.0f / 2.4f) - 0.055f;
+    return c;
+}
+
+static void levelSize(const Constants& constants, uint32_t level, int& width, int& height) {
+    width = (std::max)(constants.sourceWidth >> level, 1);
+    height = (std::max)(constants.sourceHeight >> level, 1);
+}
+
+static Texel imageLoad(const Level& level, int x, int y) {
+    const uint8_t* texel = &level.texels[(size_t(y) * level.width + x) * 4];
+    return { texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f, texel[3] / 255.0f };
+}
+
+// Float to UNORM rounds to nearest
+static void store(Level* levels, const Constants& constants, uint32_t level, int x, int y, const Texel& value) {
+    if (level > constants.levelCount || x >= levels[level].width || y >= levels[level].height) return;
+    Texel encoded = fromLinear(constants, value);
+    uint8_t* texel = &levels[level].texels[(size_t(y) * levels[level].width + x) * 4];
+    for (int c = 0; c < 4; c++) texel[c] = uint8_t(std::clamp(encoded[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static Texel average(const Texel& a, const Texel& b, const Texel& c, const Texel& d) {
+    Texel sum;
+    for (int i = 0; i < 4; i++) sum[i] = (a[i] + b[i] + c[i] + d[i]) * 0.25f;
+    return sum;
+}
+
+static Texel reduceQuad(const Texel v[4], int px, int py, int aboveWidth, int aboveHeight) {
+    bool edgeX = 2 * px + 1 >= aboveWidth;
+    bool edgeY = 2 * py + 1 >= aboveHeight;
+    const Texel& right = edgeX ? v[0] : v[1];
+    const Texel& below = edgeY ? v[0] : v[2];
+    const Texel& diagonal = edgeX ? below : (edgeY ? right : v[3]);
+    return average(v[0], right, below, diagonal);
+}
+
+
+// downsampleTile for all 256 invocations of a group. Each phase between two barriers runs for every invocation first
+static void downsampleTile(Level* levels, const Constants& constants, uint32_t sourceLevel, int tileX, int tileY) {
+    static thread_local Texel v[256][4];
+    static thread_local Texel value[256];
+    static thread_local Texel tile[16][16];
+
+    int sourceWidth, sourceHeight;
+    levelSize(constants, sourceLevel, sourceWidth, sourceHeight);
+    for (int i = 0; i < 256; i++) {
+        int localX = i % 16, localY = i / 16;
+        int quadX = tileX / 2 + localX * 2, quadY = tileY / 2 + localY * 2;
+        for (int k = 0; k < 4; k++) {
+            int px = quadX + (k & 1), py = quadY + (k >> 1);
+            Texel s[4];
+            for (int j = 0; j < 4; j++) {
+                int sx = (std::min)(2 * px + (j & 1), sourceWidth - 1), sy = (std::min)(2 * py + (j >> 1), sourceHeight - 1);
+                s[j] = toLinear(constants, imageLoad(levels[sourceLevel], sx, sy));
+            }
+            v[i][k] = average(s[0], s[1], s[2], s[3]);
+            store(levels, constants, sourceLevel + 1, px, py, v[i][k]);
+        }
+
+        int aboveWidth, aboveHeight;
+        levelSize(constants, sourceLevel + 1, aboveWidth, aboveHeight);
+        value[i] = reduceQuad(v[i], tileX / 4 + localX, tileY / 4 + localY, aboveWidth, aboveHeight);
+        store(levels, constants, sourceLevel + 2, tileX / 4 + localX, tileY / 4 + localY, value[i]);
+        tile[localY][localX] = value[i];
+    }
+
+    int n = 16, originX = tileX / 4, originY = tileY / 4;
+    for (uint32_t level = sourceLevel + 3; level <= sourceLevel + 6; level++) {
+        n /= 2;
+        originX /= 2;
+        originY /= 2;
+        int width, height, aboveWidth, aboveHeight;
+        levelSize(constants, level, width, height);
+        levelSize(constants, level - 1, aboveWidth, aboveHeight);
+        for (int i = 0; i < n * n; i++) {
+            int px = originX + i % n, py = originY + i / n;
+            if (px >= width || py >= height) continue;
+            Texel s[4];
+            for (int j = 0; j < 4; j++) {
+                int ax = (std::min)(2 * px + (j & 1), aboveWidth - 1) - 2 * originX;
+                int ay = (std::min)(2 * py + (j >> 1), aboveHeight - 1) - 2 * originY;
+                s[j] = tile[ay][ax];
+            }
+            value[i] = average(s[0], s[1], s[2], s[3]);
+            store(levels, constants, level, px, py, value[i]);
+        }
+        for (int i = 0; i < n * n; i++) {
+            tile[i / n][i % n] = value[i];
+        }
+    }
+}
+
+
+// One vkCmdDispatch: every group, then the tail in whichever group finished last
+static void dispatch(Level* levels, const Constants& constants) {
+    int groupsX = (constants.sourceWidth + TILE - 1) / TILE, groupsY = (constants.sourceHeight + TILE - 1) / TILE;
+    parallelFor(size_t(groupsX) * groupsY, [&](size_t group) {
+        downsampleTile(levels, constants, 0, int(group % groupsX) * TILE, int(group / groupsX) * TILE);
+    });
+    if (constants.levelCount > 6) {
+        downsampleTile(levels, constants, 6, 0, 0);
+    }
+}
+
+
+// The chain split into dispatches as generateMipmapsCompute does: 12 levels a dispatch, 6 while the source is over
+// MAX_TAIL_SOURCE. false if a level is off by more than its tolerance
+static bool compare(uint32_t width, uint32_t height, bool srgb, std::mt19937& random) {
+    std::vector<uint8_t> source(size_t(width) * height * 4);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            uint8_t* texel = &source[(size_t(y) * width + x) * 4];
+            texel[0] = uint8_t(x * 255 / (std::max)(width - 1, 1u)); // smooth, where rounding differences show
+            texel[1] = uint8_t(random() % 256); // noise, where the filter footprint shows
+            texel[2] = uint8_t((x / 7 + y / 5) % 2 * 255); // hard edges
+            texel[3] = uint8_t(y * 255 / (std::max)(height - 1, 1u));
+        }
+    }
+    std::vector<std::vector<uint8_t>> expected = buildMipChain(source.data(), width, height, srgb);
+    uint32_t mipLevels = static_cast<uint32_t>(expected.size());
+
+    std::vector<Level> levels(mipLevels);
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        levels[i] = { int((std::max)(width >> i, 1u)), int((std::max)(height >> i, 1u)), {} };
+        levels[i].texels.resize(size_t(levels[i].width) * levels[i].height * 4);
+    }
+    levels[0].texels = source;
+
+    // Which levels were filtered from an 8 bit one, counted per level
+    std::vector<int> restarts(mipLevels, 0);
+    auto start = Clock::now();
+    for (uint32_t level = 0; level + 1 < mipLevels;) {
+        uint32_t sourceSize = (std::max)((std::max)(width >> level, height >> level), 1u);
+        uint32_t count = (std::min)(mipLevels - 1 - level, sourceSize <= MAX_TAIL_SOURCE ? MAX_LEVELS : MAX_LEVELS / 2);
+        Constants constants{ levels[level].width, levels[level].height, count, srgb };
+        dispatch(&levels[level], constants);
+        for (uint32_t i = level + 1; i <= level + count; i++) {
+            restarts[i] = (level > 0 ? restarts[level] + 1 : 0) + (i - level > 6 ? 1 : 0);
+        }
+        level += count;
+    }
+    double milliseconds = millisecondsSince(start);
+
+    bool within = true;
+    std::string errors;
+    for (uint32_t i = 1; i < mipLevels; i++) {
+        int error = 0;
+        for (size_t j = 0; j < expected[i].size(); j++) {
+            error = (std::max)(error, std::abs(int(levels[i].texels[j]) - int(expected[i][j])));
+        }
+        int tolerance = TOLERANCE + TOLERANCE_PER_RESTART * restarts[i];
+        within &= error <= tolerance;
+        errors += " " + std::to_string(error);
+    }
+    std::cout << width << "x" << height << (srgb ? " sRGB" : " UNORM") << ", " << milliseconds << " ms, error per level:" << errors
+        << (within ? "" : "  FAILED") << std::endl;
+    return within;
+}
+
+
+int main(int argc, char** argv) {
+    std::vector<std::pair<uint32_t, uint32_t>> sizes = {
+        { 1, 1 }, { 2, 1 }, { 1, 7 }, { 3, 5 }, { 64, 64 }, { 65, 63 }, { 100, 37 }, { 129, 257 }, { 1000, 700 },
+        { 4095, 33 }, { 4096, 4096 }, { 5000, 3001 }, { 8192, 64 }
+    };
+    if (argc > 2) sizes = { { uint32_t(std::atoi(argv[1])), uint32_t(std::atoi(argv[2])) } };
+
+    std::mt19937 random(1);
+    bool failed = false;
+    for (auto [width, height] : sizes) {
+        for (bool srgb : { false, true }) {
+            failed |= !compare(width, height, srgb, random);
+        }
+    }
+    if (failed) {
+        std::cerr << "levels off by more than the tolerance" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
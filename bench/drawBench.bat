@@ -0,0 +1,13 @@
+@echo off
+rem CPU command recording time against mesh count: the geometry pool (one indirect call) vs a buffer pair per mesh.
+rem Run from the app's working directory, eg drawBench.bat VulkanTutorial.exe, and compare the "Record:" lines.
+rem --lod 0 keeps the draws identical between runs
+set APP=%1
+if "%APP%"=="" set APP=VulkanTutorial.exe
+
+for %%n in (1 10 100 1000 5000) do (
+    echo === %%n meshes, geometry pool
+    %APP% --frames 500 --lod 0 --mesh-copies %%n | findstr /b "Record:"
+    echo === %%n meshes, separate buffers
+    %APP% --frames 500 --lod 0 --mesh-copies %%n --separate-buffers | findstr /b "Record:"
+)
\ No newline at end of file
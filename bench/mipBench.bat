@@ -0,0 +1,13 @@
+@echo off
+rem GPU mip generation at startup: one compute dispatch for the whole chain vs a vkCmdBlitImage (and two barriers) per level.
+rem Run from the app's working directory, eg mipBench.bat VulkanTutorial.exe big.png, and compare the "generateMipmaps" lines.
+rem The texture is decoded on every launch either way, only the mip step differs
+set APP=%1
+if "%APP%"=="" set APP=VulkanTutorial.exe
+set TEXTURE=%2
+if "%TEXTURE%"=="" set TEXTURE=../../textures/viking_room.png
+
+for %%m in (blit compute) do (
+    echo === %%m
+    for /l %%i in (1,1,5) do %APP% --frames 1 --texture %TEXTURE% --texture-format rgba8 --blit-mipmaps --mip-downsampler %%m | findstr /c:"generateMipmaps"
+)
\ No newline at end of file
@@ -0,0 +1,13 @@
+@echo off
+rem Eviction under a shrinking simulated budget (MB per device-local heap), so it also runs on lavapipe. Run from the app's
+rem working directory, eg residencyBench.bat VulkanTutorial.exe big.ktx2, and check on the "Memory budget:" lines that usage
+rem ends up under the budget, and on the "Evicted" line which texture mips and mesh LODs it took to get there
+set APP=%1
+if "%APP%"=="" set APP=VulkanTutorial.exe
+set TEXTURE=%2
+if "%TEXTURE%"=="" set TEXTURE=../../textures/viking_room.png
+
+for %%b in (0 256 64 16) do (
+    echo === --memory-budget %%b
+    %APP% --frames 60 --texture %TEXTURE% --separate-buffers --no-cull --mesh-copies 64 --memory-budget %%b | findstr /c:"Memory" /c:"heap" /c:"Evicted"
+)
\ No newline at end of file
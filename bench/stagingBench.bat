@@ -0,0 +1,14 @@
+@echo off
+rem Startup uploads through the persistent staging ring (sizes in MB) vs a staging buffer created, copied from, waited for
+rem and destroyed per upload (--staging-ring 0). Run from the app's working directory, eg stagingBench.bat VulkanTutorial.exe
+rem big.ktx2, and compare the GB/s and waits on the "Staging:" lines. --separate-buffers and --mesh-copies make many small
+rem uploads, the texture a few big ones
+set APP=%1
+if "%APP%"=="" set APP=VulkanTutorial.exe
+set TEXTURE=%2
+if "%TEXTURE%"=="" set TEXTURE=../../textures/viking_room.png
+
+for %%r in (0 16 64 256) do (
+    echo === --staging-ring %%r
+    for /l %%i in (1,1,3) do %APP% --frames 1 --texture %TEXTURE% --separate-buffers --mesh-copies 64 --staging-ring %%r | findstr /c:"Staging" /c:"initVulkan"
+)
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "texturePacker.h"
+
+
+// packTextures and writeAtlasEntry on random texture sets: every texture placed once inside its group, atlas entries on the
+// gutter grid without overlapping, gutters that repeat the edge texels, and no group over maxLayers. Exits non-zero if
+// any check fails
+static uint32_t failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition && failures++ < 20) {
+        std::cerr << "FAILED: " << what << std::endl;
+    }
+}
+
+
+static uint32_t alignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+
+// A few sizes shared by many textures (arrays), many odd ones of up to ATLAS_MAX_TEXTURE (the atlas) and some big odd
+// ones (images of their own)
+static std::vector<TextureSize> randomSizes(std::mt19937& random, uint32_t count) {
+    const TextureSize common[] = { { 64, 64 }, { 128, 128 }, { 256, 128 }, { 512, 512 } };
+    std::vector<TextureSize> sizes;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t kind = random() % 10;
+        if (kind < 4) sizes.push_back(common[random() % 4]);
+        else if (kind < 9) sizes.push_back({ 1 + uint32_t(random() % ATLAS_MAX_TEXTURE), 1 + uint32_t(random() % ATLAS_MAX_TEXTURE) });
+        else sizes.push_back({ ATLAS_MAX_TEXTURE + 1 + uint32_t(random() % 300), 1 + uint32_t(random() % 700) });
+    }
+    return sizes;
+}
+
+
+// Texel (x, y) of texture i, different for every texture and every texel
+static void sourceTexel(uint32_t texture, uint32_t x, uint32_t y, uint8_t texel[4]) {
+    texel[0] = uint8_t(x);
+    texel[1] = uint8_t(y);
+    texel[2] = uint8_t(texture);
+    texel[3] = uint8_t(x >> 8 | y >> 8 << 4 | texture >> 8 << 6);
+}
+
+
+static void testPacking(const std::vector<TextureSize>& sizes, uint32_t maxLayers, const std::string& name) {
+    TexturePacking packing = packTextures(sizes, maxLayers, true);
+    check(packing.placements.size() == sizes.size(), name + ": a placement per texture");
+
+    uint32_t atlasEntries = 0, atlasPages = 0;
+    for (const TextureGroup& group : packing.groups) {
+        check(group.layerCount >= 1 && group.layerCount <= maxLayers, name + ": group layers within 1.." + std::to_string(maxLayers));
+        if (group.atlas) {
+            check(group.mipLevels <= ATLAS_MIP_LEVELS && group.width <= ATLAS_MAX_PAGE_SIZE, name + ": atlas page size and mips");
+            atlasPages += group.layerCount;
+        }
+    }
+
+    // Array layers hold one texture each and of their size, atlas layers many on the gutter grid
+    std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t>> layers;
+    for (uint32_t i = 0; i < sizes.size(); i++) {
+        const TexturePlacement& placement = packing.placements[i];
+        std::string texture = name + ": texture " + std::to_string(i);
+        if (placement.group >= packing.groups.size()) {
+            check(false, texture + " in a group that does not exist");
+            continue;
+        }
+        const TextureGroup& group = packing.groups[placement.group];
+        check(placement.layer < group.layerCount, texture + " in one of its group's layers");
+        check(placement.width == sizes[i].width && placement.height == sizes[i].height, texture + " keeps its size");
+        layers[{ placement.group, placement.layer }].push_back(i);
+        if (!group.atlas) {
+            check(group.width == sizes[i].width && group.height == sizes[i].height && placement.x == 0 && placement.y == 0,
+                texture + " fills its array layer");
+            continue;
+        }
+        atlasEntries++;
+        check(placement.x % ATLAS_GUTTER == 0 && placement.y % ATLAS_GUTTER == 0, texture + " starts on the gutter grid");
+        check(placement.x >= ATLAS_GUTTER && placement.y >= ATLAS_GUTTER
+            && placement.x + alignUp(placement.width, ATLAS_GUTTER) + ATLAS_GUTTER <= group.width
+            && placement.y + alignUp(placement.height, ATLAS_GUTTER) + ATLAS_GUTTER <= group.height, texture + " and its gutter inside the page");
+    }
+
+    for (const auto& [layer, textures] : layers) {
+        const TextureGroup& group = packing.groups[layer.first];
+        if (!group.atlas) {
+            check(textures.size() == 1, name + ": one texture per array layer");
+            continue;
+        }
+
+        // Every entry with its gutter written into the page, then read back: nothing overlaps if every entry survives the
+        // ones written after it
+        std::vector<uint8_t> page(size_t(group.width) * group.height * 4, 0);
+        std::vector<uint8_t> owner(size_t(group.width) * group.height, 0);
+        std::vector<uint8_t> rgba;
+        for (uint32_t texture : textures) {
+            const TexturePlacement& placement = packing.placements[texture];
+            rgba.resize(size_t(placement.width) * placement.height * 4);
+            for (uint32_t y = 0; y < placement.height; y++) {
+                for (uint32_t x = 0; x < placement.width; x++) sourceTexel(texture, x, y, &rgba[(size_t(y) * placement.width + x) * 4]);
+            }
+            writeAtlasEntry(page.data(), group.width, placement, rgba.data());
+
+            uint32_t right = placement.x + alignUp(placement.width, ATLAS_GUTTER) + ATLAS_GUTTER;
+            uint32_t bottom = placement.y + alignUp(placement.height, ATLAS_GUTTER) + ATLAS_GUTTER;
+            for (uint32_t y = placement.y - ATLAS_GUTTER; y < bottom; y++) {
+                for (uint32_t x = placement.x - ATLAS_GUTTER; x < right; x++) {
+                    check(owner[size_t(y) * group.width + x]++ == 0, name + ": texture " + std::to_string(texture) + " overlaps another");
+                }
+            }
+        }
+        for (uint32_t texture : textures) {
+            const TexturePlacement& placement = packing.placements[texture];
+            uint32_t right = placement.x + alignUp(placement.width, ATLAS_GUTTER) + ATLAS_GUTTER;
+            uint32_t bottom = placement.y + alignUp(placement.height, ATLAS_GUTTER) + ATLAS_GUTTER;
+            bool replicated = true;
+            for (uint32_t y = placement.y - ATLAS_GUTTER; y < bottom; y++) {
+                uint32_t sourceY = std::clamp(int64_t(y) - placement.y, int64_t(0), int64_t(placement.height) - 1);
+                for (uint32_t x = placement.x - ATLAS_GUTTER; x < right; x++) {
+                    uint32_t sourceX = std::clamp(int64_t(x) - placement.x, int64_t(0), int64_t(placement.width) - 1);
+                    uint8_t expected[4];
+                    sourceTexel(texture, sourceX, sourceY, expected);
+                    replicated &= memcmp(&page[(size_t(y) * group.width + x) * 4], expected, 4) == 0;
+                }
+            }
+            check(replicated, name + ": texture " + std::to_string(texture) + " with its edge texels over the gutter");
+        }
+    }
+
+    std::cout << name << ": " << sizes.size() << " textures in " << packing.groups.size() << " groups, " << atlasEntries
+        << " of them on " << atlasPages << " atlas pages" << std::endl;
+}
+
+
+int main() {
+    std::mt19937 random(1);
+    for (uint32_t count : { 1u, 5u, 64u, 500u }) {
+        std::vector<TextureSize> sizes = randomSizes(random, count);
+        for (uint32_t maxLayers : { 1u, 2u, 16u, 2048u }) {
+            testPacking(sizes, maxLayers, std::to_string(count) + " textures, " + std::to_string(maxLayers) + " layers");
+        }
+    }
+
+    // Unpacked, every texture is a group of its own
+    std::vector<TextureSize> sizes = randomSizes(random, 100);
+    TexturePacking unpacked = packTextures(sizes, 16, false);
+    check(unpacked.groups.size() == sizes.size(), "unpacked: a group per texture");
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
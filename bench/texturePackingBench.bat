@@ -0,0 +1,15 @@
+@echo off
+rem Many small material textures, an image (allocation, view, sampler) each vs packed into arrays and atlas pages. Run from
+rem the app's working directory with a directory of small images, eg texturePackingBench.bat VulkanTutorial.exe ..\..\textures\icons,
+rem and compare the "Material textures:" lines (objects, device memory), the createMaterialTextures timings and the
+rem "Record:" lines (descriptor binds per frame)
+set APP=%1
+if "%APP%"=="" set APP=VulkanTutorial.exe
+set TEXTURES=%2
+
+for %%n in (10 100 1000) do (
+    echo === %%n materials, unpacked
+    %APP% --frames 500 --lod 0 --mesh-copies 1000 --materials %%n --material-textures %TEXTURES% --no-texture-packing | findstr /c:"Material textures:" /c:"createMaterialTextures" /c:"Record:"
+    echo === %%n materials, packed
+    %APP% --frames 500 --lod 0 --mesh-copies 1000 --materials %%n --material-textures %TEXTURES% | findstr /c:"Material textures:" /c:"createMaterialTextures" /c:"Record:"
+)
\ No newline at end of file
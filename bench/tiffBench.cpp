@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "tiff.h"
+
+
+// TIFFs written tiled and in strips, classic and BigTIFF, in both byte orders with 1 to 4 samples, then read back region by
+// region through TiffFile. Exits non-zero if any check fails
+static uint32_t failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition && failures++ < 20) {
+        std::cerr << "FAILED: " << what << std::endl;
+    }
+}
+
+
+struct Layout {
+    uint32_t width;
+    uint32_t height;
+    bool tiled;
+    uint32_t chunkWidth; // tiles only
+    uint32_t chunkHeight; // tile height, or rows per strip. 0 leaves out RowsPerStrip: one strip
+};
+
+struct Entry {
+    uint16_t tag;
+    uint16_t type;
+    std::vector<uint64_t> values;
+};
+
+
+// Sample c of texel (x, y), different for neighbouring texels and samples
+static uint8_t sourceSample(uint32_t x, uint32_t y, uint32_t c) {
+    return uint8_t(x * 7 + y * 13 + c * 61 + (x >> 8) * 3 + (y >> 8) * 5);
+}
+
+
+static void put(std::vector<uint8_t>& bytes, size_t offset, uint64_t value, uint32_t size, bool bigEndian) {
+    if (bytes.size() < offset + size) bytes.resize(offset + size);
+    for (uint32_t i = 0; i < size; i++) {
+        bytes[offset + (bigEndian ? size - 1 - i : i)] = uint8_t(value >> (8 * i));
+    }
+}
+
+
+// Image data first, then the values too big for their entries, then the only directory
+static std::vector<uint8_t> writeTiff(const Layout& layout, uint32_t samplesPerPixel, bool bigTiff, bool bigEndian) {
+    std::vector<uint8_t> bytes;
+    bytes.push_back(bigEndian ? 'M' : 'I');
+    bytes.push_back(bigEndian ? 'M' : 'I');
+    put(bytes, 2, bigTiff ? 43 : 42, 2, bigEndian);
+    if (bigTiff) {
+        put(bytes, 4, 8, 2, bigEndian);
+        put(bytes, 6, 0, 2, bigEndian);
+    }
+    size_t headerSize = bigTiff ? 16 : 8;
+    bytes.resize(headerSize);
+
+    // Tiles are stored whole, what lies past the image edge is junk
+    uint32_t chunkWidth = layout.tiled ? layout.chunkWidth : layout.width;
+    uint32_t rows = layout.chunkHeight == 0 ? layout.height : layout.chunkHeight;
+    uint32_t chunksX = layout.tiled ? (layout.width + chunkWidth - 1) / chunkWidth : 1;
+    uint32_t chunksY = (layout.height + rows - 1) / rows;
+    std::vector<uint64_t> offsets;
+    for (uint32_t chunkY = 0; chunkY < chunksY; chunkY++) {
+        for (uint32_t chunkX = 0; chunkX < chunksX; chunkX++) {
+            offsets.push_back(bytes.size());
+            uint32_t chunkRows = layout.tiled ? rows : (std::min)(rows, layout.height - chunkY * rows);
+            for (uint32_t row = 0; row < chunkRows; row++) {
+                for (uint32_t column = 0; column < chunkWidth; column++) {
+                    uint32_t x = chunkX * chunkWidth + column, y = chunkY * rows + row;
+                    for (uint32_t c = 0; c < samplesPerPixel; c++) {
+                        bool inside = x < layout.width && y < layout.height;
+                        bytes.push_back(inside ? sourceSample(x, y, c) : 0xAB);
+                    }
+                }
+            }
+        }
+    }
+
+    // Classic TIFF needs LONG offsets, BigTIFF gets LONG8 ones. Sizes are SHORT where they fit
+    uint16_t offsetType = bigTiff ? 16 : 4;
+    uint16_t sizeType = layout.width < 65536 && layout.height < 65536 ? 3 : 4;
+    std::vector<Entry> entries = {
+        { 256, sizeType, { layout.width } },
+        { 257, sizeType, { layout.height } },
+        { 258, 3, std::vector<uint64_t>(samplesPerPixel, 8) },
+        { 259, 3, { 1 } },
+        { 262, 3, { samplesPerPixel >= 3 ? 2u : 1u } },
+        { 277, 3, { samplesPerPixel } },
+        { 284, 3, { 1 } },
+    };
+    if (layout.tiled) {
+        entries.push_back({ 322, sizeType, { layout.chunkWidth } });
+        entries.push_back({ 323, sizeType, { layout.chunkHeight } });
+        entries.push_back({ 324, offsetType, offsets });
+    }
+    else {
+        entries.push_back({ 273, offsetType, offsets });
+        if (layout.chunkHeight != 0) entries.push_back({ 278, 4, { layout.chunkHeight } });
+    }
+
+    auto typeSize = [](uint16_t type) { return type == 3 ? 2u : type == 4 ? 4u : 8u; };
+    uint32_t inlineBytes = bigTiff ? 8 : 4;
+    std::vector<uint64_t> valueOffsets(entries.size(), 0);
+    for (size_t i = 0; i < entries.size(); i++) {
+        uint32_t size = typeSize(entries[i].type);
+        if (entries[i].values.size() * size <= inlineBytes) continue;
+        if (bytes.size() % 2) bytes.push_back(0);
+        valueOffsets[i] = bytes.size();
+        for (uint64_t value : entries[i].values) put(bytes, bytes.size(), value, size, bigEndian);
+    }
+
+    if (bytes.size() % 2) bytes.push_back(0);
+    uint64_t ifdOffset = bytes.size();
+    put(bytes, bigTiff ? 8 : 4, ifdOffset, bigTiff ? 8 : 4, bigEndian);
+    put(bytes, ifdOffset, entries.size(), bigTiff ? 8 : 2, bigEndian);
+    size_t entrySize = bigTiff ? 20 : 12;
+    size_t firstEntry = ifdOffset + (bigTiff ? 8 : 2);
+    for (size_t i = 0; i < entries.size(); i++) {
+        size_t entry = firstEntry + i * entrySize;
+        size_t valuePosition = entry + (bigTiff ? 12 : 8);
+        put(bytes, entry, entries[i].tag, 2, bigEndian);
+        put(bytes, entry + 2, entries[i].type, 2, bigEndian);
+        put(bytes, entry + 4, entries[i].values.size(), bigTiff ? 8 : 4, bigEndian);
+        put(bytes, valuePosition, 0, inlineBytes, bigEndian);
+        if (valueOffsets[i] != 0) {
+            put(bytes, valuePosition, valueOffsets[i], inlineBytes, bigEndian);
+            continue;
+        }
+        uint32_t size = typeSize(entries[i].type);
+        for (size_t j = 0; j < entries[i].values.size(); j++) {
+            put(bytes, valuePosition + j * size, entries[i].values[j], size, bigEndian);
+        }
+    }
+    put(bytes, firstEntry + entries.size() * entrySize, 0, bigTiff ? 8 : 4, bigEndian); // no next directory
+    return bytes;
+}
+
+
+static void roundTrip(const std::string& path, const Layout& layout, uint32_t samplesPerPixel, bool bigTiff, bool bigEndian) {
+    std::string name = std::string(bigTiff ? "BigTIFF " : "TIFF ") + (bigEndian ? "MM " : "II ") + std::to_string(layout.width) + "x"
+        + std::to_string(layout.height) + (layout.tiled ? " tiled " : " in strips ") + std::to_string(samplesPerPixel) + " samples";
+    std::vector<uint8_t> bytes = writeTiff(layout, samplesPerPixel, bigTiff, bigEndian);
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+
+    TiffFile tiff;
+    try {
+        check(tiff.open(path), name + ": opens");
+    }
+    catch (const std::exception& e) {
+        check(false, name + ": opens, not " + e.what());
+        return;
+    }
+    check(tiff.width() == layout.width && tiff.height() == layout.height, name + ": size");
+    check(tiff.tiled() == layout.tiled, name + ": tiled or not");
+    if (layout.tiled) {
+        check(tiff.regionWidth() == layout.chunkWidth && tiff.regionHeight() == layout.chunkHeight, name + ": regions are the tiles");
+    }
+    else {
+        check(tiff.regionWidth() == layout.width && uint64_t(tiff.regionHeight()) * layout.width * 4 <= (std::max)(TIFF_BAND_BYTES, uint64_t(layout.width) * 4),
+            name + ": regions are bands of whole rows");
+    }
+
+    // Every texel inside the image, expanded to RGBA as TiffFile documents
+    std::vector<uint8_t> rgba(size_t(tiff.regionWidth()) * tiff.regionHeight() * 4);
+    bool matches = true;
+    for (uint32_t regionY = 0; regionY < tiff.regionsY(); regionY++) {
+        for (uint32_t regionX = 0; regionX < tiff.regionsX(); regionX++) {
+            tiff.readRegion(regionX, regionY, rgba.data());
+            for (uint32_t row = 0; row < tiff.regionHeight(); row++) {
+                for (uint32_t column = 0; column < tiff.regionWidth(); column++) {
+                    uint32_t x = regionX * tiff.regionWidth() + column, y = regionY * tiff.regionHeight() + row;
+                    if (x >= layout.width || y >= layout.height) continue;
+                    uint8_t s[4] = { sourceSample(x, y, 0), sourceSample(x, y, 1), sourceSample(x, y, 2), sourceSample(x, y, 3) };
+                    uint8_t expected[4];
+                    switch (samplesPerPixel) {
+                    case 1: expected[0] = expected[1] = expected[2] = s[0]; expected[3] = 255; break;
+                    case 2: expected[0] = expected[1] = expected[2] = s[0]; expected[3] = s[1]; break;
+                    case 3: memcpy(expected, s, 3); expected[3] = 255; break;
+                    default: memcpy(expected, s, 4); break;
+                    }
+                    matches &= memcmp(&rgba[(size_t(row) * tiff.regionWidth() + column) * 4], expected, 4) == 0;
+                }
+            }
+        }
+    }
+    check(matches, name + ": every texel read back");
+    tiff.close();
+}
+
+
+int main() {
+    check(isTiffPath("a.tif") && isTiffPath("a.tiff") && isTiffPath("A.TIF") && isTiffPath("b/A.Tiff"), "isTiffPath in any case");
+    check(!isTiffPath("a.png") && !isTiffPath("tif") && !isTiffPath("a.tif.png") && !isTiffPath("a.tiffs"), "isTiffPath on other files");
+
+    std::string path = (std::filesystem::temp_directory_path() / "tiffBench.tif").string();
+    TiffFile missing;
+    check(!missing.open(path + ".missing"), "a missing file does not open");
+
+    const Layout layouts[] = {
+        { 37, 23, true, 16, 16 }, // edge tiles cut off on both sides
+        { 64, 48, true, 32, 48 },
+        { 37, 23, false, 0, 5 }, // a short last strip
+        { 19, 7, false, 0, 0 }, // no RowsPerStrip, one strip
+        { 1100, 1000, false, 0, 7 }, // two bands, one of them starting inside a strip
+    };
+    uint32_t files = 0;
+    for (bool bigTiff : { false, true }) {
+        for (bool bigEndian : { false, true }) {
+            for (uint32_t samplesPerPixel = 1; samplesPerPixel <= 4; samplesPerPixel++) {
+                for (const Layout& layout : layouts) {
+                    roundTrip(path, layout, samplesPerPixel, bigTiff, bigEndian);
+                    files++;
+                }
+            }
+        }
+    }
+    std::filesystem::remove(path);
+    std::cout << files << " files read back" << std::endl;
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+@echo off
+rem Loading a texture bigger than host memory budgets: an uncompressed tiled TIFF (eg gdal_translate -co TILED=YES big.vrt
+rem big.tif) streamed tile by tile through the staging ring. Run from the app's working directory, eg
+rem tiledTextureBench.bat VulkanTutorial.exe ortho32k.tif, and check that peak resident on the "Texture:" line stays flat
+rem as the image grows, with the read and copy time on the "Texture tiles:" and "createTextureImage" lines
+set APP=%1
+if "%APP%"=="" set APP=VulkanTutorial.exe
+set TEXTURE=%2
+if "%TEXTURE%"=="" set TEXTURE=ortho.tif
+
+for %%m in (blit compute) do (
+    echo === %%m mips
+    %APP% --frames 1 --texture %TEXTURE% --mip-downsampler %%m | findstr /c:"Texture" /c:"createTextureImage" /c:"generateMipmaps"
+)
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include "virtualTexture.h"
+
+
+// The virtual texture's CPU side without the device: the page table along a scripted camera path, and pages cut out of
+// levels whose sides are and are not multiples of a BCn block. Exits non-zero if any check fails
+static uint32_t failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition && failures++ < 20) {
+        std::cerr << "FAILED: " << what << std::endl;
+    }
+}
+
+
+static uint32_t wrapTexel(int64_t texel, uint32_t size) {
+    int64_t wrapped = texel % size;
+    return static_cast<uint32_t>(wrapped < 0 ? wrapped + size : wrapped);
+}
+
+
+// What shader_virtual.frag asks for at uv: the page of that level, REPEAT by hand
+static uint32_t pageAt(const VirtualPageTable& table, uint32_t width, uint32_t height, uint32_t level, float u, float v) {
+    u -= std::floor(u);
+    v -= std::floor(v);
+    uint32_t levelWidth = (std::max)(width >> level, 1u), levelHeight = (std::max)(height >> level, 1u);
+    uint32_t x = (std::min)(uint32_t(u * levelWidth) / VIRTUAL_PAGE_PAYLOAD, table.levelPagesX(level) - 1);
+    uint32_t y = (std::min)(uint32_t(v * levelHeight) / VIRTUAL_PAGE_PAYLOAD, table.levelPagesY(level) - 1);
+    return table.pageId(level, x, y);
+}
+
+
+// The camera's view of frame f: a 240 texel square of one level, panning across the texture and over its right edge (so
+// the REPEAT wrap gets asked for), zooming in from level 3 to level 0 on the way, and holding still at the end
+static std::set<uint32_t> viewPages(const VirtualPageTable& table, uint32_t width, uint32_t height, uint32_t frame, uint32_t frames) {
+    uint32_t level = 3 - (std::min)(frame * 4 / frames, 3u);
+    float t = (std::min)(float(frame) / (frames * 3 / 4), 1.0f);
+    float centerU = 0.2f + 1.0f * t, centerV = 0.4f + 0.3f * t;
+    float spanU = 240.0f / (std::max)(width >> level, 1u), spanV = 240.0f / (std::max)(height >> level, 1u);
+
+    std::set<uint32_t> pages;
+    for (uint32_t j = 0; j < 16; j++) {
+        for (uint32_t i = 0; i < 16; i++) {
+            float u = centerU + spanU * (i / 15.0f - 0.5f), v = centerV + spanV * (j / 15.0f - 0.5f);
+            pages.insert(pageAt(table, width, height, level, u, v));
+        }
+    }
+    return pages;
+}
+
+
+// Frame by frame as updateVirtualTexture does it, with the loader a frame behind: the pages a frame samples are touched,
+// the misses are mapped the next frame. A model of the LRU order says which page each map may evict
+static void testCameraPath() {
+    const uint32_t width = 3000, height = 2000, slotsPerRow = 7, frames = 400;
+    uint32_t levelCount = 1;
+    while ((std::max)(width, height) >> levelCount) levelCount++;
+
+    VirtualPageTable table;
+    table.reset(width, height, levelCount, slotsPerRow);
+    std::vector<uint64_t> lastUsed(table.pageCount(), 0);
+    std::set<uint32_t> pinned;
+    for (uint32_t level = 0; level < table.levelCount(); level++) {
+        if (table.levelPagesX(level) == 1 && table.levelPagesY(level) == 1) {
+            uint32_t page = table.pageId(level, 0, 0), evicted;
+            check(table.map(page, 0, evicted) != VirtualPageTable::NONE && evicted == VirtualPageTable::NONE, "tail page gets a free slot");
+            table.pin(page);
+            pinned.insert(page);
+        }
+    }
+
+    uint64_t evictions = 0;
+    std::set<uint32_t> previous, loading;
+    std::vector<uint32_t> entries(table.pageCount());
+    for (uint32_t frame = 1; frame <= frames; frame++) {
+        std::string at = " at frame " + std::to_string(frame);
+        std::set<uint32_t> view = viewPages(table, width, height, frame, frames);
+
+        std::set<uint32_t> misses;
+        for (uint32_t page : view) {
+            table.touch(page, frame);
+            uint32_t level, x, y;
+            table.pagePosition(page, level, x, y);
+            for (; level < table.levelCount(); level++) {
+                uint32_t standIn = table.ancestor(page, level);
+                if (table.isResident(standIn)) lastUsed[standIn] = frame;
+            }
+            if (!table.isResident(page) && !loading.count(page)) misses.insert(page);
+        }
+
+        // Last frame's misses arrive. Each takes a free slot, else the least recently used page's that this frame left alone
+        for (uint32_t page : loading) {
+            bool full = table.residentCount() == table.slotCount();
+            uint64_t oldest = UINT64_MAX;
+            for (uint32_t resident = 0; resident < table.pageCount(); resident++) {
+                if (table.isResident(resident) && !pinned.count(resident) && lastUsed[resident] < frame) {
+                    oldest = (std::min)(oldest, lastUsed[resident]);
+                }
+            }
+
+            uint32_t evicted;
+            uint32_t slot = table.map(page, frame, evicted);
+            if (!full) {
+                check(slot != VirtualPageTable::NONE && evicted == VirtualPageTable::NONE, "free slot used first" + at);
+            }
+            else if (oldest == UINT64_MAX) {
+                check(slot == VirtualPageTable::NONE, "nothing evicted when every slot was used this frame" + at);
+            }
+            else {
+                check(slot != VirtualPageTable::NONE && evicted != VirtualPageTable::NONE, "full cache evicts" + at);
+                if (evicted != VirtualPageTable::NONE) {
+                    check(!pinned.count(evicted), "pinned tail page never evicted" + at);
+                    check(lastUsed[evicted] == oldest, "least recently used page evicted" + at);
+                    evictions++;
+                }
+            }
+            if (slot != VirtualPageTable::NONE) {
+                check(table.slotOf(page) == slot, "mapped page in its slot" + at);
+                lastUsed[page] = frame;
+            }
+        }
+        loading = misses;
+
+        // What the view asked for twice in a row is in by now, and the tail never goes
+        for (uint32_t page : view) {
+            if (previous.count(page)) check(table.isResident(page), "page " + std::to_string(page) + " resident" + at);
+        }
+        for (uint32_t page : pinned) {
+            check(table.isResident(page), "tail page resident" + at);
+        }
+        previous = view;
+
+        // Every entry points at the first resident page on its way up the chain, the page itself if it is in
+        table.writeEntries(entries.data());
+        for (uint32_t page = 0; page < table.pageCount(); page++) {
+            uint32_t entry = entries[page], level, x, y;
+            table.pagePosition(page, level, x, y);
+            uint32_t entryLevel = (entry >> 16) & 0xFF, slot = (entry & 0xFF) + ((entry >> 8) & 0xFF) * slotsPerRow;
+            check((entry & VIRTUAL_ENTRY_VALID) != 0, "entry valid" + at);
+            check(entryLevel >= level && entryLevel < table.levelCount(), "entry level" + at);
+            if (entryLevel < level || entryLevel >= table.levelCount()) continue;
+            check(table.slotOf(table.ancestor(page, entryLevel)) == slot, "entry slot holds the ancestor" + at);
+            for (uint32_t finer = level; finer < entryLevel; finer++) {
+                check(!table.isResident(table.ancestor(page, finer)), "entry falls back to the first resident ancestor" + at);
+            }
+        }
+    }
+
+    check(evictions > 0, "the path overflows the cache");
+    std::cout << "camera path: " << frames << " frames, " << table.pageCount() << " pages in " << table.slotCount() << " slots, "
+        << evictions << " evictions" << std::endl;
+}
+
+
+// A gradient in red and green, so a border that wraps to the wrong texel is far off, blue and alpha mark the texel's block
+static std::vector<uint8_t> gradient(uint32_t width, uint32_t height) {
+    std::vector<uint8_t> rgba(size_t(width) * height * 4);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            uint8_t* texel = &rgba[(size_t(y) * width + x) * 4];
+            texel[0] = uint8_t(x * 255 / (std::max)(width - 1, 1u));
+            texel[1] = uint8_t(y * 255 / (std::max)(height - 1, 1u));
+            texel[2] = uint8_t((x / 4 + y / 4) % 2 * 255);
+            texel[3] = 255;
+        }
+    }
+    return rgba;
+}
+
+
+// Every page of a level, decoded, against the texel the shader's fract(uv) lands on: the source's for RGBA8, what decoding
+// the whole level gives for BCn. Then the same pages cut without decoding: a block that lines up with one of the level's
+// is a copy of it, one that straddles the wrap is its wrapped texels encoded again
+static void testPageExtraction(VkFormat format, uint32_t width, uint32_t height) {
+    BlockFormat block;
+    bool srgb;
+    bool compressed = blockFormatOf(format, block, srgb);
+    std::vector<uint8_t> expected = gradient(width, height);
+    std::vector<uint8_t> data = expected;
+    if (compressed) {
+        data.resize(compressedSize(block, width, height));
+        compressImage(block, expected.data(), width, height, data.data());
+        decompressImage(block, data.data(), width, height, expected.data());
+    }
+    Ktx2Level level{ data, width, height };
+    std::string name = std::to_string(format) + " " + std::to_string(width) + "x" + std::to_string(height);
+
+    uint32_t pagesX = (width + VIRTUAL_PAGE_PAYLOAD - 1) / VIRTUAL_PAGE_PAYLOAD, pagesY = (height + VIRTUAL_PAGE_PAYLOAD - 1) / VIRTUAL_PAGE_PAYLOAD;
+    std::vector<uint8_t> page(VIRTUAL_PAGE_SIZE * VIRTUAL_PAGE_SIZE * 4), expectedPage(page.size());
+    std::vector<uint8_t> blocks(virtualPageBytes(format, false));
+    uint32_t wrong = 0, copied = 0, rebuilt = 0;
+    for (uint32_t y = 0; y < pagesY; y++) {
+        for (uint32_t x = 0; x < pagesX; x++) {
+            int64_t originX = int64_t(x) * VIRTUAL_PAGE_PAYLOAD - VIRTUAL_PAGE_BORDER, originY = int64_t(y) * VIRTUAL_PAGE_PAYLOAD - VIRTUAL_PAGE_BORDER;
+            for (uint32_t j = 0; j < VIRTUAL_PAGE_SIZE; j++) {
+                uint32_t sy = wrapTexel(originY + j, height);
+                for (uint32_t i = 0; i < VIRTUAL_PAGE_SIZE; i++) {
+                    uint32_t sx = wrapTexel(originX + i, width);
+                    memcpy(&expectedPage[(j * VIRTUAL_PAGE_SIZE + i) * 4], &expected[(size_t(sy) * width + sx) * 4], 4);
+                }
+            }
+            extractVirtualPage(level, format, true, x, y, page.data());
+            wrong += page != expectedPage;
+            if (!compressed) continue;
+
+            extractVirtualPage(level, format, false, x, y, blocks.data());
+            uint32_t pageBlocks = VIRTUAL_PAGE_SIZE / 4, bytes = blockBytes(block);
+            for (uint32_t j = 0; j < pageBlocks; j++) {
+                uint32_t sy = wrapTexel(originY + j * 4, height);
+                for (uint32_t i = 0; i < pageBlocks; i++) {
+                    uint32_t sx = wrapTexel(originX + i * 4, width);
+                    const uint8_t* actual = &blocks[(size_t(j) * pageBlocks + i) * bytes];
+                    if (sx % 4 == 0 && sx + 4 <= width && sy % 4 == 0 && sy + 4 <= height) {
+                        wrong += memcmp(actual, &data[(size_t(sy / 4) * ((width + 3) / 4) + sx / 4) * bytes], bytes) != 0;
+                        copied++;
+                        continue;
+                    }
+                    uint8_t texels[64], encoded[16];
+                    for (uint32_t row = 0; row < 4; row++) {
+                        memcpy(texels + row * 16, &expectedPage[((j * 4 + row) * VIRTUAL_PAGE_SIZE + i * 4) * 4], 16);
+                    }
+                    compressImage(block, texels, 4, 4, encoded);
+                    wrong += memcmp(actual, encoded, bytes) != 0;
+                    rebuilt++;
+                }
+            }
+        }
+    }
+
+    check(wrong == 0, std::to_string(wrong) + " wrong pages or blocks of " + name);
+    std::cout << "pages of " << name << ": " << pagesX * pagesY << " pages";
+    if (compressed) std::cout << ", " << copied << " blocks copied and " << rebuilt << " rebuilt across the wrap";
+    std::cout << std::endl;
+}
+
+
+int main() {
+    try {
+        testCameraPath();
+        for (VkFormat format : { VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK }) {
+            testPageExtraction(format, 240, 120); // whole blocks
+            testPageExtraction(format, 250, 130); // neither side a multiple of 4
+            testPageExtraction(format, 3, 2); // smaller than a block
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
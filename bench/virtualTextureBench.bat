@@ -0,0 +1,13 @@
+@echo off
+rem Virtual texturing against cache size, on the scripted camera path so every run sees the same views. Run from the app's
+rem working directory, eg virtualTextureBench.bat VulkanTutorial.exe, and compare device memory on the "Texture:" lines with
+rem the pages uploaded and evicted on the "Virtual texture:" ones. For lavapipe, point VK_ICD_FILENAMES at its lvp_icd json first
+set APP=%1
+if "%APP%"=="" set APP=VulkanTutorial.exe
+
+echo === whole texture resident
+%APP% --frames 2400 --camera-path | findstr /b "Texture:"
+for %%n in (4 8 16 32) do (
+    echo === %%n x %%n page cache
+    %APP% --frames 2400 --camera-path --virtual-texture %%n | findstr /b "Texture: Virtual"
+)
\ No newline at end of file
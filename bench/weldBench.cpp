@@ -0,0 +1,110 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include "meshCache.h"
+#include "objParser.h"
+#include "options.h"
+#include "profiling.h"
+#include "vertexWeld.h"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+
+// The hash vertex.h used before the weld table
+struct LegacyVertexHash {
+    size_t operator()(Vertex const& vertex) const {
+        return ((std::hash<glm::vec3>()(vertex.pos) ^
+            (std::hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
+            (std::hash<glm::vec2>()(vertex.texCoord) << 1);
+    }
+};
+
+
+// The model's un-welded corner stream, repeated on an integer grid. Grid-aligned copies are what the legacy hash is worst at
+static std::vector<Vertex> buildCorners(const std::string& path, int copies) {
+    std::vector<Vertex> modelVertices;
+    std::vector<uint32_t> modelIndices;
+    parseObj(path, modelVertices, modelIndices);
+
+    std::vector<Vertex> corners;
+    corners.reserve(modelIndices.size() * copies);
+    for (int copy = 0; copy < copies; copy++) {
+        glm::vec3 offset(copy % 16, (copy / 16) % 16, copy / 256);
+        for (uint32_t index : modelIndices) {
+            Vertex vertex = modelVertices[index];
+            vertex.pos += offset;
+            corners.push_back(vertex);
+        }
+    }
+    return corners;
+}
+
+
+static void weld(const std::string& mode, const std::vector<Vertex>& corners, std::vector<Vertex>& welded, std::vector<uint32_t>& weldedIndices) {
+    if (mode == "map") {
+        // Exactly the old loadModel loop
+        std::unordered_map<Vertex, uint32_t, LegacyVertexHash> uniqueVertices{};
+        for (const auto& vertex : corners) {
+            if (uniqueVertices.count(vertex) == 0) {
+                uniqueVertices[vertex] = static_cast<uint32_t>(welded.size());
+                welded.push_back(vertex);
+            }
+            weldedIndices.push_back(uniqueVertices[vertex]);
+        }
+    }
+    else if (mode == "table") {
+        VertexWelder welder(welded, corners.size());
+        weldedIndices.reserve(corners.size());
+        for (const auto& vertex : corners) {
+            weldedIndices.push_back(welder.add(vertex));
+        }
+    }
+    else if (mode == "parallel") {
+        weldParallel(corners.size(), [&](size_t i) { return corners[i]; }, welded, weldedIndices);
+    }
+    else {
+        throw std::runtime_error("unknown mode: " + mode);
+    }
+}
+
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 1 ? argv[1] : "all";
+    std::string path = argc > 2 ? argv[2] : Options().modelPath;
+    int copies = argc > 3 ? std::atoi(argv[3]) : 64;
+
+    // Peak RSS is per process, so every mode gets its own
+    if (mode == "all") {
+        int result = 0;
+        for (const char* each : { "map", "table", "parallel" }) {
+            std::string command = std::string("\"") + argv[0] + "\" " + each + " \"" + path + "\" " + std::to_string(copies);
+            result |= std::system(command.c_str());
+        }
+        return result;
+    }
+
+    try {
+        std::vector<Vertex> corners = buildCorners(path, copies);
+        size_t baseBytes = peakResidentBytes();
+
+        std::vector<Vertex> welded;
+        std::vector<uint32_t> weldedIndices;
+        auto start = Clock::now();
+        weld(mode, corners, welded, weldedIndices);
+        double milliseconds = millisecondsSince(start);
+
+        // Same checksum from every mode means the same vertex order and indices
+        uint64_t checksum = hashBytes(reinterpret_cast<const uint8_t*>(weldedIndices.data()), weldedIndices.size() * sizeof(uint32_t));
+
+        std::cout << mode << ": " << corners.size() << " corners -> " << welded.size() << " vertices in " << milliseconds << " ms, "
+            << "peak RSS +" << (peakResidentBytes() - baseBytes) / (1024.0 * 1024.0) << " MB, checksum " << std::hex << checksum << std::dec << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
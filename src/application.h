@@ -3,7 +3,29 @@
 #include <GLFW/glfw3.h>
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3native.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <span>
+#include <thread>
 #include <vector>
+#include "defrag.h"
+#include "deviceMemory.h"
+#include "frameArena.h"
+#include "geometryPool.h"
+#include "imageDecoder.h"
+#include "ktx2.h"
+#include "options.h"
+#include "residency.h"
+#include "profiling.h"
+#include "stagingRing.h"
+#include "texturePacker.h"
+#include "tiff.h"
+#include "virtualTexture.h"
 
 
 struct QueueFamilyIndices;
@@ -13,6 +35,7 @@ struct SwapChainSupportDetails;
 class Application {
 public:
     void run() {
+        launchTime = Clock::now();
         initWindow();
         initVulkan();
         mainLoop();
@@ -22,40 +45,64 @@ public:
     void initWindow();
 
     void initVulkan() {
+        auto start = Clock::now();
         createInstance();
         setupDebugMessenger();
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        createMemoryAllocator();
         createSwapChain();
         createImageViews();
         createRenderPass();
         createDescriptorSetLayout();
+        createMeshletSetLayout();
         createGraphicsPipeline();
         createCommandPool();
+        createStagingRing();
         createColorResources();
         createDepthResources();
         createFramebuffers();
+        loadModel(); // first, a .glb can carry the texture
         createTextureImage();
         createTextureImageView();
         createTextureSampler();
-        loadModel();
-        createVertexBuffer();
-        createIndexBuffer();
-        createUniformBuffers();
+        createMaterialTextures(); // before the pool, whose draws say which texture
+        createGeometryPool();
+        createMeshletBuffers();
+        releaseModel(); // the GPU has everything now
+        releaseTextureStaging();
+        finishStaging();
+        createFrameArena();
         createDescriptorPool();
         createDescriptorSets();
+        createMeshletDescriptorSets();
+        createCullPipeline();
         createCommandBuffers();
         createSyncObjects();
+        createResidency();
+        createDefragmentation();
+
+        startupTimings.add("initVulkan (total)", millisecondsSince(start));
+        startupTimings.print("Startup");
+        printStagingStats();
     }
 
     void mainLoop() {
-        while (!glfwWindowShouldClose(window)) {
+        uint32_t frame = 0;
+        while (!glfwWindowShouldClose(window) && (options.frames == 0 || frame++ < options.frames)) {
             glfwPollEvents();
             drawFrame();
         }
 
         vkDeviceWaitIdle(device);
+        printFrameStats();
+        printTextureStreamingStats();
+        printVirtualTextureStats();
+        printFrameArenaStats();
+        printResidencyStats();
+        printDefragStats();
+        printDeviceMemoryStats();
     }
 
     void cleanup();
@@ -82,6 +129,37 @@ private:
     */
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device;
+    bool memoryBudgetSupported = false; // VK_EXT_memory_budget enabled, see queryMemoryBudget
+
+
+    /*
+        Device Memory
+    */
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize bufferImageGranularity = 1;
+    bool dedicatedAllocationQueries = false; // vkGet*MemoryRequirements2 and VkMemoryDedicatedAllocateInfo, core in 1.1
+    std::vector<std::unique_ptr<MemoryBlock>> memoryBlocks; // nullptr where a block was given back
+    std::mutex memoryMutex; // the decode worker allocates the texture staging buffer
+    uint32_t excludedBlock = DEDICATED_ALLOCATION; // allocateMemory does not put anything there, the block being emptied by defragmentation
+    DeviceMemoryStats memoryStats;
+
+
+    /*
+        Staging Ring
+    */
+    VkBuffer stagingRingBuffer = VK_NULL_HANDLE;
+    DeviceAllocation stagingRingMemory; // mapped the whole time
+    VkDeviceSize stagingRingSize = 0; // 0 with --staging-ring 0
+    VkDeviceSize stagingRingHead = 0; // in use is [tail, head), wrapping
+    VkDeviceSize stagingRingTail = 0;
+    bool stagingRingInUse = false; // tells full from empty when head == tail
+    StagingSubmit stagingBatch; // being recorded, no command buffer when there is none
+    VkDeviceSize stagingBatchBytes = 0;
+    std::deque<StagingSubmit> stagingSubmits; // on the GPU, oldest first
+    std::vector<StagingSubmit> idleStagingSubmits; // command buffers and fences to reuse
+    VkBuffer oneOffStagingBuffer = VK_NULL_HANDLE; // --staging-ring 0
+    DeviceAllocation oneOffStagingMemory;
+    StagingStats stagingStats;
 
 
     /*
@@ -89,6 +167,7 @@ private:
     */
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    VkQueue transferQueue; // texture streaming copies. A separate copy engine where there is one, else graphicsQueue itself
 
 
     /*
@@ -110,10 +189,99 @@ private:
         Texture
     */
     uint32_t mipLevels;
+    VkFormat textureFormat = VK_FORMAT_R8G8B8A8_SRGB; // BCn when the device samples it, see --texture-format
+    VkExtent2D textureExtent;
     VkImage textureImage;
-    VkDeviceMemory textureImageMemory;
-    VkImageView textureImageView;
+    DeviceAllocation textureImageMemory;
+    VkImageView textureImageView; // only the resident levels, replaced as more stream in
     VkSampler textureSampler;
+    VkImageUsageFlags textureViewUsage = 0; // narrower than the image's when it also has storage usage, see generateMipmapsCompute
+    bool textureDecodeToRgba8 = false; // BCn file on a device without BC, every level is decoded on the CPU
+    VkBuffer textureStagingBuffer = VK_NULL_HANDLE; // shared by the texture uploads, grown as needed
+    DeviceAllocation textureStagingBufferMemory;
+    uint8_t* textureStagingData = nullptr; // mapped for as long as it lives
+    VkDeviceSize textureStagingSize = 0;
+
+
+    /*
+        Texture Streaming
+    */
+    std::unique_ptr<Ktx2File> streamingTexture; // stays mapped until every level is on the GPU
+    uint32_t textureResidentLevel = 0; // finest level the view exposes, counts down to 0 as levels arrive
+    std::thread streamingThread; // reads (and decodes) levels into staging, finest last
+    std::atomic<bool> streamingStop{ false };
+    std::mutex streamingMutex;
+    std::vector<uint32_t> stagedLevels; // ready in staging, waiting for a copy. Guarded by streamingMutex
+    std::vector<bool> copiedLevels;
+    VkBuffer streamingStagingBuffer = VK_NULL_HANDLE;
+    DeviceAllocation streamingStagingBufferMemory;
+    void* streamingStagingData = nullptr; // mapped the whole time
+    std::vector<VkDeviceSize> streamingOffsets; // per level, into the staging buffer
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+    struct StreamingCopy {
+        uint32_t level;
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+    };
+    std::vector<StreamingCopy> streamingCopies; // submitted, polled every frame
+    std::vector<VkImageView> frameTextureViews; // what each frame's descriptor set points at
+    std::vector<VkImageView> retiredTextureViews; // replaced, destroyed once no descriptor set uses them
+    Clock::time_point launchTime;
+    Clock::time_point streamingStart;
+    double firstFrameMilliseconds = 0.0; // since launch
+    double textureResidentMilliseconds = 0.0; // since launch, when the last level landed
+    std::vector<uint64_t> residentLevelFrames; // frames drawn with each level as the finest resident one
+
+
+    /*
+        Virtual Texture
+    */
+    bool virtualTexturing = false; // --virtual-texture and supported. textureImage is then the page cache, a single level
+    std::unique_ptr<Ktx2File> virtualTexture; // pages are cut out of it as they are asked for, so it stays mapped
+    VirtualPageTable virtualPages; // which page is in which slot. Main thread only, the loader just reads the layout
+    VkFormat virtualSourceFormat; // the file's, textureFormat is the cache's
+    uint32_t virtualPageSize = 0; // bytes of a page in staging
+    // Per frame in flight: the page table the frame's shader reads, and the flag per page it sets for the pages it samples
+    std::vector<VkBuffer> pageTableBuffers;
+    std::vector<DeviceAllocation> pageTableBuffersMemory;
+    std::vector<void*> pageTableBuffersMapped;
+    std::vector<uint64_t> pageTableVersions; // the version each frame's table was written at
+    uint64_t pageTableVersion = 0; // bumped whenever a page gets a slot
+    std::vector<VkBuffer> feedbackBuffers;
+    std::vector<DeviceAllocation> feedbackBuffersMemory;
+    std::vector<void*> feedbackBuffersMapped;
+    VkBuffer pageStagingBuffer = VK_NULL_HANDLE; // VIRTUAL_STAGING_PAGES pages
+    DeviceAllocation pageStagingBufferMemory;
+    uint8_t* pageStagingData = nullptr; // mapped the whole time
+    std::thread pageLoaderThread;
+    std::mutex pageLoaderMutex;
+    std::condition_variable pageLoaderWake;
+    bool pageLoaderStop = false; // guarded by pageLoaderMutex
+    std::deque<uint32_t> pageRequests; // pages waiting for the loader, newest first. Guarded by pageLoaderMutex
+    std::vector<std::pair<uint32_t, uint32_t>> loadedPages; // page, staging page it is in. Guarded by pageLoaderMutex
+    std::vector<uint32_t> freeStagingPages; // guarded by pageLoaderMutex
+    std::vector<std::vector<uint32_t>> frameStagingPages; // per frame in flight, staging pages its copies read
+    std::vector<bool> pageQueued; // per page, requested and not given a slot (or dropped) yet
+    std::vector<VkBufferImageCopy> pageCopies; // into the cache, recorded at the start of the current frame
+    uint64_t pagesRequested = 0;
+    uint64_t pagesUploaded = 0;
+    uint64_t pagesEvicted = 0;
+    uint64_t pagesDropped = 0; // requests that waited too long, or found no slot to go in
+
+
+    /*
+        Material Textures
+    */
+    bool materialTexturing = false; // --material-textures and on the vertex shader path. The materials then sample these instead
+    TexturePacking texturePacking; // which group (image) and layer every texture went to
+    std::vector<uint32_t> materialTextureIndices; // per material, into texturePacking.placements and the region buffer
+    // Per group
+    std::vector<VkImage> textureGroupImages;
+    std::vector<DeviceAllocation> textureGroupImagesMemory;
+    std::vector<VkImageView> textureGroupViews; // 2D array views
+    std::vector<VkSampler> textureGroupSamplers;
+    VkBuffer textureRegionBuffer = VK_NULL_HANDLE; // per texture, its layer and where it is in it (shader_atlas.frag)
+    DeviceAllocation textureRegionBufferMemory;
 
 
     /*
@@ -132,26 +300,124 @@ private:
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
     std::vector<VkFence> inFlightFences;
+    double recordMilliseconds = 0.0; // CPU time in recordCommandBuffer, summed over all frames
+    uint64_t drawCalls = 0; // summed over all frames
+    uint64_t descriptorBinds = 0; // summed over all frames
+    uint64_t frameNumber = 0; // frames drawn so far
+
+
+    /*
+        Geometry Pool
+    */
+    // Every mesh is a range of these two, see meshRanges
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    DeviceAllocation vertexBufferMemory;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    DeviceAllocation indexBufferMemory;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32; // 16-bit when the vertex count allows
+    RangeAllocator vertexRanges; // in vertices
+    RangeAllocator indexRanges; // in indices
+    std::vector<MeshRange> meshRanges;
+    VkBuffer drawIndirectBuffer = VK_NULL_HANDLE; // a command per mesh per LOD, see createDrawCommands
+    DeviceAllocation drawIndirectBufferMemory;
+    uint32_t maxDrawIndirectCount = 1; // commands per vkCmdDrawIndexedIndirect, 1 without multiDrawIndirect
+    // --separate-buffers, a pair per mesh
+    std::vector<VkBuffer> meshVertexBuffers;
+    std::vector<DeviceAllocation> meshVertexBuffersMemory;
+    std::vector<VkBuffer> meshIndexBuffers;
+    std::vector<DeviceAllocation> meshIndexBuffersMemory;
+
+
+    /*
+        Meshlets & Culling
+    */
+    enum class DrawPath {
+        Direct, // whole index buffer, --no-cull
+        ComputeCull, // cull.comp compacts visible meshlets into an index buffer for an indirect draw
+        MeshShader // task shader culls, mesh shader draws, --mesh-shader
+    };
+    DrawPath drawPath = DrawPath::Direct;
+    uint32_t meshletCount = 0;
+    std::vector<uint32_t> lodMeshletOffsets; // meshlets of LOD i are [lodMeshletOffsets[i], lodMeshletOffsets[i + 1])
+    VkBuffer meshletBuffer;
+    DeviceAllocation meshletBufferMemory;
+    VkBuffer meshletVertexBuffer;
+    DeviceAllocation meshletVertexBufferMemory;
+    VkBuffer meshletTriangleBuffer;
+    DeviceAllocation meshletTriangleBufferMemory;
+    // Per frame in flight, the compute pass rewrites them every frame
+    std::vector<VkBuffer> culledIndexBuffers;
+    std::vector<DeviceAllocation> culledIndexBuffersMemory;
+    std::vector<VkBuffer> drawCommandBuffers;
+    std::vector<DeviceAllocation> drawCommandBuffersMemory;
+    std::vector<void*> drawCommandBuffersMapped; // read back for the visible triangle count
+    std::vector<uint32_t> drawCommandLods; // the LOD each frame in flight was culled at
+    uint32_t visibleTriangles = 0; // as of the last completed frame, ComputeCull only
+    uint32_t visibleTrianglesLod = 0; // the LOD that frame was culled at
+    VkDescriptorSetLayout meshletSetLayout;
+    VkDescriptorPool meshletDescriptorPool;
+    std::vector<VkDescriptorSet> meshletDescriptorSets;
+    VkPipelineLayout cullPipelineLayout;
+    VkPipeline cullPipeline;
+    VkPipelineLayout meshPipelineLayout;
+    VkPipeline meshPipeline;
+    PFN_vkCmdDrawMeshTasksEXT vkCmdDrawMeshTasks = nullptr;
+
+
+    /*
+        Level of Detail
+    */
+    uint32_t currentLod = 0; // index into model.lods, picked every frame in updateUniformBuffer
+    std::vector<uint64_t> lodFrames; // frames drawn at each level, for the stats at exit
 
 
     /*
-        Buffers
+        Uniforms
     */
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
-    VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
+    VkDescriptorSetLayout descriptorSetLayout;
+    uint32_t frameUniformOffset = 0; // of this frame's UniformBufferObject in the frame arena
+    VkDescriptorPool descriptorPool;
+    std::vector<VkDescriptorSet> descriptorSets; // per frame, and per material without bindless, see materialDescriptorSet
+    uint32_t materialCount = 1; // --materials, clamped to the mesh count. Meshes get them in contiguous runs
+    std::vector<uint32_t> meshMaterials; // per entry of meshRanges
+    bool bindlessTextures = false; // --bindless and supported
+    uint32_t bindlessTextureCapacity = 0;
+    VkSampler nearestSampler = VK_NULL_HANDLE; // second entry of the bindless sampler table
 
 
     /*
-        Uniforms
+        Frame Arena
     */
-    VkDescriptorSetLayout descriptorSetLayout;
-    std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
-    std::vector<void*> uniformBuffersMapped;
-    VkDescriptorPool descriptorPool;
-    std::vector<VkDescriptorSet> descriptorSets;
+    VkBuffer frameArenaBuffer = VK_NULL_HANDLE;
+    DeviceAllocation frameArenaMemory; // mapped the whole time
+    VkDeviceSize frameArenaSize = 0; // per frame in flight
+    VkDeviceSize frameArenaAlignment = 1; // of every allocation, for uniform and storage buffer offsets alike
+    std::vector<VkDeviceSize> frameArenaHeads; // per frame in flight, bytes used
+    std::vector<uint32_t> frameArenaCounts; // per frame in flight, allocations
+    FrameArenaStats frameArenaStats;
+
+
+    /*
+        Residency
+    */
+    std::vector<HeapBudget> heapBudgets; // per memory heap, as of this frame
+    uint64_t textureLastUsed = 0; // frameNumber + 1 the main texture was last sampled in, 0 for never
+    std::vector<uint64_t> textureGroupLastUsed; // per material texture group
+    std::vector<uint64_t> lodLastUsed; // per LOD
+    uint32_t geometryFinestLod = 0; // --separate-buffers, the finer LODs were evicted from the index buffers
+    bool budgetExhausted = false; // over budget with nothing left to evict, said so once
+    ResidencyStats residencyStats;
+
+
+    /*
+        Defragmentation
+    */
+    VkDeviceSize defragStepBytes = 0; // at most --defrag, less while steps take longer than --defrag-ms
+    uint64_t defragBlockedAt = UINT64_MAX; // memoryChanges() when nothing could be moved
+    DefragStats defragStats;
+    std::vector<VkBuffer> soakBuffers; // --memory-soak
+    std::vector<DeviceAllocation> soakBuffersMemory;
+    std::mt19937 soakRandom{ 1 }; // the same churn every run
 
 
     /*
@@ -164,7 +430,7 @@ private:
         Color
     */
     VkImage colorImage;
-    VkDeviceMemory colorImageMemory;
+    DeviceAllocation colorImageMemory;
     VkImageView colorImageView;
 
 
@@ -172,7 +438,7 @@ private:
         Depth
     */
     VkImage depthImage; // Only 1, since draw 1
-    VkDeviceMemory depthImageMemory;
+    DeviceAllocation depthImageMemory;
     VkImageView depthImageView;
 
 
@@ -195,6 +461,7 @@ private:
     void pickPhysicalDevice();
     void createLogicalDevice();
     int rateDeviceSuitability(VkPhysicalDevice device);
+    bool checkMemoryBudgetSupport(VkPhysicalDevice device);
     
 
     /*
@@ -216,22 +483,72 @@ private:
     /*
         Image
     */
-    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
+    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, uint32_t baseMipLevel = 0,
+        VkImageUsageFlags usage = 0); // 0 is the image's usage
     void createImageViews();
     void createFramebuffers();
     void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-        VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
-    void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+        VkMemoryPropertyFlags properties, VkImage& image, DeviceAllocation& imageMemory, const std::vector<uint32_t>& queueFamilies = {}, // concurrent if more than one
+        VkImageCreateFlags flags = 0, uint32_t arrayLayers = 1);
+    void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, uint32_t baseMipLevel = 0);
     void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+    void recordImageLevelsCopy(VkCommandBuffer commandBuffer, VkImage srcImage, VkImage dstImage, uint32_t width, uint32_t height,
+        uint32_t levels, uint32_t layerCount, uint32_t firstLevel);
 
 
     /*
         Texture
     */
     void createTextureImage();
+    void prefetchTexture();
+    void createTextureImageRgba8(const DecodedImage& image);
+    void uploadKtx2(const Ktx2File& ktx, uint32_t firstLevel);
+    void createTextureImageTiled(TiffFile& tiff);
+    uint8_t* reserveTextureStaging(VkDeviceSize size);
+    void releaseTextureStaging();
+    bool isTextureFormatSupported(VkFormat format);
+    void printTextureMemory(double uploadMilliseconds);
     void createTextureImageView();
     void createTextureSampler();
     void generateMipmaps(VkImage image, VkFormat format, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+    void recordMipmapBlits(VkCommandBuffer commandBuffer, VkImage image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels, uint32_t layerCount = 1);
+    bool isComputeDownsampleSupported();
+    void generateMipmapsCompute(VkImage image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels, bool srgb);
+
+
+    /*
+        Texture Streaming
+    */
+    void startTextureStreaming(std::unique_ptr<Ktx2File> ktx);
+    void updateTextureStreaming();
+    void updateTextureDescriptor(uint32_t frame);
+    void submitStreamingCopy(uint32_t level);
+    void finishTextureStreaming();
+    void cleanupTextureStreaming();
+    void printTextureStreamingStats();
+
+
+    /*
+        Virtual Texture
+    */
+    void createVirtualTexture(std::unique_ptr<Ktx2File> ktx);
+    void loadVirtualPages();
+    void updateVirtualTexture(uint32_t frame);
+    void recordVirtualTextureUploads(VkCommandBuffer commandBuffer);
+    void recordVirtualTextureFeedback(VkCommandBuffer commandBuffer);
+    void cleanupVirtualTexture();
+    void printVirtualTextureStats();
+
+
+    /*
+        Material Textures
+    */
+    void createMaterialTextures();
+    void uploadTextureGroups(const std::vector<DecodedImage>& images);
+    void createTextureGroupView(uint32_t group);
+    uint32_t materialSetIndex(uint32_t material);
+    uint32_t descriptorSetsPerFrame();
+    void cleanupMaterialTextures();
 
 
 
@@ -262,31 +579,137 @@ private:
         Model stuff
     */
     void loadModel();
+    void releaseModel();
+
+
+    /*
+        Geometry Pool
+    */
+    void createGeometryPool();
+    MeshRange allocateMesh(uint32_t vertexCount, uint32_t indexCount);
+    void freeMesh(const MeshRange& range);
+    void assignMeshMaterials();
+    uint32_t drawMaterialIndex(uint32_t mesh);
+    void createDrawCommands();
+    void recordGeometryDraws(VkCommandBuffer commandBuffer, uint32_t frame);
+    void cleanupGeometryPool();
+
+
+    /*
+        Meshlets & Culling
+    */
+    void createMeshletSetLayout();
+    void createMeshletBuffers();
+    void createMeshletDescriptorSets();
+    void writeMeshletDescriptors(uint32_t frame);
+    void createCullPipeline();
+    bool checkMeshShaderSupport(VkPhysicalDevice device);
+    void recordCull(VkCommandBuffer commandBuffer, uint32_t frame);
+    void recordMeshShaderDraw(VkCommandBuffer commandBuffer, uint32_t frame);
+    void cleanupMeshlets();
 
 
     /*
-        Buffers
+        Level of Detail
     */
-    void createVertexBuffer();
-    void createIndexBuffer();
+    void selectLod(float distance, float fovY);
+    void printFrameStats();
 
 
     /*
         Uniforms
     */
     void createDescriptorSetLayout();
-    void createUniformBuffers();
     void updateUniformBuffer(uint32_t currentImage);
     void createDescriptorPool();
     void createDescriptorSets();
+    bool checkDescriptorIndexingSupport(VkPhysicalDevice device, uint32_t& textureCapacity);
+    VkDescriptorSet materialDescriptorSet(uint32_t frame, uint32_t material);
+    void writeTextureDescriptors(uint32_t frame);
+    void writeRegionDescriptors(uint32_t frame);
+
+
+    /*
+        Frame Arena
+    */
+    void createFrameArena();
+    void resetFrameArena(uint32_t frame);
+    FrameAllocation allocateFrameData(uint32_t frame, VkDeviceSize size);
+    VkDescriptorType frameUniformDescriptorType();
+    uint32_t materialDynamicOffsetCount();
+    void printFrameArenaStats();
+    void cleanupFrameArena();
+
+
+    /*
+        Residency
+    */
+    void createResidency();
+    void queryMemoryBudget();
+    void updateResidency();
+    bool evictLeastRecentlyUsed(uint32_t heap);
+    void copyWithoutTopMip(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t levels, uint32_t layerCount,
+        VkImage& newImage, DeviceAllocation& newMemory);
+    void evictTextureMip();
+    void evictTextureGroupMip(uint32_t group);
+    void evictFinestLod();
+    void printResidencyStats();
+
+
+    /*
+        Defragmentation
+    */
+    void createDefragmentation();
+    std::vector<MovableResource> collectMovableResources();
+    uint32_t pickDefragSource(const std::vector<MovableResource>& movable);
+    uint64_t memoryChanges();
+    bool fitsOutsideBlock(uint32_t source, VkDeviceSize size);
+    void updateDefragmentation();
+    void createSoakBuffer(uint32_t index);
+    void updateMemorySoak();
+    void printDefragStats();
+    void cleanupMemorySoak();
 
 
     /*
         Memory
     */
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, DeviceAllocation& bufferMemory);
+    void createDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, DeviceAllocation& bufferMemory);
+    void uploadBufferChunked(VkBuffer buffer, const std::vector<VkDeviceSize>& dstOffsets, size_t count, VkDeviceSize elementSize,
+        const std::function<void(void* staging, size_t first, size_t count)>& write);
+
+
+    /*
+        Device Memory
+    */
+    void createMemoryAllocator();
+    bool queryMemoryRequirements(VkBuffer buffer, VkImage image, VkMemoryRequirements& requirements); // true if it wants a dedicated allocation
+    VkDeviceSize memoryBlockSize(uint32_t memoryType);
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, VkBuffer buffer, VkImage image, void*& mapped);
+    DeviceAllocation allocateMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, VkBuffer buffer, VkImage image,
+        bool optimalImage, bool dedicated, MemoryCategory category);
+    void freeMemory(DeviceAllocation& allocation);
+    MemoryBlockTotals sumMemoryBlocks();
+    void printDeviceMemoryStats();
+    void cleanupDeviceMemory();
+
+
+    /*
+        Staging Ring
+    */
+    void createStagingRing();
+    StagingSlice reserveStaging(VkDeviceSize size, VkDeviceSize alignment = 16);
+    VkCommandBuffer stagingCommands();
+    void submitStaging();
+    void retireStaging(bool wait);
+    void finishStaging();
+    void uploadImage(VkImage image, VkFormat format, uint32_t mipLevel, uint32_t arrayLayer, uint32_t width, uint32_t height,
+        std::span<const uint8_t> data);
+    VkDeviceSize stagingChunkSize();
+    void printStagingStats();
+    void cleanupStagingRing();
 
 
     /*
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+
+// --bindless: every material's texture sits in one array per descriptor set and the draw says which, through its
+// firstInstance. The layout here has to match shader_bindless.frag
+constexpr uint32_t BINDLESS_TEXTURE_CAPACITY = 16384; // sampled images in the table, less if the device allows fewer
+constexpr uint32_t BINDLESS_SAMPLER_COUNT = 2; // the sampler table: 0 is textureSampler, 1 nearest
+constexpr uint32_t BINDLESS_SAMPLER_SHIFT = 16; // per-draw index: texture slot in the low bits, sampler above
+
+inline uint32_t bindlessDrawIndex(uint32_t textureSlot, uint32_t samplerSlot) {
+    return textureSlot | (samplerSlot << BINDLESS_SAMPLER_SHIFT);
+}
\ No newline at end of file
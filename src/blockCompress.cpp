@@ -0,0 +1,631 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "blockCompress.h"
+#include "parallel.h"
+
+
+// BC7 partition tables. Two subsets: bit i is the subset of texel i. Three subsets: 2 bits per texel
+static const uint16_t BC7_PARTITIONS_2[64] = {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+static const uint32_t BC7_PARTITIONS_3[64] = {
+    0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+    0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+    0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+    0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+    0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+    0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+    0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+    0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254
+};
+
+// Texels whose index drops its top bit: texel 0 for subset 0, these for the others
+static const uint8_t BC7_ANCHORS_2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+     6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+static const uint8_t BC7_ANCHORS_3_SECOND[64] = {
+     3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+     3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+     8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+     3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+};
+
+static const uint8_t BC7_ANCHORS_3_THIRD[64] = {
+    15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+    15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+    15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+    15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+};
+
+// Interpolation weights out of 64, by index bit count
+static const uint8_t BC7_WEIGHTS_2[4] = { 0, 21, 43, 64 };
+static const uint8_t BC7_WEIGHTS_3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const uint8_t BC7_WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct Bc7Mode {
+    uint8_t subsets;
+    uint8_t partitionBits;
+    uint8_t rotationBits;
+    uint8_t indexSelectionBits;
+    uint8_t colorBits;
+    uint8_t alphaBits;
+    uint8_t endpointPBits; // one per endpoint
+    uint8_t sharedPBits; // one per subset
+    uint8_t indexBits;
+    uint8_t index2Bits; // second index set, modes 4 and 5
+};
+
+static const Bc7Mode BC7_MODES[8] = {
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+};
+
+
+// Blocks are little endian bit streams, first field in the lowest bits
+class BitReader {
+public:
+    explicit BitReader(const uint8_t* data) : data(data) {}
+
+    uint32_t read(uint32_t count) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; i++, position++) {
+            value |= ((data[position >> 3] >> (position & 7)) & 1u) << i;
+        }
+        return value;
+    }
+
+private:
+    const uint8_t* data;
+    uint32_t position = 0;
+};
+
+
+class BitWriter {
+public:
+    explicit BitWriter(uint8_t* data, size_t size) : data(data) { memset(data, 0, size); }
+
+    void write(uint32_t value, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++, position++) {
+            if ((value >> i) & 1u) data[position >> 3] |= static_cast<uint8_t>(1u << (position & 7));
+        }
+    }
+
+private:
+    uint8_t* data;
+    uint32_t position = 0;
+};
+
+
+static int squaredDistance(const uint8_t* a, const uint8_t* b, int channels) {
+    int sum = 0;
+    for (int c = 0; c < channels; c++) {
+        int d = int(a[c]) - int(b[c]);
+        sum += d * d;
+    }
+    return sum;
+}
+
+
+// Endpoints along the block's principal axis: mean +- the extent of the texels projected onto it
+static void principalEndpoints(const uint8_t texels[64], int channels, float low[4], float high[4]) {
+    float mean[4] = {};
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < channels; c++) mean[c] += texels[i * 4 + c];
+    }
+    for (int c = 0; c < channels; c++) mean[c] /= 16.0f;
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++) {
+        float d[4];
+        for (int c = 0; c < channels; c++) d[c] = texels[i * 4 + c] - mean[c];
+        for (int r = 0; r < channels; r++) {
+            for (int c = 0; c < channels; c++) covariance[r][c] += d[r] * d[c];
+        }
+    }
+
+    // Power iteration, a handful of steps is plenty for 16 points
+    float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for (int step = 0; step < 8; step++) {
+        float next[4] = {};
+        for (int r = 0; r < channels; r++) {
+            for (int c = 0; c < channels; c++) next[r] += covariance[r][c] * axis[c];
+        }
+        float length = 0.0f;
+        for (int c = 0; c < channels; c++) length = (std::max)(length, std::fabs(next[c]));
+        if (length < 1e-6f) break; // flat block, any axis will do
+        for (int c = 0; c < channels; c++) axis[c] = next[c] / length;
+    }
+
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++) t += (texels[i * 4 + c] - mean[c]) * axis[c];
+        minT = (std::min)(minT, t);
+        maxT = (std::max)(maxT, t);
+    }
+
+    float axisLength2 = 0.0f;
+    for (int c = 0; c < channels; c++) axisLength2 += axis[c] * axis[c];
+    for (int c = 0; c < channels; c++) {
+        low[c] = std::clamp(mean[c] + axis[c] * minT / axisLength2, 0.0f, 255.0f);
+        high[c] = std::clamp(mean[c] + axis[c] * maxT / axisLength2, 0.0f, 255.0f);
+    }
+}
+
+
+// Endpoints minimizing the squared error for fixed interpolation weights t (0 = low, 1 = high). false if degenerate
+static bool leastSquaresEndpoints(const uint8_t texels[64], const float t[16], int channels, float low[4], float high[4]) {
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    float rhsLow[4] = {}, rhsHigh[4] = {};
+    for (int i = 0; i < 16; i++) {
+        float s = 1.0f - t[i];
+        a += s * s;
+        b += s * t[i];
+        c += t[i] * t[i];
+        for (int ch = 0; ch < channels; ch++) {
+            rhsLow[ch] += s * texels[i * 4 + ch];
+            rhsHigh[ch] += t[i] * texels[i * 4 + ch];
+        }
+    }
+
+    float det = a * c - b * b;
+    if (std::fabs(det) < 1e-4f) return false;
+    for (int ch = 0; ch < channels; ch++) {
+        low[ch] = std::clamp((c * rhsLow[ch] - b * rhsHigh[ch]) / det, 0.0f, 255.0f);
+        high[ch] = std::clamp((a * rhsHigh[ch] - b * rhsLow[ch]) / det, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+
+/*
+    BC1
+*/
+static uint16_t packRgb565(const float color[3]) {
+    uint32_t r = static_cast<uint32_t>(std::clamp(color[0] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f));
+    uint32_t g = static_cast<uint32_t>(std::clamp(color[1] * 63.0f / 255.0f + 0.5f, 0.0f, 63.0f));
+    uint32_t b = static_cast<uint32_t>(std::clamp(color[2] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f));
+    return static_cast<uint16_t>(r << 11 | g << 5 | b);
+}
+
+
+static void unpackRgb565(uint16_t packed, uint8_t color[4]) {
+    uint32_t r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+    color[0] = static_cast<uint8_t>(r << 3 | r >> 2);
+    color[1] = static_cast<uint8_t>(g << 2 | g >> 4);
+    color[2] = static_cast<uint8_t>(b << 3 | b >> 2);
+    color[3] = 255;
+}
+
+
+static void bc1Palette(uint16_t c0, uint16_t c1, uint8_t palette[4][4]) {
+    unpackRgb565(c0, palette[0]);
+    unpackRgb565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        if (c0 > c1) {
+            palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+            palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+        }
+        else {
+            palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = c0 > c1 ? 255 : 0; // punch-through alpha
+}
+
+
+static void encodeBC1Block(const uint8_t texels[64], uint8_t out[8]) {
+    static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    float low[4], high[4];
+    principalEndpoints(texels, 3, low, high);
+
+    uint16_t bestC0 = 0, bestC1 = 0;
+    uint32_t bestIndices = 0;
+    int bestError = INT32_MAX;
+    for (int iteration = 0; iteration < 3; iteration++) {
+        uint16_t c0 = packRgb565(high), c1 = packRgb565(low);
+        if (c0 < c1) std::swap(c0, c1);
+
+        uint32_t indices = 0;
+        int error = 0;
+        float t[16];
+        if (c0 == c1) { // solid, index 0 everywhere
+            uint8_t color[4];
+            unpackRgb565(c0, color);
+            for (int i = 0; i < 16; i++) {
+                error += squaredDistance(texels + i * 4, color, 3);
+                t[i] = 0.0f;
+            }
+        }
+        else {
+            uint8_t palette[4][4];
+            bc1Palette(c0, c1, palette);
+            for (int i = 0; i < 16; i++) {
+                int best = 0, bestDistance = INT32_MAX;
+                for (int k = 0; k < 4; k++) {
+                    int distance = squaredDistance(texels + i * 4, palette[k], 3);
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        best = k;
+                    }
+                }
+                indices |= uint32_t(best) << (2 * i);
+                error += bestDistance;
+                t[i] = weights[best];
+            }
+        }
+
+        if (error < bestError) {
+            bestError = error;
+            bestC0 = c0;
+            bestC1 = c1;
+            bestIndices = indices;
+        }
+        if (error == 0 || c0 == c1 || !leastSquaresEndpoints(texels, t, 3, high, low)) break; // t measures from c0
+    }
+
+    memcpy(out, &bestC0, 2);
+    memcpy(out + 2, &bestC1, 2);
+    memcpy(out + 4, &bestIndices, 4);
+}
+
+
+static void decodeBC1Block(const uint8_t in[8], uint8_t texels[64]) {
+    uint16_t c0, c1;
+    uint32_t indices;
+    memcpy(&c0, in, 2);
+    memcpy(&c1, in + 2, 2);
+    memcpy(&indices, in + 4, 4);
+
+    uint8_t palette[4][4];
+    bc1Palette(c0, c1, palette);
+    for (int i = 0; i < 16; i++) {
+        memcpy(texels + i * 4, palette[indices >> (2 * i) & 3], 4);
+    }
+}
+
+
+/*
+    BC4 (and BC5, which is two of them)
+*/
+static void bc4Palette(uint8_t r0, uint8_t r1, uint8_t palette[8]) {
+    palette[0] = r0;
+    palette[1] = r1;
+    if (r0 > r1) {
+        for (int k = 2; k < 8; k++) palette[k] = static_cast<uint8_t>(((8 - k) * r0 + (k - 1) * r1) / 7);
+    }
+    else {
+        for (int k = 2; k < 6; k++) palette[k] = static_cast<uint8_t>(((6 - k) * r0 + (k - 1) * r1) / 5);
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+
+// channel of the RGBA texels
+static void encodeBC4Block(const uint8_t texels[64], int channel, uint8_t out[8]) {
+    uint8_t low = 255, high = 0;
+    for (int i = 0; i < 16; i++) {
+        low = (std::min)(low, texels[i * 4 + channel]);
+        high = (std::max)(high, texels[i * 4 + channel]);
+    }
+
+    uint8_t palette[8];
+    bc4Palette(high, low, palette); // high > low picks the 8 value mode
+    uint64_t indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int value = texels[i * 4 + channel];
+        int best = 0, bestDistance = INT32_MAX;
+        for (int k = 0; k < 8; k++) {
+            int distance = std::abs(value - palette[k]);
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = k;
+            }
+        }
+        indices |= uint64_t(best) << (3 * i);
+    }
+
+    out[0] = high;
+    out[1] = low;
+    for (int b = 0; b < 6; b++) out[2 + b] = static_cast<uint8_t>(indices >> (8 * b));
+}
+
+
+static void decodeBC4Block(const uint8_t in[8], int channel, uint8_t texels[64]) {
+    uint8_t palette[8];
+    bc4Palette(in[0], in[1], palette);
+    uint64_t indices = 0;
+    for (int b = 0; b < 6; b++) indices |= uint64_t(in[2 + b]) << (8 * b);
+    for (int i = 0; i < 16; i++) {
+        texels[i * 4 + channel] = palette[indices >> (3 * i) & 7];
+    }
+}
+
+
+/*
+    BC7
+*/
+static uint8_t bc7Interpolate(uint32_t e0, uint32_t e1, uint32_t index, uint32_t indexBits) {
+    const uint8_t* weights = indexBits == 2 ? BC7_WEIGHTS_2 : (indexBits == 3 ? BC7_WEIGHTS_3 : BC7_WEIGHTS_4);
+    return static_cast<uint8_t>(((64 - weights[index]) * e0 + weights[index] * e1 + 32) >> 6);
+}
+
+
+static void decodeBC7Block(const uint8_t in[16], uint8_t texels[64]) {
+    BitReader reader(in);
+    uint32_t modeIndex = 0;
+    while (modeIndex < 8 && reader.read(1) == 0) modeIndex++;
+    if (modeIndex == 8) { // reserved, decodes to transparent black
+        memset(texels, 0, 64);
+        return;
+    }
+
+    const Bc7Mode& mode = BC7_MODES[modeIndex];
+    uint32_t partition = reader.read(mode.partitionBits);
+    uint32_t rotation = reader.read(mode.rotationBits);
+    uint32_t indexSelection = reader.read(mode.indexSelectionBits);
+
+    // [subset][endpoint][channel], all channels of one endpoint before the next, colors before alpha
+    uint32_t endpoints[3][2][4] = {};
+    for (int c = 0; c < 3; c++) {
+        for (int s = 0; s < mode.subsets; s++) {
+            for (int e = 0; e < 2; e++) endpoints[s][e][c] = reader.read(mode.colorBits);
+        }
+    }
+    for (int s = 0; s < mode.subsets && mode.alphaBits; s++) {
+        for (int e = 0; e < 2; e++) endpoints[s][e][3] = reader.read(mode.alphaBits);
+    }
+
+    uint32_t colorBits = mode.colorBits, alphaBits = mode.alphaBits;
+    if (mode.endpointPBits || mode.sharedPBits) {
+        for (int s = 0; s < mode.subsets; s++) {
+            uint32_t shared = mode.sharedPBits ? reader.read(1) : 0;
+            for (int e = 0; e < 2; e++) {
+                uint32_t p = mode.endpointPBits ? reader.read(1) : shared;
+                for (int c = 0; c < 4; c++) endpoints[s][e][c] = endpoints[s][e][c] << 1 | p;
+            }
+        }
+        colorBits++;
+        if (alphaBits) alphaBits++;
+    }
+
+    // Widen to 8 bits by repeating the top bits
+    for (int s = 0; s < mode.subsets; s++) {
+        for (int e = 0; e < 2; e++) {
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = endpoints[s][e][c];
+                endpoints[s][e][c] = (v << (8 - colorBits)) | (v >> (2 * colorBits - 8));
+            }
+            uint32_t a = endpoints[s][e][3];
+            endpoints[s][e][3] = alphaBits ? ((a << (8 - alphaBits)) | (a >> (2 * alphaBits - 8))) : 255;
+        }
+    }
+
+    auto subsetOf = [&](int texel) -> int {
+        if (mode.subsets == 2) return BC7_PARTITIONS_2[partition] >> texel & 1;
+        if (mode.subsets == 3) return BC7_PARTITIONS_3[partition] >> (2 * texel) & 3;
+        return 0;
+    };
+    auto isAnchor = [&](int texel) {
+        if (texel == 0) return true;
+        if (mode.subsets == 2) return texel == BC7_ANCHORS_2[partition];
+        if (mode.subsets == 3) return texel == BC7_ANCHORS_3_SECOND[partition] || texel == BC7_ANCHORS_3_THIRD[partition];
+        return false;
+    };
+
+    uint32_t indices[16], indices2[16] = {};
+    for (int i = 0; i < 16; i++) indices[i] = reader.read(mode.indexBits - (isAnchor(i) ? 1 : 0));
+    for (int i = 0; i < 16 && mode.index2Bits; i++) indices2[i] = reader.read(mode.index2Bits - (i == 0 ? 1 : 0));
+
+    for (int i = 0; i < 16; i++) {
+        const uint32_t(&e)[2][4] = endpoints[subsetOf(i)];
+        uint8_t* texel = texels + i * 4;
+
+        uint32_t colorIndex = indices[i], colorIndexBits = mode.indexBits;
+        uint32_t alphaIndex = indices[i], alphaIndexBits = mode.indexBits;
+        if (mode.index2Bits) {
+            if (indexSelection) {
+                colorIndex = indices2[i];
+                colorIndexBits = mode.index2Bits;
+            }
+            else {
+                alphaIndex = indices2[i];
+                alphaIndexBits = mode.index2Bits;
+            }
+        }
+
+        for (int c = 0; c < 3; c++) texel[c] = bc7Interpolate(e[0][c], e[1][c], colorIndex, colorIndexBits);
+        texel[3] = bc7Interpolate(e[0][3], e[1][3], alphaIndex, alphaIndexBits);
+        if (rotation) std::swap(texel[3], texel[rotation - 1]);
+    }
+}
+
+
+// Best 7 bit value plus shared p-bit for one 8 bit endpoint, by total error over the channels
+static void quantizeMode6Endpoint(const float endpoint[4], uint8_t quantized[4], uint32_t& pBit) {
+    float bestError = 1e30f;
+    for (uint32_t p = 0; p < 2; p++) {
+        uint8_t candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            int q = std::clamp(static_cast<int>(std::lround((endpoint[c] - p) / 2.0f)), 0, 127);
+            candidate[c] = static_cast<uint8_t>(q);
+            float d = float(q << 1 | p) - endpoint[c];
+            error += d * d;
+        }
+        if (error < bestError) {
+            bestError = error;
+            memcpy(quantized, candidate, 4);
+            pBit = p;
+        }
+    }
+}
+
+
+// Mode 6 only: one subset, 7.7.7.7 endpoints with a p-bit each, 4 bit indices. Handles alpha and suits smooth
+// texture content well. The partitioned modes would do better on blocks with several distinct colors
+static void encodeBC7Block(const uint8_t texels[64], uint8_t out[16]) {
+    float low[4], high[4];
+    principalEndpoints(texels, 4, low, high);
+
+    uint8_t bestQuantized[2][4] = {};
+    uint32_t bestPBits[2] = {};
+    uint8_t bestIndices[16] = {};
+    int bestError = INT32_MAX;
+    for (int iteration = 0; iteration < 3; iteration++) {
+        uint8_t quantized[2][4];
+        uint32_t pBits[2];
+        quantizeMode6Endpoint(low, quantized[0], pBits[0]);
+        quantizeMode6Endpoint(high, quantized[1], pBits[1]);
+
+        uint8_t palette[16][4];
+        for (int k = 0; k < 16; k++) {
+            for (int c = 0; c < 4; c++) {
+                palette[k][c] = bc7Interpolate(quantized[0][c] << 1 | pBits[0], quantized[1][c] << 1 | pBits[1], k, 4);
+            }
+        }
+
+        uint8_t indices[16];
+        float t[16];
+        int error = 0;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDistance = INT32_MAX;
+            for (int k = 0; k < 16; k++) {
+                int distance = squaredDistance(texels + i * 4, palette[k], 4);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = k;
+                }
+            }
+            indices[i] = static_cast<uint8_t>(best);
+            t[i] = BC7_WEIGHTS_4[best] / 64.0f;
+            error += bestDistance;
+        }
+
+        if (error < bestError) {
+            bestError = error;
+            memcpy(bestQuantized, quantized, sizeof(quantized));
+            memcpy(bestPBits, pBits, sizeof(pBits));
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+        if (error == 0 || !leastSquaresEndpoints(texels, t, 4, low, high)) break;
+    }
+
+    // Texel 0 only stores 3 index bits, so its top bit must be 0. Swapping the endpoints mirrors the indices
+    if (bestIndices[0] & 8) {
+        std::swap(bestQuantized[0], bestQuantized[1]);
+        std::swap(bestPBits[0], bestPBits[1]);
+        for (auto& index : bestIndices) index = static_cast<uint8_t>(15 - index);
+    }
+
+    BitWriter writer(out, 16);
+    writer.write(1u << 6, 7); // mode 6
+    for (int c = 0; c < 4; c++) {
+        writer.write(bestQuantized[0][c], 7);
+        writer.write(bestQuantized[1][c], 7);
+    }
+    writer.write(bestPBits[0], 1);
+    writer.write(bestPBits[1], 1);
+    for (int i = 0; i < 16; i++) writer.write(bestIndices[i], i == 0 ? 3 : 4);
+}
+
+
+// BC4/BC5 only carry R or RG, the rest decodes like the GPU would: 0 for color, 1 for alpha
+static void fillOpaqueBlack(uint8_t texels[64]) {
+    for (int i = 0; i < 16; i++) {
+        texels[i * 4 + 0] = texels[i * 4 + 1] = texels[i * 4 + 2] = 0;
+        texels[i * 4 + 3] = 255;
+    }
+}
+
+
+uint32_t blockBytes(BlockFormat format) {
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+
+size_t compressedSize(BlockFormat format, uint32_t width, uint32_t height) {
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+
+void compressImage(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks) {
+    uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    uint32_t bytes = blockBytes(format);
+
+    parallelFor(blocksY, [&](size_t by) {
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            uint8_t texels[64];
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t sy = (std::min)(static_cast<uint32_t>(by) * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t sx = (std::min)(bx * 4 + x, width - 1);
+                    memcpy(texels + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+                }
+            }
+
+            uint8_t* out = blocks + (by * blocksX + bx) * bytes;
+            switch (format) {
+            case BlockFormat::BC1: encodeBC1Block(texels, out); break;
+            case BlockFormat::BC4: encodeBC4Block(texels, 0, out); break;
+            case BlockFormat::BC5:
+                encodeBC4Block(texels, 0, out);
+                encodeBC4Block(texels, 1, out + 8);
+                break;
+            case BlockFormat::BC7: encodeBC7Block(texels, out); break;
+            }
+        }
+    });
+}
+
+
+void decompressImage(BlockFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba) {
+    uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    uint32_t bytes = blockBytes(format);
+
+    parallelFor(blocksY, [&](size_t by) {
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            const uint8_t* in = blocks + (by * blocksX + bx) * bytes;
+            uint8_t texels[64];
+            switch (format) {
+            case BlockFormat::BC1: decodeBC1Block(in, texels); break;
+            case BlockFormat::BC4:
+                fillOpaqueBlack(texels);
+                decodeBC4Block(in, 0, texels);
+                break;
+            case BlockFormat::BC5:
+                fillOpaqueBlack(texels);
+                decodeBC4Block(in, 0, texels);
+                decodeBC4Block(in + 8, 1, texels);
+                break;
+            case BlockFormat::BC7: decodeBC7Block(in, texels); break;
+            }
+
+            // Only the texels inside the image, edge blocks hang over
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++) {
+                    memcpy(rgba + ((by * 4 + y) * width + bx * 4 + x) * 4, texels + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+    });
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+
+// 4x4 block compression. BC1 is 4 bits per texel RGB, BC4 one channel and BC5 two (both linear data: masks, normal
+// maps), BC7 8 bits per texel RGBA at far better quality than BC1. Images are tightly packed RGBA8 in and out,
+// blocks are row-major. Edges of images that are not a multiple of 4 are padded by repeating the last texel
+enum class BlockFormat { BC1, BC4, BC5, BC7 };
+
+uint32_t blockBytes(BlockFormat format); // 8 or 16
+size_t compressedSize(BlockFormat format, uint32_t width, uint32_t height);
+
+// Blocks are encoded on all cores. The BC7 encoder only emits mode 6 (one subset, RGBA endpoints), the decoder reads all 8 modes
+void compressImage(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks);
+void decompressImage(BlockFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
\ No newline at end of file
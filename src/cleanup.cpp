@@ -5,24 +5,27 @@
 void Application::cleanup() {
     cleanupSwapChain();
 
+    cleanupTextureStreaming();
+    cleanupVirtualTexture();
     vkDestroySampler(device, textureSampler, nullptr);
+    vkDestroySampler(device, nearestSampler, nullptr);
+    for (VkImageView view : retiredTextureViews) {
+        vkDestroyImageView(device, view, nullptr);
+    }
     vkDestroyImageView(device, textureImageView, nullptr);
     vkDestroyImage(device, textureImage, nullptr);
-    vkFreeMemory(device, textureImageMemory, nullptr);
+    freeMemory(textureImageMemory);
+    cleanupMaterialTextures();
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-        vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-    }
+    cleanupFrameArena();
 
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
     
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
+    cleanupGeometryPool();
 
-    vkDestroyBuffer(device, indexBuffer, nullptr);
-    vkFreeMemory(device, indexBufferMemory, nullptr);
+    cleanupMeshlets();
+    cleanupMemorySoak();
 
     vkDestroyPipeline(device, graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
@@ -35,8 +38,10 @@ void Application::cleanup() {
         vkDestroyFence(device, inFlightFences[i], nullptr);
     }
 
+    cleanupStagingRing();
     vkDestroyCommandPool(device, commandPool, nullptr);
-        
+
+    cleanupDeviceMemory();
     vkDestroyDevice(device, nullptr);
 
     if (enableValidationLayers) {
@@ -49,6 +49,8 @@ void Application::createSyncObjects() {
 
 
 VkCommandBuffer Application::beginSingleTimeCommands() {
+    submitStaging(); // copies recorded before go first
+
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
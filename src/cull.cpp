@@ -0,0 +1,324 @@
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include "application.h"
+#include "command.h"
+#include "mesh.h"
+#include "meshlet.h"
+#include "shader.h"
+#include "uniform.h"
+#include "vertex.h"
+
+
+const uint32_t CULL_GROUP_SIZE = 64; // local_size_x in cull.comp
+const uint32_t TASK_GROUP_SIZE = 32; // local_size_x in meshlet.task
+const uint32_t MAX_GROUPS_X = 65535; // guaranteed dispatch limit per dimension, larger counts spill into y
+
+
+// Push constants of cull.comp and meshlet.task
+struct MeshletRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+static MeshletRange meshletRange(const std::vector<uint32_t>& lodOffsets, uint32_t lod) {
+    return { lodOffsets[lod], lodOffsets[lod + 1] - lodOffsets[lod] };
+}
+
+
+// Bindings shared by cull.comp (set 0) and meshlet.task/meshlet.mesh (set 1)
+enum MeshletBinding : uint32_t {
+    BINDING_UNIFORMS = 0,
+    BINDING_MESHLETS = 1,
+    BINDING_MESHLET_VERTICES = 2,
+    BINDING_MESHLET_TRIANGLES = 3,
+    BINDING_CULLED_INDICES = 4, // compute only
+    BINDING_DRAW_COMMAND = 5, // compute only
+    BINDING_VERTICES = 6 // mesh shader only
+};
+
+
+void Application::createMeshletSetLayout() {
+    if (drawPath == DrawPath::Direct) return;
+
+    bool compute = drawPath == DrawPath::ComputeCull;
+    VkShaderStageFlags stages = compute ? VK_SHADER_STAGE_COMPUTE_BIT : (VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT);
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    auto addBinding = [&](uint32_t binding, VkDescriptorType type) {
+        VkDescriptorSetLayoutBinding layoutBinding{};
+        layoutBinding.binding = binding;
+        layoutBinding.descriptorType = type;
+        layoutBinding.descriptorCount = 1;
+        layoutBinding.stageFlags = stages;
+        bindings.push_back(layoutBinding);
+    };
+
+    addBinding(BINDING_UNIFORMS, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+    addBinding(BINDING_MESHLETS, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    addBinding(BINDING_MESHLET_VERTICES, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    addBinding(BINDING_MESHLET_TRIANGLES, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    if (compute) {
+        addBinding(BINDING_CULLED_INDICES, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        addBinding(BINDING_DRAW_COMMAND, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    }
+    else {
+        addBinding(BINDING_VERTICES, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &meshletSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create meshlet descriptor set layout!");
+    }
+}
+
+
+void Application::createMeshletBuffers() {
+    if (drawPath == DrawPath::Direct) return;
+    auto start = Clock::now();
+
+    // Every LOD gets its own meshlets, one after the other, so culling only walks the level being drawn
+    MeshletMesh mesh;
+    uint32_t maxLodTriangles = 0;
+    lodMeshletOffsets.assign(1, 0);
+    for (const MeshLod& lod : model.lods) {
+        MeshletMesh level = buildMeshlets(model.vertices(), model.indices().subspan(lod.firstIndex, lod.indexCount));
+        for (Meshlet& meshlet : level.meshlets) {
+            meshlet.vertexOffset += static_cast<uint32_t>(mesh.vertices.size());
+            meshlet.triangleOffset += static_cast<uint32_t>(mesh.triangles.size());
+        }
+        mesh.meshlets.insert(mesh.meshlets.end(), level.meshlets.begin(), level.meshlets.end());
+        mesh.vertices.insert(mesh.vertices.end(), level.vertices.begin(), level.vertices.end());
+        mesh.triangles.insert(mesh.triangles.end(), level.triangles.begin(), level.triangles.end());
+        lodMeshletOffsets.push_back(static_cast<uint32_t>(mesh.meshlets.size()));
+        maxLodTriangles = (std::max)(maxLodTriangles, lod.indexCount / 3);
+    }
+
+    meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+    if (meshletCount == 0) {
+        throw std::runtime_error("model has no triangles to build meshlets from!");
+    }
+    std::cout << "Meshlets: " << meshletCount << " in " << model.lods.size() << " LODs, " << mesh.triangles.size() / double(meshletCount)
+        << " triangles and " << mesh.vertices.size() / double(meshletCount) << " vertices on average" << std::endl;
+
+    createDeviceLocalBuffer(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        meshletBuffer, meshletBufferMemory);
+    createDeviceLocalBuffer(mesh.vertices.data(), mesh.vertices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        meshletVertexBuffer, meshletVertexBufferMemory);
+    createDeviceLocalBuffer(mesh.triangles.data(), mesh.triangles.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        meshletTriangleBuffer, meshletTriangleBufferMemory);
+
+    if (drawPath == DrawPath::ComputeCull) {
+        culledIndexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        culledIndexBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        drawCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        drawCommandBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        drawCommandBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        drawCommandLods.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            // Room for every triangle of the biggest level, in case nothing gets culled
+            createBuffer(VkDeviceSize(maxLodTriangles) * 3 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, culledIndexBuffers[i], culledIndexBuffersMemory[i]);
+
+            // Host visible: reset by the CPU before each dispatch and read back for stats. It is only 20 bytes
+            createBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, drawCommandBuffers[i], drawCommandBuffersMemory[i]);
+            drawCommandBuffersMapped[i] = drawCommandBuffersMemory[i].mapped;
+            *static_cast<VkDrawIndexedIndirectCommand*>(drawCommandBuffersMapped[i]) = { 0, 1, 0, 0, 0 };
+        }
+    }
+
+    startupTimings.add("createMeshletBuffers", millisecondsSince(start));
+}
+
+
+void Application::createMeshletDescriptorSets() {
+    if (drawPath == DrawPath::Direct) return;
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 5;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &meshletDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create meshlet descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, meshletSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = meshletDescriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    allocInfo.pSetLayouts = layouts.data();
+
+    meshletDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    if (vkAllocateDescriptorSets(device, &allocInfo, meshletDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate meshlet descriptor sets!");
+    }
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        writeMeshletDescriptors(i);
+    }
+}
+
+
+// Also again when defragmentation has moved one of the buffers
+void Application::writeMeshletDescriptors(uint32_t frame) {
+    bool compute = drawPath == DrawPath::ComputeCull;
+    std::vector<VkDescriptorBufferInfo> bufferInfos; // reserved, the writes point into it
+    bufferInfos.reserve(6);
+    std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+    auto write = [&](uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize range = VK_WHOLE_SIZE) {
+        bufferInfos.push_back({ buffer, 0, range });
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = meshletDescriptorSets[frame];
+        descriptorWrite.dstBinding = binding;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = type;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &bufferInfos.back();
+        descriptorWrites.push_back(descriptorWrite);
+    };
+
+    write(BINDING_UNIFORMS, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frameArenaBuffer, sizeof(UniformBufferObject)); // at frameUniformOffset
+    write(BINDING_MESHLETS, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshletBuffer);
+    write(BINDING_MESHLET_VERTICES, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshletVertexBuffer);
+    write(BINDING_MESHLET_TRIANGLES, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshletTriangleBuffer);
+    if (compute) {
+        write(BINDING_CULLED_INDICES, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, culledIndexBuffers[frame]);
+        write(BINDING_DRAW_COMMAND, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, drawCommandBuffers[frame]);
+    }
+    else {
+        write(BINDING_VERTICES, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vertexBuffer);
+    }
+
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+
+void Application::createCullPipeline() {
+    if (drawPath != DrawPath::ComputeCull) return; // the mesh shader pipeline is made with the graphics pipeline
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(MeshletRange);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &meshletSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull pipeline layout!");
+    }
+
+    auto cullShaderCode = readFile("../../shaders/cull.comp.spv");
+    VkShaderModule cullShaderModule = createShaderModule(cullShaderCode);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = cullShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = cullPipelineLayout;
+
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull pipeline!");
+    }
+
+    vkDestroyShaderModule(device, cullShaderModule, nullptr);
+}
+
+
+// Outside the render pass: cull meshlets and write the survivors' indices plus the indirect draw for this frame
+void Application::recordCull(VkCommandBuffer commandBuffer, uint32_t frame) {
+    // The fence for this frame has signaled, so the GPU is done with these. Read last result, then reset the count.
+    // That result is MAX_FRAMES_IN_FLIGHT frames old, so it goes with the LOD it was culled at, not the current one
+    auto* drawCommand = static_cast<VkDrawIndexedIndirectCommand*>(drawCommandBuffersMapped[frame]);
+    visibleTriangles = drawCommand->indexCount / 3;
+    visibleTrianglesLod = drawCommandLods[frame];
+    drawCommandLods[frame] = currentLod;
+    *drawCommand = { 0, 1, 0, 0, 0 }; // host writes before the submit are visible to it, no barrier needed
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &meshletDescriptorSets[frame], 1, &frameUniformOffset);
+    MeshletRange range = meshletRange(lodMeshletOffsets, currentLod);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(range), &range);
+
+    uint32_t groups = (range.count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+    vkCmdDispatch(commandBuffer, (std::min)(groups, MAX_GROUPS_X), (groups + MAX_GROUPS_X - 1) / MAX_GROUPS_X, 1);
+
+    // Compute writes -> indirect args and index fetch
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+
+// Inside the render pass: the task shader culls the current LOD's meshlets and launches a mesh shader group per survivor
+void Application::recordMeshShaderDraw(VkCommandBuffer commandBuffer, uint32_t frame) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
+    std::array<VkDescriptorSet, 2> sets = { materialDescriptorSet(frame, 0), meshletDescriptorSets[frame] };
+    std::array<uint32_t, 2> dynamicOffsets = { frameUniformOffset, frameUniformOffset }; // each set's uniforms, the material set's only if it has dynamic ones
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipelineLayout, 0, static_cast<uint32_t>(sets.size()), sets.data(),
+        materialDynamicOffsetCount() + 1, dynamicOffsets.data());
+
+    MeshletRange range = meshletRange(lodMeshletOffsets, currentLod);
+    vkCmdPushConstants(commandBuffer, meshPipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT, 0, sizeof(range), &range);
+
+    uint32_t groups = (range.count + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE;
+    vkCmdDrawMeshTasks(commandBuffer, (std::min)(groups, MAX_GROUPS_X), (groups + MAX_GROUPS_X - 1) / MAX_GROUPS_X, 1);
+}
+
+
+void Application::cleanupMeshlets() {
+    if (drawPath == DrawPath::Direct) return;
+
+    if (drawPath == DrawPath::ComputeCull) {
+        vkDestroyPipeline(device, cullPipeline, nullptr);
+        vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkDestroyBuffer(device, culledIndexBuffers[i], nullptr);
+            freeMemory(culledIndexBuffersMemory[i]);
+            vkDestroyBuffer(device, drawCommandBuffers[i], nullptr);
+            freeMemory(drawCommandBuffersMemory[i]); // implicitly unmapped
+        }
+    }
+    else {
+        vkDestroyPipeline(device, meshPipeline, nullptr);
+        vkDestroyPipelineLayout(device, meshPipelineLayout, nullptr);
+    }
+
+    vkDestroyDescriptorPool(device, meshletDescriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, meshletSetLayout, nullptr);
+
+    vkDestroyBuffer(device, meshletBuffer, nullptr);
+    freeMemory(meshletBufferMemory);
+    vkDestroyBuffer(device, meshletVertexBuffer, nullptr);
+    freeMemory(meshletVertexBufferMemory);
+    vkDestroyBuffer(device, meshletTriangleBuffer, nullptr);
+    freeMemory(meshletTriangleBufferMemory);
+}
\ No newline at end of file
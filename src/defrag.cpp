@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include "application.h"
+#include "command.h"
+
+
+void Application::createDefragmentation() {
+    defragStepBytes = VkDeviceSize(options.defragKilobytes) * 1024;
+
+    soakBuffers.resize(options.memorySoak);
+    soakBuffersMemory.resize(options.memorySoak);
+    for (uint32_t i = 0; i < options.memorySoak; i++) {
+        createSoakBuffer(i);
+    }
+}
+
+
+// Everything that can live somewhere else without more than a copy and a few descriptor writes. Not the per-frame
+// buffers the GPU writes (cull output, virtual texture feedback), nor the virtual texture's cache, nor the main texture
+// while levels still stream into it
+std::vector<MovableResource> Application::collectMovableResources() {
+    std::vector<MovableResource> movable;
+    auto add = [&](MovableKind kind, VkBuffer* buffer, DeviceAllocation& memory, uint32_t index) {
+        if (memory.memory != VK_NULL_HANDLE && memory.block != DEDICATED_ALLOCATION) movable.push_back({ kind, buffer, &memory, index });
+    };
+
+    add(MovableKind::MeshletSetBuffer, &vertexBuffer, vertexBufferMemory, 0); // the mesh shader fetches from it
+    add(MovableKind::Buffer, &indexBuffer, indexBufferMemory, 0);
+    add(MovableKind::Buffer, &drawIndirectBuffer, drawIndirectBufferMemory, 0);
+    for (uint32_t i = 0; i < meshVertexBuffers.size(); i++) {
+        add(MovableKind::Buffer, &meshVertexBuffers[i], meshVertexBuffersMemory[i], i);
+        add(MovableKind::Buffer, &meshIndexBuffers[i], meshIndexBuffersMemory[i], i);
+    }
+    if (drawPath != DrawPath::Direct) {
+        add(MovableKind::MeshletSetBuffer, &meshletBuffer, meshletBufferMemory, 0);
+        add(MovableKind::MeshletSetBuffer, &meshletVertexBuffer, meshletVertexBufferMemory, 0);
+        add(MovableKind::MeshletSetBuffer, &meshletTriangleBuffer, meshletTriangleBufferMemory, 0);
+    }
+    add(MovableKind::RegionBuffer, &textureRegionBuffer, textureRegionBufferMemory, 0);
+    for (uint32_t i = 0; i < soakBuffers.size(); i++) {
+        add(MovableKind::Buffer, &soakBuffers[i], soakBuffersMemory[i], i);
+    }
+
+    if (!virtualTexturing && !streamingTexture) {
+        add(MovableKind::Texture, nullptr, textureImageMemory, 0);
+    }
+    for (uint32_t i = 0; i < textureGroupImages.size(); i++) {
+        add(MovableKind::TextureGroup, nullptr, textureGroupImagesMemory[i], i);
+    }
+    return movable;
+}
+
+
+// The least used block that holds nothing but movable resources and whose contents the other blocks of its kind have
+// room for. DEDICATED_ALLOCATION if there is none
+uint32_t Application::pickDefragSource(const std::vector<MovableResource>& movable) {
+    std::vector<uint32_t> movableCounts(memoryBlocks.size(), 0);
+    for (const MovableResource& resource : movable) {
+        movableCounts[resource.memory->block]++;
+    }
+
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    uint32_t source = DEDICATED_ALLOCATION;
+    VkDeviceSize sourceUsed = 0;
+    for (uint32_t i = 0; i < memoryBlocks.size(); i++) {
+        const MemoryBlock* block = memoryBlocks[i].get();
+        if (!block || movableCounts[i] == 0 || movableCounts[i] != block->heap.allocationCount()) continue;
+
+        VkDeviceSize used = block->heap.capacity() - block->heap.freeBytes();
+        VkDeviceSize roomElsewhere = 0;
+        for (uint32_t j = 0; j < memoryBlocks.size(); j++) {
+            const MemoryBlock* other = memoryBlocks[j].get();
+            if (other && j != i && other->memoryType == block->memoryType && other->optimalImages == block->optimalImages) {
+                roomElsewhere += other->heap.freeBytes();
+            }
+        }
+        if (roomElsewhere >= used && (source == DEDICATED_ALLOCATION || used < sourceUsed)) {
+            source = i;
+            sourceUsed = used;
+        }
+    }
+    return source;
+}
+
+
+// Allocations and frees so far. Where nothing could be moved, nothing can until this changes
+uint64_t Application::memoryChanges() {
+    return memoryStats.allocateCount + memoryStats.freeCount;
+}
+
+
+// Whether a block other than the one being emptied can take size more bytes, so moving does not make a new block
+bool Application::fitsOutsideBlock(uint32_t source, VkDeviceSize size) {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    const MemoryBlock* from = memoryBlocks[source].get();
+    return std::any_of(memoryBlocks.begin(), memoryBlocks.end(), [&](const std::unique_ptr<MemoryBlock>& block) {
+        return block && block.get() != from && block->memoryType == from->memoryType && block->optimalImages == from->optimalImages
+            && block->heap.largestFree() >= size + DEFRAG_ALIGNMENT_SLACK;
+    });
+}
+
+
+// One step a frame, before it is recorded: copy the biggest resources of the emptiest block into the other blocks, up
+// to this step's bytes, wait for the copies, then switch handles and descriptors over and free the old memory. The block
+// is given back with its last allocation. Nothing to do until an allocation changes things when nothing fitted
+void Application::updateDefragmentation() {
+    if (options.defragKilobytes == 0 || memoryChanges() == defragBlockedAt) return;
+    auto start = Clock::now();
+
+    std::vector<MovableResource> movable = collectMovableResources();
+    uint32_t source = pickDefragSource(movable);
+    if (source == DEDICATED_ALLOCATION) {
+        defragBlockedAt = memoryChanges();
+        return;
+    }
+    std::vector<MovableResource> candidates;
+    std::copy_if(movable.begin(), movable.end(), std::back_inserter(candidates), [&](const MovableResource& resource) {
+        return resource.memory->block == source;
+    });
+    std::sort(candidates.begin(), candidates.end(), [](const MovableResource& a, const MovableResource& b) {
+        return a.memory->size > b.memory->size;
+    });
+
+    // The new resources, made while the source block is off limits
+    struct Move {
+        MovableResource resource;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImage image = VK_NULL_HANDLE;
+        DeviceAllocation memory;
+    };
+    std::vector<Move> moves;
+    VkDeviceSize stepBytes = 0;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    excludedBlock = source;
+    for (const MovableResource& resource : candidates) {
+        if (!moves.empty() && stepBytes + resource.memory->size > defragStepBytes) break;
+        if (!fitsOutsideBlock(source, resource.memory->size)) break;
+        if (commandBuffer == VK_NULL_HANDLE) commandBuffer = beginSingleTimeCommands();
+
+        Move move;
+        move.resource = resource;
+        if (resource.buffer) {
+            createBuffer(resource.memory->bufferSize, resource.memory->bufferUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, move.buffer, move.memory);
+            VkBufferCopy region{ 0, 0, resource.memory->bufferSize };
+            vkCmdCopyBuffer(commandBuffer, *resource.buffer, move.buffer, 1, &region);
+        }
+        else if (resource.kind == MovableKind::Texture) {
+            createImage(textureExtent.width, textureExtent.height, mipLevels, VK_SAMPLE_COUNT_1_BIT, textureFormat, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, move.image, move.memory);
+            recordImageLevelsCopy(commandBuffer, textureImage, move.image, textureExtent.width, textureExtent.height, mipLevels, 1, 0);
+        }
+        else {
+            const TextureGroup& group = texturePacking.groups[resource.index];
+            createImage(group.width, group.height, group.mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, move.image, move.memory, {}, 0, group.layerCount);
+            recordImageLevelsCopy(commandBuffer, textureGroupImages[resource.index], move.image, group.width, group.height, group.mipLevels,
+                group.layerCount, 0);
+        }
+        stepBytes += resource.memory->size;
+        moves.push_back(move);
+    }
+    excludedBlock = DEDICATED_ALLOCATION;
+    if (moves.empty()) {
+        defragBlockedAt = memoryChanges();
+        return;
+    }
+
+    // Copied buffers are read as vertices, indices, indirect commands and storage from the next frame on
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    endSingleTimeCommands(commandBuffer); // waits for the queue, so no frame still uses the old handles either
+
+    bool texturesMoved = false, meshletSetsMoved = false, regionsMoved = false;
+    for (Move& move : moves) {
+        const MovableResource& resource = move.resource;
+        defragStats.movedBytes += resource.memory->size;
+        if (resource.buffer) {
+            vkDestroyBuffer(device, *resource.buffer, nullptr);
+            *resource.buffer = move.buffer;
+            meshletSetsMoved |= resource.kind == MovableKind::MeshletSetBuffer;
+            regionsMoved |= resource.kind == MovableKind::RegionBuffer;
+        }
+        else if (resource.kind == MovableKind::Texture) {
+            vkDestroyImageView(device, textureImageView, nullptr);
+            for (VkImageView view : retiredTextureViews) {
+                vkDestroyImageView(device, view, nullptr);
+            }
+            retiredTextureViews.clear();
+            vkDestroyImage(device, textureImage, nullptr);
+            textureImage = move.image;
+            textureViewUsage = 0; // the copy has no storage usage to narrow
+            createTextureImageView();
+            texturesMoved = true;
+        }
+        else {
+            vkDestroyImageView(device, textureGroupViews[resource.index], nullptr);
+            vkDestroyImage(device, textureGroupImages[resource.index], nullptr);
+            textureGroupImages[resource.index] = move.image;
+            createTextureGroupView(resource.index);
+            texturesMoved = true;
+        }
+        freeMemory(*resource.memory);
+        *resource.memory = move.memory;
+    }
+    for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++) {
+        if (texturesMoved) writeTextureDescriptors(frame);
+        if (regionsMoved) writeRegionDescriptors(frame);
+        if (meshletSetsMoved && !meshletDescriptorSets.empty()) writeMeshletDescriptors(frame);
+    }
+
+    if (!memoryBlocks[source]) defragStats.releasedBlocks++;
+    defragStats.steps++;
+    defragStats.moves += moves.size();
+    double milliseconds = millisecondsSince(start);
+    defragStats.milliseconds += milliseconds;
+    defragStats.maxStepMilliseconds = (std::max)(defragStats.maxStepMilliseconds, milliseconds);
+
+    // Most of the step is the wait for the copies, so the next one gets fewer bytes if this one ran over
+    VkDeviceSize maxStepBytes = VkDeviceSize(options.defragKilobytes) * 1024;
+    if (milliseconds > options.defragMilliseconds) {
+        defragStepBytes = (std::min)((std::max)(defragStepBytes / 2, DEFRAG_MIN_STEP_BYTES), maxStepBytes);
+    }
+    else if (milliseconds < options.defragMilliseconds / 2) {
+        defragStepBytes = (std::min)(defragStepBytes * 2, maxStepBytes);
+    }
+}
+
+
+// Sizes like a scene's, as in bench/allocatorBench.cpp: mostly small buffers, some of a few hundred KB, a few of MBs
+void Application::createSoakBuffer(uint32_t index) {
+    uint32_t kind = soakRandom() % 100;
+    VkDeviceSize size;
+    if (kind < 60) size = 256 + soakRandom() % (16 * 1024);
+    else if (kind < 90) size = 16 * 1024 + soakRandom() % (256 * 1024);
+    else if (kind < 99) size = 256 * 1024 + soakRandom() % (1024 * 1024);
+    else size = 1024 * 1024 + soakRandom() % (3 * 1024 * 1024);
+    createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        soakBuffers[index], soakBuffersMemory[index]);
+}
+
+
+// --memory-soak: the churn of a long session, a sixteenth of the buffers freed and made again at other sizes every
+// frame. No frame reads them, so they go at once
+void Application::updateMemorySoak() {
+    if (soakBuffers.empty()) return;
+    uint32_t count = (std::max)(static_cast<uint32_t>(soakBuffers.size()) / 16, 1u);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = soakRandom() % soakBuffers.size();
+        vkDestroyBuffer(device, soakBuffers[index], nullptr);
+        freeMemory(soakBuffersMemory[index]);
+        createSoakBuffer(index);
+    }
+
+    if (frameNumber % SOAK_REPORT_FRAMES == 0) {
+        MemoryBlockTotals totals = sumMemoryBlocks();
+        std::cout << "Soak frame " << frameNumber << ": " << totals.blocks << " blocks of " << totals.capacity / (1024 * 1024) << " MB, "
+            << (totals.capacity - totals.freeBytes) / (1024.0 * 1024.0) << " MB used, " << totals.fragmentation() << "% fragmented, "
+            << defragStats.moves << " moves and " << defragStats.releasedBlocks << " blocks given back so far" << std::endl;
+    }
+}
+
+
+void Application::printDefragStats() {
+    if (options.defragKilobytes == 0) return;
+    std::cout << "Defragmentation: " << defragStats.steps << " steps moved " << defragStats.moves << " resources ("
+        << defragStats.movedBytes / (1024.0 * 1024.0) << " MB) and gave back " << defragStats.releasedBlocks << " blocks in "
+        << defragStats.milliseconds << " ms, " << defragStats.maxStepMilliseconds << " ms the longest step, "
+        << defragStepBytes / 1024 << " KB a step at the end" << std::endl;
+}
+
+
+void Application::cleanupMemorySoak() {
+    for (size_t i = 0; i < soakBuffers.size(); i++) {
+        vkDestroyBuffer(device, soakBuffers[i], nullptr);
+        freeMemory(soakBuffersMemory[i]);
+    }
+    soakBuffers.clear();
+    soakBuffersMemory.clear();
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "deviceMemory.h"
+
+
+const VkDeviceSize DEFRAG_MIN_STEP_BYTES = 256 * 1024; // --defrag-ms never shrinks a step below this
+const VkDeviceSize DEFRAG_ALIGNMENT_SLACK = 64 * 1024; // the most alignment a copy may need on top of the old size
+const uint32_t SOAK_REPORT_FRAMES = 100;
+
+
+// What has to be patched once a resource lives somewhere else
+enum class MovableKind : uint32_t {
+    Buffer, // bound when the frame is recorded, nothing
+    MeshletSetBuffer, // in the meshlet descriptor sets
+    RegionBuffer, // in the material descriptor sets
+    Texture, // the main texture, its view and the material descriptor sets
+    TextureGroup // index is the group
+};
+
+
+// A live buffer or image defragmentation may move, and where its handle and memory are kept. Collected for every step,
+// so the pointers never outlive a frame, see collectMovableResources
+struct MovableResource {
+    MovableKind kind;
+    VkBuffer* buffer; // nullptr for the images
+    DeviceAllocation* memory;
+    uint32_t index;
+};
+
+
+struct DefragStats {
+    uint32_t steps = 0;
+    uint64_t moves = 0;
+    VkDeviceSize movedBytes = 0;
+    uint32_t releasedBlocks = 0;
+    double milliseconds = 0.0;
+    double maxStepMilliseconds = 0.0;
+};
\ No newline at end of file
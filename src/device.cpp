@@ -1,9 +1,12 @@
+#include <algorithm>
+#include <iostream>
 #include <stdexcept>
 #include <map>
 #include <set>
 #include <string>
 
 #include "application.h"
+#include "bindless.h"
 #include "debug.h"
 #include "queueFamily.h"
 #include "swapChain.h"
@@ -48,7 +51,7 @@ void Application::pickPhysicalDevice() {
 
 void Application::createLogicalDevice() {
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
     float queuePriority = 1.0f;
@@ -61,10 +64,115 @@ void Application::createLogicalDevice() {
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    // Pick how meshlets get culled. The mesh shader reads full Vertex structs, so it does not mix with --packed-vertices
+    bool useMeshShader = false;
+    bool singleMesh = options.meshCopies <= 1 && !options.separateBuffers;
+    if (!singleMesh && (options.meshShader || options.cullMeshlets)) {
+        std::cout << "meshlets only cover a single pooled mesh, drawing without culling" << std::endl;
+    }
+    else if (options.meshShader) {
+        if (options.packedVertices) {
+            std::cout << "--mesh-shader does not support --packed-vertices, using compute culling" << std::endl;
+        }
+        else if (!checkMeshShaderSupport(physicalDevice)) {
+            std::cout << "VK_EXT_mesh_shader not supported, using compute culling" << std::endl;
+        }
+        else {
+            useMeshShader = true;
+        }
+    }
+    drawPath = useMeshShader ? DrawPath::MeshShader : (options.cullMeshlets && singleMesh ? DrawPath::ComputeCull : DrawPath::Direct);
+
+    // Bindless draws carry their texture index in firstInstance, which only the vertex shader path passes on
+    bindlessTextures = false;
+    if (options.bindless) {
+        if (drawPath != DrawPath::Direct) {
+            std::cout << "--bindless needs the vertex shader path (--mesh-copies or --no-cull), using descriptor sets" << std::endl;
+        }
+        else if (!checkDescriptorIndexingSupport(physicalDevice, bindlessTextureCapacity)) {
+            std::cout << "VK_EXT_descriptor_indexing not supported, using descriptor sets" << std::endl;
+        }
+        else {
+            bindlessTextures = true;
+        }
+    }
+    // Material textures tell the fragment shader which texture through firstInstance, the same way bindless does
+    materialTexturing = false;
+    if (!options.materialTextures.empty()) {
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        if (drawPath != DrawPath::Direct) {
+            std::cout << "--material-textures needs the vertex shader path (--mesh-copies or --no-cull), using the model's texture" << std::endl;
+        }
+        else if (bindlessTextures) {
+            std::cout << "--material-textures does not combine with --bindless, using the model's texture" << std::endl;
+        }
+        else if (!supportedFeatures.drawIndirectFirstInstance) {
+            std::cout << "drawIndirectFirstInstance not supported, using the model's texture" << std::endl;
+        }
+        else {
+            materialTexturing = true;
+        }
+    }
+    // The virtual texture's fragment shader writes page requests to a storage buffer
+    virtualTexturing = false;
+    if (options.virtualTexturePages > 0) {
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        if (bindlessTextures) {
+            std::cout << "--virtual-texture does not combine with --bindless, keeping the whole texture resident" << std::endl;
+        }
+        else if (materialTexturing) {
+            std::cout << "--virtual-texture does not combine with --material-textures, keeping the whole texture resident" << std::endl;
+        }
+        else if (isTiffPath(options.texturePath)) {
+            std::cout << "--virtual-texture needs the cached mip chain, a .tif is streamed in tiles instead, keeping the whole texture resident" << std::endl;
+        }
+        else if (options.blitMipmaps) {
+            std::cout << "--virtual-texture needs the cached mip chain, not --blit-mipmaps, keeping the whole texture resident" << std::endl;
+        }
+        else if (!supportedFeatures.fragmentStoresAndAtomics) {
+            std::cout << "fragment shader stores not supported, keeping the whole texture resident" << std::endl;
+        }
+        else {
+            virtualTexturing = true;
+        }
+    }
+    materialCount = std::clamp(options.materials, 1u, (std::max)(options.meshCopies, 1u));
+    if (bindlessTextures) {
+        materialCount = (std::min)(materialCount, bindlessTextureCapacity);
+    }
+
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    meshShaderFeatures.taskShader = VK_TRUE;
+    meshShaderFeatures.meshShader = VK_TRUE;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    if (useMeshShader) {
+        enabledExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+        createInfo.pNext = &meshShaderFeatures; // fine next to pEnabledFeatures, only VkPhysicalDeviceFeatures2 is not
+    }
+    if (bindlessTextures) {
+        enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        indexingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+        createInfo.pNext = &indexingFeatures;
+    }
+    memoryBudgetSupported = checkMemoryBudgetSupport(physicalDevice);
+    if (memoryBudgetSupported) {
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME); // no features, just the query, see queryMemoryBudget
+    }
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 
@@ -74,6 +182,11 @@ void Application::createLogicalDevice() {
     vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
     createInfo.pEnabledFeatures = &deviceFeatures;
 
+    // Without multiDrawIndirect every indirect draw call takes a single command
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    maxDrawIndirectCount = deviceFeatures.multiDrawIndirect ? (std::max)(deviceProperties.limits.maxDrawIndirectCount, 1u) : 1;
+
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
         createInfo.ppEnabledLayerNames = validationLayers.data();
@@ -91,6 +204,14 @@ void Application::createLogicalDevice() {
     // Queue index = 0 since only 1 queue
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+
+    if (useMeshShader) { // extension command, not exported by the loader
+        vkCmdDrawMeshTasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT"));
+        if (vkCmdDrawMeshTasks == nullptr) {
+            throw std::runtime_error("failed to load vkCmdDrawMeshTasksEXT!");
+        }
+    }
 }
 
 int Application::rateDeviceSuitability(VkPhysicalDevice device) {
@@ -148,4 +269,88 @@ bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
     }
 
     return requiredExtensions.empty();
+}
+
+
+bool Application::checkMeshShaderSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_2) return false;
+
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    bool found = false;
+    for (const auto& extension : availableExtensions) {
+        if (std::string(extension.extensionName) == VK_EXT_MESH_SHADER_EXTENSION_NAME) found = true;
+    }
+    if (!found) return false;
+
+    // The extension can be there with the task stage missing, so check the features as well
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &meshShaderFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+}
+
+
+// Optional: without it the budget is the heap's size and the usage only what we allocated, see queryMemoryBudget
+bool Application::checkMemoryBudgetSupport(VkPhysicalDevice device) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions) {
+        if (std::string(extension.extensionName) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) return true;
+    }
+    return false;
+}
+
+
+// What --bindless relies on: non-uniform indexing into a partially bound, update-after-bind array of sampled images, and
+// firstInstance in indirect draws. textureCapacity is how big the array can be on this device
+bool Application::checkDescriptorIndexingSupport(VkPhysicalDevice device, uint32_t& textureCapacity) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_1) return false; // the extension needs maintenance3
+
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    bool found = false;
+    for (const auto& extension : availableExtensions) {
+        if (std::string(extension.extensionName) == VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) found = true;
+    }
+    if (!found) return false;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    if (!indexingFeatures.shaderSampledImageArrayNonUniformIndexing || !indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+        || !indexingFeatures.descriptorBindingPartiallyBound || !indexingFeatures.runtimeDescriptorArray
+        || !features.features.drawIndirectFirstInstance) {
+        return false;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(device, &properties);
+    textureCapacity = (std::min)({ BINDLESS_TEXTURE_CAPACITY, 1u << BINDLESS_SAMPLER_SHIFT,
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages });
+    return textureCapacity > 0;
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "application.h"
+
+
+void Application::createMemoryAllocator() {
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    bufferImageGranularity = deviceProperties.limits.bufferImageGranularity;
+    dedicatedAllocationQueries = deviceProperties.apiVersion >= VK_API_VERSION_1_1; // VK_KHR_dedicated_allocation is core there
+}
+
+
+// What the buffer or image needs, and whether the driver would rather it had a VkDeviceMemory of its own (some do for
+// render targets, to compress them)
+bool Application::queryMemoryRequirements(VkBuffer buffer, VkImage image, VkMemoryRequirements& requirements) {
+    if (!dedicatedAllocationQueries) {
+        if (buffer != VK_NULL_HANDLE) vkGetBufferMemoryRequirements(device, buffer, &requirements);
+        else vkGetImageMemoryRequirements(device, image, &requirements);
+        return false;
+    }
+
+    VkMemoryDedicatedRequirements dedicatedRequirements{};
+    dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 requirements2{};
+    requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements2.pNext = &dedicatedRequirements;
+    if (buffer != VK_NULL_HANDLE) {
+        VkBufferMemoryRequirementsInfo2 info{};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+        info.buffer = buffer;
+        vkGetBufferMemoryRequirements2(device, &info, &requirements2);
+    }
+    else {
+        VkImageMemoryRequirementsInfo2 info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+        info.image = image;
+        vkGetImageMemoryRequirements2(device, &info, &requirements2);
+    }
+    requirements = requirements2.memoryRequirements;
+    return dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+}
+
+
+// Smaller blocks on small heaps (eg the 256 MB of host visible device memory without resizable BAR), so one block
+// does not take a big share of the heap
+VkDeviceSize Application::memoryBlockSize(uint32_t memoryType) {
+    VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+    return (std::min)(DEVICE_MEMORY_BLOCK_SIZE, heapSize / 8);
+}
+
+
+VkDeviceMemory Application::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, VkBuffer buffer, VkImage image, void*& mapped) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+    VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+    if (dedicatedAllocationQueries && (buffer != VK_NULL_HANDLE || image != VK_NULL_HANDLE)) {
+        dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicatedInfo.buffer = buffer;
+        dedicatedInfo.image = image;
+        allocInfo.pNext = &dedicatedInfo;
+    }
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    memoryStats.memoryAllocations++;
+    memoryStats.heapBytes[memoryProperties.memoryTypes[memoryType].heapIndex] += size;
+
+    mapped = nullptr;
+    if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped); // once, a VkDeviceMemory can only be mapped once at a time
+    }
+    return memory;
+}
+
+
+// Sub-allocated from a block of the memory type, first block that has room, a new block when none has. Attachments
+// (dedicated), whatever the driver wants on its own, and anything over half a block get a VkDeviceMemory of their own.
+// Also called from the decode worker, for the texture staging buffer
+DeviceAllocation Application::allocateMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, VkBuffer buffer,
+    VkImage image, bool optimalImage, bool dedicated, MemoryCategory category) {
+    auto start = Clock::now();
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    bool separateImages = optimalImage && bufferImageGranularity > 1;
+    VkDeviceSize blockSize = memoryBlockSize(memoryType);
+
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    DeviceAllocation allocation;
+    allocation.size = requirements.size;
+    allocation.memoryType = memoryType;
+    allocation.category = category;
+
+    if (!dedicated && requirements.size <= blockSize / 2) {
+        for (uint32_t i = 0; i < memoryBlocks.size() && allocation.memory == VK_NULL_HANDLE; i++) {
+            MemoryBlock* block = memoryBlocks[i].get();
+            if (!block || block->memoryType != memoryType || block->optimalImages != separateImages || i == excludedBlock) continue;
+            allocation.node = block->heap.allocate(requirements.size, requirements.alignment, allocation.offset);
+            if (allocation.node != TLSF_NONE) {
+                allocation.memory = block->memory;
+                allocation.block = i;
+            }
+        }
+
+        if (allocation.memory == VK_NULL_HANDLE) {
+            void* mapped;
+            VkDeviceMemory memory = allocateDeviceMemory(blockSize, memoryType, VK_NULL_HANDLE, VK_NULL_HANDLE, mapped);
+            if (memory != VK_NULL_HANDLE) { // else out of memory for a whole block, maybe not for this one resource
+                auto block = std::make_unique<MemoryBlock>(MemoryBlock{ memory, memoryType, separateImages, mapped, {} });
+                block->heap.reset(blockSize);
+                allocation.node = block->heap.allocate(requirements.size, requirements.alignment, allocation.offset);
+                if (allocation.node != TLSF_NONE) allocation.memory = memory; // else an alignment bigger than the rest of the block
+
+                auto slot = std::find(memoryBlocks.begin(), memoryBlocks.end(), nullptr);
+                allocation.block = static_cast<uint32_t>(slot - memoryBlocks.begin());
+                if (slot == memoryBlocks.end()) memoryBlocks.push_back(std::move(block));
+                else *slot = std::move(block);
+            }
+        }
+        if (allocation.memory != VK_NULL_HANDLE) {
+            void* blockMapped = memoryBlocks[allocation.block]->mapped;
+            allocation.mapped = blockMapped ? static_cast<uint8_t*>(blockMapped) + allocation.offset : nullptr;
+        }
+    }
+
+    if (allocation.memory == VK_NULL_HANDLE) {
+        allocation.memory = allocateDeviceMemory(requirements.size, memoryType, buffer, image, allocation.mapped);
+        if (allocation.memory == VK_NULL_HANDLE) {
+            throw std::runtime_error("failed to allocate device memory!");
+        }
+        allocation.block = DEDICATED_ALLOCATION;
+        memoryStats.dedicatedCount++;
+        memoryStats.dedicatedBytes += requirements.size;
+    }
+
+    memoryStats.categoryBytes[memoryProperties.memoryTypes[memoryType].heapIndex][uint32_t(category)] += requirements.size;
+    double milliseconds = millisecondsSince(start);
+    memoryStats.allocateCount++;
+    memoryStats.allocateMilliseconds += milliseconds;
+    memoryStats.maxAllocateMilliseconds = (std::max)(memoryStats.maxAllocateMilliseconds, milliseconds);
+    return allocation;
+}
+
+
+// An empty block is given back unless it is the last of its kind, which stays for the next allocation (eg the staging
+// buffers that come and go during startup)
+void Application::freeMemory(DeviceAllocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) return;
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    uint32_t heap = memoryProperties.memoryTypes[allocation.memoryType].heapIndex;
+    memoryStats.categoryBytes[heap][uint32_t(allocation.category)] -= allocation.size;
+    memoryStats.freeCount++;
+
+    if (allocation.block == DEDICATED_ALLOCATION) {
+        vkFreeMemory(device, allocation.memory, nullptr); // implicitly unmapped
+        memoryStats.heapBytes[heap] -= allocation.size;
+        memoryStats.dedicatedCount--;
+        memoryStats.dedicatedBytes -= allocation.size;
+    }
+    else {
+        std::unique_ptr<MemoryBlock>& block = memoryBlocks[allocation.block];
+        block->heap.free(allocation.node);
+        bool sameKind = std::any_of(memoryBlocks.begin(), memoryBlocks.end(), [&](const std::unique_ptr<MemoryBlock>& other) {
+            return other && other != block && other->memoryType == block->memoryType && other->optimalImages == block->optimalImages;
+        });
+        if (block->heap.allocationCount() == 0 && sameKind) {
+            vkFreeMemory(device, block->memory, nullptr);
+            memoryStats.heapBytes[heap] -= block->heap.capacity();
+            block.reset();
+        }
+    }
+    allocation = DeviceAllocation();
+}
+
+
+MemoryBlockTotals Application::sumMemoryBlocks() {
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    MemoryBlockTotals totals;
+    for (const std::unique_ptr<MemoryBlock>& block : memoryBlocks) {
+        if (!block) continue;
+        totals.blocks++;
+        totals.allocations += block->heap.allocationCount();
+        totals.capacity += block->heap.capacity();
+        totals.freeBytes += block->heap.freeBytes();
+        totals.largestFree += block->heap.largestFree();
+    }
+    return totals;
+}
+
+
+void Application::printDeviceMemoryStats() {
+    MemoryBlockTotals totals = sumMemoryBlocks();
+    double averageMicroseconds = memoryStats.allocateCount > 0 ? 1000.0 * memoryStats.allocateMilliseconds / memoryStats.allocateCount : 0.0;
+    std::cout << "Device memory: " << totals.blocks << " blocks of " << totals.capacity / (1024 * 1024) << " MB holding " << totals.allocations
+        << " allocations (" << (totals.capacity - totals.freeBytes) / (1024 * 1024) << " MB used, " << totals.fragmentation() << "% fragmented), "
+        << memoryStats.dedicatedCount << " dedicated (" << memoryStats.dedicatedBytes / (1024 * 1024) << " MB), "
+        << memoryStats.memoryAllocations << " vkAllocateMemory for " << memoryStats.allocateCount << " allocations, "
+        << averageMicroseconds << " us average, " << 1000.0 * memoryStats.maxAllocateMilliseconds << " us max" << std::endl;
+}
+
+
+// After everything has freed its memory, the blocks kept for reuse
+void Application::cleanupDeviceMemory() {
+    for (std::unique_ptr<MemoryBlock>& block : memoryBlocks) {
+        if (block) vkFreeMemory(device, block->memory, nullptr);
+    }
+    memoryBlocks.clear();
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "tlsf.h"
+
+
+const VkDeviceSize DEVICE_MEMORY_BLOCK_SIZE = 64 * 1024 * 1024; // per vkAllocateMemory, smaller on small heaps
+const uint32_t DEDICATED_ALLOCATION = UINT32_MAX;
+
+
+// What an allocation holds, from the usage it was created with, for the budget and the stats
+enum class MemoryCategory : uint32_t {
+    Texture,
+    Geometry, // vertex, index and indirect buffers
+    Attachment,
+    Uniform,
+    Staging,
+    Other,
+    Count
+};
+
+
+// Where a buffer or image lives: a range of one of the allocator's blocks, or a VkDeviceMemory of its own
+struct DeviceAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr; // at offset already, when the memory is host visible. Stays mapped until freed
+    uint32_t block = DEDICATED_ALLOCATION;
+    uint32_t node = TLSF_NONE; // in the block's heap
+    uint32_t memoryType = 0;
+    MemoryCategory category = MemoryCategory::Other;
+    VkDeviceSize bufferSize = 0; // createBuffer's size and usage, for defragmentation to make another buffer like it
+    VkBufferUsageFlags bufferUsage = 0;
+};
+
+
+// One vkAllocateMemory, sub-allocated. Buffers and optimal tiling images get blocks of their own when the device's
+// bufferImageGranularity would otherwise need padding between them
+struct MemoryBlock {
+    VkDeviceMemory memory;
+    uint32_t memoryType;
+    bool optimalImages;
+    void* mapped; // the whole block, when host visible
+    TlsfHeap heap;
+};
+
+
+struct DeviceMemoryStats {
+    uint32_t memoryAllocations = 0; // vkAllocateMemory calls, blocks and dedicated
+    uint32_t dedicatedCount = 0; // live
+    VkDeviceSize dedicatedBytes = 0;
+    uint64_t allocateCount = 0; // allocateMemory calls
+    uint64_t freeCount = 0; // freeMemory calls
+    double allocateMilliseconds = 0.0;
+    double maxAllocateMilliseconds = 0.0;
+    VkDeviceSize heapBytes[VK_MAX_MEMORY_HEAPS] = {}; // vkAllocateMemory'd, blocks and dedicated
+    VkDeviceSize categoryBytes[VK_MAX_MEMORY_HEAPS][uint32_t(MemoryCategory::Count)] = {}; // live allocations
+};
+
+
+// The blocks added up, see sumMemoryBlocks
+struct MemoryBlockTotals {
+    uint32_t blocks = 0;
+    uint32_t allocations = 0;
+    VkDeviceSize capacity = 0;
+    VkDeviceSize freeBytes = 0;
+    VkDeviceSize largestFree = 0; // each block's biggest free range, summed
+
+    // How much of the free space is not in its block's biggest free range, in %
+    double fragmentation() const { return freeBytes > 0 ? 100.0 * (1.0 - double(largestFree) / double(freeBytes)) : 0.0; }
+};
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include "application.h"
+#include "shader.h"
+
+
+const uint32_t DOWNSAMPLE_TILE = 64; // source texels per group and side, 6 levels later one texel (downsample.comp)
+const uint32_t DOWNSAMPLE_MAX_LEVELS = 12; // per dispatch, 6 in every group and 6 more in the last one
+const uint32_t DOWNSAMPLE_MAX_TAIL_SOURCE = DOWNSAMPLE_TILE << 6; // the last group only covers a 64x64 level 6
+
+struct DownsampleConstants { // push constants of downsample.comp
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+    uint32_t levelCount;
+    uint32_t groupCount;
+    uint32_t srgb;
+};
+
+
+// The compute path writes the sRGB texture through UNORM storage views, so the image needs the extended usage (Vulkan 1.1)
+// and the sampled view has to drop the storage usage again
+bool Application::isComputeDownsampleSupported() {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_1) return false;
+
+    VkPhysicalDeviceFeatures deviceFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
+    if (!deviceFeatures.shaderStorageImageArrayDynamicIndexing) return false; // levels[] is indexed by a loop counter
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+    return formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+}
+
+
+// All the mips of an RGBA8 image from level 0, which is in TRANSFER_DST like the rest. One dispatch per 12 levels (one
+// for anything up to 4096 texels), instead of a blit and two barriers per level. Needs no linear filtering support, the
+// shader only loads and stores. Everything it creates is gone again when it returns, it runs once at startup
+void Application::generateMipmapsCompute(VkImage image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels, bool srgb) {
+    auto setupStart = Clock::now();
+
+    // Above 4096 the last group cannot take the tail, so big levels go 6 at a time until the source is small enough
+    struct Dispatch {
+        uint32_t sourceLevel;
+        uint32_t levelCount;
+    };
+    std::vector<Dispatch> dispatches;
+    for (uint32_t level = 0; level + 1 < mipLevels;) {
+        uint32_t sourceSize = (std::max)((std::max)(uint32_t(texWidth) >> level, uint32_t(texHeight) >> level), 1u);
+        uint32_t count = (std::min)(mipLevels - 1 - level, sourceSize <= DOWNSAMPLE_MAX_TAIL_SOURCE ? DOWNSAMPLE_MAX_LEVELS : DOWNSAMPLE_MAX_LEVELS / 2);
+        dispatches.push_back({ level, count });
+        level += count;
+    }
+    if (dispatches.empty()) {
+        transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+        return;
+    }
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[0].descriptorCount = DOWNSAMPLE_MAX_LEVELS + 1; // the source, then the levels it writes
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    VkDescriptorSetLayout setLayout;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create downsample descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DownsampleConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VkPipelineLayout pipelineLayout;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create downsample pipeline layout!");
+    }
+
+    auto shaderCode = readFile("../../shaders/downsample.comp.spv");
+    VkShaderModule shaderModule = createShaderModule(shaderCode);
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create downsample pipeline!");
+    }
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+
+    // A storage view per level, UNORM whatever the image is
+    std::vector<VkImageView> levelViews(mipLevels);
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        levelViews[i] = createImageView(image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, 1, i, VK_IMAGE_USAGE_STORAGE_BIT);
+    }
+
+    // Counts the groups that are done, zeroed before every dispatch
+    VkBuffer counterBuffer;
+    DeviceAllocation counterBufferMemory;
+    createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, counterBuffer, counterBufferMemory);
+
+    uint32_t setCount = static_cast<uint32_t>(dispatches.size());
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount * (DOWNSAMPLE_MAX_LEVELS + 1) };
+    poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, setCount };
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = setCount;
+    VkDescriptorPool descriptorPool;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create downsample descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(setCount, setLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts.data();
+    std::vector<VkDescriptorSet> descriptorSets(setCount);
+    if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate downsample descriptor sets!");
+    }
+
+    VkDescriptorBufferInfo counterInfo{ counterBuffer, 0, sizeof(uint32_t) };
+    for (uint32_t i = 0; i < setCount; i++) {
+        // Every element has to be valid, the ones past the last level repeat it (the shader never touches them)
+        std::vector<VkDescriptorImageInfo> imageInfos(DOWNSAMPLE_MAX_LEVELS + 1);
+        for (uint32_t j = 0; j < imageInfos.size(); j++) {
+            uint32_t level = dispatches[i].sourceLevel + (std::min)(j, dispatches[i].levelCount);
+            imageInfos[j] = { VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+        }
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = descriptorSets[i];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorWrites[0].descriptorCount = static_cast<uint32_t>(imageInfos.size());
+        descriptorWrites[0].pImageInfo = imageInfos.data();
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = descriptorSets[i];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pBufferInfo = &counterInfo;
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+    startupTimings.add("generateMipmaps (compute setup)", millisecondsSince(setupStart));
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+    // Every level to GENERAL at once, level 0 has to wait for its copy
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    for (uint32_t i = 0; i < setCount; i++) {
+        vkCmdFillBuffer(commandBuffer, counterBuffer, 0, sizeof(uint32_t), 0);
+        VkMemoryBarrier counterBarrier{};
+        counterBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        counterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        counterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            1, &counterBarrier, 0, nullptr, 0, nullptr);
+
+        uint32_t sourceWidth = (std::max)(uint32_t(texWidth) >> dispatches[i].sourceLevel, 1u);
+        uint32_t sourceHeight = (std::max)(uint32_t(texHeight) >> dispatches[i].sourceLevel, 1u);
+        uint32_t groupsX = (sourceWidth + DOWNSAMPLE_TILE - 1) / DOWNSAMPLE_TILE, groupsY = (sourceHeight + DOWNSAMPLE_TILE - 1) / DOWNSAMPLE_TILE;
+        DownsampleConstants constants{ sourceWidth, sourceHeight, dispatches[i].levelCount, groupsX * groupsY, srgb ? 1u : 0u };
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+
+        // The next dispatch starts from this one's last level, and the counter gets cleared again
+        VkMemoryBarrier levelBarrier{};
+        levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        levelBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            1, &levelBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &barrier);
+
+    endSingleTimeCommands(commandBuffer);
+
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyBuffer(device, counterBuffer, nullptr);
+    freeMemory(counterBufferMemory);
+    for (VkImageView view : levelViews) {
+        vkDestroyImageView(device, view, nullptr);
+    }
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "draw.h"
 #include "command.h"
 #include "vertex.h"
+#include "options.h"
 
 
 void Application::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
@@ -26,15 +27,18 @@ void Application::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t im
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues = clearValues.data();
 
-    // All recording functions have Cmd. Return void so no error-handling until after recording
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE); // INLINE=primary buffer only
+    // Culling is a compute dispatch, it has to go before the render pass
+    if (drawPath == DrawPath::ComputeCull) {
+        recordCull(commandBuffer, currentFrame);
+    }
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline); // not a compute pipeline
-    VkBuffer vertexBuffers[] = { vertexBuffer };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets); // only 1 binding
+    // Pages loaded for the virtual texture, copied in before anything samples it
+    if (virtualTexturing) {
+        recordVirtualTextureUploads(commandBuffer);
+    }
 
-    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    // All recording functions have Cmd. Return void so no error-handling until after recording
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE); // INLINE=primary buffer only
 
     // Dynamic, but need to initialize
     VkViewport viewport{};
@@ -51,14 +55,42 @@ void Application::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t im
     scissor.extent = swapChainExtent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    // Uniforms
-    // NB DSets are not graphics-exclusive
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
-
-    // Draw Indexed
-    vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+    if (drawPath == DrawPath::MeshShader) {
+        // No vertex or index buffers, the task shader culls meshlets and the mesh shader fetches what it needs
+        recordMeshShaderDraw(commandBuffer, currentFrame);
+    }
+    else {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline); // not a compute pipeline
+
+        // Uniforms
+        // NB DSets are not graphics-exclusive
+        VkDescriptorSet descriptorSet = materialDescriptorSet(currentFrame, 0); // the whole texture table, if bindless
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet,
+            materialDynamicOffsetCount(), &frameUniformOffset);
+        descriptorBinds++;
+        if (options.packedVertices) {
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DequantizeConstants), &vertexDequantize);
+        }
+
+        if (drawPath == DrawPath::ComputeCull) {
+            // Surviving triangles only, the count comes from the cull shader
+            VkBuffer vertexBuffers[] = { vertexBuffer };
+            VkDeviceSize offsets[] = { 0 };
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets); // only 1 binding
+            vkCmdBindIndexBuffer(commandBuffer, culledIndexBuffers[currentFrame], 0, VK_INDEX_TYPE_UINT32);
+            vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffers[currentFrame], 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+            drawCalls++;
+        }
+        else {
+            // Every mesh, only the current LOD's range of each
+            recordGeometryDraws(commandBuffer, currentFrame);
+        }
+    }
 
     vkCmdEndRenderPass(commandBuffer);
+    if (virtualTexturing) {
+        recordVirtualTextureFeedback(commandBuffer);
+    }
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) { // End recording
         throw std::runtime_error("failed to record command buffer!");
     }
@@ -67,6 +99,7 @@ void Application::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t im
 
 void Application::drawFrame() {
     vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    resetFrameArena(currentFrame); // the GPU is done with what this frame wrote last time
     uint32_t imageIndex;// VkImage in swapChainImages
 
     VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
@@ -82,13 +115,24 @@ void Application::drawFrame() {
 
     vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
+    // This frame's descriptor set is free again, it can take the newest texture view
+    updateTextureStreaming();
+    updateTextureDescriptor(currentFrame);
+    residentLevelFrames[textureResidentLevel]++;
+    updateVirtualTexture(currentFrame); // its feedback buffer is only complete once the fence says so
+
+    updateUniformBuffer(currentFrame); // before recording, it also picks the LOD to draw
+    updateResidency(); // may drop what this frame would draw with, so before recording too
+    updateMemorySoak();
+    updateDefragmentation(); // moves what this frame draws with, so before recording as well
+
     vkResetCommandBuffer(commandBuffers[currentFrame], 0); // nothing special, no flags
+    auto recordStart = Clock::now();
     recordCommandBuffer(commandBuffers[currentFrame], imageIndex); // Record draw!
+    recordMilliseconds += millisecondsSince(recordStart);
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
-    updateUniformBuffer(currentFrame);
-
     // SUBMIT INFO
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -120,6 +164,9 @@ void Application::drawFrame() {
 
     presentInfo.pResults = nullptr; // Optional
     result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    if (firstFrameMilliseconds == 0.0) {
+        firstFrameMilliseconds = millisecondsSince(launchTime);
+    }
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
         framebufferResized = false;
@@ -130,4 +177,5 @@ void Application::drawFrame() {
     }
 
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    frameNumber++;
 }
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "application.h"
+#include "command.h"
+
+
+// One persistently mapped buffer, a region per frame in flight that is bumped through while the frame is recorded and
+// rewound once its fence has signalled. Uniform blocks in it are bound through UNIFORM_BUFFER_DYNAMIC descriptors, so any
+// number of them can be written each frame without new buffers, allocations or descriptor sets
+void Application::createFrameArena() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    frameArenaAlignment = (std::max)(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+    frameArenaSize = (VkDeviceSize(options.frameArenaKilobytes) * 1024 + frameArenaAlignment - 1) / frameArenaAlignment * frameArenaAlignment;
+    if (frameArenaSize * MAX_FRAMES_IN_FLIGHT > UINT32_MAX) {
+        throw std::runtime_error("failed to create frame arena, dynamic offsets are 32 bit, see --frame-arena!");
+    }
+
+    createBuffer(frameArenaSize * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        frameArenaBuffer, frameArenaMemory);
+    frameArenaHeads.assign(MAX_FRAMES_IN_FLIGHT, 0);
+    frameArenaCounts.assign(MAX_FRAMES_IN_FLIGHT, 0);
+}
+
+
+// Only once the frame's fence has signalled, the GPU may still read everything allocated in it before that
+void Application::resetFrameArena(uint32_t frame) {
+    frameArenaStats.peakBytes = (std::max)(frameArenaStats.peakBytes, frameArenaHeads[frame]);
+    frameArenaStats.peakAllocations = (std::max)(frameArenaStats.peakAllocations, frameArenaCounts[frame]);
+    frameArenaHeads[frame] = 0;
+    frameArenaCounts[frame] = 0;
+}
+
+
+FrameAllocation Application::allocateFrameData(uint32_t frame, VkDeviceSize size) {
+    VkDeviceSize offset = frameArenaHeads[frame];
+    if (offset + size > frameArenaSize) {
+        throw std::runtime_error("failed to allocate " + std::to_string(size) + " bytes of frame data, the frame arena is full, see --frame-arena!");
+    }
+    frameArenaHeads[frame] = (offset + size + frameArenaAlignment - 1) / frameArenaAlignment * frameArenaAlignment;
+    frameArenaCounts[frame]++;
+    frameArenaStats.allocations++;
+
+    VkDeviceSize bufferOffset = VkDeviceSize(frame) * frameArenaSize + offset;
+    return { static_cast<uint32_t>(bufferOffset), static_cast<uint8_t*>(frameArenaMemory.mapped) + bufferOffset };
+}
+
+
+// The bindless layout is update-after-bind, which rules out dynamic descriptors. Its uniforms descriptor is rewritten to
+// the frame's offset instead, see updateUniformBuffer
+VkDescriptorType Application::frameUniformDescriptorType() {
+    return bindlessTextures ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+}
+
+
+// Dynamic offsets a material set takes when bound: its uniforms, unless bindless
+uint32_t Application::materialDynamicOffsetCount() {
+    return bindlessTextures ? 0 : 1;
+}
+
+
+void Application::printFrameArenaStats() {
+    for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++) {
+        resetFrameArena(frame); // the frames since the last reset count too
+    }
+    std::cout << "Frame arena: " << MAX_FRAMES_IN_FLIGHT << " x " << frameArenaSize / 1024 << " KB, at most "
+        << frameArenaStats.peakBytes / 1024.0 << " KB in " << frameArenaStats.peakAllocations << " allocations in a frame, "
+        << frameArenaStats.allocations << " allocations in all" << std::endl;
+}
+
+
+void Application::cleanupFrameArena() {
+    vkDestroyBuffer(device, frameArenaBuffer, nullptr);
+    freeMemory(frameArenaMemory);
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+
+// Written this frame, read by the GPU until the frame's fence signals. offset is from the start of the arena buffer,
+// the dynamic offset to bind it with
+struct FrameAllocation {
+    uint32_t offset;
+    void* data;
+};
+
+
+struct FrameArenaStats {
+    VkDeviceSize peakBytes = 0; // the most one frame used
+    uint32_t peakAllocations = 0;
+    uint64_t allocations = 0;
+};
\ No newline at end of file
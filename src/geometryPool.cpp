@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include "application.h"
+#include "bindless.h"
+#include "mesh.h"
+#include "options.h"
+
+
+void RangeAllocator::reset(uint64_t capacity) {
+    freeRanges.clear();
+    if (capacity > 0) freeRanges[0] = capacity;
+    total = capacity;
+    available = capacity;
+}
+
+
+bool RangeAllocator::allocate(uint64_t size, uint64_t& offset) {
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it->second < size) continue;
+
+        offset = it->first;
+        uint64_t remaining = it->second - size;
+        freeRanges.erase(it);
+        if (remaining > 0) freeRanges[offset + size] = remaining;
+        available -= size;
+        return true;
+    }
+    return false;
+}
+
+
+void RangeAllocator::free(uint64_t offset, uint64_t size) {
+    available += size;
+
+    auto next = freeRanges.lower_bound(offset);
+    if (next != freeRanges.end() && next->first == offset + size) { // merge with the range after
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+    if (next != freeRanges.begin()) { // and the one before
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+    freeRanges[offset] = size;
+}
+
+
+static uint64_t roundUpToPowerOfTwo(uint64_t value) {
+    uint64_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+
+// Every mesh is a range of the pool's vertex and index buffers, so drawing them needs no rebinding and the draws can
+// come from one indirect buffer. --mesh-copies N uploads the model N times as separate meshes to stand in for a
+// bigger scene, --separate-buffers gives each mesh its own buffers instead, for comparison
+void Application::createGeometryPool() {
+    auto start = Clock::now();
+    uint32_t meshCount = (std::max)(options.meshCopies, 1u);
+
+    uint32_t vertexCount = model.vertexCount();
+    uint32_t indexCount = model.indexCount();
+
+    // Vertices as the pipeline reads them, converted straight into staging a chunk at a time. Chunks of the model
+    // are let go as soon as they are copied, so only a chunk's worth of a mapped mesh cache is resident at once
+    VkDeviceSize vertexStride = options.packedVertices ? sizeof(PackedVertex) : sizeof(Vertex);
+    if (options.packedVertices) {
+        vertexDequantize = computeDequantize(model.vertices(), model.bounds);
+        model.evictVertices(0, vertexCount);
+    }
+    auto writeVertices = [&](void* staging, size_t first, size_t count) {
+        std::span<const Vertex> source = model.vertices().subspan(first, count);
+        if (options.packedVertices) {
+            packVertices(source, vertexDequantize, static_cast<PackedVertex*>(staging));
+        }
+        else {
+            memcpy(staging, source.data(), source.size_bytes());
+        }
+        model.evictVertices(first, count);
+    };
+
+    // Half the index bandwidth whenever every vertex of a mesh fits. No primitive restart, so 0xFFFF is an ordinary index
+    indexType = vertexCount <= UINT16_MAX + 1 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    VkDeviceSize indexStride = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    auto writeIndices = [&](void* staging, size_t first, size_t count) {
+        std::span<const uint32_t> source = model.indices().subspan(first, count);
+        if (indexType == VK_INDEX_TYPE_UINT16) {
+            std::transform(source.begin(), source.end(), static_cast<uint16_t*>(staging), [](uint32_t index) { return static_cast<uint16_t>(index); });
+        }
+        else {
+            memcpy(staging, source.data(), source.size_bytes());
+        }
+        model.evictIndices(first, count);
+    };
+
+    VkDeviceSize vertexSize = vertexCount * vertexStride;
+    VkDeviceSize indexSize = indexCount * indexStride;
+    std::cout << "Mesh: " << vertexSize / 1024 << " KB of vertices (" << vertexStride << " bytes each), "
+        << indexSize / 1024 << " KB of " << indexStride * 8 << "-bit indices, " << meshCount << " copies" << std::endl;
+
+    if (options.separateBuffers) {
+        meshVertexBuffers.resize(meshCount);
+        meshVertexBuffersMemory.resize(meshCount);
+        meshIndexBuffers.resize(meshCount);
+        meshIndexBuffersMemory.resize(meshCount);
+        for (uint32_t i = 0; i < meshCount; i++) {
+            createBuffer(vertexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshVertexBuffers[i], meshVertexBuffersMemory[i]);
+            createBuffer(indexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, // see evictFinestLod
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshIndexBuffers[i], meshIndexBuffersMemory[i]);
+            uploadBufferChunked(meshVertexBuffers[i], { 0 }, vertexCount, vertexStride, writeVertices);
+            uploadBufferChunked(meshIndexBuffers[i], { 0 }, indexCount, indexStride, writeIndices);
+            meshRanges.push_back({ 0, indexCount, 0, vertexCount });
+        }
+        assignMeshMaterials();
+        startupTimings.add("createGeometryPool (separate buffers)", millisecondsSince(start));
+        return;
+    }
+
+    // Room to grow, meshes streamed in later go into the same buffers
+    vertexRanges.reset(roundUpToPowerOfTwo(uint64_t(vertexCount) * meshCount));
+    indexRanges.reset(roundUpToPowerOfTwo(uint64_t(indexCount) * meshCount));
+
+    // Storage too, the mesh shader fetches vertices itself
+    createBuffer(vertexRanges.capacity() * vertexStride,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+    createBuffer(indexRanges.capacity() * indexStride, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+
+    // Each chunk is staged once and copied to every copy's range
+    std::vector<VkDeviceSize> vertexOffsets;
+    std::vector<VkDeviceSize> indexOffsets;
+    for (uint32_t i = 0; i < meshCount; i++) {
+        MeshRange range = allocateMesh(vertexCount, indexCount);
+        meshRanges.push_back(range);
+        vertexOffsets.push_back(range.vertexOffset * vertexStride);
+        indexOffsets.push_back(range.firstIndex * indexStride);
+    }
+    uploadBufferChunked(vertexBuffer, vertexOffsets, vertexCount, vertexStride, writeVertices);
+    uploadBufferChunked(indexBuffer, indexOffsets, indexCount, indexStride, writeIndices);
+
+    std::cout << "Geometry pool: " << vertexRanges.used() << " of " << vertexRanges.capacity() << " vertices, "
+        << indexRanges.used() << " of " << indexRanges.capacity() << " indices" << std::endl;
+
+    assignMeshMaterials();
+    createDrawCommands();
+    startupTimings.add("createGeometryPool", millisecondsSince(start));
+}
+
+
+// --materials N: mesh i gets material i * N / meshCount, so every material is a contiguous run that a descriptor set
+// (or a single bindless bind) covers
+void Application::assignMeshMaterials() {
+    meshMaterials.resize(meshRanges.size());
+    for (size_t i = 0; i < meshRanges.size(); i++) {
+        meshMaterials[i] = static_cast<uint32_t>(i * materialCount / meshRanges.size());
+    }
+}
+
+
+// What a draw passes as firstInstance. Bindless: the material's texture slot, with the default sampler. Material textures:
+// the texture's entry in the region buffer. 0 otherwise
+uint32_t Application::drawMaterialIndex(uint32_t mesh) {
+    if (bindlessTextures) return bindlessDrawIndex(meshMaterials[mesh], 0);
+    if (materialTexturing) return materialTextureIndices[meshMaterials[mesh]];
+    return 0;
+}
+
+
+MeshRange Application::allocateMesh(uint32_t vertexCount, uint32_t indexCount) {
+    uint64_t vertexOffset, firstIndex;
+    if (!vertexRanges.allocate(vertexCount, vertexOffset)) {
+        throw std::runtime_error("failed to allocate vertices from the geometry pool!");
+    }
+    if (!indexRanges.allocate(indexCount, firstIndex)) {
+        vertexRanges.free(vertexOffset, vertexCount);
+        throw std::runtime_error("failed to allocate indices from the geometry pool!");
+    }
+    return { static_cast<uint32_t>(firstIndex), indexCount, static_cast<int32_t>(vertexOffset), vertexCount };
+}
+
+
+void Application::freeMesh(const MeshRange& range) {
+    vertexRanges.free(static_cast<uint64_t>(range.vertexOffset), range.vertexCount);
+    indexRanges.free(range.firstIndex, range.indexCount);
+}
+
+
+// One VkDrawIndexedIndirectCommand per mesh for each LOD, LOD-major, so a frame draws a contiguous run of them
+void Application::createDrawCommands() {
+    std::vector<VkDrawIndexedIndirectCommand> commands;
+    commands.reserve(model.lods.size() * meshRanges.size());
+    for (const MeshLod& lod : model.lods) {
+        for (uint32_t i = 0; i < meshRanges.size(); i++) {
+            const MeshRange& mesh = meshRanges[i];
+            VkDrawIndexedIndirectCommand command{};
+            command.indexCount = lod.indexCount;
+            command.instanceCount = 1;
+            command.firstIndex = mesh.firstIndex + lod.firstIndex;
+            command.vertexOffset = mesh.vertexOffset;
+            command.firstInstance = drawMaterialIndex(i); // needs drawIndirectFirstInstance, checked for bindless
+            commands.push_back(command);
+        }
+    }
+
+    createDeviceLocalBuffer(commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand),
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, drawIndirectBuffer, drawIndirectBufferMemory);
+}
+
+
+// Draws every mesh at the current LOD. From the pool that is one indirect call (more only past maxDrawIndirectCount),
+// with separate buffers it is a bind and a draw per mesh. Without bindless, every further material (texture group, with material textures) adds a descriptor set
+// bind, and from the pool also splits the indirect call
+void Application::recordGeometryDraws(VkCommandBuffer commandBuffer, uint32_t frame) {
+    uint32_t meshCount = static_cast<uint32_t>(meshRanges.size());
+    VkDeviceSize offsets[] = { 0 };
+
+    uint32_t boundSet = materialSetIndex(0); // recordCommandBuffer bound the first
+    auto bindMaterial = [&](uint32_t material) {
+        if (bindlessTextures || materialSetIndex(material) == boundSet) return;
+        VkDescriptorSet descriptorSet = materialDescriptorSet(frame, material);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet,
+            materialDynamicOffsetCount(), &frameUniformOffset);
+        descriptorBinds++;
+        boundSet = materialSetIndex(material);
+    };
+
+    if (options.separateBuffers) {
+        // The finer LODs may have been evicted, the index buffers then start at the finest one left
+        const MeshLod& drawnLod = model.lods[(std::max)(currentLod, geometryFinestLod)];
+        uint32_t firstIndex = drawnLod.firstIndex - model.lods[geometryFinestLod].firstIndex;
+        for (uint32_t i = 0; i < meshCount; i++) {
+            bindMaterial(meshMaterials[i]);
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &meshVertexBuffers[i], offsets);
+            vkCmdBindIndexBuffer(commandBuffer, meshIndexBuffers[i], 0, indexType);
+            vkCmdDrawIndexed(commandBuffer, drawnLod.indexCount, 1, firstIndex, 0, drawMaterialIndex(i));
+        }
+        drawCalls += meshCount;
+        return;
+    }
+
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+
+    VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+    VkDeviceSize lodOffset = VkDeviceSize(currentLod) * meshCount * stride;
+    for (uint32_t first = 0; first < meshCount;) {
+        // A run of meshes that share a descriptor set: a material's, a texture group's, or all of them when bindless
+        uint32_t end = bindlessTextures ? meshCount : first + 1;
+        while (end < meshCount && materialSetIndex(meshMaterials[end]) == materialSetIndex(meshMaterials[first])) end++;
+        bindMaterial(meshMaterials[first]);
+
+        for (uint32_t chunk = first; chunk < end; chunk += maxDrawIndirectCount) {
+            uint32_t count = (std::min)(maxDrawIndirectCount, end - chunk);
+            vkCmdDrawIndexedIndirect(commandBuffer, drawIndirectBuffer, lodOffset + chunk * stride, count, static_cast<uint32_t>(stride));
+            drawCalls++;
+        }
+        first = end;
+    }
+}
+
+
+void Application::cleanupGeometryPool() {
+    for (size_t i = 0; i < meshVertexBuffers.size(); i++) {
+        vkDestroyBuffer(device, meshVertexBuffers[i], nullptr);
+        freeMemory(meshVertexBuffersMemory[i]);
+        vkDestroyBuffer(device, meshIndexBuffers[i], nullptr);
+        freeMemory(meshIndexBuffersMemory[i]);
+    }
+
+    vkDestroyBuffer(device, drawIndirectBuffer, nullptr);
+    freeMemory(drawIndirectBufferMemory);
+
+    vkDestroyBuffer(device, vertexBuffer, nullptr);
+    freeMemory(vertexBufferMemory);
+
+    vkDestroyBuffer(device, indexBuffer, nullptr);
+    freeMemory(indexBufferMemory);
+}
\ No newline at end of file
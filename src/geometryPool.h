@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <map>
+
+
+// Hands out [offset, offset + size) ranges of a fixed capacity, first fit. Freed ranges merge with free neighbours.
+// Units are whatever the caller counts in, the geometry pool uses vertices and indices
+class RangeAllocator {
+public:
+    void reset(uint64_t capacity);
+
+    bool allocate(uint64_t size, uint64_t& offset); // false if no free range is big enough
+    void free(uint64_t offset, uint64_t size);
+
+    uint64_t capacity() const { return total; }
+    uint64_t used() const { return total - available; }
+
+private:
+    std::map<uint64_t, uint64_t> freeRanges; // offset -> size
+    uint64_t total = 0;
+    uint64_t available = 0;
+};
+
+
+// Where one mesh lives in the pool. Indices are relative to vertexOffset, so 16-bit indices keep working however
+// much the pool holds, as long as each mesh stays under 65536 vertices
+struct MeshRange {
+    uint32_t firstIndex; // all of the mesh's LODs, back to back as in Mesh::indices()
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+};
\ No newline at end of file
@@ -0,0 +1,424 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include "glbLoader.h"
+
+
+const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+const uint32_t GLB_VERSION = 2;
+const uint32_t CHUNK_JSON = 0x4E4F534A;
+const uint32_t CHUNK_BIN = 0x004E4942;
+
+const int MODE_TRIANGLES = 4;
+const int COMPONENT_BYTE = 5120;
+const int COMPONENT_UNSIGNED_BYTE = 5121;
+const int COMPONENT_SHORT = 5122;
+const int COMPONENT_UNSIGNED_SHORT = 5123;
+const int COMPONENT_UNSIGNED_INT = 5125;
+const int COMPONENT_FLOAT = 5126;
+
+
+static uint32_t readU32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value)); // glTF is little endian, as is everything we run on
+    return value;
+}
+
+
+void GlbFile::open(const std::string& path) {
+    if (!file.open(path)) {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+
+    const uint8_t* data = file.data();
+    size_t size = file.size();
+    if (size < 20 || readU32(data) != GLB_MAGIC || readU32(data + 4) != GLB_VERSION || readU32(data + 8) > size) {
+        throw std::runtime_error("failed to load " + path + ", not a glTF 2.0 binary!");
+    }
+    size = readU32(data + 8);
+
+    // JSON chunk first, then an optional BIN chunk. Unknown chunks after those are skipped as the spec asks
+    size_t offset = 12;
+    bool haveJson = false;
+    while (offset + 8 <= size) {
+        uint32_t length = readU32(data + offset);
+        uint32_t type = readU32(data + offset + 4);
+        offset += 8;
+        if (length > size - offset) {
+            throw std::runtime_error("failed to load " + path + ", truncated chunk!");
+        }
+
+        if (type == CHUNK_JSON && !haveJson) {
+            root = parseJson(std::string_view(reinterpret_cast<const char*>(data + offset), length));
+            haveJson = true;
+        }
+        else if (type == CHUNK_BIN && haveJson && binary.empty()) {
+            binary = std::span<const uint8_t>(data + offset, length);
+        }
+        offset += (length + 3) & ~3u;
+    }
+
+    if (!haveJson) {
+        throw std::runtime_error("failed to load " + path + ", no JSON chunk!");
+    }
+}
+
+
+void GlbFile::close() {
+    root = JsonValue();
+    binary = {};
+    file.close();
+}
+
+
+std::span<const uint8_t> GlbFile::bufferView(size_t index) const {
+    const JsonValue& view = root["bufferViews"][index];
+    if (view.isNull()) {
+        throw std::runtime_error("failed to load glTF, missing buffer view!");
+    }
+    // Only the embedded buffer, external .bin files and data: URIs would need a copy
+    size_t buffer = static_cast<size_t>(view["buffer"].number());
+    if (buffer != 0 || !root["buffers"][buffer]["uri"].isNull()) {
+        throw std::runtime_error("failed to load glTF, only the GLB binary chunk is supported as a buffer!");
+    }
+
+    size_t offset = static_cast<size_t>(view["byteOffset"].number());
+    size_t length = static_cast<size_t>(view["byteLength"].number());
+    if (offset > binary.size() || length > binary.size() - offset) {
+        throw std::runtime_error("failed to load glTF, buffer view out of range!");
+    }
+    return binary.subspan(offset, length);
+}
+
+
+std::span<const uint8_t> GlbFile::baseColorImage() const {
+    // Material of the first primitive that has one, the renderer binds a single texture
+    for (const auto& mesh : root["meshes"].items()) {
+        for (const auto& primitive : mesh["primitives"].items()) {
+            const JsonValue& material = primitive["material"];
+            if (material.isNull()) continue;
+
+            const JsonValue& texture = root["materials"][static_cast<size_t>(material.number())]["pbrMetallicRoughness"]["baseColorTexture"];
+            if (texture.isNull()) continue;
+
+            const JsonValue& source = root["textures"][static_cast<size_t>(texture["index"].number())]["source"];
+            const JsonValue& image = root["images"][static_cast<size_t>(source.number())];
+            if (source.isNull() || image["bufferView"].isNull()) return {}; // external file or an extension's source
+
+            return bufferView(static_cast<size_t>(image["bufferView"].number()));
+        }
+    }
+    return {};
+}
+
+
+// A typed view of accessor elements inside the binary chunk
+struct Accessor {
+    const uint8_t* data = nullptr; // null for accessors without a buffer view, which read as zeros
+    size_t count = 0;
+    size_t stride = 0;
+    int componentType = 0;
+    int components = 0;
+    bool normalized = false;
+};
+
+
+static size_t componentSize(int componentType) {
+    switch (componentType) {
+    case COMPONENT_BYTE:
+    case COMPONENT_UNSIGNED_BYTE: return 1;
+    case COMPONENT_SHORT:
+    case COMPONENT_UNSIGNED_SHORT: return 2;
+    case COMPONENT_UNSIGNED_INT:
+    case COMPONENT_FLOAT: return 4;
+    default: throw std::runtime_error("failed to load glTF, unknown component type!");
+    }
+}
+
+
+static int componentCount(const std::string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    throw std::runtime_error("failed to load glTF, unsupported accessor type " + type + "!");
+}
+
+
+static Accessor getAccessor(const GlbFile& glb, size_t index) {
+    const JsonValue& json = glb.json()["accessors"][index];
+    if (json.isNull()) {
+        throw std::runtime_error("failed to load glTF, missing accessor!");
+    }
+    if (!json["sparse"].isNull()) {
+        throw std::runtime_error("failed to load glTF, sparse accessors are not supported!");
+    }
+
+    Accessor accessor;
+    accessor.count = static_cast<size_t>(json["count"].number());
+    accessor.componentType = static_cast<int>(json["componentType"].number());
+    accessor.components = componentCount(json["type"].string());
+    accessor.normalized = json["normalized"].boolean();
+
+    size_t elementSize = componentSize(accessor.componentType) * accessor.components;
+    if (json["bufferView"].isNull()) return accessor;
+
+    size_t viewIndex = static_cast<size_t>(json["bufferView"].number());
+    std::span<const uint8_t> view = glb.bufferView(viewIndex);
+    size_t offset = static_cast<size_t>(json["byteOffset"].number());
+    accessor.stride = static_cast<size_t>(glb.json()["bufferViews"][viewIndex]["byteStride"].number(static_cast<double>(elementSize)));
+
+    // Last element has to end inside the view
+    if (accessor.count > 0 && (offset > view.size() || accessor.stride * (accessor.count - 1) + elementSize > view.size() - offset)) {
+        throw std::runtime_error("failed to load glTF, accessor out of range!");
+    }
+    accessor.data = view.data() + offset;
+    return accessor;
+}
+
+
+// Element i, components widened to float, normalized integers mapped to [0, 1] or [-1, 1]
+static void readFloats(const Accessor& accessor, size_t i, float* out, int wanted) {
+    for (int c = 0; c < wanted; c++) out[c] = 0.0f;
+    if (accessor.data == nullptr) return;
+
+    const uint8_t* p = accessor.data + i * accessor.stride;
+    int n = (std::min)(wanted, accessor.components);
+    if (accessor.componentType == COMPONENT_FLOAT) {
+        memcpy(out, p, n * sizeof(float));
+        return;
+    }
+
+    for (int c = 0; c < n; c++) {
+        float value = 0.0f;
+        switch (accessor.componentType) {
+        case COMPONENT_BYTE: {
+            int8_t v;
+            memcpy(&v, p + c, 1);
+            value = accessor.normalized ? (std::max)(v / 127.0f, -1.0f) : v;
+            break;
+        }
+        case COMPONENT_UNSIGNED_BYTE:
+            value = accessor.normalized ? p[c] / 255.0f : p[c];
+            break;
+        case COMPONENT_SHORT: {
+            int16_t v;
+            memcpy(&v, p + 2 * c, 2);
+            value = accessor.normalized ? (std::max)(v / 32767.0f, -1.0f) : v;
+            break;
+        }
+        case COMPONENT_UNSIGNED_SHORT: {
+            uint16_t v;
+            memcpy(&v, p + 2 * c, 2);
+            value = accessor.normalized ? v / 65535.0f : v;
+            break;
+        }
+        default: { // UNSIGNED_INT is not valid for attributes, read it anyway
+            uint32_t v;
+            memcpy(&v, p + 4 * c, 4);
+            value = static_cast<float>(v);
+            break;
+        }
+        }
+        out[c] = value;
+    }
+}
+
+
+// Column major, like glm and glTF
+static glm::mat4 nodeMatrix(const JsonValue& node) {
+    glm::mat4 m(1.0f);
+    const JsonValue& matrix = node["matrix"];
+    if (matrix.isArray() && matrix.size() == 16) {
+        for (int i = 0; i < 16; i++) m[i / 4][i % 4] = static_cast<float>(matrix[i].number());
+        return m;
+    }
+
+    // T * R * S
+    const JsonValue& t = node["translation"];
+    const JsonValue& r = node["rotation"];
+    const JsonValue& s = node["scale"];
+    float x = static_cast<float>(r[0].number()), y = static_cast<float>(r[1].number());
+    float z = static_cast<float>(r[2].number()), w = static_cast<float>(r[3].number(1.0));
+
+    m[0][0] = 1 - 2 * (y * y + z * z); m[0][1] = 2 * (x * y + z * w);     m[0][2] = 2 * (x * z - y * w);
+    m[1][0] = 2 * (x * y - z * w);     m[1][1] = 1 - 2 * (x * x + z * z); m[1][2] = 2 * (y * z + x * w);
+    m[2][0] = 2 * (x * z + y * w);     m[2][1] = 2 * (y * z - x * w);     m[2][2] = 1 - 2 * (x * x + y * y);
+    for (int c = 0; c < 3; c++) {
+        float scale = static_cast<float>(s[c].number(1.0));
+        for (int row = 0; row < 3; row++) m[c][row] *= scale;
+        m[3][c] = static_cast<float>(t[c].number());
+    }
+    return m;
+}
+
+
+static bool isIdentity(const glm::mat4& m) {
+    for (int c = 0; c < 4; c++) {
+        for (int row = 0; row < 4; row++) {
+            if (m[c][row] != (c == row ? 1.0f : 0.0f)) return false;
+        }
+    }
+    return true;
+}
+
+
+static bool isFloatAttribute(const Accessor& accessor, int components) {
+    return accessor.data != nullptr && accessor.componentType == COMPONENT_FLOAT && accessor.components == components;
+}
+
+
+static void loadPrimitive(const GlbFile& glb, const JsonValue& primitive, const glm::mat4& transform,
+    std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, GlbLoadStats& stats) {
+    if (primitive["mode"].number(MODE_TRIANGLES) != MODE_TRIANGLES) {
+        stats.skippedPrimitives++;
+        return;
+    }
+
+    const JsonValue& attributes = primitive["attributes"];
+    if (attributes["POSITION"].isNull()) {
+        stats.skippedPrimitives++;
+        return;
+    }
+
+    Accessor positions = getAccessor(glb, static_cast<size_t>(attributes["POSITION"].number()));
+    Accessor texCoords, colors;
+    if (!attributes["TEXCOORD_0"].isNull()) texCoords = getAccessor(glb, static_cast<size_t>(attributes["TEXCOORD_0"].number()));
+    if (!attributes["COLOR_0"].isNull()) colors = getAccessor(glb, static_cast<size_t>(attributes["COLOR_0"].number()));
+
+    glm::vec3 baseColor(1.0f);
+    if (!primitive["material"].isNull()) {
+        const JsonValue& factor = glb.json()["materials"][static_cast<size_t>(primitive["material"].number())]["pbrMetallicRoughness"]["baseColorFactor"];
+        baseColor = glm::vec3(static_cast<float>(factor[0].number(1.0)), static_cast<float>(factor[1].number(1.0)),
+            static_cast<float>(factor[2].number(1.0)));
+    }
+
+    size_t count = positions.count;
+    if ((texCoords.data != nullptr && texCoords.count < count) || (colors.data != nullptr && colors.count < count)) {
+        throw std::runtime_error("failed to load glTF, attribute counts differ!");
+    }
+    size_t baseVertex = vertices.size();
+    vertices.resize(baseVertex + count);
+    Vertex* out = vertices.data() + baseVertex;
+
+    // Exported straight from a Vertex array: one interleaved view, pos / color / uv at the same offsets. Then the whole
+    // block goes over in one copy, no per-vertex work
+    bool sameLayout = isIdentity(transform) && baseColor == glm::vec3(1.0f)
+        && isFloatAttribute(positions, 3) && isFloatAttribute(colors, 3) && isFloatAttribute(texCoords, 2)
+        && positions.stride == sizeof(Vertex) && colors.stride == sizeof(Vertex) && texCoords.stride == sizeof(Vertex)
+        && colors.data == positions.data + offsetof(Vertex, color) && texCoords.data == positions.data + offsetof(Vertex, texCoord);
+    if (sameLayout) {
+        memcpy(out, positions.data, count * sizeof(Vertex));
+        stats.directCopies++;
+    }
+    else {
+        for (size_t i = 0; i < count; i++) {
+            float pos[3], uv[2], rgb[3];
+            readFloats(positions, i, pos, 3);
+            readFloats(texCoords, i, uv, 2);
+            out[i].pos = glm::vec3(transform * glm::vec4(pos[0], pos[1], pos[2], 1.0f));
+            out[i].texCoord = glm::vec2(uv[0], uv[1]); // glTF puts v = 0 at the top already, unlike OBJ
+
+            if (colors.data != nullptr) {
+                readFloats(colors, i, rgb, 3);
+                out[i].color = glm::vec3(rgb[0], rgb[1], rgb[2]) * baseColor;
+            }
+            else {
+                out[i].color = baseColor;
+            }
+        }
+    }
+
+    size_t firstIndex = indices.size();
+    if (primitive["indices"].isNull()) {
+        indices.resize(firstIndex + count / 3 * 3);
+        for (size_t i = firstIndex; i < indices.size(); i++) indices[i] = static_cast<uint32_t>(baseVertex + i - firstIndex);
+    }
+    else {
+        Accessor source = getAccessor(glb, static_cast<size_t>(primitive["indices"].number()));
+        if (source.components != 1 || source.data == nullptr) {
+            throw std::runtime_error("failed to load glTF, bad index accessor!");
+        }
+        size_t indexCount = source.count / 3 * 3;
+        indices.resize(firstIndex + indexCount);
+        uint32_t* dst = indices.data() + firstIndex;
+
+        if (source.componentType == COMPONENT_UNSIGNED_INT && source.stride == 4) {
+            memcpy(dst, source.data, indexCount * sizeof(uint32_t));
+        }
+        else {
+            for (size_t i = 0; i < indexCount; i++) {
+                const uint8_t* p = source.data + i * source.stride;
+                if (source.componentType == COMPONENT_UNSIGNED_BYTE) dst[i] = p[0];
+                else if (source.componentType == COMPONENT_UNSIGNED_SHORT) dst[i] = static_cast<uint32_t>(p[0] | p[1] << 8);
+                else if (source.componentType == COMPONENT_UNSIGNED_INT) dst[i] = readU32(p);
+                else throw std::runtime_error("failed to load glTF, bad index component type!");
+            }
+        }
+
+        for (size_t i = 0; i < indexCount; i++) {
+            if (dst[i] >= count) {
+                throw std::runtime_error("failed to load glTF, index out of range!");
+            }
+            dst[i] += static_cast<uint32_t>(baseVertex);
+        }
+    }
+
+    // Mirroring transforms turn triangles inside out
+    glm::vec3 x(transform[0]), y(transform[1]), z(transform[2]);
+    if (glm::dot(glm::cross(x, y), z) < 0.0f) {
+        for (size_t i = firstIndex; i + 2 < indices.size(); i += 3) std::swap(indices[i + 1], indices[i + 2]);
+    }
+
+    stats.primitives++;
+}
+
+
+static void loadNode(const GlbFile& glb, size_t index, const glm::mat4& parent, int depth,
+    std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, GlbLoadStats& stats) {
+    const JsonValue& node = glb.json()["nodes"][index];
+    if (node.isNull() || depth > 64) { // the hierarchy is supposed to be a tree, do not trust that
+        throw std::runtime_error("failed to load glTF, bad node hierarchy!");
+    }
+
+    glm::mat4 transform = parent * nodeMatrix(node);
+    if (!node["mesh"].isNull()) {
+        const JsonValue& mesh = glb.json()["meshes"][static_cast<size_t>(node["mesh"].number())];
+        for (const auto& primitive : mesh["primitives"].items()) {
+            loadPrimitive(glb, primitive, transform, vertices, indices, stats);
+        }
+    }
+    for (const auto& child : node["children"].items()) {
+        loadNode(glb, static_cast<size_t>(child.number()), transform, depth + 1, vertices, indices, stats);
+    }
+}
+
+
+void loadGlb(const GlbFile& glb, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, GlbLoadStats* stats) {
+    GlbLoadStats localStats;
+    if (!stats) stats = &localStats;
+    const JsonValue& json = glb.json();
+
+    vertices.clear();
+    indices.clear();
+
+    const JsonValue& scene = json["scenes"][static_cast<size_t>(json["scene"].number())];
+    if (!scene.isNull()) {
+        for (const auto& node : scene["nodes"].items()) {
+            loadNode(glb, static_cast<size_t>(node.number()), glm::mat4(1.0f), 0, vertices, indices, *stats);
+        }
+    }
+    else { // no scene, just the meshes as they are
+        for (const auto& mesh : json["meshes"].items()) {
+            for (const auto& primitive : mesh["primitives"].items()) {
+                loadPrimitive(glb, primitive, glm::mat4(1.0f), vertices, indices, *stats);
+            }
+        }
+    }
+
+    if (indices.empty()) {
+        throw std::runtime_error("failed to load glTF, no triangles!");
+    }
+}
\ No newline at end of file
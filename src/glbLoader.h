@@ -0,0 +1,38 @@
+#pragma once
+#include <span>
+#include <string>
+#include <vector>
+#include "json.h"
+#include "mappedFile.h"
+#include "vertex.h"
+
+
+struct GlbLoadStats {
+    size_t primitives = 0; // drawn, one per mesh primitive per node that uses it
+    size_t skippedPrimitives = 0; // points, lines and strips
+    size_t directCopies = 0; // primitives whose vertices were already laid out like Vertex, copied in one block
+};
+
+
+// A mapped glTF 2.0 binary. The JSON chunk is parsed, the binary chunk stays in the mapping and buffer views point into it
+class GlbFile {
+public:
+    void open(const std::string& path); // throws if it is missing or not a valid .glb
+    void close();
+
+    const JsonValue& json() const { return root; }
+    std::span<const uint8_t> bufferView(size_t index) const;
+
+    // Still encoded (PNG or JPEG), straight out of the mapping. Empty if no material has an embedded base color texture
+    std::span<const uint8_t> baseColorImage() const;
+
+private:
+    MappedFile file;
+    JsonValue root;
+    std::span<const uint8_t> binary;
+};
+
+
+// Every triangle primitive of the default scene, flattened with node transforms applied, in the usual Vertex format.
+// COLOR_0 times the material's base color factor goes into Vertex::color. Normals are not kept, Vertex has no room for them
+void loadGlb(const GlbFile& glb, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, GlbLoadStats* stats = nullptr);
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+
+// splitmix64 finalizer. Every input bit affects every output bit, so it is safe to take a table slot from any bits
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
\ No newline at end of file
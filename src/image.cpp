@@ -4,7 +4,8 @@
 #include "depth.h"
 
 
-VkImageView Application::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
+VkImageView Application::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, uint32_t baseMipLevel,
+    VkImageUsageFlags usage) {
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
@@ -12,10 +13,18 @@ VkImageView Application::createImageView(VkImage image, VkFormat format, VkImage
     viewInfo.format = format;
     viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
-    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
+    // Narrower than the image's usage, eg an sRGB view of an image that is also written through UNORM storage views
+    VkImageViewUsageCreateInfo usageInfo{};
+    if (usage) {
+        usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+        usageInfo.usage = usage;
+        viewInfo.pNext = &usageInfo;
+    }
+
     VkImageView imageView;
     if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
         throw std::runtime_error("failed to create image view!");
@@ -61,7 +70,8 @@ void Application::createFramebuffers() {
 
 
 void Application::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-    VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+    VkMemoryPropertyFlags properties, VkImage& image, DeviceAllocation& imageMemory, const std::vector<uint32_t>& queueFamilies, VkImageCreateFlags flags,
+    uint32_t arrayLayers) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -69,37 +79,38 @@ void Application::createImage(uint32_t width, uint32_t height, uint32_t mipLevel
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
     imageInfo.mipLevels = mipLevels;
-    imageInfo.arrayLayers = 1;
+    imageInfo.arrayLayers = arrayLayers;
     imageInfo.format = format;
     imageInfo.tiling = tiling;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = usage;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (queueFamilies.size() > 1) { // used from several queue families without ownership transfers, eg a streamed texture
+        imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+        imageInfo.pQueueFamilyIndices = queueFamilies.data();
+    }
     imageInfo.samples = numSamples;
-    imageInfo.flags = 0; // Optional. Eg sparse images like voxel terrain
+    imageInfo.flags = flags; // Optional. Eg sparse images like voxel terrain, or views in another format
 
     if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
         throw std::runtime_error("failed to create image!");
     }
 
 
+    // Render targets get memory of their own: they are big, and recreated with the swap chain, which would leave holes
+    // in a shared block every resize
     VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
+    bool dedicated = queryMemoryRequirements(VK_NULL_HANDLE, image, memRequirements);
+    bool attachment = (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+    imageMemory = allocateMemory(memRequirements, properties, VK_NULL_HANDLE, image, tiling == VK_IMAGE_TILING_OPTIMAL, dedicated || attachment,
+        attachment ? MemoryCategory::Attachment : MemoryCategory::Texture);
 
-    vkBindImageMemory(device, image, imageMemory, 0);
+    vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
 }
 
 
-void Application::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
+void Application::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, uint32_t baseMipLevel) {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
     VkImageMemoryBarrier barrier{};
@@ -110,7 +121,7 @@ void Application::transitionImageLayout(VkImage image, VkFormat format, VkImageL
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.image = image;
 
-    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.baseMipLevel = baseMipLevel;
     barrier.subresourceRange.levelCount = mipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
@@ -197,4 +208,49 @@ void Application::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t wid
         &region
     );
     endSingleTimeCommands(commandBuffer);
+}
+
+
+// Levels [firstLevel, levels) of a shader read image into the levels from 0 of dstImage, a new image that is that much
+// smaller. dstImage ends up shader readable, srcImage stays a transfer source, it is only copied from to be destroyed
+void Application::recordImageLevelsCopy(VkCommandBuffer commandBuffer, VkImage srcImage, VkImage dstImage, uint32_t width, uint32_t height,
+    uint32_t levels, uint32_t layerCount, uint32_t firstLevel) {
+    uint32_t levelCount = levels - firstLevel;
+    std::array<VkImageMemoryBarrier, 2> barriers{};
+    for (VkImageMemoryBarrier& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    }
+    barriers[0].image = srcImage;
+    barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, firstLevel, levelCount, 0, layerCount };
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[1].image = dstImage;
+    barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, layerCount };
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    std::vector<VkImageCopy> regions(levelCount);
+    for (uint32_t i = 0; i < levelCount; i++) {
+        uint32_t level = firstLevel + i;
+        regions[i].srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, layerCount };
+        regions[i].dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, layerCount };
+        regions[i].extent = { (std::max)(width >> level, 1u), (std::max)(height >> level, 1u), 1 };
+    }
+    vkCmdCopyImage(commandBuffer, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regions.size()), regions.data());
+
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+        1, &barriers[1]);
 }
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include "imageDecoder.h"
+
+
+// stb_image allocates through these. While a worker decodes into an ImageDestination, the first allocation exactly the
+// size of the RGBA8 result gets the destination instead of the heap. That is the output buffer for 8-bit PNG and JPEG,
+// or the final conversion for grey/16-bit sources, so the pixels are written once, where they are going
+static thread_local uint8_t* decodeTarget = nullptr;
+static thread_local size_t decodeTargetSize = 0;
+static thread_local bool decodeTargetTaken = false;
+
+static void* decodeMalloc(size_t size) {
+    if (decodeTarget && !decodeTargetTaken && size == decodeTargetSize) {
+        decodeTargetTaken = true;
+        return decodeTarget;
+    }
+    return malloc(size);
+}
+
+static void decodeFree(void* pointer) {
+    if (pointer != decodeTarget) {
+        free(pointer);
+    }
+}
+
+static void* decodeRealloc(void* pointer, size_t size) {
+    if (pointer && pointer == decodeTarget) {
+        // Not something stb does to its output, but the destination cannot grow
+        void* grown = malloc(size);
+        if (grown) memcpy(grown, pointer, (std::min)(size, decodeTargetSize));
+        return grown;
+    }
+    return realloc(pointer, size);
+}
+
+#define STBI_MALLOC(size) decodeMalloc(size)
+#define STBI_FREE(pointer) decodeFree(pointer)
+#define STBI_REALLOC(pointer, size) decodeRealloc(pointer, size)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+
+void ImageFree::operator()(uint8_t* pixels) const {
+    if (owned) {
+        stbi_image_free(pixels);
+    }
+}
+
+
+ImageDecoder::ImageDecoder(unsigned threadCount, size_t memoryBudget) : memoryBudget(memoryBudget) {
+    for (unsigned i = 0; i < (std::max)(threadCount, 1u); i++) {
+        workers.emplace_back(&ImageDecoder::work, this);
+    }
+}
+
+
+ImageDecoder::~ImageDecoder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAdded.notify_all();
+    roomFreed.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+
+size_t ImageDecoder::add(const std::string& path, ImageDestination destination) {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back({ added, path, {}, std::move(destination) });
+    jobAdded.notify_one();
+    return added++;
+}
+
+
+size_t ImageDecoder::add(std::span<const uint8_t> encoded, const std::string& name, ImageDestination destination) {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back({ added, name, encoded, std::move(destination) });
+    jobAdded.notify_one();
+    return added++;
+}
+
+
+bool ImageDecoder::next(DecodedImage& image) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (handedOut == added) return false;
+
+    imageDone.wait(lock, [&]() { return !done.empty(); });
+    image = std::move(done.front().first);
+    bytesInFlight -= done.front().second;
+    done.pop_front();
+    handedOut++;
+    roomFreed.notify_all();
+    return true;
+}
+
+
+void ImageDecoder::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        jobAdded.wait(lock, [&]() { return stopping || !jobs.empty(); });
+        if (stopping) return;
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+
+        lock.unlock();
+        size_t bytes = 0;
+        DecodedImage image = decode(job, bytes);
+        lock.lock();
+
+        if (stopping) return;
+        done.emplace_back(std::move(image), bytes);
+        imageDone.notify_one();
+    }
+}
+
+
+// Reads the header first for the size, reserves that much of the budget, then decodes outside the lock
+DecodedImage ImageDecoder::decode(const Job& job, size_t& bytes) {
+    DecodedImage image;
+    image.id = job.id;
+    image.name = job.path;
+
+    bool fromMemory = !job.encoded.empty();
+    int width = 0, height = 0, channels = 0;
+    bool headerOk = fromMemory
+        ? stbi_info_from_memory(job.encoded.data(), static_cast<int>(job.encoded.size()), &width, &height, &channels)
+        : stbi_info(job.path.c_str(), &width, &height, &channels);
+    if (!headerOk) {
+        image.error = "failed to read image header of " + job.path + "!";
+        return image;
+    }
+
+    uint8_t* destination = nullptr;
+    if (job.destination) {
+        try {
+            destination = job.destination(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+        }
+        catch (const std::exception& e) {
+            image.error = e.what();
+            return image;
+        }
+    }
+    bytes = destination ? 0 : size_t(width) * height * 4;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        roomFreed.wait(lock, [&]() { return stopping || bytesInFlight == 0 || bytesInFlight + bytes <= memoryBudget; });
+        bytesInFlight += bytes;
+        peakBytes = (std::max)(peakBytes, bytesInFlight);
+    }
+
+    size_t size = size_t(width) * height * 4;
+    decodeTarget = destination;
+    decodeTargetSize = size;
+    decodeTargetTaken = false;
+    stbi_uc* pixels = fromMemory
+        ? stbi_load_from_memory(job.encoded.data(), static_cast<int>(job.encoded.size()), &width, &height, &channels, STBI_rgb_alpha)
+        : stbi_load(job.path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    decodeTarget = nullptr;
+    if (!pixels) {
+        image.error = "failed to decode " + job.path + "!";
+        return image; // the budget is given back when next() hands out the error
+    }
+
+    image.width = static_cast<uint32_t>(width);
+    image.height = static_cast<uint32_t>(height);
+    if (destination && pixels != destination) {
+        memcpy(destination, pixels, size);
+        stbi_image_free(pixels);
+        image.copied = true;
+    }
+    if (destination) {
+        image.pixels = std::unique_ptr<uint8_t, ImageFree>(destination, ImageFree{ false });
+    }
+    else {
+        image.pixels.reset(pixels);
+    }
+    return image;
+}
\ No newline at end of file
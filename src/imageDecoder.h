@@ -0,0 +1,79 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct ImageFree {
+    bool owned = true; // false when the pixels are in an ImageDestination
+    void operator()(uint8_t* pixels) const; // stbi_image_free
+};
+
+// Where a decode should write its RGBA8 pixels (width * height * 4 bytes), eg mapped staging memory. Called on the worker
+// once the header is read. Returning null decodes to the heap as usual
+using ImageDestination = std::function<uint8_t*(uint32_t width, uint32_t height)>;
+
+// RGBA8, tightly packed. pixels is null and error says why if the decode failed
+struct DecodedImage {
+    size_t id = 0; // what add() returned
+    std::string name;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::unique_ptr<uint8_t, ImageFree> pixels;
+    std::string error;
+    bool copied = false; // into the destination, because stb did not decode straight into it
+};
+
+
+// Decodes PNG/JPEG/... (whatever stb_image reads) on a pool of worker threads and hands the images back as each one
+// finishes, not in the order they were added. Decoded bytes waiting to be taken, plus those being decoded, stay under
+// memoryBudget: a worker whose image does not fit waits until next() frees room. One image bigger than the whole budget
+// still goes through on its own, so nothing deadlocks. Images with a destination do not count, their memory is the caller's
+class ImageDecoder {
+public:
+    explicit ImageDecoder(unsigned threadCount, size_t memoryBudget = 256 * 1024 * 1024);
+    ~ImageDecoder(); // stops the workers, whatever is still queued is dropped
+    ImageDecoder(const ImageDecoder&) = delete;
+    ImageDecoder& operator=(const ImageDecoder&) = delete;
+
+    size_t add(const std::string& path, ImageDestination destination = {});
+    // encoded must stay valid until its image comes out
+    size_t add(std::span<const uint8_t> encoded, const std::string& name, ImageDestination destination = {});
+
+    // Blocks until an image is done. false once every added image has been handed out
+    bool next(DecodedImage& image);
+
+    size_t peakBytesInFlight() const { return peakBytes; }
+
+private:
+    struct Job {
+        size_t id;
+        std::string path; // empty when decoding from memory
+        std::span<const uint8_t> encoded;
+        ImageDestination destination;
+    };
+
+    void work();
+    DecodedImage decode(const Job& job, size_t& bytes);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobAdded; // workers wait here for jobs
+    std::condition_variable roomFreed; // workers wait here for budget
+    std::condition_variable imageDone; // next() waits here
+    std::deque<Job> jobs;
+    std::deque<std::pair<DecodedImage, size_t>> done; // image and the budget it holds
+    size_t added = 0;
+    size_t handedOut = 0;
+    size_t memoryBudget;
+    size_t bytesInFlight = 0;
+    size_t peakBytes = 0;
+    bool stopping = false;
+};
\ No newline at end of file
@@ -18,7 +18,7 @@ void Application::createInstance() {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_2; // VK_EXT_mesh_shader needs 1.2 (SPIR-V 1.4)
 
     // Instance Create Info
     VkInstanceCreateInfo createInfo{};
@@ -0,0 +1,212 @@
+#include <charconv>
+#include <stdexcept>
+#include "json.h"
+
+
+const int MAX_DEPTH = 256; // nesting, so hostile input cannot blow the stack
+
+
+static const JsonValue& nullValue() {
+    static const JsonValue value;
+    return value;
+}
+
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+    return kind == Type::Array && index < elements.size() ? elements[index] : nullValue();
+}
+
+
+const JsonValue& JsonValue::operator[](std::string_view key) const {
+    if (kind == Type::Object) {
+        for (const auto& member : members) {
+            if (member.first == key) return member.second;
+        }
+    }
+    return nullValue();
+}
+
+
+class JsonParser {
+public:
+    explicit JsonParser(std::string_view text) : p(text.data()), end(text.data() + text.size()) {}
+
+    JsonValue parseDocument() {
+        JsonValue root = parseValue(0);
+        skipWhitespace();
+        if (p != end) fail("trailing characters");
+        return root;
+    }
+
+private:
+    [[noreturn]] void fail(const char* what) {
+        throw std::runtime_error(std::string("failed to parse JSON: ") + what + "!");
+    }
+
+    void skipWhitespace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    }
+
+    bool consume(std::string_view literal) {
+        if (static_cast<size_t>(end - p) < literal.size() || std::string_view(p, literal.size()) != literal) return false;
+        p += literal.size();
+        return true;
+    }
+
+    void expect(char c) {
+        skipWhitespace();
+        if (p >= end || *p != c) fail("unexpected character");
+        p++;
+    }
+
+    JsonValue parseValue(int depth) {
+        if (depth > MAX_DEPTH) fail("nested too deeply");
+        skipWhitespace();
+        if (p >= end) fail("unexpected end");
+
+        JsonValue value;
+        switch (*p) {
+        case '{': {
+            p++;
+            value.kind = JsonValue::Type::Object;
+            skipWhitespace();
+            if (p < end && *p == '}') {
+                p++;
+                break;
+            }
+            while (true) {
+                skipWhitespace();
+                if (p >= end || *p != '"') fail("expected a key");
+                std::string key = parseString();
+                expect(':');
+                value.members.emplace_back(std::move(key), parseValue(depth + 1));
+                skipWhitespace();
+                if (p < end && *p == ',') {
+                    p++;
+                    continue;
+                }
+                expect('}');
+                break;
+            }
+            break;
+        }
+        case '[': {
+            p++;
+            value.kind = JsonValue::Type::Array;
+            skipWhitespace();
+            if (p < end && *p == ']') {
+                p++;
+                break;
+            }
+            while (true) {
+                value.elements.push_back(parseValue(depth + 1));
+                skipWhitespace();
+                if (p < end && *p == ',') {
+                    p++;
+                    continue;
+                }
+                expect(']');
+                break;
+            }
+            break;
+        }
+        case '"':
+            value.kind = JsonValue::Type::String;
+            value.text = parseString();
+            break;
+        case 't':
+        case 'f':
+            value.kind = JsonValue::Type::Bool;
+            if (consume("true")) value.flag = true;
+            else if (!consume("false")) fail("bad literal");
+            break;
+        case 'n':
+            if (!consume("null")) fail("bad literal");
+            break;
+        default: {
+            value.kind = JsonValue::Type::Number;
+            auto result = std::from_chars(p, end, value.value); // also takes inf/nan/hex-less forms JSON does not, harmless here
+            if (result.ec != std::errc()) fail("bad number");
+            p = result.ptr;
+            break;
+        }
+        }
+        return value;
+    }
+
+    static void appendUtf8(std::string& out, uint32_t c) {
+        if (c < 0x80) {
+            out += static_cast<char>(c);
+        }
+        else if (c < 0x800) {
+            out += static_cast<char>(0xC0 | c >> 6);
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000) {
+            out += static_cast<char>(0xE0 | c >> 12);
+            out += static_cast<char>(0x80 | (c >> 6 & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else {
+            out += static_cast<char>(0xF0 | c >> 18);
+            out += static_cast<char>(0x80 | (c >> 12 & 0x3F));
+            out += static_cast<char>(0x80 | (c >> 6 & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+
+    uint32_t parseHex4() {
+        if (end - p < 4) fail("bad escape");
+        uint32_t c = 0;
+        auto result = std::from_chars(p, p + 4, c, 16);
+        if (result.ec != std::errc() || result.ptr != p + 4) fail("bad escape");
+        p += 4;
+        return c;
+    }
+
+    std::string parseString() {
+        p++; // opening quote
+        std::string out;
+        while (true) {
+            if (p >= end) fail("unterminated string");
+            char c = *p++;
+            if (c == '"') break;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+
+            if (p >= end) fail("unterminated string");
+            switch (*p++) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t code = parseHex4();
+                if (code >= 0xD800 && code < 0xDC00 && consume("\\u")) { // surrogate pair
+                    uint32_t low = parseHex4();
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, code);
+                break;
+            }
+            default:
+                fail("bad escape");
+            }
+        }
+        return out;
+    }
+
+    const char* p;
+    const char* end;
+};
+
+
+JsonValue parseJson(std::string_view text) {
+    return JsonParser(text).parseDocument();
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+// Just enough JSON for glTF: a DOM of plain values. Lookups of missing keys or indices give a null value
+// instead of throwing, so optional glTF properties read as (*value)["key"].number(default)
+class JsonValue {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type() const { return kind; }
+    bool isNull() const { return kind == Type::Null; }
+    bool isObject() const { return kind == Type::Object; }
+    bool isArray() const { return kind == Type::Array; }
+
+    bool boolean(bool fallback = false) const { return kind == Type::Bool ? flag : fallback; }
+    double number(double fallback = 0.0) const { return kind == Type::Number ? value : fallback; }
+    const std::string& string() const { return text; } // empty unless a string
+
+    size_t size() const { return kind == Type::Array ? elements.size() : members.size(); }
+    const JsonValue& operator[](size_t index) const;
+    const JsonValue& operator[](std::string_view key) const;
+    const std::vector<JsonValue>& items() const { return elements; }
+    const std::vector<std::pair<std::string, JsonValue>>& fields() const { return members; }
+
+private:
+    friend class JsonParser;
+
+    Type kind = Type::Null;
+    bool flag = false;
+    double value = 0.0;
+    std::string text;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue>> members;
+};
+
+
+// Throws std::runtime_error on malformed input
+JsonValue parseJson(std::string_view text);
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include "ktx2.h"
+
+
+static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+const size_t KTX2_HEADER_SIZE = 80; // identifier, 9 u32 fields, the dfd/kvd/sgd index
+const size_t KTX2_LEVEL_INDEX_ENTRY = 24; // u64 byteOffset, byteLength, uncompressedByteLength
+
+// Data Format Descriptor values, from the Khronos Data Format spec
+const uint32_t DF_MODEL_RGBSDA = 1;
+const uint32_t DF_MODEL_BC1A = 128;
+const uint32_t DF_MODEL_BC4 = 131;
+const uint32_t DF_MODEL_BC5 = 132;
+const uint32_t DF_MODEL_BC7 = 134;
+const uint32_t DF_PRIMARIES_BT709 = 1;
+const uint32_t DF_TRANSFER_LINEAR = 1;
+const uint32_t DF_TRANSFER_SRGB = 2;
+const uint32_t DF_SAMPLE_LINEAR = 1 << 4; // qualifier: this channel is linear even in an sRGB format (alpha)
+
+
+static uint32_t readU32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value)); // KTX2 is little endian
+    return value;
+}
+
+static uint64_t readU64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+
+struct FormatDescription {
+    uint32_t model;
+    uint32_t blockDimension; // texels per side, 1 for uncompressed
+    uint32_t bytesPerBlock;
+    bool srgb;
+};
+
+// false for formats this app does not write
+static bool findFormatDescription(VkFormat format, FormatDescription& description) {
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM: description = { DF_MODEL_RGBSDA, 1, 4, false }; return true;
+    case VK_FORMAT_R8G8B8A8_SRGB: description = { DF_MODEL_RGBSDA, 1, 4, true }; return true;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK: description = { DF_MODEL_BC1A, 4, 8, false }; return true;
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK: description = { DF_MODEL_BC1A, 4, 8, true }; return true;
+    case VK_FORMAT_BC4_UNORM_BLOCK: description = { DF_MODEL_BC4, 4, 8, false }; return true;
+    case VK_FORMAT_BC5_UNORM_BLOCK: description = { DF_MODEL_BC5, 4, 16, false }; return true;
+    case VK_FORMAT_BC7_UNORM_BLOCK: description = { DF_MODEL_BC7, 4, 16, false }; return true;
+    case VK_FORMAT_BC7_SRGB_BLOCK: description = { DF_MODEL_BC7, 4, 16, true }; return true;
+    default: return false;
+    }
+}
+
+static FormatDescription describeFormat(VkFormat format) {
+    FormatDescription description;
+    if (!findFormatDescription(format, description)) {
+        throw std::runtime_error("failed to write KTX2, unsupported format!");
+    }
+    return description;
+}
+
+
+bool blockFormatOf(VkFormat format, BlockFormat& block, bool& srgb) {
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK: case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: block = BlockFormat::BC1; srgb = false; return true;
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK: case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: block = BlockFormat::BC1; srgb = true; return true;
+    case VK_FORMAT_BC4_UNORM_BLOCK: block = BlockFormat::BC4; srgb = false; return true;
+    case VK_FORMAT_BC5_UNORM_BLOCK: block = BlockFormat::BC5; srgb = false; return true;
+    case VK_FORMAT_BC7_UNORM_BLOCK: block = BlockFormat::BC7; srgb = false; return true;
+    case VK_FORMAT_BC7_SRGB_BLOCK: block = BlockFormat::BC7; srgb = true; return true;
+    default: return false;
+    }
+}
+
+
+
+bool Ktx2File::open(const std::string& path) {
+    close();
+    if (!file.open(path)) {
+        return false;
+    }
+
+    const uint8_t* data = file.data();
+    size_t size = file.size();
+    if (size < KTX2_HEADER_SIZE || memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        throw std::runtime_error("failed to load " + path + ", not a KTX2 file!");
+    }
+
+    vkFormat = static_cast<VkFormat>(readU32(data + 12));
+    baseWidth = readU32(data + 20);
+    baseHeight = readU32(data + 24);
+    uint32_t depth = readU32(data + 28);
+    uint32_t layers = readU32(data + 32);
+    uint32_t faces = readU32(data + 36);
+    uint32_t levelCount = (std::max)(readU32(data + 40), 1u); // 0 asks the loader to generate mips, we just take the base level
+    uint32_t supercompression = readU32(data + 44);
+    if (vkFormat == VK_FORMAT_UNDEFINED || supercompression != 0) {
+        throw std::runtime_error("failed to load " + path + ", supercompressed KTX2 is not supported!");
+    }
+    if (baseWidth == 0 || baseHeight == 0 || depth > 1 || layers > 1 || faces != 1 || levelCount > 32) {
+        throw std::runtime_error("failed to load " + path + ", only single 2D KTX2 images are supported!");
+    }
+    if (KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_ENTRY > size) {
+        throw std::runtime_error("failed to load " + path + ", truncated level index!");
+    }
+
+    // Only the formats this app writes, whose levels must hold the whole image, so nothing reading them has to check again
+    FormatDescription description;
+    if (!findFormatDescription(vkFormat, description)) {
+        throw std::runtime_error("failed to load " + path + ", unsupported KTX2 format!");
+    }
+
+    levels.resize(levelCount);
+    for (uint32_t i = 0; i < levelCount; i++) {
+        const uint8_t* entry = data + KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_ENTRY;
+        uint64_t offset = readU64(entry);
+        uint64_t length = readU64(entry + 8);
+        if (offset > size || length > size - offset) {
+            throw std::runtime_error("failed to load " + path + ", level out of range!");
+        }
+        levels[i].data = std::span<const uint8_t>(data + offset, length);
+        levels[i].width = (std::max)(baseWidth >> i, 1u);
+        levels[i].height = (std::max)(baseHeight >> i, 1u);
+
+        uint32_t blocks = description.blockDimension;
+        if (length < uint64_t((levels[i].width + blocks - 1) / blocks) * ((levels[i].height + blocks - 1) / blocks) * description.bytesPerBlock) {
+            throw std::runtime_error("failed to load " + path + ", truncated level!");
+        }
+    }
+
+    // Key/value data: u32 length, "key\0value", padded to 4 bytes
+    uint32_t kvdOffset = readU32(data + 56);
+    uint32_t kvdLength = readU32(data + 60);
+    if (kvdOffset > size || kvdLength > size - kvdOffset) {
+        throw std::runtime_error("failed to load " + path + ", key/value data out of range!");
+    }
+    const uint8_t* kvd = data + kvdOffset;
+    for (uint32_t offset = 0; offset + 4 <= kvdLength;) {
+        uint32_t length = readU32(kvd + offset);
+        offset += 4;
+        if (length > kvdLength - offset) break;
+
+        const char* text = reinterpret_cast<const char*>(kvd + offset);
+        const char* separator = static_cast<const char*>(memchr(text, '\0', length));
+        if (separator) {
+            std::string value(separator + 1, text + length);
+            if (!value.empty() && value.back() == '\0') value.pop_back(); // values are usually NUL terminated too
+            keyValues.emplace_back(std::string(text, separator), std::move(value));
+        }
+        offset += (length + 3) & ~3u;
+    }
+    return true;
+}
+
+
+void Ktx2File::close() {
+    levels.clear();
+    ownedLevels.clear();
+    keyValues.clear();
+    vkFormat = VK_FORMAT_UNDEFINED;
+    baseWidth = baseHeight = 0;
+    file.close();
+}
+
+
+void Ktx2File::assign(VkFormat format, uint32_t width, uint32_t height, std::vector<std::vector<uint8_t>> levelData) {
+    close();
+    vkFormat = format;
+    baseWidth = width;
+    baseHeight = height;
+    ownedLevels = std::move(levelData);
+    levels.resize(ownedLevels.size());
+    for (uint32_t i = 0; i < levels.size(); i++) {
+        levels[i] = { ownedLevels[i], (std::max)(width >> i, 1u), (std::max)(height >> i, 1u) };
+    }
+}
+
+
+std::string Ktx2File::value(const std::string& key) const {
+    for (const auto& keyValue : keyValues) {
+        if (keyValue.first == key) return keyValue.second;
+    }
+    return {};
+}
+
+
+// Basic descriptor block: the format's color model, transfer function and one sample per channel
+static std::vector<uint32_t> buildDataFormatDescriptor(VkFormat format) {
+    FormatDescription description = describeFormat(format);
+
+    struct Sample {
+        uint32_t bitOffset, bitLength, channel, upper;
+    };
+    std::vector<Sample> samples;
+    if (description.model == DF_MODEL_RGBSDA) {
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            uint32_t id = channel == 3 ? 15 : channel; // R G B, alpha is 15
+            if (channel == 3 && description.srgb) id |= DF_SAMPLE_LINEAR;
+            samples.push_back({ channel * 8, 8, id, 255 });
+        }
+    }
+    else if (description.model == DF_MODEL_BC5) {
+        samples.push_back({ 0, 64, 0, UINT32_MAX }); // red block
+        samples.push_back({ 64, 64, 1, UINT32_MAX }); // green block
+    }
+    else {
+        samples.push_back({ 0, description.bytesPerBlock * 8, 0, UINT32_MAX });
+    }
+
+    uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+    uint32_t dimension = description.blockDimension - 1;
+    std::vector<uint32_t> words = {
+        4 + blockSize, // total size, including this word
+        0, // vendor Khronos, descriptor type basic
+        2 | blockSize << 16, // version 1.3
+        description.model | DF_PRIMARIES_BT709 << 8 | (description.srgb ? DF_TRANSFER_SRGB : DF_TRANSFER_LINEAR) << 16,
+        dimension | dimension << 8,
+        description.bytesPerBlock, // bytes in plane 0
+        0
+    };
+    for (const Sample& sample : samples) {
+        words.push_back(sample.bitOffset | (sample.bitLength - 1) << 16 | sample.channel << 24);
+        words.push_back(0); // sample position
+        words.push_back(0); // lower
+        words.push_back(sample.upper);
+    }
+    return words;
+}
+
+
+static void writeU32(std::vector<uint8_t>& out, size_t offset, uint32_t value) {
+    memcpy(out.data() + offset, &value, sizeof(value));
+}
+
+static void writeU64(std::vector<uint8_t>& out, size_t offset, uint64_t value) {
+    memcpy(out.data() + offset, &value, sizeof(value));
+}
+
+static void alignTo(std::vector<uint8_t>& out, size_t alignment) {
+    out.resize((out.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+
+void writeKtx2(const std::string& path, VkFormat format, uint32_t width, uint32_t height,
+    const std::vector<std::vector<uint8_t>>& levels, const std::vector<std::pair<std::string, std::string>>& keyValues) {
+    FormatDescription description = describeFormat(format);
+    uint32_t levelCount = static_cast<uint32_t>(levels.size());
+
+    std::vector<uint8_t> out(KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_ENTRY, 0);
+    memcpy(out.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    writeU32(out, 12, format);
+    writeU32(out, 16, 1); // typeSize, 1 for 8 bit and block formats
+    writeU32(out, 20, width);
+    writeU32(out, 24, height);
+    writeU32(out, 28, 0); // depth, layers: not a 3D or array texture
+    writeU32(out, 32, 0);
+    writeU32(out, 36, 1); // faces
+    writeU32(out, 40, levelCount);
+    writeU32(out, 44, 0); // no supercompression
+
+    std::vector<uint32_t> dfd = buildDataFormatDescriptor(format);
+    writeU32(out, 48, static_cast<uint32_t>(out.size()));
+    writeU32(out, 52, static_cast<uint32_t>(dfd.size() * 4));
+    out.insert(out.end(), reinterpret_cast<const uint8_t*>(dfd.data()), reinterpret_cast<const uint8_t*>(dfd.data() + dfd.size()));
+
+    // Keys must be sorted by their bytes
+    auto sorted = keyValues;
+    std::sort(sorted.begin(), sorted.end());
+    size_t kvdStart = out.size();
+    for (const auto& [key, value] : sorted) {
+        uint32_t length = static_cast<uint32_t>(key.size() + 1 + value.size() + 1);
+        size_t at = out.size();
+        out.resize(at + 4);
+        writeU32(out, at, length);
+        out.insert(out.end(), key.begin(), key.end());
+        out.push_back(0);
+        out.insert(out.end(), value.begin(), value.end());
+        out.push_back(0);
+        alignTo(out, 4);
+    }
+    writeU32(out, 56, sorted.empty() ? 0 : static_cast<uint32_t>(kvdStart));
+    writeU32(out, 60, static_cast<uint32_t>(out.size() - kvdStart));
+    // No supercompression global data, the sgd offset and length at 64 and 72 stay 0
+
+    // Level data smallest first, each aligned to lcm(block size, 4), which for our formats is the block size
+    for (uint32_t i = levelCount; i-- > 0;) {
+        alignTo(out, description.bytesPerBlock);
+        size_t entry = KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_ENTRY;
+        writeU64(out, entry, out.size());
+        writeU64(out, entry + 8, levels[i].size());
+        writeU64(out, entry + 16, levels[i].size());
+        out.insert(out.end(), levels[i].begin(), levels[i].end());
+    }
+
+    // Write next to it and rename, so a crash halfway never leaves a truncated file that looks valid
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open " + path + " for writing!");
+        }
+        file.write(reinterpret_cast<const char*>(out.data()), out.size());
+        if (!file) {
+            throw std::runtime_error("failed to write " + path + "!");
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        throw std::runtime_error("failed to replace " + path + "!");
+    }
+}
\ No newline at end of file
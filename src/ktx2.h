@@ -0,0 +1,55 @@
+#pragma once
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "blockCompress.h"
+#include "mappedFile.h"
+
+
+// One mip level of a KTX2 texture, pointing into the mapping
+struct Ktx2Level {
+    std::span<const uint8_t> data;
+    uint32_t width;
+    uint32_t height;
+};
+
+
+// A mapped KTX2 container (Khronos texture format 2.0): a single 2D image with its mip chain, already in the GPU's format.
+// Only the formats writeKtx2 supports, and no supercompression (Basis, zstd), arrays, cubes or 3D textures, which is all
+// this app writes
+class Ktx2File {
+public:
+    bool open(const std::string& path); // false if missing, throws if it is not a KTX2 file we can read
+    void close();
+    // Levels laid out as for writeKtx2, held in memory instead of mapped. For when the file could not be written
+    void assign(VkFormat format, uint32_t width, uint32_t height, std::vector<std::vector<uint8_t>> levelData);
+
+    VkFormat format() const { return vkFormat; }
+    uint32_t width() const { return baseWidth; }
+    uint32_t height() const { return baseHeight; }
+    uint32_t levelCount() const { return static_cast<uint32_t>(levels.size()); }
+    const Ktx2Level& level(uint32_t index) const { return levels[index]; }
+
+    // Key/value metadata, empty if the key is not there
+    std::string value(const std::string& key) const;
+
+private:
+    MappedFile file;
+    VkFormat vkFormat = VK_FORMAT_UNDEFINED;
+    uint32_t baseWidth = 0;
+    uint32_t baseHeight = 0;
+    std::vector<Ktx2Level> levels;
+    std::vector<std::vector<uint8_t>> ownedLevels; // what levels point into after assign
+    std::vector<std::pair<std::string, std::string>> keyValues;
+};
+
+
+// levels[0] is the full size image, each next one half the size (rounded down, at least 1).
+// Supports the formats the texture loader produces: R8G8B8A8, BC1 RGB, BC4, BC5 and BC7
+void writeKtx2(const std::string& path, VkFormat format, uint32_t width, uint32_t height,
+    const std::vector<std::vector<uint8_t>>& levels, const std::vector<std::pair<std::string, std::string>>& keyValues = {});
+
+// Which block format a KTX2 file holds, for decoding it when the device cannot sample it. false if not BCn
+bool blockFormatOf(VkFormat format, BlockFormat& block, bool& srgb);
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "application.h"
+#include "options.h"
+#include "mesh.h"
+
+
+const float NEAR_DISTANCE = 0.1f; // inside the bounding sphere, treat it as this close
+
+
+// Coarsest level whose model space error, projected at this distance, stays within --lod-error pixels
+void Application::selectLod(float distance, float fovY) {
+    uint32_t levelCount = static_cast<uint32_t>(model.lods.size());
+    if (lodFrames.size() != levelCount) lodFrames.assign(levelCount, 0);
+
+    if (options.forcedLod >= 0) {
+        currentLod = (std::min)(static_cast<uint32_t>(options.forcedLod), levelCount - 1);
+    }
+    else {
+        float pixelsPerUnit = swapChainExtent.height / (2.0f * std::tan(fovY * 0.5f)) / (std::max)(distance, NEAR_DISTANCE);
+        currentLod = 0;
+        for (uint32_t i = levelCount; i-- > 1; ) {
+            if (model.lods[i].error * pixelsPerUnit <= options.lodErrorPixels) {
+                currentLod = i;
+                break;
+            }
+        }
+    }
+
+    lodFrames[currentLod]++;
+}
+
+
+void Application::printFrameStats() {
+    uint64_t frameCount = 0;
+    for (size_t i = 0; i < lodFrames.size(); i++) {
+        std::cout << "LOD " << i << " (" << model.lods[i].indexCount / 3 << " triangles): " << lodFrames[i] << " frames" << std::endl;
+        frameCount += lodFrames[i];
+    }
+
+    uint64_t frames = (std::max)(frameCount, uint64_t(1));
+    std::cout << "Record: " << recordMilliseconds / frames << " ms, " << drawCalls / double(frames) << " draw calls and "
+        << descriptorBinds / double(frames) << " descriptor binds per frame, " << meshRanges.size() << " meshes"
+        << (options.separateBuffers ? " in separate buffers" : " in the geometry pool") << ", " << materialCount << " materials"
+        << (bindlessTextures ? " in a bindless table" : "") << std::endl;
+
+    if (drawPath == DrawPath::ComputeCull) { // the task shader does not report back
+        std::cout << "Meshlet culling: " << visibleTriangles << " of " << model.lods[visibleTrianglesLod].indexCount / 3
+            << " triangles visible at LOD " << visibleTrianglesLod << std::endl;
+    }
+}
\ No newline at end of file
@@ -1,12 +1,14 @@
 #include <stdexcept>
 #include <iostream>
 #include "application.h"
+#include "options.h"
 
 
-int main() {
+int main(int argc, char** argv) {
     Application app;
 
     try {
+        parseOptions(argc, argv);
         app.run();
     }
     catch (const std::exception& e) {
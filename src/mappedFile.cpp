@@ -0,0 +1,121 @@
+#include <algorithm>
+#include "mappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) { // empty files cannot be mapped
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    mapped = view;
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+
+void MappedFile::close() {
+    if (mapped) UnmapViewOfFile(mapped);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    mapped = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    mappedSize = 0;
+}
+
+
+void MappedFile::evict(size_t offset, size_t size) const {
+    if (!mapped || offset >= mappedSize) return;
+    // Unlocking pages that were never locked trims them from the working set, the call "fails" with ERROR_NOT_LOCKED
+    VirtualUnlock(static_cast<uint8_t*>(mapped) + offset, (std::min)(size, mappedSize - offset));
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (view == MAP_FAILED) {
+        return false;
+    }
+
+    mapped = view;
+    mappedSize = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+
+void MappedFile::close() {
+    if (mapped) munmap(mapped, mappedSize);
+    mapped = nullptr;
+    mappedSize = 0;
+}
+
+
+void MappedFile::evict(size_t offset, size_t size) const {
+    if (!mapped || offset >= mappedSize) return;
+    size = (std::min)(size, mappedSize - offset);
+
+    // madvise wants a page aligned start. Rounding out may drop a neighbour's page too, which only costs a re-read
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = offset / page * page;
+    madvise(static_cast<uint8_t*>(mapped) + start, size + (offset - start), MADV_DONTNEED); // clean, read-only pages, nothing is lost
+}
+
+#endif
\ No newline at end of file
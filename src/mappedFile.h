@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+
+// Read-only memory mapping of a whole file. The OS pages it in on demand, so nothing is copied until touched.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path); // false if missing or empty
+    void close();
+
+    bool isOpen() const { return mapped != nullptr; }
+    const uint8_t* data() const { return static_cast<const uint8_t*>(mapped); }
+    size_t size() const { return mappedSize; }
+
+    // Gives the pages of [offset, offset + size) back to the OS. Still mapped, touching them again reads the file
+    void evict(size_t offset, size_t size) const;
+
+private:
+    void* mapped = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
\ No newline at end of file
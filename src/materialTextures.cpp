@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+#include "application.h"
+#include "bindless.h"
+#include "parallel.h"
+
+
+// std430 element of shader_atlas.frag's region buffer
+struct TextureRegion {
+    float scaleOffset[4]; // uv * scale + offset, in the layer
+    uint32_t layer;
+    uint32_t padding[3];
+};
+
+
+// --material-textures DIR: every image in DIR, packed into as few images as texturePacker.h manages (or not, with
+// --no-texture-packing), and handed out to the materials in group order so meshes next to each other share a group
+void Application::createMaterialTextures() {
+    if (!materialTexturing) return;
+    auto start = Clock::now();
+
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(options.materialTextures)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (entry.is_regular_file() && (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp")) {
+            paths.push_back(entry.path().string());
+        }
+    }
+    if (paths.empty()) {
+        throw std::runtime_error("failed to find material textures in " + options.materialTextures + "!");
+    }
+    std::sort(paths.begin(), paths.end()); // the same textures for the same materials every run
+
+    ImageDecoder decoder(workerCount());
+    for (const std::string& path : paths) {
+        decoder.add(path);
+    }
+    std::vector<DecodedImage> images(paths.size());
+    for (DecodedImage image; decoder.next(image);) {
+        if (!image.pixels) {
+            throw std::runtime_error("failed to load material texture " + image.name + ": " + image.error);
+        }
+        images[image.id] = std::move(image);
+    }
+    startupTimings.add("createMaterialTextures (decode)", millisecondsSince(start));
+
+    std::vector<TextureSize> sizes;
+    for (const DecodedImage& image : images) {
+        sizes.push_back({ image.width, image.height });
+    }
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    texturePacking = packTextures(sizes, properties.limits.maxImageArrayLayers, options.packTextures);
+
+    // An image per texture runs into the allocation and sampler limits long before the memory runs out. Half the allocations
+    // are left for everything else
+    uint32_t groupCount = static_cast<uint32_t>(texturePacking.groups.size());
+    if (groupCount > properties.limits.maxMemoryAllocationCount / 2 || groupCount + BINDLESS_SAMPLER_COUNT > properties.limits.maxSamplerAllocationCount) {
+        throw std::runtime_error("failed to create material textures: " + std::to_string(groupCount)
+            + " images need more allocations or samplers than the device has, pack them!");
+    }
+
+    auto uploadStart = Clock::now();
+    uploadTextureGroups(images);
+    startupTimings.add("createMaterialTextures (upload)", millisecondsSince(uploadStart));
+
+    // Where every texture is, and the materials' textures in group, layer, position order
+    std::vector<TextureRegion> regions(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        const TexturePlacement& placement = texturePacking.placements[i];
+        const TextureGroup& group = texturePacking.groups[placement.group];
+        regions[i] = { { float(placement.width) / group.width, float(placement.height) / group.height,
+            float(placement.x) / group.width, float(placement.y) / group.height }, placement.layer, {} };
+    }
+    createDeviceLocalBuffer(regions.data(), regions.size() * sizeof(TextureRegion), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        textureRegionBuffer, textureRegionBufferMemory);
+
+    std::vector<uint32_t> order(images.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        const TexturePlacement& pa = texturePacking.placements[a];
+        const TexturePlacement& pb = texturePacking.placements[b];
+        return std::tie(pa.group, pa.layer, pa.y, pa.x) < std::tie(pb.group, pb.layer, pb.y, pb.x);
+    });
+    materialTextureIndices.resize(materialCount);
+    for (uint32_t material = 0; material < materialCount; material++) {
+        materialTextureIndices[material] = order[material % order.size()];
+    }
+
+    // What it costs on the device, and in objects
+    VkDeviceSize deviceBytes = 0;
+    uint32_t arrays = 0, atlasPages = 0;
+    for (uint32_t i = 0; i < groupCount; i++) {
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, textureGroupImages[i], &memRequirements);
+        deviceBytes += memRequirements.size;
+        if (texturePacking.groups[i].atlas) atlasPages += texturePacking.groups[i].layerCount;
+        else if (texturePacking.groups[i].layerCount > 1) arrays++;
+    }
+    std::cout << "Material textures: " << images.size() << " textures in " << groupCount << " images (" << arrays << " arrays, "
+        << atlasPages << " atlas pages), " << groupCount << " allocations, views and samplers for " << images.size() << " textures, "
+        << deviceBytes / (1024.0 * 1024.0) << " MB on the device. " << (std::min)(materialCount, static_cast<uint32_t>(images.size()))
+        << " of them used by " << materialCount << " materials" << std::endl;
+    startupTimings.add("createMaterialTextures (total)", millisecondsSince(start));
+}
+
+
+// Level 0 of every layer through the staging ring and the mips blitted from it. Array layers go up straight from the
+// decoded images, atlas pages are put together one at a time
+void Application::uploadTextureGroups(const std::vector<DecodedImage>& images) {
+    if (!isTextureFormatSupported(VK_FORMAT_R8G8B8A8_SRGB)) {
+        throw std::runtime_error("texture image format does not support linear blitting!");
+    }
+
+    const std::vector<TextureGroup>& groups = texturePacking.groups;
+    std::vector<std::vector<std::vector<uint32_t>>> layerTextures(groups.size()); // which textures each layer holds
+    for (size_t i = 0; i < groups.size(); i++) {
+        layerTextures[i].resize(groups[i].layerCount);
+    }
+    for (uint32_t i = 0; i < images.size(); i++) {
+        const TexturePlacement& placement = texturePacking.placements[i];
+        layerTextures[placement.group][placement.layer].push_back(i);
+    }
+
+    textureGroupImages.resize(groups.size());
+    textureGroupImagesMemory.resize(groups.size());
+    textureGroupViews.resize(groups.size());
+    textureGroupSamplers.resize(groups.size());
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    for (size_t i = 0; i < groups.size(); i++) {
+        const TextureGroup& group = groups[i];
+        createImage(group.width, group.height, group.mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureGroupImages[i], textureGroupImagesMemory[i], {}, 0, group.layerCount);
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = textureGroupImages[i];
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, group.mipLevels, 0, group.layerCount };
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &barrier);
+    }
+    endSingleTimeCommands(commandBuffer);
+
+    // Atlas pages start out black, gaps between the entries included
+    std::vector<uint8_t> page;
+    for (size_t i = 0; i < groups.size(); i++) {
+        const TextureGroup& group = groups[i];
+        for (uint32_t layer = 0; layer < group.layerCount; layer++) {
+            const std::vector<uint32_t>& textures = layerTextures[i][layer];
+            size_t layerBytes = size_t(group.width) * group.height * 4;
+            if (!group.atlas) {
+                uploadImage(textureGroupImages[i], VK_FORMAT_R8G8B8A8_SRGB, 0, layer, group.width, group.height,
+                    std::span<const uint8_t>(images[textures[0]].pixels.get(), layerBytes));
+                continue;
+            }
+            page.assign(layerBytes, 0);
+            parallelFor(textures.size(), [&](size_t j) {
+                writeAtlasEntry(page.data(), group.width, texturePacking.placements[textures[j]], images[textures[j]].pixels.get());
+            });
+            uploadImage(textureGroupImages[i], VK_FORMAT_R8G8B8A8_SRGB, 0, layer, group.width, group.height, page);
+        }
+    }
+
+    // An atlas keeps only the levels its gutters cover, see ATLAS_MIP_LEVELS
+    commandBuffer = beginSingleTimeCommands();
+    for (size_t i = 0; i < groups.size(); i++) {
+        recordMipmapBlits(commandBuffer, textureGroupImages[i], static_cast<int32_t>(groups[i].width), static_cast<int32_t>(groups[i].height),
+            groups[i].mipLevels, groups[i].layerCount);
+    }
+    endSingleTimeCommands(commandBuffer);
+
+    // A view and a sampler per group. Array layers are whole textures and can repeat, atlas entries must not run into the
+    // neighbours, shader_atlas.frag wraps those itself
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    for (size_t i = 0; i < groups.size(); i++) {
+        createTextureGroupView(static_cast<uint32_t>(i));
+
+        VkSamplerAddressMode addressMode = groups[i].atlas ? VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE : VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.addressModeU = addressMode;
+        samplerInfo.addressModeV = addressMode;
+        samplerInfo.addressModeW = addressMode;
+        samplerInfo.anisotropyEnable = VK_TRUE;
+        samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        if (vkCreateSampler(device, &samplerInfo, nullptr, &textureGroupSamplers[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture sampler!");
+        }
+    }
+}
+
+
+// Every layer and level, also when the group's image is replaced by one with a level less, see evictTextureGroupMip
+void Application::createTextureGroupView(uint32_t group) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = textureGroupImages[group];
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texturePacking.groups[group].mipLevels, 0, texturePacking.groups[group].layerCount };
+    if (vkCreateImageView(device, &viewInfo, nullptr, &textureGroupViews[group]) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image view!");
+    }
+}
+
+
+// Which of a frame's descriptor sets a material uses. With material textures that is its texture's group, so materials
+// in one group share a set and need no bind in between
+uint32_t Application::materialSetIndex(uint32_t material) {
+    if (bindlessTextures) return 0;
+    if (materialTexturing) return texturePacking.placements[materialTextureIndices[material]].group;
+    return material;
+}
+
+
+uint32_t Application::descriptorSetsPerFrame() {
+    if (bindlessTextures) return 1;
+    if (materialTexturing) return static_cast<uint32_t>(texturePacking.groups.size());
+    return materialCount;
+}
+
+
+void Application::cleanupMaterialTextures() {
+    for (size_t i = 0; i < textureGroupImages.size(); i++) {
+        vkDestroySampler(device, textureGroupSamplers[i], nullptr);
+        vkDestroyImageView(device, textureGroupViews[i], nullptr);
+        vkDestroyImage(device, textureGroupImages[i], nullptr);
+        freeMemory(textureGroupImagesMemory[i]);
+    }
+    vkDestroyBuffer(device, textureRegionBuffer, nullptr);
+    freeMemory(textureRegionBufferMemory);
+}
\ No newline at end of file
@@ -1,6 +1,9 @@
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include "application.h"
 
+
 uint32_t Application::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
 	VkPhysicalDeviceMemoryProperties memProperties;
 	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
@@ -15,44 +18,69 @@ uint32_t Application::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags
 	throw std::runtime_error("failed to find suitable memory type!");
 }
 
-void Application::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+// For the budget: whatever the buffer is read as, staging if it is only ever copied from
+static MemoryCategory bufferCategory(VkBufferUsageFlags usage) {
+    if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)) return MemoryCategory::Geometry;
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) return MemoryCategory::Uniform;
+    if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) return MemoryCategory::Staging;
+    return MemoryCategory::Other;
+}
+
+void Application::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, DeviceAllocation& bufferMemory) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
+    if (properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+        bufferInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT; // defragmentation copies it somewhere else, see moveBuffer
+    }
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
     if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to create buffer!");
     }
 
+    // Sub-allocated from a bigger block (deviceMemory.cpp), a vkAllocateMemory per buffer would run into
+    // maxMemoryAllocationCount, which can be as low as 4096
     VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    // Should not do this for every buffer. Max # of simultaneous allocs is limited by the maxMemoryAllocationCount physical device limit
-    // Can be as low as 4096 on a GTX 1080. Propery way is to use VulkanMemoryAllocator to alloc a large # of objects at the same time
-    // splits up a single allocation among many different objects by using the offset parameters
-    // Can also implement yourself :)
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate buffer memory!");
-    }
+    bool dedicated = queryMemoryRequirements(buffer, VK_NULL_HANDLE, memRequirements);
+    bufferMemory = allocateMemory(memRequirements, properties, buffer, VK_NULL_HANDLE, false, dedicated, bufferCategory(usage));
+    bufferMemory.bufferSize = size;
+    bufferMemory.bufferUsage = usage;
 
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
 }
 
-void Application::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = 0; // Optional
-    copyRegion.dstOffset = 0; // Optional
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+// Staging upload for static data (meshlets etc). usage gets TRANSFER_DST added
+void Application::createDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, DeviceAllocation& bufferMemory) {
+    createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+    uploadBufferChunked(buffer, { 0 }, static_cast<size_t>(size), 1, [data](void* staging, size_t first, size_t count) {
+        memcpy(staging, static_cast<const uint8_t*>(data) + first, count);
+    });
+}
+
+
+// Fills buffer through the staging ring, in slices of at most STAGING_CHUNK_SIZE. write(staging, first, count) puts
+// elements [first, first + count) at the start of the slice, which then goes to every offset in dstOffsets. Nothing
+// waits for a copy unless the ring is full, and whatever write reads from can let go behind it
+void Application::uploadBufferChunked(VkBuffer buffer, const std::vector<VkDeviceSize>& dstOffsets, size_t count, VkDeviceSize elementSize,
+    const std::function<void(void* staging, size_t first, size_t count)>& write) {
+    if (count == 0) return;
+    auto start = Clock::now();
+    size_t chunkElements = (std::max)(static_cast<size_t>(stagingChunkSize() / elementSize), size_t(1));
 
-    endSingleTimeCommands(commandBuffer);
+    std::vector<VkBufferCopy> regions(dstOffsets.size());
+    for (size_t first = 0; first < count; first += chunkElements) {
+        size_t chunk = (std::min)(chunkElements, count - first);
+        StagingSlice slice = reserveStaging(chunk * elementSize, 16);
+        write(slice.data, first, chunk);
+
+        for (size_t i = 0; i < dstOffsets.size(); i++) {
+            regions[i] = { slice.offset, dstOffsets[i] + first * elementSize, chunk * elementSize };
+        }
+        vkCmdCopyBuffer(stagingCommands(), slice.buffer, buffer, static_cast<uint32_t>(regions.size()), regions.data());
+    }
+    stagingStats.bytes += count * elementSize;
+    stagingStats.uploadMilliseconds += millisecondsSince(start);
 }
\ No newline at end of file
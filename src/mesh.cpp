@@ -0,0 +1,60 @@
+#include "mesh.h"
+#include "meshCache.h"
+
+
+Mesh model;
+
+
+Mesh::Mesh() = default;
+Mesh::~Mesh() = default;
+Mesh::Mesh(Mesh&& other) noexcept = default;
+Mesh& Mesh::operator=(Mesh&& other) noexcept = default;
+
+
+void Mesh::assign(std::vector<Vertex>&& vertices, std::vector<uint32_t>&& indices) {
+    release();
+    ownedVertices = std::move(vertices);
+    ownedIndices = std::move(indices);
+    vertexView = ownedVertices;
+    indexView = ownedIndices;
+    totalVertices = static_cast<uint32_t>(ownedVertices.size());
+    totalIndices = static_cast<uint32_t>(ownedIndices.size());
+}
+
+
+bool Mesh::openCache(const std::string& cachePath, const std::string& sourcePath, uint32_t flags) {
+    auto opened = std::make_unique<MeshCache>();
+    if (!opened->open(cachePath, sourcePath, flags)) {
+        return false;
+    }
+
+    release();
+    cache = std::move(opened);
+    vertexView = cache->vertices();
+    indexView = cache->indices();
+    totalVertices = static_cast<uint32_t>(vertexView.size());
+    totalIndices = static_cast<uint32_t>(indexView.size());
+    bounds = cache->bounds();
+    lods = cache->lods();
+    return true;
+}
+
+
+void Mesh::release() {
+    // swap, clear() alone keeps the capacity
+    std::vector<Vertex>().swap(ownedVertices);
+    std::vector<uint32_t>().swap(ownedIndices);
+    cache.reset();
+    vertexView = {};
+    indexView = {};
+}
+
+
+void Mesh::evictVertices(size_t first, size_t count) const {
+    if (cache) cache->evict(vertexView.data() + first, count * sizeof(Vertex));
+}
+
+
+void Mesh::evictIndices(size_t first, size_t count) const {
+    if (cache) cache->evict(indexView.data() + first, count * sizeof(uint32_t));
+}
\ No newline at end of file
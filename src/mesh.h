@@ -0,0 +1,52 @@
+#pragma once
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "vertex.h"
+
+class MeshCache;
+
+
+// A model's geometry. The arrays are either owned (what a loader produced) or views into a mapped mesh cache, and
+// release() drops them once the GPU has its copy. Counts, bounds and LODs stay valid after that
+class Mesh {
+public:
+    Mesh();
+    ~Mesh();
+    Mesh(Mesh&& other) noexcept;
+    Mesh& operator=(Mesh&& other) noexcept;
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // Takes the arrays over, no copy. Bounds and LODs are set separately
+    void assign(std::vector<Vertex>&& vertices, std::vector<uint32_t>&& indices);
+    // Maps the cache instead, so nothing is read until it is uploaded. false if it is missing or stale
+    bool openCache(const std::string& cachePath, const std::string& sourcePath, uint32_t flags);
+    void release();
+
+    bool resident() const { return !vertexView.empty(); }
+    std::span<const Vertex> vertices() const { return vertexView; }
+    std::span<const uint32_t> indices() const { return indexView; }
+    uint32_t vertexCount() const { return totalVertices; }
+    uint32_t indexCount() const { return totalIndices; }
+
+    // Done reading these for now. A mapped cache gives the pages back, so a chunked upload only keeps a chunk resident
+    void evictVertices(size_t first, size_t count) const;
+    void evictIndices(size_t first, size_t count) const;
+
+    Bounds bounds{};
+    std::vector<MeshLod> lods; // at least one level, covering the start of indices()
+
+private:
+    std::vector<Vertex> ownedVertices;
+    std::vector<uint32_t> ownedIndices;
+    std::unique_ptr<MeshCache> cache; // a MappedFile does not move, the pointer does
+    std::span<const Vertex> vertexView;
+    std::span<const uint32_t> indexView;
+    uint32_t totalVertices = 0;
+    uint32_t totalIndices = 0;
+};
+
+
+extern Mesh model; // the one being drawn, loaded by loadModel
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include "hash.h"
+#include "meshCache.h"
+
+
+bool stampSource(const std::string& sourcePath, SourceStamp& stamp) {
+    std::error_code ec;
+    stamp.size = std::filesystem::file_size(sourcePath, ec);
+    if (ec) return false;
+    stamp.mtime = static_cast<int64_t>(std::filesystem::last_write_time(sourcePath, ec).time_since_epoch().count());
+    return !ec;
+}
+
+static uint64_t hashFile(const std::string& path) {
+    MappedFile source;
+    if (!source.open(path)) return 0;
+    return hashBytes(source.data(), source.size());
+}
+
+
+uint64_t hashBytes(const uint8_t* data, size_t size) {
+    // Word at a time, so hashing a source file stays far cheaper than parsing it
+    const uint64_t prime = 0x9E3779B97F4A7C15ull;
+    uint64_t h = size * prime;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ mix64(word)) * prime;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    h = (h ^ mix64(tail)) * prime;
+
+    return mix64(h);
+}
+
+
+bool MeshCache::open(const std::string& cachePath, const std::string& sourcePath, uint32_t flags) {
+    close();
+
+    SourceStamp stamp;
+    if (!stampSource(sourcePath, stamp) || !file.open(cachePath)) {
+        return false;
+    }
+
+    if (file.size() < sizeof(MeshCacheHeader)) {
+        close();
+        return false;
+    }
+    const MeshCacheHeader* h = reinterpret_cast<const MeshCacheHeader*>(file.data());
+
+    bool formatOk = h->magic == MESH_CACHE_MAGIC && h->version == MESH_CACHE_VERSION && h->vertexStride == sizeof(Vertex) && h->flags == flags
+        && h->vertexOffset + h->vertexCount * sizeof(Vertex) <= file.size()
+        && h->indexOffset + h->indexCount * sizeof(uint32_t) <= file.size()
+        && h->lodCount >= 1 && h->lodCount <= MAX_LODS;
+    for (uint32_t i = 0; formatOk && i < h->lodCount; i++) {
+        formatOk = uint64_t(h->lods[i].firstIndex) + h->lods[i].indexCount <= h->indexCount;
+    }
+    if (!formatOk || h->sourceSize != stamp.size) {
+        close();
+        return false;
+    }
+
+    // Touched but maybe not changed. Only now pay for reading the whole source
+    if (h->sourceMtime != stamp.mtime && h->sourceHash != hashFile(sourcePath)) {
+        close();
+        return false;
+    }
+
+    header = h;
+    return true;
+}
+
+
+void MeshCache::close() {
+    header = nullptr;
+    file.close();
+}
+
+
+std::span<const Vertex> MeshCache::vertices() const {
+    return { reinterpret_cast<const Vertex*>(file.data() + header->vertexOffset), static_cast<size_t>(header->vertexCount) };
+}
+
+
+std::span<const uint32_t> MeshCache::indices() const {
+    return { reinterpret_cast<const uint32_t*>(file.data() + header->indexOffset), static_cast<size_t>(header->indexCount) };
+}
+
+
+Bounds MeshCache::bounds() const {
+    return {
+        { header->boundsMin[0], header->boundsMin[1], header->boundsMin[2] },
+        { header->boundsMax[0], header->boundsMax[1], header->boundsMax[2] }
+    };
+}
+
+
+std::vector<MeshLod> MeshCache::lods() const {
+    return { header->lods, header->lods + header->lodCount };
+}
+
+
+void MeshCache::evict(const void* data, size_t size) const {
+    file.evict(static_cast<size_t>(static_cast<const uint8_t*>(data) - file.data()), size);
+}
+
+
+void writeMeshCache(const std::string& cachePath, const std::string& sourcePath,
+    std::span<const Vertex> vertices, std::span<const uint32_t> indices, const Bounds& bounds, std::span<const MeshLod> lods, uint32_t flags) {
+    if (lods.empty() || lods.size() > MAX_LODS) {
+        throw std::runtime_error("invalid LOD count for mesh cache!");
+    }
+
+    SourceStamp stamp;
+    if (!stampSource(sourcePath, stamp)) {
+        throw std::runtime_error("failed to stat model source for mesh cache!");
+    }
+
+    MeshCacheHeader header{};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.vertexStride = sizeof(Vertex);
+    header.flags = flags;
+    header.sourceSize = stamp.size;
+    header.sourceMtime = stamp.mtime;
+    header.sourceHash = hashFile(sourcePath);
+    header.vertexCount = vertices.size();
+    header.indexCount = indices.size();
+    header.vertexOffset = sizeof(MeshCacheHeader);
+    header.indexOffset = header.vertexOffset + vertices.size_bytes();
+    memcpy(header.boundsMin, &bounds.min, sizeof(header.boundsMin));
+    memcpy(header.boundsMax, &bounds.max, sizeof(header.boundsMax));
+    header.lodCount = static_cast<uint32_t>(lods.size());
+    std::copy(lods.begin(), lods.end(), header.lods);
+
+    // Write next to it and rename, so a crash halfway never leaves a truncated cache that looks valid
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("failed to open mesh cache for writing!");
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(vertices.data()), vertices.size_bytes());
+        out.write(reinterpret_cast<const char*>(indices.data()), indices.size_bytes());
+        if (!out) {
+            throw std::runtime_error("failed to write mesh cache!");
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        throw std::runtime_error("failed to replace mesh cache!");
+    }
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include <span>
+#include <string>
+#include <vector>
+#include "mappedFile.h"
+#include "vertex.h"
+
+
+// Binary cache of an already de-duplicated model, written next to the source on the first load.
+// Layout: MeshCacheHeader | Vertex[vertexCount] | uint32_t[indexCount] (every LOD back to back). Bump the version whenever any of it changes.
+const uint32_t MESH_CACHE_MAGIC = 0x4853454D; // "MESH"
+const uint32_t MESH_CACHE_VERSION = 3; // 2: vertices/indices are stored optimized, 3: LOD chain
+
+// MeshCacheHeader::flags, for load options that change the stored data
+const uint32_t MESH_CACHE_OVERDRAW_ORDER = 1 << 0;
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexStride; // sizeof(Vertex) when written, catches layout changes that forgot the version bump
+    uint32_t flags; // MESH_CACHE_* bits, must match what the loader asks for
+
+    // Source identity. Size + mtime is the fast check, the hash saves a rebuild when only the mtime changed (eg git checkout)
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t sourceHash;
+
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t vertexOffset; // bytes from the start of the file
+    uint64_t indexOffset;
+
+    float boundsMin[3];
+    float boundsMax[3];
+
+    uint32_t lodCount;
+    MeshLod lods[MAX_LODS];
+};
+
+
+class MeshCache {
+public:
+    // Maps the cache if it exists and is still valid for the source and flags. false means rebuild it.
+    bool open(const std::string& cachePath, const std::string& sourcePath, uint32_t flags = 0);
+    void close();
+
+    // Point straight into the mapping, valid until close()
+    std::span<const Vertex> vertices() const;
+    std::span<const uint32_t> indices() const;
+    Bounds bounds() const;
+    std::vector<MeshLod> lods() const;
+
+    // data points into vertices() or indices(), see MappedFile::evict
+    void evict(const void* data, size_t size) const;
+
+private:
+    MappedFile file;
+    const MeshCacheHeader* header = nullptr;
+};
+
+
+void writeMeshCache(const std::string& cachePath, const std::string& sourcePath,
+    std::span<const Vertex> vertices, std::span<const uint32_t> indices, const Bounds& bounds, std::span<const MeshLod> lods, uint32_t flags = 0);
+
+uint64_t hashBytes(const uint8_t* data, size_t size);
+
+
+// Size and modification time of a cache's source, the cheap staleness check. false if the source is missing
+struct SourceStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+};
+
+bool stampSource(const std::string& sourcePath, SourceStamp& stamp);
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include "meshOptimize.h"
+
+
+const uint32_t NO_VERTEX = UINT32_MAX;
+
+
+// FIFO cache simulation. A vertex is still cached if fewer than cacheSize misses happened since it was loaded
+class FifoCache {
+public:
+    FifoCache(size_t vertexCount, unsigned cacheSize) : loadedAt(vertexCount, 0), cacheSize(cacheSize), time(cacheSize + 1) {}
+
+    // true on a miss
+    bool access(uint32_t vertex) {
+        if (time - loadedAt[vertex] > cacheSize) {
+            loadedAt[vertex] = time++;
+            return true;
+        }
+        return false;
+    }
+
+    void clear() {
+        time += cacheSize + 1;
+    }
+
+private:
+    std::vector<uint32_t> loadedAt;
+    uint32_t cacheSize;
+    uint32_t time;
+};
+
+
+VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, unsigned cacheSize) {
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> used(vertexCount, false);
+
+    size_t misses = 0, usedCount = 0;
+    for (uint32_t index : indices) {
+        misses += cache.access(index);
+        if (!used[index]) {
+            used[index] = true;
+            usedCount++;
+        }
+    }
+
+    VertexCacheStats stats;
+    if (!indices.empty()) {
+        stats.acmr = double(misses) / (indices.size() / 3);
+        stats.atvr = double(misses) / usedCount;
+    }
+    return stats;
+}
+
+
+std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize) {
+    size_t triangleCount = indices.size() / 3;
+
+    // Vertex -> triangles adjacency, CSR style
+    std::vector<uint32_t> liveCount(vertexCount, 0);
+    for (uint32_t index : indices) liveCount[index]++;
+
+    std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] = adjacencyOffset[v] + liveCount[v];
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<uint32_t> cachedAt(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds; // recently used vertices, the cheap place to restart from
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> hardBoundaries;
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    uint32_t time = cacheSize + 1;
+    size_t scan = 0; // every vertex before this has no live triangles left
+    uint32_t fanning = indices.empty() ? NO_VERTEX : indices[0];
+    hardBoundaries.push_back(0);
+
+    while (fanning != NO_VERTEX) {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = adjacencyOffset[fanning]; a < adjacencyOffset[fanning + 1]; a++) {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle]) continue;
+
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[triangle * 3 + k];
+                result.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveCount[v]--;
+                if (time - cachedAt[v] > cacheSize) {
+                    cachedAt[v] = time++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // Next fanning vertex: the oldest candidate that will still be in the cache after emitting its remaining triangles.
+        // Any live candidate beats the dead-end stack, also one that would drop out of the cache (priority 0)
+        uint32_t next = NO_VERTEX;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (liveCount[v] == 0) continue;
+            int64_t priority = 0;
+            if (time - cachedAt[v] + 2 * liveCount[v] <= cacheSize) {
+                priority = time - cachedAt[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        if (next == NO_VERTEX) {
+            // Dead end: back up through recent vertices, then fall back to scanning in order
+            while (!deadEnds.empty() && next == NO_VERTEX) {
+                uint32_t v = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveCount[v] > 0) next = v;
+            }
+            while (next == NO_VERTEX && scan < vertexCount) {
+                if (liveCount[scan] > 0) next = static_cast<uint32_t>(scan);
+                else scan++;
+            }
+            if (next != NO_VERTEX) {
+                hardBoundaries.push_back(static_cast<uint32_t>(result.size() / 3));
+            }
+        }
+
+        fanning = next;
+    }
+
+    indices.swap(result);
+    return hardBoundaries;
+}
+
+
+// Cuts each hard cluster wherever the triangles so far already reach its ACMR (times threshold),
+// so overdraw sorting gets more, smaller clusters without giving up much cache efficiency
+static std::vector<uint32_t> findSoftBoundaries(std::span<const uint32_t> indices, size_t vertexCount,
+    const std::vector<uint32_t>& hardBoundaries, float threshold, unsigned cacheSize) {
+    size_t triangleCount = indices.size() / 3;
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<uint32_t> boundaries;
+
+    for (size_t c = 0; c < hardBoundaries.size(); c++) {
+        size_t start = hardBoundaries[c];
+        size_t end = c + 1 < hardBoundaries.size() ? hardBoundaries[c + 1] : triangleCount;
+        if (start >= end) continue;
+
+        cache.clear();
+        size_t clusterMisses = 0;
+        for (size_t t = start * 3; t < end * 3; t++) clusterMisses += cache.access(indices[t]);
+        double limit = threshold * double(clusterMisses) / (end - start);
+
+        cache.clear();
+        boundaries.push_back(static_cast<uint32_t>(start));
+        size_t softStart = start, misses = 0;
+        for (size_t t = start; t < end; t++) {
+            for (int k = 0; k < 3; k++) misses += cache.access(indices[t * 3 + k]);
+
+            if (t + 1 < end && double(misses) / (t + 1 - softStart) <= limit) {
+                boundaries.push_back(static_cast<uint32_t>(t + 1));
+                softStart = t + 1;
+                misses = 0;
+                cache.clear();
+            }
+        }
+    }
+    return boundaries;
+}
+
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, std::span<const Vertex> vertices, const std::vector<uint32_t>& hardBoundaries,
+    float threshold, unsigned cacheSize) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    std::vector<uint32_t> clusters = findSoftBoundaries(indices, vertices.size(), hardBoundaries, threshold, cacheSize);
+
+    // Area weighted centroid and normal per cluster, and for the whole mesh
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> clusterCenter(clusters.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormal(clusters.size(), glm::vec3(0.0f));
+
+    for (size_t c = 0; c < clusters.size(); c++) {
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        float clusterArea = 0.0f;
+
+        for (size_t t = clusters[c]; t < end; t++) {
+            const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0); // length is twice the area
+            float area = glm::length(normal);
+            glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+
+            clusterCenter[c] += center * area;
+            clusterNormal[c] += normal;
+            clusterArea += area;
+        }
+
+        meshCenter += clusterCenter[c];
+        meshArea += clusterArea;
+        clusterCenter[c] = clusterArea > 0.0f ? clusterCenter[c] / clusterArea : clusterCenter[c];
+    }
+    meshCenter = meshArea > 0.0f ? meshCenter / meshArea : meshCenter;
+
+    // Clusters facing away from the middle are the ones in front from most directions
+    std::vector<float> sortKey(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        float length = glm::length(clusterNormal[c]);
+        glm::vec3 normal = length > 0.0f ? clusterNormal[c] / length : glm::vec3(0.0f);
+        sortKey[c] = glm::dot(clusterCenter[c] - meshCenter, normal);
+    }
+
+    std::vector<uint32_t> order(clusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (uint32_t c : order) {
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+    }
+    indices.swap(result);
+}
+
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    std::vector<uint32_t> remap(vertices.size(), NO_VERTEX);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (uint32_t& index : indices) {
+        if (remap[index] == NO_VERTEX) {
+            remap[index] = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "vertex.h"
+
+
+// Post-transform cache size the optimizations target and the stats simulate (FIFO, like most desktop GPUs behave in practice)
+const unsigned VERTEX_CACHE_SIZE = 16;
+
+
+struct VertexCacheStats {
+    double acmr = 0.0; // transformed vertices per triangle, 0.5 is the ideal for a large regular grid, 3 the worst
+    double atvr = 0.0; // transformed vertices per referenced vertex, 1 is ideal
+};
+
+VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, unsigned cacheSize = VERTEX_CACHE_SIZE);
+
+
+// Tipsify (Sander et al. 2007): reorders triangles for post-transform cache reuse in linear time.
+// Returns the first triangle of every cluster it had to restart at, which optimizeOverdraw uses as hard boundaries.
+std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize = VERTEX_CACHE_SIZE);
+
+// Splits the cache-optimized order into clusters whose ACMR stays within threshold of the original,
+// then draws outward-facing clusters first so they occlude the rest. Run after optimizeVertexCache.
+void optimizeOverdraw(std::vector<uint32_t>& indices, std::span<const Vertex> vertices, const std::vector<uint32_t>& hardBoundaries,
+    float threshold = 1.05f, unsigned cacheSize = VERTEX_CACHE_SIZE);
+
+// Renumbers vertices in the order the indices first use them and drops unused ones, so vertex fetch walks memory forwards
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
\ No newline at end of file
@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "meshSimplify.h"
+#include "meshOptimize.h"
+#include "vertexWeld.h"
+
+
+const uint32_t NO_VERTEX = UINT32_MAX;
+const double BORDER_WEIGHT = 10.0; // how much more an open border resists moving than the surface does
+const size_t MIN_LOD_TRIANGLES = 64; // below this a level saves nothing worth a draw
+
+
+enum class VertexKind : uint8_t {
+    Manifold, // free to collapse onto any neighbour
+    Border, // on an open border, only collapses along it
+    Locked // texture seam, non-manifold or a border corner
+};
+
+
+// Sum of squared distances to a set of planes, weighted by the area they came from. Symmetric 4x4, upper half
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double weight = 0;
+
+    void addPlane(const glm::vec3& n, float d, double w) {
+        double a = n.x, b = n.y, c = n.z;
+        a00 += w * a * a; a01 += w * a * b; a02 += w * a * c; a03 += w * a * d;
+        a11 += w * b * b; a12 += w * b * c; a13 += w * b * d;
+        a22 += w * c * c; a23 += w * c * d;
+        a33 += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        weight += q.weight;
+    }
+
+    double evaluate(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double r = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+            + 2 * (a03 * x + a13 * y + a23 * z) + a33;
+        return r > 0 ? r : 0; // rounding can dip below 0
+    }
+};
+
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    float error;
+};
+
+
+static uint64_t hashPosition(const glm::vec3& pos) {
+    uint32_t bits[3];
+    memcpy(bits, &pos, sizeof(bits));
+    for (uint32_t& b : bits) b = b == 0x80000000u ? 0 : b; // -0 == 0
+    return mix64(mix64(bits[0] | uint64_t(bits[1]) << 32) ^ bits[2]);
+}
+
+static uint64_t edgeKey(uint32_t a, uint32_t b) {
+    return uint64_t(a) << 32 | b;
+}
+
+
+// Everything simplifyMesh works on is per position, not per vertex: vertices that only differ in texcoords
+// are the same point of the surface. remap takes a vertex to the first vertex at its position
+class SimplifyMesh {
+public:
+    SimplifyMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices) : vertices(vertices) {
+        size_t vertexCount = vertices.size();
+        remap.resize(vertexCount);
+        WeldTable table;
+        table.reserve(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            remap[i] = table.findOrInsert(hashPosition(vertices[i].pos), i, [&](uint32_t other) { return vertices[other].pos == vertices[i].pos; });
+        }
+
+        triangles.reserve(indices.size());
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a]) continue; // degenerate already
+            triangles.insert(triangles.end(), { a, b, c });
+        }
+
+        classifyVertices();
+        computeQuadrics();
+    }
+
+    std::vector<uint32_t> simplify(size_t targetIndexCount, float& error);
+
+private:
+    void buildEdges();
+    bool hasEdge(uint32_t a, uint32_t b) const {
+        return std::binary_search(edges.begin(), edges.end(), edgeKey(a, b));
+    }
+    bool isBorderEdge(uint32_t a, uint32_t b) const {
+        return hasEdge(a, b) != hasEdge(b, a);
+    }
+
+    void classifyVertices();
+    void computeQuadrics();
+    void buildAdjacency();
+    void collectCollapses(std::vector<Collapse>& collapses);
+    bool flips(uint32_t from, uint32_t to) const;
+    uint32_t findTargetVertex(uint32_t from, uint32_t to) const;
+
+    const glm::vec3& position(uint32_t v) const {
+        return vertices[v].pos;
+    }
+
+    std::span<const Vertex> vertices;
+    std::vector<uint32_t> remap;
+    std::vector<uint32_t> triangles; // vertex indices, like the index buffer
+    std::vector<VertexKind> kind; // per position
+    std::vector<uint32_t> wedge; // per position, its only vertex. Meaningless for Locked seams
+    std::vector<Quadric> quadrics; // per position
+    std::vector<uint64_t> edges; // sorted directed position edges of the current triangles
+
+    // Position -> triangles, rebuilt every pass
+    std::vector<uint32_t> adjacencyOffset;
+    std::vector<uint32_t> adjacency;
+};
+
+
+void SimplifyMesh::buildEdges() {
+    edges.clear();
+    edges.reserve(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            edges.push_back(edgeKey(remap[triangles[i + k]], remap[triangles[i + (k + 1) % 3]]));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+}
+
+
+void SimplifyMesh::classifyVertices() {
+    size_t vertexCount = vertices.size();
+    kind.assign(vertexCount, VertexKind::Manifold);
+    wedge.assign(vertexCount, NO_VERTEX);
+
+    // More than one vertex at a position is a seam, moving it would tear the texture
+    for (uint32_t v : triangles) {
+        uint32_t p = remap[v];
+        if (wedge[p] == NO_VERTEX) wedge[p] = v;
+        else if (wedge[p] != v) kind[p] = VertexKind::Locked;
+    }
+
+    buildEdges();
+    std::vector<uint8_t> borderEdges(vertexCount, 0);
+    for (size_t i = 0; i < edges.size(); i++) {
+        uint32_t a = static_cast<uint32_t>(edges[i] >> 32), b = static_cast<uint32_t>(edges[i]);
+        if (i + 1 < edges.size() && edges[i + 1] == edges[i]) { // same directed edge twice, non-manifold
+            kind[a] = kind[b] = VertexKind::Locked;
+        }
+        else if (!hasEdge(b, a)) {
+            borderEdges[a] = static_cast<uint8_t>((std::min)(borderEdges[a] + 1, 255));
+            borderEdges[b] = static_cast<uint8_t>((std::min)(borderEdges[b] + 1, 255));
+        }
+    }
+
+    for (size_t p = 0; p < vertexCount; p++) {
+        if (kind[p] == VertexKind::Locked || borderEdges[p] == 0) continue;
+        kind[p] = borderEdges[p] == 2 ? VertexKind::Border : VertexKind::Locked; // where borders meet, nothing to slide along
+    }
+}
+
+
+void SimplifyMesh::computeQuadrics() {
+    quadrics.assign(vertices.size(), Quadric{});
+
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        uint32_t p[3] = { remap[triangles[i]], remap[triangles[i + 1]], remap[triangles[i + 2]] };
+        glm::vec3 normal = glm::cross(position(p[1]) - position(p[0]), position(p[2]) - position(p[0]));
+        float length = glm::length(normal);
+        if (length <= 0.0f) continue;
+        normal /= length;
+
+        Quadric plane;
+        plane.addPlane(normal, -glm::dot(normal, position(p[0])), length * 0.5);
+        for (int k = 0; k < 3; k++) quadrics[p[k]].add(plane);
+
+        // Open borders get a plane through the edge, perpendicular to the surface, so they keep their outline
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = p[k], b = p[(k + 1) % 3];
+            if (hasEdge(b, a)) continue;
+            glm::vec3 edge = position(b) - position(a);
+            glm::vec3 side = glm::cross(edge, normal);
+            float sideLength = glm::length(side);
+            if (sideLength <= 0.0f) continue;
+            side /= sideLength;
+
+            Quadric border;
+            border.addPlane(side, -glm::dot(side, position(a)), glm::dot(edge, edge) * BORDER_WEIGHT);
+            quadrics[a].add(border);
+            quadrics[b].add(border);
+        }
+    }
+}
+
+
+void SimplifyMesh::buildAdjacency() {
+    size_t vertexCount = vertices.size();
+    adjacencyOffset.assign(vertexCount + 1, 0);
+    for (uint32_t v : triangles) adjacencyOffset[remap[v] + 1]++;
+    for (size_t p = 0; p < vertexCount; p++) adjacencyOffset[p + 1] += adjacencyOffset[p];
+
+    adjacency.resize(triangles.size());
+    std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t i = 0; i < triangles.size(); i++) {
+        adjacency[fill[remap[triangles[i]]]++] = static_cast<uint32_t>(i / 3);
+    }
+}
+
+
+void SimplifyMesh::collectCollapses(std::vector<Collapse>& collapses) {
+    collapses.clear();
+
+    auto allowed = [&](uint32_t from, uint32_t to) {
+        switch (kind[from]) {
+        case VertexKind::Manifold: return true;
+        case VertexKind::Border: return kind[to] != VertexKind::Manifold && isBorderEdge(from, to);
+        default: return false;
+        }
+    };
+    auto cost = [&](uint32_t from, uint32_t to) {
+        Quadric q = quadrics[from];
+        q.add(quadrics[to]);
+        return q.weight > 0 ? static_cast<float>(std::sqrt(q.evaluate(position(to)) / q.weight)) : 0.0f;
+    };
+
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = remap[triangles[i + k]], b = remap[triangles[i + (k + 1) % 3]];
+            if (a > b && hasEdge(b, a)) continue; // interior edges show up twice, keep one
+
+            bool forward = allowed(a, b), backward = allowed(b, a);
+            if (!forward && !backward) continue;
+            float forwardCost = forward ? cost(a, b) : 0.0f;
+            float backwardCost = backward ? cost(b, a) : 0.0f;
+
+            if (forward && (!backward || forwardCost <= backwardCost)) collapses.push_back({ a, b, forwardCost });
+            else collapses.push_back({ b, a, backwardCost });
+        }
+    }
+
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+}
+
+
+// true if moving from onto to turns any of from's remaining triangles over (or flat)
+bool SimplifyMesh::flips(uint32_t from, uint32_t to) const {
+    for (uint32_t a = adjacencyOffset[from]; a < adjacencyOffset[from + 1]; a++) {
+        const uint32_t* triangle = &triangles[adjacency[a] * 3];
+        uint32_t p[3] = { remap[triangle[0]], remap[triangle[1]], remap[triangle[2]] };
+        if (p[0] == to || p[1] == to || p[2] == to) continue; // goes away
+
+        glm::vec3 q[3] = { position(p[0]), position(p[1]), position(p[2]) };
+        glm::vec3 before = glm::cross(q[1] - q[0], q[2] - q[0]);
+        for (int k = 0; k < 3; k++) {
+            if (p[k] == from) q[k] = position(to);
+        }
+        glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+        if (glm::dot(before, after) <= 0.0f) return true;
+    }
+    return false;
+}
+
+
+// The vertex that replaces from's. If to sits on a seam, it is the one the triangles of the edge use,
+// and they have to agree, or the collapse would pull texcoords across the seam
+uint32_t SimplifyMesh::findTargetVertex(uint32_t from, uint32_t to) const {
+    if (kind[to] != VertexKind::Locked) return wedge[to];
+
+    uint32_t target = NO_VERTEX;
+    for (uint32_t a = adjacencyOffset[from]; a < adjacencyOffset[from + 1]; a++) {
+        const uint32_t* triangle = &triangles[adjacency[a] * 3];
+        for (int k = 0; k < 3; k++) {
+            if (remap[triangle[k]] != to) continue;
+            if (target != NO_VERTEX && target != triangle[k]) return NO_VERTEX;
+            target = triangle[k];
+        }
+    }
+    return target;
+}
+
+
+std::vector<uint32_t> SimplifyMesh::simplify(size_t targetIndexCount, float& error) {
+    error = 0.0f;
+    std::vector<Collapse> collapses;
+    std::vector<uint8_t> locked(vertices.size());
+    std::vector<uint32_t> vertexRemap(vertices.size());
+
+    while (triangles.size() > targetIndexCount) {
+        buildEdges();
+        buildAdjacency();
+        collectCollapses(collapses);
+        if (collapses.empty()) break;
+
+        // Most collapses remove two triangles. Do not go far past the cheap ones in a single pass, later passes
+        // see the updated quadrics and usually find something cheaper
+        size_t trianglesToRemove = (triangles.size() - targetIndexCount + 2) / 3;
+        size_t budget = (std::min)(collapses.size(), (trianglesToRemove + 1) / 2);
+        float errorLimit = collapses[budget - 1].error * 1.5f;
+
+        std::fill(locked.begin(), locked.end(), 0);
+        for (uint32_t v = 0; v < vertexRemap.size(); v++) vertexRemap[v] = v;
+
+        size_t removed = 0, collapsed = 0;
+        for (const Collapse& collapse : collapses) {
+            if (removed >= trianglesToRemove || collapse.error > errorLimit) break;
+            if (locked[collapse.from] || locked[collapse.to]) continue;
+
+            uint32_t target = findTargetVertex(collapse.from, collapse.to);
+            if (target == NO_VERTEX || flips(collapse.from, collapse.to)) continue;
+
+            vertexRemap[wedge[collapse.from]] = target;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            error = (std::max)(error, collapse.error);
+            collapsed++;
+
+            for (uint32_t a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1]; a++) {
+                const uint32_t* triangle = &triangles[adjacency[a] * 3];
+                removed += remap[triangle[0]] == collapse.to || remap[triangle[1]] == collapse.to || remap[triangle[2]] == collapse.to;
+            }
+
+            // Everything around both ends is off limits until the next pass, the adjacency no longer describes it
+            for (uint32_t end : { collapse.from, collapse.to }) {
+                for (uint32_t a = adjacencyOffset[end]; a < adjacencyOffset[end + 1]; a++) {
+                    const uint32_t* triangle = &triangles[adjacency[a] * 3];
+                    for (int k = 0; k < 3; k++) locked[remap[triangle[k]]] = 1;
+                }
+            }
+        }
+        if (collapsed == 0) break;
+
+        // Apply, dropping triangles that collapsed to a line
+        size_t write = 0;
+        for (size_t i = 0; i < triangles.size(); i += 3) {
+            uint32_t a = vertexRemap[triangles[i]], b = vertexRemap[triangles[i + 1]], c = vertexRemap[triangles[i + 2]];
+            if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a]) continue;
+            triangles[write++] = a;
+            triangles[write++] = b;
+            triangles[write++] = c;
+        }
+        triangles.resize(write);
+    }
+
+    return triangles;
+}
+
+
+std::vector<uint32_t> simplifyMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices, size_t targetIndexCount, float& error) {
+    SimplifyMesh mesh(vertices, indices);
+    return mesh.simplify(targetIndexCount, error);
+}
+
+
+void buildLodChain(std::span<const Vertex> vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& levels, uint32_t maxLevels) {
+    std::vector<uint32_t> full(indices.begin() + levels[0].firstIndex, indices.begin() + levels[0].firstIndex + levels[0].indexCount);
+
+    // Every level starts over from the full mesh, so its error is measured against the original surface
+    SimplifyMesh base(vertices, full);
+    while (levels.size() < maxLevels) {
+        size_t target = levels.back().indexCount / 6 * 3;
+        if (target < MIN_LOD_TRIANGLES * 3) break;
+
+        SimplifyMesh mesh = base;
+        float error = 0.0f;
+        std::vector<uint32_t> level = mesh.simplify(target, error);
+        if (level.size() * 10 > size_t(levels.back().indexCount) * 9) break; // stalled, eg everything is seams
+
+        optimizeVertexCache(level, vertices.size());
+        levels.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(level.size()), (std::max)(error, levels.back().error) });
+        indices.insert(indices.end(), level.begin(), level.end());
+    }
+}
\ No newline at end of file
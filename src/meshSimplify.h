@@ -0,0 +1,17 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "vertex.h"
+
+
+// Quadric error edge collapse (Garland & Heckbert 1997). Every collapse moves a vertex onto one of its neighbours,
+// so the result only references existing vertices and can share the vertex buffer with the full mesh.
+// Texture seams, non-manifold edges and the corners of open borders never move; borders only slide along themselves.
+// Returns at most targetIndexCount indices unless the mesh runs out of legal collapses first. error gets the largest
+// collapse error in model space units, a rough bound on how far the result strays from the original surface.
+std::vector<uint32_t> simplifyMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices, size_t targetIndexCount, float& error);
+
+
+// Appends simplified copies of indices[0, levels[0].indexCount) to indices, each about half the previous one, and
+// their ranges to levels. levels must hold level 0 already. Stops early at maxLevels or once simplification stalls.
+void buildLodChain(std::span<const Vertex> vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& levels, uint32_t maxLevels = MAX_LODS);
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "meshlet.h"
+
+
+const uint32_t NOT_IN_MESHLET = UINT32_MAX;
+
+
+static void computeMeshletBounds(Meshlet& meshlet, const MeshletMesh& mesh, std::span<const Vertex> vertices) {
+    auto position = [&](uint32_t local) -> const glm::vec3& {
+        return vertices[mesh.vertices[meshlet.vertexOffset + local]].pos;
+    };
+
+    // Sphere around the box center. Not the tightest, but cheap and never too small
+    glm::vec3 boxMin(std::numeric_limits<float>::max());
+    glm::vec3 boxMax(std::numeric_limits<float>::lowest());
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+        boxMin = glm::min(boxMin, position(i));
+        boxMax = glm::max(boxMax, position(i));
+    }
+    glm::vec3 center = (boxMin + boxMax) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+        radius = (std::max)(radius, glm::length(position(i) - center));
+    }
+    meshlet.sphere = glm::vec4(center, radius);
+
+    // Normal cone: average facing, and how far the triangles stray from it
+    struct Face {
+        glm::vec3 normal;
+        glm::vec3 corner;
+    };
+    std::vector<Face> faces;
+    faces.reserve(meshlet.triangleCount);
+    glm::vec3 axis(0.0f);
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+        uint32_t packed = mesh.triangles[meshlet.triangleOffset + t];
+        const glm::vec3& p0 = position(packed & 0xFF);
+        const glm::vec3& p1 = position((packed >> 8) & 0xFF);
+        const glm::vec3& p2 = position((packed >> 16) & 0xFF);
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length <= 0.0f) continue; // degenerate, faces nowhere
+
+        faces.push_back({ normal / length, p0 });
+        axis += normal / length;
+    }
+
+    // Default cone can never pass the back-facing test, dot(anything, 0) < 1
+    meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    meshlet.coneApex = glm::vec4(center, 0.0f);
+
+    float axisLength = glm::length(axis);
+    if (faces.empty() || axisLength <= 0.0f) return;
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const auto& face : faces) minDot = (std::min)(minDot, glm::dot(axis, face.normal));
+    if (minDot <= 0.1f) return; // spread over more than ~85 degrees, the cone would almost never cull
+
+    // Apex far enough back along the axis that every triangle's plane is in front of it
+    float maxT = 0.0f;
+    for (const auto& face : faces) {
+        maxT = (std::max)(maxT, glm::dot(center - face.corner, face.normal) / glm::dot(axis, face.normal));
+    }
+
+    meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+    meshlet.coneApex = glm::vec4(center - axis * maxT, 0.0f);
+}
+
+
+MeshletMesh buildMeshlets(std::span<const Vertex> vertices, std::span<const uint32_t> indices, uint32_t maxVertices, uint32_t maxTriangles) {
+    MeshletMesh mesh;
+    std::vector<uint32_t> localIndex(vertices.size(), NOT_IN_MESHLET);
+
+    Meshlet current{};
+    auto flush = [&]() {
+        if (current.triangleCount == 0) return;
+        computeMeshletBounds(current, mesh, vertices);
+        for (uint32_t i = 0; i < current.vertexCount; i++) {
+            localIndex[mesh.vertices[current.vertexOffset + i]] = NOT_IN_MESHLET;
+        }
+        mesh.meshlets.push_back(current);
+
+        current = Meshlet{};
+        current.vertexOffset = static_cast<uint32_t>(mesh.vertices.size());
+        current.triangleOffset = static_cast<uint32_t>(mesh.triangles.size());
+    };
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        uint32_t newVertices = (localIndex[a] == NOT_IN_MESHLET) + (localIndex[b] == NOT_IN_MESHLET && b != a)
+            + (localIndex[c] == NOT_IN_MESHLET && c != a && c != b);
+
+        if (current.vertexCount + newVertices > maxVertices || current.triangleCount + 1 > maxTriangles) {
+            flush();
+        }
+
+        uint32_t packed = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[i + k];
+            if (localIndex[v] == NOT_IN_MESHLET) {
+                localIndex[v] = current.vertexCount++;
+                mesh.vertices.push_back(v);
+            }
+            packed |= localIndex[v] << (8 * k);
+        }
+        mesh.triangles.push_back(packed);
+        current.triangleCount++;
+    }
+    flush();
+
+    return mesh;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "vertex.h"
+
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124; // 124 * 3 local indices + padding stay within 512 bytes, what most mesh shader hardware likes
+
+
+// One cluster of triangles. std430 layout, shared with cull.comp, meshlet.task and meshlet.mesh
+struct Meshlet {
+    glm::vec4 sphere; // model space bounding sphere, xyz center and w radius
+    glm::vec4 cone; // xyz axis, w cutoff. Back-facing from the camera when dot(normalize(apex - camera), axis) >= cutoff
+    glm::vec4 coneApex; // xyz, w unused
+    uint32_t vertexOffset; // into MeshletMesh::vertices
+    uint32_t triangleOffset; // into MeshletMesh::triangles
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+static_assert(sizeof(Meshlet) == 64, "Meshlet must match the std430 struct in the shaders");
+
+
+struct MeshletMesh {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices; // meshlet-local index -> index into the vertex buffer
+    std::vector<uint32_t> triangles; // one per triangle, three 8-bit meshlet-local indices
+};
+
+// Greedily cuts the index buffer into meshlets in its current order, so run it after the vertex cache optimization
+MeshletMesh buildMeshlets(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+    uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
\ No newline at end of file
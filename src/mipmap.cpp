@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include "mipmap.h"
+#include "parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIPMAP_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MIPMAP_NEON
+#endif
+
+
+// One texel, RGBA as 4 floats, is exactly one SIMD register
+static inline void averageTexels(const float* a, const float* b, const float* c, const float* d, float* out) {
+#if defined(MIPMAP_SSE2)
+    __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)), _mm_add_ps(_mm_loadu_ps(c), _mm_loadu_ps(d)));
+    _mm_storeu_ps(out, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#elif defined(MIPMAP_NEON)
+    float32x4_t sum = vaddq_f32(vaddq_f32(vld1q_f32(a), vld1q_f32(b)), vaddq_f32(vld1q_f32(c), vld1q_f32(d)));
+    vst1q_f32(out, vmulq_n_f32(sum, 0.25f));
+#else
+    for (int i = 0; i < 4; i++) out[i] = (a[i] + b[i] + c[i] + d[i]) * 0.25f;
+#endif
+}
+
+
+// 8 bit to linear float, per channel (alpha never gets the sRGB curve)
+struct DecodeTable {
+    float values[4][256];
+};
+
+// Linear float to 8 bit through a 16 bit index, fine enough that the steep dark end of the sRGB curve still rounds right
+const uint32_t ENCODE_STEPS = 65535;
+
+struct EncodeTable {
+    uint8_t values[4][ENCODE_STEPS + 1];
+};
+
+
+static float srgbToLinear(float v) {
+    return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float v) {
+    return v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+}
+
+
+static void buildTables(bool srgb, DecodeTable& decode, EncodeTable& encode) {
+    for (int c = 0; c < 4; c++) {
+        bool curve = srgb && c < 3;
+        for (uint32_t i = 0; i < 256; i++) {
+            decode.values[c][i] = curve ? srgbToLinear(i / 255.0f) : i / 255.0f;
+        }
+        for (uint32_t i = 0; i <= ENCODE_STEPS; i++) {
+            float v = i / float(ENCODE_STEPS);
+            encode.values[c][i] = static_cast<uint8_t>((curve ? linearToSrgb(v) : v) * 255.0f + 0.5f);
+        }
+    }
+}
+
+
+static inline uint8_t encodeChannel(const EncodeTable& encode, int channel, float v) {
+    uint32_t index = static_cast<uint32_t>(std::clamp(v, 0.0f, 1.0f) * ENCODE_STEPS + 0.5f);
+    return encode.values[channel][index];
+}
+
+
+std::vector<std::vector<uint8_t>> buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb) {
+    uint32_t levelCount = static_cast<uint32_t>(std::floor(std::log2((std::max)(width, height)))) + 1;
+    std::vector<std::vector<uint8_t>> levels(levelCount);
+    levels[0].assign(rgba, rgba + size_t(width) * height * 4);
+    if (levelCount == 1) return levels;
+
+    // Big tables, built per call rather than kept around: a few ms against the seconds a large chain takes
+    auto decode = std::make_unique<DecodeTable>();
+    auto encode = std::make_unique<EncodeTable>();
+    buildTables(srgb, *decode, *encode);
+
+    // Each level is filtered from the float copy of the one above, so rounding to 8 bits never compounds down the chain.
+    // Level 0 is never converted as a whole, rows of it are decoded as they are needed
+    std::vector<float> previous;
+    uint32_t previousWidth = width, previousHeight = height;
+    for (uint32_t level = 1; level < levelCount; level++) {
+        uint32_t levelWidth = (std::max)(previousWidth / 2, 1u), levelHeight = (std::max)(previousHeight / 2, 1u);
+        std::vector<float> current(size_t(levelWidth) * levelHeight * 4);
+        levels[level].resize(size_t(levelWidth) * levelHeight * 4);
+
+        parallelFor(levelHeight, [&](size_t y) {
+            // Odd sizes repeat the last row/column, the same footprint a linear blit ends up with
+            uint32_t y0 = (std::min)(static_cast<uint32_t>(y) * 2, previousHeight - 1);
+            uint32_t y1 = (std::min)(static_cast<uint32_t>(y) * 2 + 1, previousHeight - 1);
+
+            const float* row0;
+            const float* row1;
+            std::vector<float> decoded;
+            if (level == 1) {
+                decoded.resize(size_t(previousWidth) * 4 * 2);
+                for (uint32_t x = 0; x < previousWidth * 4; x++) {
+                    decoded[x] = decode->values[x & 3][rgba[size_t(y0) * previousWidth * 4 + x]];
+                    decoded[previousWidth * 4 + x] = decode->values[x & 3][rgba[size_t(y1) * previousWidth * 4 + x]];
+                }
+                row0 = decoded.data();
+                row1 = decoded.data() + size_t(previousWidth) * 4;
+            }
+            else {
+                row0 = previous.data() + size_t(y0) * previousWidth * 4;
+                row1 = previous.data() + size_t(y1) * previousWidth * 4;
+            }
+
+            float* out = current.data() + y * levelWidth * 4;
+            uint8_t* bytes = levels[level].data() + y * levelWidth * 4;
+            for (uint32_t x = 0; x < levelWidth; x++) {
+                uint32_t x0 = (std::min)(x * 2, previousWidth - 1) * 4;
+                uint32_t x1 = (std::min)(x * 2 + 1, previousWidth - 1) * 4;
+                averageTexels(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out + x * 4);
+                for (int c = 0; c < 4; c++) bytes[x * 4 + c] = encodeChannel(*encode, c, out[x * 4 + c]);
+            }
+        });
+
+        previous = std::move(current);
+        previousWidth = levelWidth;
+        previousHeight = levelHeight;
+    }
+    return levels;
+}
\ No newline at end of file
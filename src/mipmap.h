@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+
+// Full mip chain of a tightly packed RGBA8 image down to 1x1, levels[0] being a copy of the input. Each level is a 2x2 box
+// filter of the one above, done in float with SIMD (SSE2 or NEON) on all cores. With srgb, RGB is averaged in linear light
+// and encoded back, which keeps bright/dark detail from going muddy the way averaging the stored values does. Alpha is always linear
+std::vector<std::vector<uint8_t>> buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb);
\ No newline at end of file
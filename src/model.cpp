@@ -1,17 +1,136 @@
+#include <cctype>
+#include <cstring>
 #include <unordered_map>
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
+#include <iostream>
+#include <limits>
 #include "model.h"
 #include "vertex.h"
+#include "glbLoader.h"
+#include "mesh.h"
+#include "meshCache.h"
+#include "meshOptimize.h"
+#include "meshSimplify.h"
+#include "objParser.h"
+#include "options.h"
+#include "profiling.h"
+
+// Define to load the model a second time through tinyobj and check the in-tree parser matches it exactly
+// #define VERIFY_OBJ_PARSER
+#ifdef VERIFY_OBJ_PARSER
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+#endif
+
+
+static GlbFile glbFile; // keeps the mapping alive for embeddedTexture
+
+std::span<const uint8_t> embeddedTexture;
+
+#ifdef VERIFY_OBJ_PARSER
+static void loadObj(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+static void verifyObjParser(const std::string& path, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+#endif
+static Bounds computeBounds(std::span<const Vertex> vertices);
+static void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+static void printLods();
+static void printResident(const char* when);
+static bool isGlb(const std::string& path);
 
 
 void Application::loadModel() {
+    auto start = Clock::now();
+    const std::string& modelPath = options.modelPath;
+    std::string cachePath = modelPath + ".meshcache";
+
+    // Mapping and parsing the JSON chunk is cheap, and the texture lives in there even when the mesh cache hits
+    bool glb = isGlb(modelPath);
+    if (glb) {
+        glbFile.open(modelPath);
+        embeddedTexture = glbFile.baseColorImage();
+    }
+
+    // If the texture cache needs rebuilding, its source decodes on a worker while the mesh loads
+    prefetchTexture();
+
+    // Only mapped, the upload reads it a chunk at a time
+    uint32_t cacheFlags = OPTIMIZE_OVERDRAW ? MESH_CACHE_OVERDRAW_ORDER : 0;
+    if (model.openCache(cachePath, modelPath, cacheFlags)) {
+        startupTimings.add("loadModel (mesh cache)", millisecondsSince(start));
+        printLods();
+        printResident("after loadModel");
+        return;
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    if (glb) {
+        GlbLoadStats stats;
+        loadGlb(glbFile, vertices, indices, &stats);
+        startupTimings.add("loadModel (GLB)", millisecondsSince(start));
+        std::cout << "GLB: " << stats.primitives << " primitives (" << stats.directCopies << " copied as is, "
+            << stats.skippedPrimitives << " skipped), " << vertices.size() << " vertices" << std::endl;
+    }
+    else {
+        ObjParseStats stats;
+        parseObj(modelPath, vertices, indices, &stats);
+        startupTimings.add("loadModel (OBJ)", millisecondsSince(start));
+        std::cout << "OBJ: " << stats.bytes / (1024.0 * 1024.0) << " MB in " << stats.chunks << " chunks, parse "
+            << stats.parseMilliseconds << " ms + weld " << stats.weldMilliseconds << " ms = "
+            << stats.megabytesPerSecond() << " MB/s" << std::endl;
+
+#ifdef VERIFY_OBJ_PARSER
+        verifyObjParser(modelPath, vertices, indices); // before optimizeMesh reorders everything
+#endif
+    }
+
+    auto optimizeStart = Clock::now();
+    optimizeMesh(vertices, indices);
+    startupTimings.add("optimizeMesh", millisecondsSince(optimizeStart));
+
+    // Coarser levels go after the full mesh in the same index buffer
+    auto lodStart = Clock::now();
+    std::vector<MeshLod> lods = { { 0, static_cast<uint32_t>(indices.size()), 0.0f } };
+    buildLodChain(vertices, indices, lods);
+    startupTimings.add("buildLodChain", millisecondsSince(lodStart));
+
+    model.bounds = computeBounds(vertices);
+    model.lods = std::move(lods);
+    model.assign(std::move(vertices), std::move(indices));
+    printLods();
+
+    // Next launch skips all of the above. This one swaps its arrays for the mapping too, so the upload streams from
+    // the file like every later launch and the arrays are gone before any staging memory exists
+    auto writeStart = Clock::now();
+    try {
+        writeMeshCache(cachePath, modelPath, model.vertices(), model.indices(), model.bounds, model.lods, cacheFlags);
+        model.openCache(cachePath, modelPath, cacheFlags); // if that fails the arrays just stay
+    }
+    catch (const std::exception& e) { // not fatal, eg read-only install dir
+        std::cerr << e.what() << std::endl;
+    }
+    startupTimings.add("writeMeshCache", millisecondsSince(writeStart));
+    printResident("after loadModel");
+}
+
+
+// Everything CPU side has a GPU copy by now
+void Application::releaseModel() {
+    model.release();
+    embeddedTexture = {};
+    glbFile.close();
+    printResident("after releaseModel");
+}
+
+
+#ifdef VERIFY_OBJ_PARSER
+// The old loader, kept as the reference for parseObj
+static void loadObj(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
     std::string warn, err;
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str())) {
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
         throw std::runtime_error(warn + err);
     }
 
@@ -43,4 +162,67 @@ void Application::loadModel() {
             indices.push_back(uniqueVertices[vertex]);
         }
     }
+}
+
+
+static void verifyObjParser(const std::string& path, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+    std::vector<Vertex> referenceVertices;
+    std::vector<uint32_t> referenceIndices;
+    loadObj(path, referenceVertices, referenceIndices);
+
+    bool same = referenceVertices.size() == vertices.size() && referenceIndices.size() == indices.size()
+        && memcmp(referenceVertices.data(), vertices.data(), vertices.size() * sizeof(Vertex)) == 0
+        && memcmp(referenceIndices.data(), indices.data(), indices.size() * sizeof(uint32_t)) == 0;
+    if (!same) {
+        throw std::runtime_error("OBJ parser output differs from tinyobj!");
+    }
+    std::cout << "OBJ parser matches tinyobj" << std::endl;
+}
+#endif
+
+
+// Triangle order for the post-transform cache (and optionally overdraw), then vertex order for fetch locality.
+// Only runs when building the mesh cache, the cache stores the result.
+static void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+
+    std::vector<uint32_t> clusters = optimizeVertexCache(indices, vertices.size());
+    if (OPTIMIZE_OVERDRAW) {
+        optimizeOverdraw(indices, vertices, clusters);
+    }
+    optimizeVertexFetch(vertices, indices);
+
+    VertexCacheStats after = analyzeVertexCache(indices, vertices.size());
+    std::cout << "Vertex cache (" << VERTEX_CACHE_SIZE << " entry FIFO): ACMR " << before.acmr << " -> " << after.acmr
+        << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+}
+
+
+static void printLods() {
+    for (size_t i = 0; i < model.lods.size(); i++) {
+        std::cout << "LOD " << i << ": " << model.lods[i].indexCount / 3 << " triangles, error " << model.lods[i].error << std::endl;
+    }
+}
+
+
+static void printResident(const char* when) {
+    std::cout << "Resident " << when << ": " << currentResidentBytes() / (1024 * 1024) << " MB, peak "
+        << peakResidentBytes() / (1024 * 1024) << " MB" << std::endl;
+}
+
+
+static Bounds computeBounds(std::span<const Vertex> vertices) {
+    Bounds bounds{ glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+    for (const auto& vertex : vertices) {
+        bounds.min = glm::min(bounds.min, vertex.pos);
+        bounds.max = glm::max(bounds.max, vertex.pos);
+    }
+    return bounds;
+}
+
+
+static bool isGlb(const std::string& path) {
+    std::string extension = path.substr((std::min)(path.size(), path.find_last_of('.')));
+    for (auto& c : extension) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    return extension == ".glb";
 }
\ No newline at end of file
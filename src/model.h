@@ -1,7 +1,10 @@
 #pragma once
-#include <string>
+#include <cstdint>
+#include <span>
 #include "application.h"
 
 
-const std::string MODEL_PATH = "../../models/viking_room.obj";
-const std::string TEXTURE_PATH = "../../textures/viking_room.png";
\ No newline at end of file
+const bool OPTIMIZE_OVERDRAW = true; // on top of the vertex cache order, costs a little ACMR
+
+// Base color image of a .glb, still PNG/JPEG encoded, pointing into the mapped file. Empty for OBJ models
+extern std::span<const uint8_t> embeddedTexture;
\ No newline at end of file
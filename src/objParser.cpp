@@ -0,0 +1,307 @@
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include "objParser.h"
+#include "mappedFile.h"
+#include "parallel.h"
+#include "profiling.h"
+#include "vertexWeld.h"
+
+
+const size_t MIN_CHUNK_BYTES = 256 * 1024; // below this, threads cost more than they save
+const uint32_t INVALID_INDEX = UINT32_MAX;
+
+
+struct ObjCorner {
+    uint32_t position; // already resolved to a global, 0-based index
+    uint32_t texcoord; // INVALID_INDEX if the face has no texcoords
+};
+
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+
+    // Pass 1: line counts, so every chunk knows where its definitions start before parsing
+    size_t positionCount = 0;
+    size_t texcoordCount = 0;
+    size_t faceCount = 0;
+    size_t positionBase = 0;
+    size_t texcoordBase = 0;
+
+    // Pass 2: faces as written, triangulated later once all positions exist
+    std::vector<ObjCorner> corners;
+    std::vector<uint16_t> faceSizes;
+    bool malformed = false;
+};
+
+
+enum class ObjLine { Other, Position, TexCoord, Face };
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) p++;
+    return p;
+}
+
+static const char* findLineEnd(const char* p, const char* end) {
+    const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+    return newline ? newline : end;
+}
+
+// Moves p past the keyword of the line
+static ObjLine classifyLine(const char*& p, const char* end) {
+    p = skipBlanks(p, end);
+    if (end - p < 2) return ObjLine::Other;
+
+    if (p[0] == 'v') {
+        if (isBlank(p[1])) {
+            p += 2;
+            return ObjLine::Position;
+        }
+        if (p[1] == 't' && end - p >= 3 && isBlank(p[2])) {
+            p += 3;
+            return ObjLine::TexCoord;
+        }
+    }
+    else if (p[0] == 'f' && isBlank(p[1])) {
+        p += 2;
+        return ObjLine::Face;
+    }
+    return ObjLine::Other;
+}
+
+
+static float parseFloat(const char*& p, const char* end) {
+    p = skipBlanks(p, end);
+    if (p < end && *p == '+') p++; // from_chars does not take a leading +
+
+    // Same as tinyobj: read as double, store as float. Keeps the output bit-identical to the old loader
+    double value = 0.0;
+    p = std::from_chars(p, end, value).ptr;
+    return static_cast<float>(value);
+}
+
+static bool parseIndex(const char*& p, const char* end, int64_t& value) {
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) return false;
+    p = result.ptr;
+    return true;
+}
+
+// OBJ indices are 1-based, negative ones count back from the most recent definition
+static uint32_t resolveIndex(int64_t index, size_t definedSoFar) {
+    int64_t resolved = index > 0 ? index - 1 : static_cast<int64_t>(definedSoFar) + index;
+    if (index == 0 || resolved < 0 || resolved >= INVALID_INDEX) return INVALID_INDEX;
+    return static_cast<uint32_t>(resolved);
+}
+
+
+static void countLines(ObjChunk& chunk) {
+    for (const char* p = chunk.begin; p < chunk.end; ) {
+        const char* lineEnd = findLineEnd(p, chunk.end);
+        switch (classifyLine(p, lineEnd)) {
+        case ObjLine::Position: chunk.positionCount++; break;
+        case ObjLine::TexCoord: chunk.texcoordCount++; break;
+        case ObjLine::Face: chunk.faceCount++; break;
+        default: break;
+        }
+        p = lineEnd + 1;
+    }
+}
+
+
+static void parseChunk(ObjChunk& chunk, glm::vec3* positions, glm::vec2* texcoords) {
+    chunk.corners.reserve(chunk.faceCount * 3);
+    chunk.faceSizes.reserve(chunk.faceCount);
+
+    size_t positionCount = chunk.positionBase;
+    size_t texcoordCount = chunk.texcoordBase;
+
+    for (const char* p = chunk.begin; p < chunk.end; ) {
+        const char* lineEnd = findLineEnd(p, chunk.end);
+
+        switch (classifyLine(p, lineEnd)) {
+        case ObjLine::Position: {
+            glm::vec3& position = positions[positionCount++];
+            position.x = parseFloat(p, lineEnd);
+            position.y = parseFloat(p, lineEnd);
+            position.z = parseFloat(p, lineEnd); // anything after (w, vertex colors) is ignored
+            break;
+        }
+        case ObjLine::TexCoord: {
+            glm::vec2& texcoord = texcoords[texcoordCount++];
+            texcoord.x = parseFloat(p, lineEnd);
+            texcoord.y = parseFloat(p, lineEnd);
+            break;
+        }
+        case ObjLine::Face: {
+            size_t faceSize = 0;
+            while (true) {
+                p = skipBlanks(p, lineEnd);
+                if (p >= lineEnd || *p == '\r' || *p == '#') break;
+
+                int64_t index;
+                if (!parseIndex(p, lineEnd, index)) {
+                    chunk.malformed = true;
+                    break;
+                }
+                ObjCorner corner{ resolveIndex(index, positionCount), INVALID_INDEX };
+
+                // v, v/vt, v//vn or v/vt/vn
+                if (p < lineEnd && *p == '/') {
+                    p++;
+                    if (p < lineEnd && *p != '/' && parseIndex(p, lineEnd, index)) {
+                        corner.texcoord = resolveIndex(index, texcoordCount);
+                    }
+                    if (p < lineEnd && *p == '/') {
+                        p++;
+                        parseIndex(p, lineEnd, index); // normals are not used
+                    }
+                }
+
+                chunk.corners.push_back(corner);
+                faceSize++;
+            }
+
+            if (faceSize < 3 || faceSize > UINT16_MAX) { // points, lines and garbage are dropped
+                chunk.corners.resize(chunk.corners.size() - faceSize);
+            }
+            else {
+                chunk.faceSizes.push_back(static_cast<uint16_t>(faceSize));
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+        p = lineEnd + 1;
+    }
+}
+
+
+// Writes three corners per triangle to out, false if a face points at a vertex that was never defined
+static bool triangulateChunk(const ObjChunk& chunk, const std::vector<glm::vec3>& positions, const std::vector<glm::vec2>& texcoords, ObjCorner* out) {
+    const ObjCorner* face = chunk.corners.data();
+    for (uint16_t faceSize : chunk.faceSizes) {
+        for (uint16_t i = 0; i < faceSize; i++) {
+            if (face[i].position >= positions.size() || (face[i].texcoord != INVALID_INDEX && face[i].texcoord >= texcoords.size())) {
+                return false;
+            }
+        }
+
+        auto emit = [&](int a, int b, int c) {
+            *out++ = face[a];
+            *out++ = face[b];
+            *out++ = face[c];
+        };
+
+        if (faceSize == 4) {
+            // Split along the shorter diagonal, same as tinyobj
+            glm::vec3 e02 = positions[face[2].position] - positions[face[0].position];
+            glm::vec3 e13 = positions[face[3].position] - positions[face[1].position];
+            if (glm::dot(e02, e02) < glm::dot(e13, e13)) {
+                emit(0, 1, 2);
+                emit(0, 2, 3);
+            }
+            else {
+                emit(0, 1, 3);
+                emit(1, 2, 3);
+            }
+        }
+        else {
+            for (int i = 1; i + 1 < faceSize; i++) { // fan; a plain triangle is a fan of one
+                emit(0, i, i + 1);
+            }
+        }
+
+        face += faceSize;
+    }
+    return true;
+}
+
+
+void parseObj(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, ObjParseStats* stats) {
+    auto start = Clock::now();
+
+    MappedFile file;
+    if (!file.open(path)) {
+        throw std::runtime_error("failed to open OBJ file: " + path);
+    }
+    const char* data = reinterpret_cast<const char*>(file.data());
+    const char* dataEnd = data + file.size();
+
+    // Line-aligned chunks. A few per thread, so one dense chunk does not hold everybody up
+    size_t chunkCount = (std::max)(size_t(1), (std::min)(file.size() / MIN_CHUNK_BYTES, size_t(workerCount()) * 4));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* chunkBegin = data;
+    for (size_t i = 0; i < chunkCount; i++) {
+        const char* chunkEnd = (i + 1 == chunkCount) ? dataEnd : data + file.size() * (i + 1) / chunkCount;
+        if (chunkEnd < chunkBegin) chunkEnd = chunkBegin;
+        if (chunkEnd < dataEnd) chunkEnd = findLineEnd(chunkEnd, dataEnd) + 1;
+        if (chunkEnd > dataEnd) chunkEnd = dataEnd;
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    parallelFor(chunkCount, [&](size_t i) { countLines(chunks[i]); });
+
+    size_t positionTotal = 0, texcoordTotal = 0;
+    for (auto& chunk : chunks) {
+        chunk.positionBase = positionTotal;
+        chunk.texcoordBase = texcoordTotal;
+        positionTotal += chunk.positionCount;
+        texcoordTotal += chunk.texcoordCount;
+    }
+
+    // Every chunk writes its own slice, no per-chunk copies to merge afterwards
+    std::vector<glm::vec3> positions(positionTotal);
+    std::vector<glm::vec2> texcoords(texcoordTotal);
+    parallelFor(chunkCount, [&](size_t i) { parseChunk(chunks[i], positions.data(), texcoords.data()); });
+
+    auto weldStart = Clock::now();
+
+    // Where each chunk's triangles go in the flat corner list
+    std::vector<size_t> triangleBase(chunkCount + 1, 0);
+    for (size_t i = 0; i < chunkCount; i++) {
+        if (chunks[i].malformed) {
+            throw std::runtime_error("malformed face in OBJ file: " + path);
+        }
+        size_t triangleCount = 0;
+        for (uint16_t faceSize : chunks[i].faceSizes) triangleCount += faceSize - 2;
+        triangleBase[i + 1] = triangleBase[i] + triangleCount;
+    }
+
+    std::vector<ObjCorner> triangles(triangleBase[chunkCount] * 3);
+    std::vector<char> badIndex(chunkCount, false);
+    parallelFor(chunkCount, [&](size_t i) {
+        badIndex[i] = !triangulateChunk(chunks[i], positions, texcoords, triangles.data() + triangleBase[i] * 3);
+    });
+    for (char bad : badIndex) {
+        if (bad) {
+            throw std::runtime_error("OBJ face references a vertex that does not exist: " + path);
+        }
+    }
+
+    auto corner = [&](size_t i) {
+        const ObjCorner& c = triangles[i];
+        Vertex vertex{};
+        vertex.pos = positions[c.position];
+        glm::vec2 texcoord = c.texcoord != INVALID_INDEX ? texcoords[c.texcoord] : glm::vec2(0.0f);
+        vertex.texCoord = { texcoord.x, 1.0f - texcoord.y };
+        vertex.color = { 1.0f, 1.0f, 1.0f };
+        return vertex;
+    };
+    weldParallel(triangles.size(), corner, vertices, indices);
+
+    if (stats) {
+        stats->bytes = file.size();
+        stats->chunks = chunkCount;
+        stats->parseMilliseconds = std::chrono::duration<double, std::milli>(weldStart - start).count();
+        stats->weldMilliseconds = millisecondsSince(weldStart);
+    }
+}
\ No newline at end of file
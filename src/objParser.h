@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "vertex.h"
+
+
+struct ObjParseStats {
+    size_t bytes = 0;
+    size_t chunks = 0;
+    double parseMilliseconds = 0.0; // parallel part: splitting, float and face parsing
+    double weldMilliseconds = 0.0; // triangulation and de-duplication, also parallel
+
+    double megabytesPerSecond() const {
+        double total = parseMilliseconds + weldMilliseconds;
+        return total > 0.0 ? (bytes / (1024.0 * 1024.0)) / (total / 1000.0) : 0.0;
+    }
+};
+
+
+// Streaming OBJ reader for positions, texcoords and faces (normals, groups and materials are skipped).
+// Maps the file, parses line-aligned chunks in parallel and welds vertices/indices in file order,
+// matching what tinyobj + the old unordered_map loop produced.
+void parseObj(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, ObjParseStats* stats = nullptr);
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include <stdexcept>
+#include <string>
+#include "options.h"
+
+
+Options options;
+
+
+void parseOptions(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--model" && i + 1 < argc) {
+            options.modelPath = argv[++i];
+        }
+        else if (arg == "--texture" && i + 1 < argc) {
+            options.texturePath = argv[++i];
+        }
+        else if (arg == "--texture-format" && i + 1 < argc) {
+            options.textureFormat = argv[++i];
+        }
+        else if (arg == "--no-texture-streaming") {
+            options.streamTextures = false;
+        }
+        else if (arg == "--blit-mipmaps") {
+            options.blitMipmaps = true;
+        }
+        else if (arg == "--mip-downsampler" && i + 1 < argc) {
+            options.mipDownsampler = argv[++i];
+            if (options.mipDownsampler != "compute" && options.mipDownsampler != "blit") {
+                throw std::runtime_error("unknown mip downsampler: " + options.mipDownsampler);
+            }
+        }
+        else if (arg == "--packed-vertices" || arg == "--packed") {
+            options.packedVertices = true;
+        }
+        else if (arg == "--no-cull") {
+            options.cullMeshlets = false;
+        }
+        else if (arg == "--mesh-shader") {
+            options.meshShader = true;
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            options.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--lod-error" && i + 1 < argc) {
+            options.lodErrorPixels = std::stof(argv[++i]);
+        }
+        else if (arg == "--lod" && i + 1 < argc) {
+            options.forcedLod = std::stoi(argv[++i]);
+        }
+        else if (arg == "--mesh-copies" && i + 1 < argc) {
+            options.meshCopies = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--separate-buffers") {
+            options.separateBuffers = true;
+        }
+        else if (arg == "--materials" && i + 1 < argc) {
+            options.materials = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--bindless") {
+            options.bindless = true;
+        }
+        else if (arg == "--camera-distance" && i + 1 < argc) {
+            options.cameraDistance = std::stof(argv[++i]);
+        }
+        else if (arg == "--camera-path") {
+            options.cameraPath = true;
+        }
+        else if (arg == "--virtual-texture" && i + 1 < argc) {
+            options.virtualTexturePages = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--material-textures" && i + 1 < argc) {
+            options.materialTextures = argv[++i];
+        }
+        else if (arg == "--no-texture-packing") {
+            options.packTextures = false;
+        }
+        else if (arg == "--staging-ring" && i + 1 < argc) {
+            options.stagingRingMegabytes = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--frame-arena" && i + 1 < argc) {
+            options.frameArenaKilobytes = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--memory-budget" && i + 1 < argc) {
+            options.memoryBudgetMegabytes = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--evict-fraction" && i + 1 < argc) {
+            options.evictFraction = std::stof(argv[++i]);
+        }
+        else if (arg == "--defrag" && i + 1 < argc) {
+            options.defragKilobytes = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--defrag-ms" && i + 1 < argc) {
+            options.defragMilliseconds = std::stof(argv[++i]);
+        }
+        else if (arg == "--memory-soak" && i + 1 < argc) {
+            options.memorySoak = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else {
+            throw std::runtime_error("unknown option: " + arg);
+        }
+    }
+}
\ No newline at end of file
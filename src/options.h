@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+
+// Command line switches, parsed once in main before the app starts
+struct Options {
+    std::string modelPath = "../../models/viking_room.obj"; // --model PATH: .obj or .glb
+    std::string texturePath = "../../textures/viking_room.png"; // --texture PATH: used when the model has no embedded texture. A .tif/.tiff is streamed in tiles, for images bigger than memory
+    std::string textureFormat = "bc7"; // --texture-format F: rgba8, bc1, bc7 (color) or bc4, bc5 (linear R / RG data), compressed once into a .ktx2 next to the source
+    bool streamTextures = true; // --no-texture-streaming: upload every mip level before the first frame instead of the small ones first
+    bool blitMipmaps = false; // --blit-mipmaps: with rgba8, build mips on the GPU on every launch instead of the cached CPU chain, see --mip-downsampler
+    std::string mipDownsampler = "compute"; // --mip-downsampler M: with --blit-mipmaps, compute (one dispatch for all the levels) or blit (vkCmdBlitImage level by level)
+    bool packedVertices = false; // --packed-vertices (or --packed): 12 byte quantized PackedVertex instead of the 32 byte Vertex
+    bool cullMeshlets = true; // --no-cull: draw the whole index buffer instead of the culled meshlets
+    bool meshShader = false; // --mesh-shader: cull and draw meshlets with VK_EXT_mesh_shader where supported
+    uint32_t frames = 0; // --frames N: quit after N frames, 0 runs until the window closes
+    float lodErrorPixels = 1.0f; // --lod-error P: coarsest LOD whose error projects to at most P pixels
+    int forcedLod = -1; // --lod N: always draw LOD N (clamped to the levels there are), -1 picks by distance
+    uint32_t meshCopies = 1; // --mesh-copies N: put the model in the geometry pool N times as separate meshes, all drawn (overlapping)
+    bool separateBuffers = false; // --separate-buffers: a vertex and index buffer per mesh, bound and drawn one at a time, instead of the pool
+    uint32_t materials = 1; // --materials N: split the meshes into N materials (all the same texture), a descriptor set each
+    bool bindless = false; // --bindless: materials' textures in one VK_EXT_descriptor_indexing table, picked per draw by index
+    float cameraDistance = 0.0f; // --camera-distance D: move the camera out along its view direction, 0 keeps the default
+    bool cameraPath = false; // --camera-path: scripted camera driven by the frame count (orbit, dolly in and out), the same views every run
+    std::string materialTextures; // --material-textures DIR: the materials sample the images in DIR (png, jpg, ...) instead of the model's texture, see --materials
+    bool packTextures = true; // --no-texture-packing: with --material-textures, an image, allocation, view and sampler per texture instead of arrays and atlases
+    uint32_t virtualTexturePages = 0; // --virtual-texture N: keep only the sampled pages of the texture, in a cache of N x N 128 texel pages. 0 keeps it all resident
+    uint32_t stagingRingMegabytes = 64; // --staging-ring MB: size of the persistently mapped buffer uploads go through. 0 makes a staging buffer per upload and waits for each
+    uint32_t frameArenaKilobytes = 1024; // --frame-arena KB: per frame in flight, the linear allocator the frame's uniforms and per-draw blocks are written into
+    uint32_t memoryBudgetMegabytes = 0; // --memory-budget MB: pretend each device-local heap has only MB to spend, to test eviction anywhere (lavapipe). 0 takes the driver's budget
+    float evictFraction = 0.9f; // --evict-fraction F: drop texture mips and mesh LODs, least recently used first, once a heap's usage passes F of its budget
+    uint32_t defragKilobytes = 4096; // --defrag KB: per frame, move at most this much out of the emptiest memory block into the others, so the block can be given back. 0 never moves anything
+    float defragMilliseconds = 1.0f; // --defrag-ms MS: a defragmentation step that took longer halves the bytes of the next, one well under doubles them again, up to --defrag
+    uint32_t memorySoak = 0; // --memory-soak N: keep N device-local buffers of random sizes alive, replace a sixteenth of them every frame, and print how fragmented the blocks are every 100 frames
+};
+
+extern Options options;
+
+void parseOptions(int argc, char** argv);
\ No newline at end of file
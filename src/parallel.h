@@ -0,0 +1,39 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+inline unsigned workerCount() {
+    return (std::max)(1u, std::thread::hardware_concurrency());
+}
+
+
+// Runs fn(i) for every i in [0, count) on up to workerCount() threads and waits for all of them.
+// Items are handed out one at a time, so uneven items still balance.
+template<typename Fn>
+void parallelFor(size_t count, Fn&& fn) {
+    size_t threadCount = (std::min)(count, static_cast<size_t>(workerCount()));
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next{ 0 };
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            fn(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (size_t t = 1; t < threadCount; t++) {
+        threads.emplace_back(worker);
+    }
+    worker(); // this thread helps too
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "application.h"
 #include "shader.h"
 #include "vertex.h"
+#include "options.h"
 
 void Application::createRenderPass() {
     // only 1 subpass now
@@ -87,8 +88,10 @@ void Application::createRenderPass() {
 
 
 void Application::createGraphicsPipeline() {
-    auto vertShaderCode = readFile("../../shaders/shader.vert.spv");
-    auto fragShaderCode = readFile("../../shaders/shader.frag.spv");
+    auto vertShaderCode = readFile(options.packedVertices ? "../../shaders/shader_packed.vert.spv" : "../../shaders/shader.vert.spv");
+    auto fragShaderCode = readFile(bindlessTextures ? "../../shaders/shader_bindless.frag.spv"
+        : virtualTexturing ? "../../shaders/shader_virtual.frag.spv" : materialTexturing ? "../../shaders/shader_atlas.frag.spv"
+        : "../../shaders/shader.frag.spv");
 
     // why local? these can be freed after pipeline is created (when SPIR-V bytecode is converted to machine code)
     VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
@@ -111,8 +114,18 @@ void Application::createGraphicsPipeline() {
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    VkVertexInputBindingDescription bindingDescription;
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+    if (options.packedVertices) {
+        bindingDescription = PackedVertex::getBindingDescription();
+        auto packedAttributes = PackedVertex::getAttributeDescriptions();
+        attributeDescriptions.assign(packedAttributes.begin(), packedAttributes.end());
+    }
+    else {
+        bindingDescription = Vertex::getBindingDescription();
+        auto attributes = Vertex::getAttributeDescriptions();
+        attributeDescriptions.assign(attributes.begin(), attributes.end());
+    }
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputInfo.vertexBindingDescriptionCount = 1;
     vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
@@ -219,8 +232,13 @@ void Application::createGraphicsPipeline() {
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = 1; // why multiple, when one layout can specify multiple bindings?
     pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional // push dynamic constants to shaders
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+    // Packed vertices need their dequantization constants
+    VkPushConstantRange dequantizeRange{};
+    dequantizeRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    dequantizeRange.offset = 0;
+    dequantizeRange.size = sizeof(DequantizeConstants);
+    pipelineLayoutInfo.pushConstantRangeCount = options.packedVertices ? 1 : 0; // push dynamic constants to shaders
+    pipelineLayoutInfo.pPushConstantRanges = options.packedVertices ? &dequantizeRange : nullptr;
 
     if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
@@ -267,6 +285,48 @@ void Application::createGraphicsPipeline() {
         throw std::runtime_error("failed to create graphics pipeline!");
     }
 
+    // Mesh shader pipeline: same fixed functions and fragment shader, task + mesh stages instead of vertex input
+    if (drawPath == DrawPath::MeshShader) {
+        VkShaderModule taskShaderModule = createShaderModule(readFile("../../shaders/meshlet.task.spv"));
+        VkShaderModule meshShaderModule = createShaderModule(readFile("../../shaders/meshlet.mesh.spv"));
+
+        VkPipelineShaderStageCreateInfo meshShaderStages[3] = { fragShaderStageInfo, fragShaderStageInfo, fragShaderStageInfo };
+        meshShaderStages[0].stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+        meshShaderStages[0].module = taskShaderModule;
+        meshShaderStages[1].stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+        meshShaderStages[1].module = meshShaderModule;
+
+        std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayout, meshletSetLayout }; // set 0 for the sampler
+        VkPushConstantRange meshletRange{};
+        meshletRange.stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT;
+        meshletRange.offset = 0;
+        meshletRange.size = 2 * sizeof(uint32_t); // first meshlet and count of the current LOD
+
+        VkPipelineLayoutCreateInfo meshLayoutInfo{};
+        meshLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        meshLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        meshLayoutInfo.pSetLayouts = setLayouts.data();
+        meshLayoutInfo.pushConstantRangeCount = 1;
+        meshLayoutInfo.pPushConstantRanges = &meshletRange;
+
+        if (vkCreatePipelineLayout(device, &meshLayoutInfo, nullptr, &meshPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create mesh pipeline layout!");
+        }
+
+        pipelineInfo.stageCount = 3;
+        pipelineInfo.pStages = meshShaderStages;
+        pipelineInfo.pVertexInputState = nullptr; // ignored with a mesh stage
+        pipelineInfo.pInputAssemblyState = nullptr;
+        pipelineInfo.layout = meshPipelineLayout;
+
+        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &meshPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create mesh pipeline!");
+        }
+
+        vkDestroyShaderModule(device, meshShaderModule, nullptr);
+        vkDestroyShaderModule(device, taskShaderModule, nullptr);
+    }
+
     // Cleanup shader module after pipeline created
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
@@ -0,0 +1,63 @@
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include "profiling.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+
+TimingReport startupTimings;
+
+
+void TimingReport::add(const std::string& name, double milliseconds) {
+    entries.emplace_back(name, milliseconds);
+}
+
+
+void TimingReport::print(const std::string& title) const {
+    std::cout << title << " timings:\n";
+    for (const auto& [name, milliseconds] : entries) {
+        std::cout << '\t' << std::left << std::setw(40) << name
+            << std::right << std::fixed << std::setprecision(2) << std::setw(10) << milliseconds << " ms\n";
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+
+size_t peakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss); // bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024; // kilobytes on Linux
+#endif
+#endif
+}
+
+
+size_t currentResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.WorkingSetSize;
+#else
+    std::ifstream statm("/proc/self/statm"); // pages: total, resident, ...
+    size_t totalPages = 0, residentPages = 0;
+    if (!(statm >> totalPages >> residentPages)) return 0;
+    return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+
+using Clock = std::chrono::high_resolution_clock;
+
+inline double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+// Collects named timings (eg startup phases) and prints them as one table
+class TimingReport {
+public:
+    void add(const std::string& name, double milliseconds);
+    void print(const std::string& title) const;
+
+private:
+    std::vector<std::pair<std::string, double>> entries;
+};
+
+extern TimingReport startupTimings;
+
+
+// High-water mark of this process's resident memory, in bytes
+size_t peakResidentBytes();
+
+// Resident memory right now, in bytes. 0 where the platform does not say (macOS)
+size_t currentResidentBytes();
\ No newline at end of file
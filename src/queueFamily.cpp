@@ -12,7 +12,9 @@ QueueFamilyIndices Application::findQueueFamilies(VkPhysicalDevice device) {
 
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) { // Implicitly supports VK_QUEUE_TRANSFER_BIT 
+        // Implicitly supports VK_QUEUE_TRANSFER_BIT. Compute too, for meshlet culling on the same queue
+        // (the spec guarantees a graphics device has at least one family with both)
+        if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
             indices.graphicsFamily = i;
         }
 
@@ -29,5 +31,17 @@ QueueFamilyIndices Application::findQueueFamilies(VkPhysicalDevice device) {
         i++;
     }
 
+    // No graphics or compute: usually a DMA engine that copies while the graphics queue renders
+    for (uint32_t family = 0; family < queueFamilyCount; family++) {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            indices.transferFamily = family;
+            break;
+        }
+    }
+    if (!indices.transferFamily) {
+        indices.transferFamily = indices.graphicsFamily;
+    }
+
     return indices;
 }
\ No newline at end of file
@@ -4,8 +4,9 @@
 
 
 struct QueueFamilyIndices {
-    std::optional<uint32_t> graphicsFamily; // Implicitly supports memory transfers
+    std::optional<uint32_t> graphicsFamily; // Implicitly supports memory transfers, also has compute
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily; // transfer only (a copy engine) where the device has one, else graphicsFamily
 
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include "application.h"
+#include "command.h"
+#include "mesh.h"
+
+
+static const char* const EVICTION_NAMES[] = { "texture mips", "material texture mips", "mesh LODs" };
+static const char* const CATEGORY_NAMES[] = { "textures", "geometry", "attachments", "uniforms", "staging", "other" };
+
+
+void Application::createResidency() {
+    heapBudgets.resize(memoryProperties.memoryHeapCount);
+    textureGroupLastUsed.assign(textureGroupImages.size(), 0);
+    lodLastUsed.assign(model.lods.size(), 0);
+}
+
+
+// Budget and usage of every heap. The driver's usage counts all of our blocks, also the free space in them that any new
+// allocation goes to first, so that is taken off. Without VK_EXT_memory_budget, or with --memory-budget, our own
+// vkAllocateMemory total is all there is to go by
+void Application::queryMemoryBudget() {
+    VkDeviceSize freeBytes[VK_MAX_MEMORY_HEAPS] = {};
+    VkDeviceSize allocatedBytes[VK_MAX_MEMORY_HEAPS];
+    {
+        std::lock_guard<std::mutex> lock(memoryMutex);
+        for (const std::unique_ptr<MemoryBlock>& block : memoryBlocks) {
+            if (block) freeBytes[memoryProperties.memoryTypes[block->memoryType].heapIndex] += block->heap.freeBytes();
+        }
+        std::copy(std::begin(memoryStats.heapBytes), std::end(memoryStats.heapBytes), allocatedBytes);
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    if (memoryBudgetSupported) {
+        VkPhysicalDeviceMemoryProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties.pNext = &budgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+    }
+
+    for (uint32_t i = 0; i < heapBudgets.size(); i++) {
+        const VkMemoryHeap& heap = memoryProperties.memoryHeaps[i];
+        HeapBudget& budget = heapBudgets[i];
+        bool simulated = options.memoryBudgetMegabytes > 0 && (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+        if (simulated) {
+            budget.budget = VkDeviceSize(options.memoryBudgetMegabytes) * 1024 * 1024;
+            budget.usage = allocatedBytes[i];
+        }
+        else if (memoryBudgetSupported) {
+            budget.budget = budgetProperties.heapBudget[i];
+            budget.usage = budgetProperties.heapUsage[i];
+        }
+        else {
+            budget.budget = heap.size;
+            budget.usage = allocatedBytes[i];
+        }
+        budget.usage -= (std::min)(budget.usage, freeBytes[i]);
+        residencyStats.peakUsage[i] = (std::max)(residencyStats.peakUsage[i], budget.usage);
+    }
+}
+
+
+// Once a frame, before it is recorded: note what it draws with, then give one thing back if a heap is over the line.
+// Evicting waits for the GPU, so it is one step a frame, the next frame sees the budget that is left
+void Application::updateResidency() {
+    uint64_t used = frameNumber + 1;
+    if (materialTexturing) {
+        for (uint32_t material : meshMaterials) {
+            textureGroupLastUsed[texturePacking.placements[materialTextureIndices[material]].group] = used;
+        }
+    }
+    else {
+        textureLastUsed = used;
+    }
+    lodLastUsed[(std::max)(currentLod, geometryFinestLod)] = used;
+
+    queryMemoryBudget();
+    for (uint32_t heap = 0; heap < heapBudgets.size(); heap++) {
+        const HeapBudget& budget = heapBudgets[heap];
+        if (budget.usage <= VkDeviceSize(options.evictFraction * budget.budget)) continue;
+        residencyStats.overBudgetFrames++;
+
+        auto start = Clock::now();
+        bool evicted = evictLeastRecentlyUsed(heap);
+        residencyStats.evictMilliseconds += millisecondsSince(start);
+        if (!evicted && !budgetExhausted) {
+            std::cout << "Memory heap " << heap << " over budget (" << budget.usage / (1024 * 1024) << " of "
+                << budget.budget / (1024 * 1024) << " MB) with nothing left to evict" << std::endl;
+            budgetExhausted = true;
+        }
+        return;
+    }
+}
+
+
+// Longest unused first, and of those whatever frees the most. Only what lives in the heap that is over
+bool Application::evictLeastRecentlyUsed(uint32_t heap) {
+    auto inHeap = [&](const DeviceAllocation& allocation) {
+        return memoryProperties.memoryTypes[allocation.memoryType].heapIndex == heap;
+    };
+
+    std::vector<EvictionCandidate> candidates;
+    if (!virtualTexturing && !streamingTexture && mipLevels > 1 && inHeap(textureImageMemory)) {
+        candidates.push_back({ EvictionKind::TextureMip, 0, textureLastUsed, textureImageMemory.size * 3 / 4 });
+    }
+    for (uint32_t i = 0; i < textureGroupImages.size(); i++) {
+        if (texturePacking.groups[i].mipLevels > 1 && inHeap(textureGroupImagesMemory[i])) {
+            candidates.push_back({ EvictionKind::TextureGroupMip, i, textureGroupLastUsed[i], textureGroupImagesMemory[i].size * 3 / 4 });
+        }
+    }
+    // The pool's index buffer holds every mesh at every LOD in ranges of the range allocator, only separate buffers shrink
+    if (options.separateBuffers && drawPath == DrawPath::Direct && geometryFinestLod + 1 < model.lods.size() && inHeap(meshIndexBuffersMemory[0])) {
+        VkDeviceSize indexStride = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        VkDeviceSize lodBytes = VkDeviceSize(model.lods[geometryFinestLod + 1].firstIndex - model.lods[geometryFinestLod].firstIndex) * indexStride;
+        candidates.push_back({ EvictionKind::MeshLod, 0, lodLastUsed[geometryFinestLod], lodBytes * meshIndexBuffers.size() });
+    }
+    if (candidates.empty()) return false;
+
+    const EvictionCandidate& victim = *std::min_element(candidates.begin(), candidates.end(), [](const EvictionCandidate& a, const EvictionCandidate& b) {
+        return a.lastUsed != b.lastUsed ? a.lastUsed < b.lastUsed : a.bytes > b.bytes;
+    });
+    switch (victim.kind) {
+    case EvictionKind::TextureMip: evictTextureMip(); break;
+    case EvictionKind::TextureGroupMip: evictTextureGroupMip(victim.index); break;
+    case EvictionKind::MeshLod: evictFinestLod(); break;
+    default: break;
+    }
+    residencyStats.evictions[uint32_t(victim.kind)]++;
+    return true;
+}
+
+
+// The image minus its finest level: half the size, a level less, every other level copied over as it is (BCn blocks
+// too). Waits for the queue, so once it returns no frame still reads the old image
+void Application::copyWithoutTopMip(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t levels, uint32_t layerCount,
+    VkImage& newImage, DeviceAllocation& newMemory) {
+    createImage((std::max)(width / 2, 1u), (std::max)(height / 2, 1u), levels - 1, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, newImage, newMemory, {}, 0, layerCount);
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    recordImageLevelsCopy(commandBuffer, image, newImage, width, height, levels, layerCount, 1);
+    endSingleTimeCommands(commandBuffer);
+}
+
+
+// Streaming is over by now, so the view covers every level and the retired ones are only waiting for their frames,
+// which the copy waited for
+void Application::evictTextureMip() {
+    VkImage image;
+    DeviceAllocation memory;
+    copyWithoutTopMip(textureImage, textureFormat, textureExtent.width, textureExtent.height, mipLevels, 1, image, memory);
+    residencyStats.evictedBytes += textureImageMemory.size - memory.size;
+
+    vkDestroyImageView(device, textureImageView, nullptr);
+    for (VkImageView view : retiredTextureViews) {
+        vkDestroyImageView(device, view, nullptr);
+    }
+    retiredTextureViews.clear();
+    vkDestroyImage(device, textureImage, nullptr);
+    freeMemory(textureImageMemory);
+
+    textureImage = image;
+    textureImageMemory = memory;
+    textureExtent = { (std::max)(textureExtent.width / 2, 1u), (std::max)(textureExtent.height / 2, 1u) };
+    mipLevels--;
+    textureViewUsage = 0; // the copy has no storage usage to narrow
+    createTextureImageView();
+    for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++) {
+        writeTextureDescriptors(frame);
+    }
+}
+
+
+// Layers keep their place and atlas entries their share of the page, so the region buffer stays as it is
+void Application::evictTextureGroupMip(uint32_t group) {
+    TextureGroup& textureGroup = texturePacking.groups[group];
+    VkImage image;
+    DeviceAllocation memory;
+    copyWithoutTopMip(textureGroupImages[group], VK_FORMAT_R8G8B8A8_SRGB, textureGroup.width, textureGroup.height, textureGroup.mipLevels,
+        textureGroup.layerCount, image, memory);
+    residencyStats.evictedBytes += textureGroupImagesMemory[group].size - memory.size;
+
+    vkDestroyImageView(device, textureGroupViews[group], nullptr);
+    vkDestroyImage(device, textureGroupImages[group], nullptr);
+    freeMemory(textureGroupImagesMemory[group]);
+
+    textureGroupImages[group] = image;
+    textureGroupImagesMemory[group] = memory;
+    textureGroup.width = (std::max)(textureGroup.width / 2, 1u);
+    textureGroup.height = (std::max)(textureGroup.height / 2, 1u);
+    textureGroup.mipLevels--;
+    createTextureGroupView(group);
+    for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++) {
+        writeTextureDescriptors(frame);
+    }
+}
+
+
+// LODs are back to back in every index buffer, finest first, so dropping one is a copy of the tail into a smaller
+// buffer. Draws then start at geometryFinestLod, see recordGeometryDraws
+void Application::evictFinestLod() {
+    VkDeviceSize indexStride = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    uint32_t firstIndex = model.lods[geometryFinestLod].firstIndex;
+    uint32_t nextIndex = model.lods[geometryFinestLod + 1].firstIndex;
+
+    std::vector<VkBuffer> buffers(meshIndexBuffers.size());
+    std::vector<DeviceAllocation> memory(meshIndexBuffers.size());
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    for (size_t i = 0; i < meshIndexBuffers.size(); i++) {
+        VkDeviceSize size = VkDeviceSize(meshRanges[i].indexCount - nextIndex) * indexStride;
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers[i], memory[i]);
+        VkBufferCopy region{ VkDeviceSize(nextIndex - firstIndex) * indexStride, 0, size };
+        vkCmdCopyBuffer(commandBuffer, meshIndexBuffers[i], buffers[i], 1, &region);
+    }
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    endSingleTimeCommands(commandBuffer); // no frame still reads the old buffers after this
+
+    for (size_t i = 0; i < meshIndexBuffers.size(); i++) {
+        residencyStats.evictedBytes += meshIndexBuffersMemory[i].size - memory[i].size;
+        vkDestroyBuffer(device, meshIndexBuffers[i], nullptr);
+        freeMemory(meshIndexBuffersMemory[i]);
+        meshIndexBuffers[i] = buffers[i];
+        meshIndexBuffersMemory[i] = memory[i];
+    }
+    geometryFinestLod++;
+}
+
+
+void Application::printResidencyStats() {
+    queryMemoryBudget();
+    std::cout << "Memory budget: " << (options.memoryBudgetMegabytes > 0 ? "simulated" : memoryBudgetSupported ? "VK_EXT_memory_budget" : "heap sizes")
+        << ", evicting past " << 100.0f * options.evictFraction << "%" << std::endl;
+    for (uint32_t i = 0; i < heapBudgets.size(); i++) {
+        if (residencyStats.peakUsage[i] == 0) continue;
+        std::cout << "  heap " << i << ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "") << ": "
+            << heapBudgets[i].usage / (1024.0 * 1024.0) << " of " << heapBudgets[i].budget / (1024 * 1024) << " MB, peak "
+            << residencyStats.peakUsage[i] / (1024.0 * 1024.0) << " MB. Ours:";
+        for (uint32_t category = 0; category < uint32_t(MemoryCategory::Count); category++) {
+            VkDeviceSize bytes = memoryStats.categoryBytes[i][category];
+            if (bytes > 0) std::cout << " " << CATEGORY_NAMES[category] << " " << bytes / (1024.0 * 1024.0) << " MB";
+        }
+        std::cout << std::endl;
+    }
+
+    std::cout << "Evicted " << residencyStats.evictedBytes / (1024.0 * 1024.0) << " MB in " << residencyStats.evictMilliseconds << " ms over "
+        << residencyStats.overBudgetFrames << " frames over budget:";
+    for (uint32_t kind = 0; kind < uint32_t(EvictionKind::Count); kind++) {
+        std::cout << " " << residencyStats.evictions[kind] << " " << EVICTION_NAMES[kind];
+    }
+    std::cout << std::endl;
+}
\ No newline at end of file
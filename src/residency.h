@@ -0,0 +1,36 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+
+// One memory heap as of this frame. usage leaves out what our own blocks hold free, the allocator hands that out
+// before it asks the driver for more
+struct HeapBudget {
+    VkDeviceSize budget = 0; // VK_EXT_memory_budget's, the heap's size without it, or --memory-budget
+    VkDeviceSize usage = 0; // the whole process's with the extension, only ours otherwise
+};
+
+
+// What can be given back when a heap is over budget, the finest level of it first and never the last level
+enum class EvictionKind : uint32_t {
+    TextureMip, // top mip of the main texture
+    TextureGroupMip, // top mip of a --material-textures array, index is the group
+    MeshLod, // finest LOD of every --separate-buffers index buffer
+    Count
+};
+
+
+struct EvictionCandidate {
+    EvictionKind kind;
+    uint32_t index;
+    uint64_t lastUsed; // frameNumber + 1 it was last drawn with, 0 for never
+    VkDeviceSize bytes; // roughly, what evicting it frees
+};
+
+
+struct ResidencyStats {
+    uint32_t evictions[uint32_t(EvictionKind::Count)] = {};
+    VkDeviceSize evictedBytes = 0;
+    uint64_t overBudgetFrames = 0;
+    double evictMilliseconds = 0.0;
+    VkDeviceSize peakUsage[VK_MAX_MEMORY_HEAPS] = {};
+};
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "application.h"
+#include "texture.h"
+
+
+// One persistently mapped buffer every upload goes through: a slice is a bump of the head, the GPU's copies out of it are
+// batched into one command buffer, and space comes back when the fence of the batch that read it signals
+void Application::createStagingRing() {
+    stagingRingSize = VkDeviceSize(options.stagingRingMegabytes) * 1024 * 1024;
+    if (stagingRingSize == 0) return;
+    createBuffer(stagingRingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        stagingRingBuffer, stagingRingMemory);
+}
+
+
+// Upload memory for size bytes. The copy out of it has to be recorded (stagingCommands) before the next slice is
+// reserved, which may submit the batch. Waits only when the ring is full of slices the GPU has not copied yet
+StagingSlice Application::reserveStaging(VkDeviceSize size, VkDeviceSize alignment) {
+    stagingStats.slices++;
+
+    // --staging-ring 0: a buffer per slice, created, copied from, waited for and destroyed, as uploads used to be
+    if (stagingRingSize == 0) {
+        submitStaging();
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            oneOffStagingBuffer, oneOffStagingMemory);
+        stagingCommands();
+        return { oneOffStagingBuffer, 0, static_cast<uint8_t*>(oneOffStagingMemory.mapped) };
+    }
+    if (size > stagingRingSize) {
+        throw std::runtime_error("failed to reserve staging memory, " + std::to_string(size) + " bytes is more than the staging ring holds!");
+    }
+
+    // A quarter of the ring per batch, so the GPU copies one while the next is written
+    if (stagingBatchBytes >= stagingRingSize / 4) {
+        submitStaging();
+    }
+    retireStaging(false);
+
+    for (;;) {
+        // In use is [tail, head), wrapping around the end, where head == tail means full
+        VkDeviceSize offset = (stagingRingHead + alignment - 1) / alignment * alignment;
+        bool fits = true;
+        if (!stagingRingInUse) {
+            offset = 0;
+        }
+        else if (stagingRingHead > stagingRingTail) {
+            if (offset + size > stagingRingSize) {
+                offset = 0; // the rest of the end is skipped
+                fits = size <= stagingRingTail;
+            }
+        }
+        else {
+            fits = offset + size <= stagingRingTail;
+        }
+
+        if (fits) {
+            stagingRingHead = offset + size;
+            stagingRingInUse = true;
+            stagingBatchBytes += size;
+            stagingCommands();
+            return { stagingRingBuffer, offset, static_cast<uint8_t*>(stagingRingMemory.mapped) + offset };
+        }
+
+        auto waitStart = Clock::now();
+        submitStaging();
+        retireStaging(true);
+        stagingStats.waits++;
+        stagingStats.waitMilliseconds += millisecondsSince(waitStart);
+    }
+}
+
+
+// The batch being recorded, begun if there is none
+VkCommandBuffer Application::stagingCommands() {
+    if (stagingBatch.commandBuffer != VK_NULL_HANDLE) {
+        return stagingBatch.commandBuffer;
+    }
+
+    if (!idleStagingSubmits.empty()) {
+        stagingBatch = idleStagingSubmits.back();
+        idleStagingSubmits.pop_back();
+        vkResetFences(device, 1, &stagingBatch.fence);
+    }
+    else {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &stagingBatch.commandBuffer) != VK_SUCCESS ||
+            vkCreateFence(device, &fenceInfo, nullptr, &stagingBatch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create staging command buffer!");
+        }
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(stagingBatch.commandBuffer, &beginInfo); // resets it, the pool allows that per command buffer
+    return stagingBatch.commandBuffer;
+}
+
+
+// Sends the batch off without waiting. Its copies are made visible to everything submitted after it on the queue, so
+// whoever uses the uploaded data only has to be submitted later
+void Application::submitStaging() {
+    if (stagingBatch.commandBuffer == VK_NULL_HANDLE) return;
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(stagingBatch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+        1, &barrier, 0, nullptr, 0, nullptr);
+    vkEndCommandBuffer(stagingBatch.commandBuffer);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &stagingBatch.commandBuffer;
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, stagingBatch.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit staging copies!");
+    }
+    stagingStats.submits++;
+
+    stagingBatch.end = stagingRingHead;
+    stagingSubmits.push_back(stagingBatch);
+    stagingBatch = StagingSubmit();
+    stagingBatchBytes = 0;
+
+    if (stagingRingSize == 0) {
+        retireStaging(true);
+        vkDestroyBuffer(device, oneOffStagingBuffer, nullptr);
+        freeMemory(oneOffStagingMemory);
+        oneOffStagingBuffer = VK_NULL_HANDLE;
+    }
+}
+
+
+// Gives the space of finished batches back, oldest first. wait: block on the oldest one if it is still going
+void Application::retireStaging(bool wait) {
+    while (!stagingSubmits.empty()) {
+        StagingSubmit& oldest = stagingSubmits.front();
+        if (wait) {
+            vkWaitForFences(device, 1, &oldest.fence, VK_TRUE, UINT64_MAX);
+            wait = false;
+        }
+        else if (vkGetFenceStatus(device, oldest.fence) != VK_SUCCESS) {
+            break;
+        }
+        stagingRingTail = oldest.end;
+        idleStagingSubmits.push_back(oldest);
+        stagingSubmits.pop_front();
+    }
+    if (stagingSubmits.empty() && stagingBatchBytes == 0) {
+        stagingRingInUse = false;
+        stagingRingHead = stagingRingTail = 0;
+    }
+}
+
+
+// Everything uploaded so far is on the GPU once this returns
+void Application::finishStaging() {
+    auto start = Clock::now();
+    submitStaging();
+    while (!stagingSubmits.empty()) {
+        retireStaging(true);
+    }
+    stagingStats.uploadMilliseconds += millisecondsSince(start);
+}
+
+
+// One level (or array layer) of an image in TRANSFER_DST_OPTIMAL, tightly packed texels or BCn blocks, in bands of whole
+// block rows of at most STAGING_CHUNK_SIZE
+void Application::uploadImage(VkImage image, VkFormat format, uint32_t mipLevel, uint32_t arrayLayer, uint32_t width, uint32_t height,
+    std::span<const uint8_t> data) {
+    auto start = Clock::now();
+    BlockFormat block;
+    bool srgb;
+    uint32_t blockSize = 1, bytesPerBlock = 4; // RGBA8 is the only uncompressed format here
+    if (blockFormatOf(format, block, srgb)) {
+        blockSize = 4;
+        bytesPerBlock = blockBytes(block);
+    }
+    else if (format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB) {
+        throw std::runtime_error("failed to upload image, unsupported format!");
+    }
+    VkDeviceSize rowBytes = VkDeviceSize((width + blockSize - 1) / blockSize) * bytesPerBlock;
+    uint32_t blockRows = (height + blockSize - 1) / blockSize;
+    if (data.size() < rowBytes * blockRows) {
+        throw std::runtime_error("failed to upload image, truncated data!");
+    }
+    uint32_t bandRows = static_cast<uint32_t>((std::max)(stagingChunkSize() / rowBytes, VkDeviceSize(1)));
+
+    for (uint32_t firstRow = 0; firstRow < blockRows; firstRow += bandRows) {
+        uint32_t rows = (std::min)(bandRows, blockRows - firstRow);
+        StagingSlice slice = reserveStaging(rows * rowBytes, 16);
+        memcpy(slice.data, data.data() + firstRow * rowBytes, static_cast<size_t>(rows * rowBytes));
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = slice.offset;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, arrayLayer, 1 };
+        region.imageOffset = { 0, static_cast<int32_t>(firstRow * blockSize), 0 };
+        region.imageExtent = { width, (std::min)(rows * blockSize, height - firstRow * blockSize), 1 };
+        vkCmdCopyBufferToImage(stagingCommands(), slice.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+    stagingStats.bytes += rowBytes * blockRows;
+    stagingStats.uploadMilliseconds += millisecondsSince(start);
+}
+
+
+VkDeviceSize Application::stagingChunkSize() {
+    return stagingRingSize > 0 ? (std::min)(STAGING_CHUNK_SIZE, stagingRingSize / 4) : STAGING_CHUNK_SIZE;
+}
+
+
+void Application::printStagingStats() {
+    double seconds = stagingStats.uploadMilliseconds / 1000.0;
+    std::cout << "Staging: ";
+    if (stagingRingSize > 0) std::cout << stagingRingSize / (1024 * 1024) << " MB ring, ";
+    else std::cout << "a buffer per upload, ";
+    std::cout << stagingStats.bytes / (1024.0 * 1024.0) << " MB uploaded in " << stagingStats.slices << " slices and "
+        << stagingStats.submits << " submits, " << stagingStats.waits << " waits for space (" << stagingStats.waitMilliseconds << " ms), "
+        << (seconds > 0.0 ? stagingStats.bytes / seconds / (1024.0 * 1024.0 * 1024.0) : 0.0) << " GB/s" << std::endl;
+}
+
+
+void Application::cleanupStagingRing() {
+    finishStaging();
+    for (const StagingSubmit& submit : idleStagingSubmits) {
+        vkFreeCommandBuffers(device, commandPool, 1, &submit.commandBuffer);
+        vkDestroyFence(device, submit.fence, nullptr);
+    }
+    idleStagingSubmits.clear();
+    if (stagingRingBuffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, stagingRingBuffer, nullptr);
+        freeMemory(stagingRingMemory);
+        stagingRingBuffer = VK_NULL_HANDLE;
+    }
+}
\ No newline at end of file
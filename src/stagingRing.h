@@ -0,0 +1,32 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+
+const VkDeviceSize STAGING_CHUNK_SIZE = 8 * 1024 * 1024; // the most one slice of an upload takes, so the next can be filled while it copies
+
+
+// Host visible memory to write an upload into, then copy out of with stagingCommands(). In the ring, or in a buffer of
+// its own with --staging-ring 0
+struct StagingSlice {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    uint8_t* data;
+};
+
+
+// A batch of copies on its way. Its slices end where the ring's head was when it was submitted
+struct StagingSubmit {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkDeviceSize end = 0;
+};
+
+
+struct StagingStats {
+    VkDeviceSize bytes = 0;
+    uint32_t slices = 0;
+    uint32_t submits = 0;
+    uint32_t waits = 0; // for the GPU to finish with ring space that was needed again
+    double waitMilliseconds = 0.0;
+    double uploadMilliseconds = 0.0; // in the upload calls, writing, recording, submitting and waiting. Plus the final drain
+};
\ No newline at end of file
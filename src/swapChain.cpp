@@ -129,11 +129,11 @@ SwapChainSupportDetails Application::querySwapChainSupport(VkPhysicalDevice devi
 void Application::cleanupSwapChain() {
     vkDestroyImageView(device, colorImageView, nullptr);
     vkDestroyImage(device, colorImage, nullptr);
-    vkFreeMemory(device, colorImageMemory, nullptr);
+    freeMemory(colorImageMemory);
 
     vkDestroyImageView(device, depthImageView, nullptr);
     vkDestroyImage(device, depthImage, nullptr);
-    vkFreeMemory(device, depthImageMemory, nullptr);
+    freeMemory(depthImageMemory);
 
     for (auto framebuffer : swapChainFramebuffers) {
         vkDestroyFramebuffer(device, framebuffer, nullptr);
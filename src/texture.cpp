@@ -1,55 +1,425 @@
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
 #include <stdexcept>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <iostream>
+#include <string>
 #include "application.h"
+#include "blockCompress.h"
+#include "ktx2.h"
+#include "mipmap.h"
+#include "meshCache.h"
 #include "model.h"
+#include "options.h"
 #include "depth.h"
+#include "imageDecoder.h"
+#include "queueFamily.h"
+#include "texture.h"
+#include "tiff.h"
+
+
+const uint32_t TEXTURE_CACHE_VERSION = 2; // 2: sRGB-correct mips. Bump when the encoder or the mip filter changes, so old .ktx2 caches get rebuilt
+const char* TEXTURE_CACHE_KEY = "VulkanTutorial.source"; // KTX2 key/value entry: source size, mtime and the version above
+
+struct TextureFormatChoice {
+    const char* name; // --texture-format value and cache file suffix
+    VkFormat format;
+    bool compressed;
+    BlockFormat block; // if compressed
+    bool srgb;
+};
+
+// Color textures are sRGB, BC4/BC5 hold linear data (roughness, normal XY) so they stay UNORM
+static const TextureFormatChoice TEXTURE_FORMATS[] = {
+    { "rgba8", VK_FORMAT_R8G8B8A8_SRGB, false, BlockFormat::BC7, true },
+    { "bc1", VK_FORMAT_BC1_RGB_SRGB_BLOCK, true, BlockFormat::BC1, true },
+    { "bc4", VK_FORMAT_BC4_UNORM_BLOCK, true, BlockFormat::BC4, false },
+    { "bc5", VK_FORMAT_BC5_UNORM_BLOCK, true, BlockFormat::BC5, false },
+    { "bc7", VK_FORMAT_BC7_SRGB_BLOCK, true, BlockFormat::BC7, true },
+};
+const TextureFormatChoice& UNCOMPRESSED_TEXTURE = TEXTURE_FORMATS[0];
+
+
+static const TextureFormatChoice& findTextureFormat(const std::string& name) {
+    for (const auto& choice : TEXTURE_FORMATS) {
+        if (name == choice.name) return choice;
+    }
+    throw std::runtime_error("unknown texture format: " + name);
+}
 
 
-void Application::createTextureImage() {
-    int texWidth, texHeight, texChannels;
+// Decided by prefetchTexture while the model loads, used up by createTextureImage
+struct TextureLoad {
+    const TextureFormatChoice* choice = nullptr;
+    bool blitMipmaps = false;
+    std::string sourcePath;
+    std::string cachePath;
+    std::unique_ptr<Ktx2File> ktx; // what gets uploaded, once it is open
+    std::unique_ptr<ImageDecoder> decoder; // decoding the source, when there is no usable .ktx2 yet
+    std::unique_ptr<TiffFile> tiff; // a .tif/.tiff texture, streamed a tile at a time instead
+};
+
+static TextureLoad textureLoad;
+
+
+static std::string sourceStampValue(const std::string& sourcePath) {
+    SourceStamp stamp;
+    if (!stampSource(sourcePath, stamp)) return {};
+    return std::to_string(stamp.size) + " " + std::to_string(stamp.mtime) + " " + std::to_string(TEXTURE_CACHE_VERSION);
+}
+
+
+// false if the cache is missing, stale or unreadable, which all mean encode it again
+static bool openTextureCache(Ktx2File& ktx, const TextureFormatChoice& choice, const std::string& cachePath, const std::string& sourcePath) {
+    std::string stamp = sourceStampValue(sourcePath);
+    try {
+        if (ktx.open(cachePath) && ktx.format() == choice.format && !stamp.empty() && ktx.value(TEXTURE_CACHE_KEY) == stamp) {
+            return true;
+        }
+    }
+    catch (const std::runtime_error&) {
+    }
+    ktx.close(); // unmap before it gets replaced
+    return false;
+}
+
+
+// Build the mip chain of the decoded source and compress every level (unless RGBA8)
+static std::vector<std::vector<uint8_t>> encodeTexture(const TextureFormatChoice& choice, const DecodedImage& image) {
+    auto mipStart = Clock::now();
+    std::vector<std::vector<uint8_t>> levels = buildMipChain(image.pixels.get(), image.width, image.height, choice.srgb);
+    startupTimings.add("buildMipChain (CPU)", millisecondsSince(mipStart));
 
-    // Read from file
-    stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
-    if (!pixels) {
+    for (uint32_t i = 0; choice.compressed && i < levels.size(); i++) {
+        uint32_t levelWidth = (std::max)(image.width >> i, 1u), levelHeight = (std::max)(image.height >> i, 1u);
+        std::vector<uint8_t> blocks(compressedSize(choice.block, levelWidth, levelHeight));
+        compressImage(choice.block, levels[i].data(), levelWidth, levelHeight, blocks.data());
+        levels[i] = std::move(blocks);
+    }
+    return levels;
+}
+
+
+// Write the encoded levels as one .ktx2 and map that. If it cannot be written or read back (read-only install dir, full
+// disk) this launch uploads them from memory, and the next one encodes again
+static void cacheTexture(Ktx2File& ktx, const TextureFormatChoice& choice, const DecodedImage& image,
+    std::vector<std::vector<uint8_t>> levels, const std::string& cachePath, const std::string& sourcePath) {
+    try {
+        writeKtx2(cachePath, choice.format, image.width, image.height, levels, {
+            { "KTXwriter", "VulkanTutorial" },
+            { TEXTURE_CACHE_KEY, sourceStampValue(sourcePath) }
+        });
+        if (!ktx.open(cachePath)) {
+            throw std::runtime_error("failed to open " + cachePath + "!");
+        }
+    }
+    catch (const std::exception& e) { // not fatal, same as the mesh cache
+        std::cerr << e.what() << std::endl;
+        ktx.assign(choice.format, image.width, image.height, std::move(levels));
+    }
+}
+
+
+// Waits for the source decode prefetchTexture started
+static DecodedImage takeDecodedTexture() {
+    auto start = Clock::now();
+    DecodedImage image;
+    textureLoad.decoder->next(image);
+    textureLoad.decoder.reset();
+    startupTimings.add("decode texture (wait)", millisecondsSince(start));
+    if (!image.pixels) {
         throw std::runtime_error("failed to load texture image!");
     }
+    return image;
+}
+
+
+uint32_t streamingTailStart(const Ktx2File& ktx) {
+    uint32_t level = 0;
+    while (level + 1 < ktx.levelCount() && (ktx.level(level).width > STREAMING_TAIL_SIZE || ktx.level(level).height > STREAMING_TAIL_SIZE)) {
+        level++;
+    }
+    return level;
+}
 
+
+VkDeviceSize stagedLevelSize(const Ktx2Level& level, bool decode) {
+    return decode ? VkDeviceSize(level.width) * level.height * 4 : level.data.size();
+}
+
+
+void stageLevel(const Ktx2Level& level, VkFormat format, bool decode, uint8_t* destination) {
+    BlockFormat block;
+    bool srgb;
+    if (!decode || !blockFormatOf(format, block, srgb)) {
+        memcpy(destination, level.data.data(), level.data.size());
+        return;
+    }
+    if (level.data.size() < compressedSize(block, level.width, level.height)) {
+        throw std::runtime_error("failed to load texture image, truncated KTX2 level!");
+    }
+    decompressImage(block, level.data.data(), level.width, level.height, destination);
+}
+
+
+// Runs from loadModel, once a .glb has given up its texture. Picks the format and opens the cache, and when the source has to be
+// decoded after all, starts that on a worker so it overlaps with loading the mesh
+void Application::prefetchTexture() {
+    TextureLoad& load = textureLoad;
+    load.choice = &findTextureFormat(options.textureFormat);
+    if (load.choice->compressed && !isTextureFormatSupported(load.choice->format)) {
+        std::cout << load.choice->name << " textures not supported by the device, using RGBA8" << std::endl;
+        load.choice = &UNCOMPRESSED_TEXTURE;
+    }
+    load.blitMipmaps = !load.choice->compressed && options.blitMipmaps && isTextureFormatSupported(UNCOMPRESSED_TEXTURE.format);
+
+    // A .tif/.tiff may not fit in memory, it gets neither decoded whole nor cached, only read a tile at a time later
+    if (embeddedTexture.empty() && isTiffPath(options.texturePath)) {
+        load.tiff = std::make_unique<TiffFile>();
+        if (!load.tiff->open(options.texturePath)) {
+            throw std::runtime_error("failed to load texture image!");
+        }
+        return;
+    }
+
+    // A .ktx2 given as the texture is used as is, whatever --texture-format says
+    load.ktx = std::make_unique<Ktx2File>();
+    if (embeddedTexture.empty() && options.texturePath.ends_with(".ktx2")) {
+        if (!load.ktx->open(options.texturePath)) {
+            throw std::runtime_error("failed to load texture image!");
+        }
+        return;
+    }
+
+    // Mips (and blocks) built once, cached next to whatever the image came from
+    load.sourcePath = embeddedTexture.empty() ? options.texturePath : options.modelPath;
+    load.cachePath = load.sourcePath + "." + load.choice->name + ".ktx2";
+    if (!load.blitMipmaps && openTextureCache(*load.ktx, *load.choice, load.cachePath, load.sourcePath)) {
+        return;
+    }
+
+    // Blitting uploads the decoded image as is, so it goes straight into the staging buffer
+    ImageDestination destination;
+    if (load.blitMipmaps) {
+        destination = [this](uint32_t width, uint32_t height) { return reserveTextureStaging(VkDeviceSize(width) * height * 4); };
+    }
+
+    load.decoder = std::make_unique<ImageDecoder>(1);
+    if (embeddedTexture.empty()) {
+        load.decoder->add(options.texturePath, destination);
+    }
+    else {
+        load.decoder->add(embeddedTexture, options.modelPath, destination); // the mapping stays open until releaseModel
+    }
+}
+
+
+void Application::createTextureImage() {
+    auto start = Clock::now();
+    TextureLoad& load = textureLoad;
+    if (load.decoder && !load.blitMipmaps) {
+        DecodedImage image = takeDecodedTexture();
+        auto encodeStart = Clock::now();
+        std::vector<std::vector<uint8_t>> levels = encodeTexture(*load.choice, image);
+        startupTimings.add(std::string("createTextureImage (") + load.choice->name + " encode)", millisecondsSince(encodeStart));
+        cacheTexture(*load.ktx, *load.choice, image, std::move(levels), load.cachePath, load.sourcePath);
+    }
+
+    // Streamed: only the small mip tail now, the rest arrives in the background while frames are drawn. Virtual: only the
+    // tail too, and then just the pages the frames sample
+    auto uploadStart = Clock::now();
+    if (load.tiff) {
+        createTextureImageTiled(*load.tiff);
+    }
+    else if (load.ktx->levelCount() > 0 && virtualTexturing) {
+        createVirtualTexture(std::move(load.ktx));
+    }
+    else if (load.ktx->levelCount() > 0) {
+        uint32_t firstLevel = options.streamTextures ? streamingTailStart(*load.ktx) : 0;
+        uploadKtx2(*load.ktx, firstLevel);
+        if (firstLevel > 0) {
+            startTextureStreaming(std::move(load.ktx));
+        }
+    }
+    else {
+        createTextureImageRgba8(takeDecodedTexture());
+    }
+    load = TextureLoad();
+
+    double uploadMilliseconds = millisecondsSince(uploadStart);
+    residentLevelFrames.assign(mipLevels, 0);
+    startupTimings.add("createTextureImage", millisecondsSince(start));
+    printTextureMemory(uploadMilliseconds);
+}
+
+
+// Levels [firstLevel, levelCount) of the file through the staging ring, a copy per slice. The image gets the
+// whole chain, the finer levels stay undefined until streamed. BCn the device cannot sample is decoded to RGBA8 first
+void Application::uploadKtx2(const Ktx2File& ktx, uint32_t firstLevel) {
+    textureFormat = ktx.format();
+    textureExtent = { ktx.width(), ktx.height() };
+    mipLevels = ktx.levelCount();
+    textureResidentLevel = firstLevel;
+
+    BlockFormat block;
+    bool srgb;
+    textureDecodeToRgba8 = blockFormatOf(textureFormat, block, srgb) && !isTextureFormatSupported(textureFormat);
+    if (textureDecodeToRgba8) {
+        std::cout << "compressed texture not supported by the device, decoding to RGBA8" << std::endl;
+    }
+    VkFormat imageFormat = textureDecodeToRgba8 ? (srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM) : textureFormat;
+
+    // The transfer queue writes the streamed levels while the graphics queue samples the others. Concurrent sharing saves
+    // the ownership transfers, which would need the graphics queue to take part in every copy
+    QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+    std::vector<uint32_t> queueFamilies = { indices.graphicsFamily.value() };
+    if (firstLevel > 0 && indices.transferFamily != indices.graphicsFamily) {
+        queueFamilies.push_back(indices.transferFamily.value());
+    }
+
+    textureFormat = imageFormat;
+    createImage(ktx.width(), ktx.height(), mipLevels, VK_SAMPLE_COUNT_1_BIT, textureFormat, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, // source of evictTextureMip
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory, queueFamilies);
+    uint32_t levelCount = mipLevels - firstLevel;
+    transitionImageLayout(textureImage, textureFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, firstLevel);
+
+    // Straight from the mapped file into the staging ring, a decoded level through memory of its own first
+    std::vector<uint8_t> decoded;
+    for (uint32_t i = firstLevel; i < mipLevels; i++) {
+        const Ktx2Level& level = ktx.level(i);
+        std::span<const uint8_t> data = level.data;
+        if (textureDecodeToRgba8) {
+            decoded.resize(static_cast<size_t>(stagedLevelSize(level, true)));
+            stageLevel(level, ktx.format(), true, decoded.data());
+            data = decoded;
+        }
+        uploadImage(textureImage, textureFormat, i, 0, level.width, level.height, data);
+    }
+    transitionImageLayout(textureImage, textureFormat, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levelCount, firstLevel);
+}
+
+
+// The mapped staging buffer every texture upload goes through, recreated only when a bigger one is needed. Also called from
+// the decode worker, which writes the image straight into it. Decoders read back what they wrote (PNG unfiltering reads the
+// row above), so cached memory is preferred over the usual write-combined kind
+uint8_t* Application::reserveTextureStaging(VkDeviceSize size) {
+    if (size <= textureStagingSize) {
+        return textureStagingData;
+    }
+
+    releaseTextureStaging();
+    try {
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+            textureStagingBuffer, textureStagingBufferMemory);
+    }
+    catch (const std::runtime_error&) {
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            textureStagingBuffer, textureStagingBufferMemory);
+    }
+    textureStagingData = static_cast<uint8_t*>(textureStagingBufferMemory.mapped);
+    textureStagingSize = size;
+    return textureStagingData;
+}
+
+
+void Application::releaseTextureStaging() {
+    if (textureStagingBuffer == VK_NULL_HANDLE) return;
+    vkDestroyBuffer(device, textureStagingBuffer, nullptr);
+    freeMemory(textureStagingBufferMemory);
+    textureStagingBuffer = VK_NULL_HANDLE;
+    textureStagingData = nullptr;
+    textureStagingSize = 0;
+}
+
+
+bool Application::isTextureFormatSupported(VkFormat format) {
+    try {
+        findSupportedFormat({ format }, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+        return true;
+    }
+    catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+
+// What the texture actually takes on the device, next to what the same mip chain would as RGBA8
+void Application::printTextureMemory(double uploadMilliseconds) {
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, textureImage, &memRequirements);
+
+    VkDeviceSize rgba8Size = 0;
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        rgba8Size += VkDeviceSize((std::max)(textureExtent.width >> i, 1u)) * (std::max)(textureExtent.height >> i, 1u) * 4;
+    }
+
+    const char* formatName = textureFormat == VK_FORMAT_R8G8B8A8_UNORM ? "rgba8 (decoded)" : "other format";
+    for (const auto& choice : TEXTURE_FORMATS) {
+        if (choice.format == textureFormat) formatName = choice.name;
+    }
+    std::cout << "Texture: " << textureExtent.width << "x" << textureExtent.height << " " << formatName << ", " << mipLevels << " levels, "
+        << memRequirements.size / (1024.0 * 1024.0) << " MB on the device (" << rgba8Size / (1024.0 * 1024.0) << " MB as RGBA8), upload "
+        << uploadMilliseconds << " ms, peak resident " << peakResidentBytes() / (1024 * 1024) << " MB" << std::endl;
+}
+
+
+// --blit-mipmaps: decode to RGBA8, upload the base level and blit the mips on the GPU, every launch
+void Application::createTextureImageRgba8(const DecodedImage& image) {
+    int texWidth = static_cast<int>(image.width), texHeight = static_cast<int>(image.height);
+    VkDeviceSize imageSize = VkDeviceSize(texWidth) * texHeight * 4;
+
+    textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    textureExtent = { static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight) };
     mipLevels = static_cast<uint32_t>(std::floor(std::log2((std::max)(texWidth, texHeight)))) + 1;
 
-    // Create & Copy to buffer
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingBufferMemory);
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    stbi_image_free(pixels);
-
-    // Create & Copy to image
-    createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+    // Normally the decoder wrote it into staging already. The copy is the fallback, eg for a format stb decodes unusually
+    if (image.pixels.get() != textureStagingData) {
+        memcpy(reserveTextureStaging(imageSize), image.pixels.get(), static_cast<size_t>(imageSize));
+    }
+    std::cout << "Texture decoded " << (image.pixels.get() == textureStagingData && !image.copied ? "straight into" : "and copied to")
+        << " staging, " << imageSize / (1024.0 * 1024.0) << " MB" << std::endl;
+
+    // The compute downsampler also covers a device that cannot blit the format
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_SRGB, &formatProperties);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    bool blitSupported = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+    bool computeMips = isComputeDownsampleSupported() && (options.mipDownsampler == "compute" || !blitSupported);
+    if (!computeMips && !blitSupported) {
+        throw std::runtime_error("failed to find a way to generate mipmaps!");
+    }
+    if (computeMips != (options.mipDownsampler == "compute")) {
+        std::cout << options.mipDownsampler << " mip downsampler not supported by the device, using " << (computeMips ? "compute" : "blit") << std::endl;
+    }
+
+    // Create & Copy to image. The compute path writes the sRGB levels through UNORM storage views, which the sampled view must not inherit
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT; // source of blits and evictTextureMip
+    if (computeMips) usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    VkImageCreateFlags flags = computeMips ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT : 0;
+    textureViewUsage = computeMips ? VK_IMAGE_USAGE_SAMPLED_BIT : 0;
+    createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory, {}, flags);
     transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-    copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+    copyBufferToImage(textureStagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
 
     // Generate mips
-    generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    auto mipStart = Clock::now();
+    if (computeMips) {
+        generateMipmapsCompute(textureImage, texWidth, texHeight, mipLevels, true);
+        startupTimings.add("generateMipmaps (compute)", millisecondsSince(mipStart));
+    }
+    else {
+        generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
+        startupTimings.add("generateMipmaps (blit)", millisecondsSince(mipStart));
+    }
 }
 
 
 void Application::createTextureImageView() {
-    textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+    textureImageView = createImageView(textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels - textureResidentLevel, textureResidentLevel, textureViewUsage);
 }
 
 
@@ -83,6 +453,17 @@ void Application::createTextureSampler() {
     if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
     }
+
+    // The rest of the bindless sampler table
+    if (bindlessTextures) {
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        if (vkCreateSampler(device, &samplerInfo, nullptr, &nearestSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create nearest sampler!");
+        }
+    }
 }
 
 
@@ -91,13 +472,18 @@ void Application::generateMipmaps(VkImage image, VkFormat format, int32_t texWid
     VkFormatProperties formatProperties;
     vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
     if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-        // could do mip-mapping in software (see stb_image_resize) and load into image OR find a format that does support linear blitting.
-        // usually mip-maps are generated beforehand, rarely in runtime.
+        // createTextureImage checks first and builds the chain on the CPU instead (mipmap.h), this is only a guard
         throw std::runtime_error("texture image format does not support linear blitting!");
     }
 
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    recordMipmapBlits(commandBuffer, image, texWidth, texHeight, mipLevels);
+    endSingleTimeCommands(commandBuffer);
+}
 
+
+// Every layer's levels from its level 0, which is in TRANSFER_DST like the rest. Leaves them all SHADER_READ_ONLY
+void Application::recordMipmapBlits(VkCommandBuffer commandBuffer, VkImage image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels, uint32_t layerCount) {
     // Reuse this barrier for image memory layout transition.
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -106,7 +492,7 @@ void Application::generateMipmaps(VkImage image, VkFormat format, int32_t texWid
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.layerCount = layerCount;
     barrier.subresourceRange.levelCount = 1;
 
     int32_t mipWidth = texWidth;
@@ -133,14 +519,14 @@ void Application::generateMipmaps(VkImage image, VkFormat format, int32_t texWid
         blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         blit.srcSubresource.mipLevel = i - 1;
         blit.srcSubresource.baseArrayLayer = 0;
-        blit.srcSubresource.layerCount = 1;
+        blit.srcSubresource.layerCount = layerCount;
 
         blit.dstOffsets[0] = { 0, 0, 0 };
         blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
         blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         blit.dstSubresource.mipLevel = i;
         blit.dstSubresource.baseArrayLayer = 0;
-        blit.dstSubresource.layerCount = 1;
+        blit.dstSubresource.layerCount = layerCount;
 
         vkCmdBlitImage(commandBuffer,
             image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
@@ -176,6 +562,4 @@ void Application::generateMipmaps(VkImage image, VkFormat format, int32_t texWid
         0, nullptr,
         0, nullptr,
         1, &barrier);
-
-    endSingleTimeCommands(commandBuffer);
 }
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include "application.h"
+#include "blockCompress.h"
+
+
+// Levels with both sides at most this are uploaded before the first frame, the finer ones stream in behind it
+const uint32_t STREAMING_TAIL_SIZE = 64;
+
+// First level of the tail, 0 if the whole texture is that small
+uint32_t streamingTailStart(const Ktx2File& ktx);
+
+// Bytes one level takes in staging: as stored, or RGBA8 when decoded
+VkDeviceSize stagedLevelSize(const Ktx2Level& level, bool decode);
+
+// Copies one level into staging memory, or decodes it to RGBA8 when the device cannot sample the file's BCn format
+void stageLevel(const Ktx2Level& level, VkFormat format, bool decode, uint8_t* destination);
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include "texturePacker.h"
+
+
+static uint32_t fullMipLevels(uint32_t width, uint32_t height) {
+    return static_cast<uint32_t>(std::floor(std::log2((std::max)(width, height)))) + 1;
+}
+
+
+static uint32_t alignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+
+// Entry plus gutter on both sides, always a multiple of the gutter
+static uint32_t paddedSize(uint32_t size) {
+    return alignUp(size, ATLAS_GUTTER) + 2 * ATLAS_GUTTER;
+}
+
+
+TexturePacking packTextures(const std::vector<TextureSize>& sizes, uint32_t maxLayers, bool pack) {
+    TexturePacking packing;
+    packing.placements.resize(sizes.size());
+    maxLayers = (std::max)(maxLayers, 1u);
+
+    if (!pack) {
+        for (uint32_t i = 0; i < sizes.size(); i++) {
+            packing.placements[i] = { i, 0, 0, 0, sizes[i].width, sizes[i].height };
+            packing.groups.push_back({ sizes[i].width, sizes[i].height, 1, fullMipLevels(sizes[i].width, sizes[i].height), false });
+        }
+        return packing;
+    }
+
+    // Same size, same array. std::map so the groups come out in the same order every run
+    std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t>> bySize;
+    for (uint32_t i = 0; i < sizes.size(); i++) {
+        bySize[{ sizes[i].width, sizes[i].height }].push_back(i);
+    }
+
+    std::vector<uint32_t> atlasEntries;
+    for (const auto& [size, textures] : bySize) {
+        auto [width, height] = size;
+        if (textures.size() < ARRAY_MIN_LAYERS && (std::max)(width, height) <= ATLAS_MAX_TEXTURE) {
+            atlasEntries.insert(atlasEntries.end(), textures.begin(), textures.end());
+            continue;
+        }
+        for (uint32_t i = 0; i < textures.size(); i++) {
+            if (i % maxLayers == 0) {
+                uint32_t layers = (std::min)(maxLayers, static_cast<uint32_t>(textures.size()) - i);
+                packing.groups.push_back({ width, height, layers, fullMipLevels(width, height), false });
+            }
+            packing.placements[textures[i]] = { static_cast<uint32_t>(packing.groups.size() - 1), i % maxLayers, 0, 0, width, height };
+        }
+    }
+    if (atlasEntries.empty()) return packing;
+
+    // Pages big enough for everything with some slack for the shelves, as long as that stays under the maximum. A power
+    // of two keeps the page's own mips exact
+    uint64_t area = 0;
+    uint32_t largest = 0;
+    for (uint32_t texture : atlasEntries) {
+        area += uint64_t(paddedSize(sizes[texture].width)) * paddedSize(sizes[texture].height);
+        largest = (std::max)({ largest, paddedSize(sizes[texture].width), paddedSize(sizes[texture].height) });
+    }
+    uint32_t pageSize = 1;
+    while (pageSize < largest) pageSize *= 2;
+    while (pageSize < ATLAS_MAX_PAGE_SIZE && uint64_t(pageSize) * pageSize < area * 5 / 4) pageSize *= 2;
+
+    // Shelves: tallest first, left to right, a new shelf when the row is full and a new page when the shelves are
+    std::stable_sort(atlasEntries.begin(), atlasEntries.end(), [&](uint32_t a, uint32_t b) {
+        return sizes[a].height > sizes[b].height;
+    });
+    uint32_t layer = 0, x = 0, shelfY = 0, shelfHeight = 0;
+    packing.groups.push_back({ pageSize, pageSize, 1, (std::min)(ATLAS_MIP_LEVELS, fullMipLevels(pageSize, pageSize)), true });
+    for (uint32_t texture : atlasEntries) {
+        uint32_t width = paddedSize(sizes[texture].width), height = paddedSize(sizes[texture].height);
+        if (x + width > pageSize) {
+            shelfY += shelfHeight;
+            x = 0;
+            shelfHeight = 0;
+        }
+        if (shelfY + height > pageSize) {
+            x = 0;
+            shelfY = 0;
+            shelfHeight = 0;
+            if (++layer == maxLayers) {
+                packing.groups.push_back(packing.groups.back());
+                packing.groups.back().layerCount = 0;
+                layer = 0;
+            }
+            packing.groups.back().layerCount = layer + 1;
+        }
+        packing.placements[texture] = { static_cast<uint32_t>(packing.groups.size() - 1), layer, x + ATLAS_GUTTER, shelfY + ATLAS_GUTTER,
+            sizes[texture].width, sizes[texture].height };
+        x += width;
+        shelfHeight = (std::max)(shelfHeight, height);
+    }
+    return packing;
+}
+
+
+void writeAtlasEntry(uint8_t* page, uint32_t pageWidth, const TexturePlacement& placement, const uint8_t* rgba) {
+    uint32_t left = placement.x - ATLAS_GUTTER, top = placement.y - ATLAS_GUTTER;
+    uint32_t right = placement.x + alignUp(placement.width, ATLAS_GUTTER) + ATLAS_GUTTER;
+    uint32_t bottom = placement.y + alignUp(placement.height, ATLAS_GUTTER) + ATLAS_GUTTER;
+    for (uint32_t y = top; y < bottom; y++) {
+        uint32_t sourceY = std::clamp(int64_t(y) - placement.y, int64_t(0), int64_t(placement.height) - 1);
+        const uint8_t* sourceRow = rgba + size_t(sourceY) * placement.width * 4;
+        uint8_t* row = page + (size_t(y) * pageWidth) * 4;
+
+        // Gutter left, the row itself, then its last texel out to the right
+        for (uint32_t x = left; x < placement.x; x++) memcpy(row + size_t(x) * 4, sourceRow, 4);
+        memcpy(row + size_t(placement.x) * 4, sourceRow, size_t(placement.width) * 4);
+        for (uint32_t x = placement.x + placement.width; x < right; x++) memcpy(row + size_t(x) * 4, sourceRow + size_t(placement.width - 1) * 4, 4);
+    }
+}
\ No newline at end of file
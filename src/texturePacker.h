@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+
+// --material-textures: lots of small textures packed into a few images, each a 2D array. Textures that share their size
+// with enough others become the layers of an array with the full mip chain. The rest are shelf packed into atlas pages (the
+// layers of another array), each surrounded by a gutter of its own edge texels so the few mips an atlas keeps do not bleed
+const uint32_t ATLAS_GUTTER = 8; // texels around every atlas entry, which also starts and ends on a multiple of it
+const uint32_t ATLAS_MIP_LEVELS = 4; // the gutter is still a texel wide at level 3, coarser levels would mix entries
+const uint32_t ATLAS_MAX_PAGE_SIZE = 2048;
+const uint32_t ATLAS_MAX_TEXTURE = 256; // bigger textures of an odd size get an image to themselves instead
+const uint32_t ARRAY_MIN_LAYERS = 4; // fewer textures than this of one size go to the atlas
+
+struct TextureSize {
+    uint32_t width;
+    uint32_t height;
+};
+
+struct TextureGroup { // becomes one image, one view and one sampler
+    uint32_t width; // of a layer
+    uint32_t height;
+    uint32_t layerCount;
+    uint32_t mipLevels;
+    bool atlas;
+};
+
+struct TexturePlacement { // where one texture ended up
+    uint32_t group;
+    uint32_t layer;
+    uint32_t x; // texel offset into the layer, 0 unless atlas
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct TexturePacking {
+    std::vector<TextureGroup> groups;
+    std::vector<TexturePlacement> placements; // in the order of the sizes packed
+};
+
+// All RGBA8, so same format throughout. Groups never have more than maxLayers layers. pack = false gives every texture a
+// group of its own, which is what the textures cost unpacked
+TexturePacking packTextures(const std::vector<TextureSize>& sizes, uint32_t maxLayers, bool pack);
+
+// Copies a texture into its atlas page, and its edge texels out over the gutter around it
+void writeAtlasEntry(uint8_t* page, uint32_t pageWidth, const TexturePlacement& placement, const uint8_t* rgba);
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "application.h"
+#include "command.h"
+#include "queueFamily.h"
+#include "texture.h"
+
+
+// The levels above the resident tail: staging for all of them, a thread to fill it, and a command pool on the transfer queue
+void Application::startTextureStreaming(std::unique_ptr<Ktx2File> ktx) {
+    streamingTexture = std::move(ktx);
+    streamingStart = Clock::now();
+    copiedLevels.assign(mipLevels, false);
+    for (uint32_t i = textureResidentLevel; i < mipLevels; i++) copiedLevels[i] = true;
+
+    streamingOffsets.assign(textureResidentLevel, 0);
+    VkDeviceSize stagingSize = 0;
+    for (uint32_t i = 0; i < textureResidentLevel; i++) {
+        streamingOffsets[i] = stagingSize;
+        stagingSize = (stagingSize + stagedLevelSize(streamingTexture->level(i), textureDecodeToRgba8) + 15) & ~VkDeviceSize(15);
+    }
+    createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        streamingStagingBuffer, streamingStagingBufferMemory);
+    streamingStagingData = streamingStagingBufferMemory.mapped;
+
+    QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // one short command buffer per level
+    poolInfo.queueFamilyIndex = indices.transferFamily.value();
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create transfer command pool!");
+    }
+
+    // Reading the mapping (page faults, so the actual disk I/O) and any decoding happen here, never on the frame's thread.
+    // Coarse to fine, each level is usable as soon as everything below it is
+    streamingStop = false;
+    streamingThread = std::thread([this, firstStreamed = textureResidentLevel]() {
+        for (uint32_t level = firstStreamed; level-- > 0 && !streamingStop;) {
+            stageLevel(streamingTexture->level(level), streamingTexture->format(), textureDecodeToRgba8,
+                static_cast<uint8_t*>(streamingStagingData) + streamingOffsets[level]);
+
+            std::lock_guard<std::mutex> lock(streamingMutex);
+            stagedLevels.push_back(level);
+        }
+    });
+}
+
+
+// Once per frame on the main thread. Submits what the thread has staged, picks up finished copies and moves the view
+// down to the finest level with everything below it resident. Only polls, a frame never waits on streaming
+void Application::updateTextureStreaming() {
+    if (!streamingTexture) return;
+
+    std::vector<uint32_t> ready;
+    {
+        std::lock_guard<std::mutex> lock(streamingMutex);
+        ready.swap(stagedLevels);
+    }
+    for (uint32_t level : ready) {
+        submitStreamingCopy(level);
+    }
+
+    std::erase_if(streamingCopies, [&](const StreamingCopy& copy) {
+        if (vkGetFenceStatus(device, copy.fence) != VK_SUCCESS) return false;
+        vkDestroyFence(device, copy.fence, nullptr);
+        vkFreeCommandBuffers(device, transferCommandPool, 1, &copy.commandBuffer);
+        copiedLevels[copy.level] = true;
+        return true;
+    });
+
+    uint32_t residentLevel = textureResidentLevel;
+    while (residentLevel > 0 && copiedLevels[residentLevel - 1]) residentLevel--;
+    if (residentLevel != textureResidentLevel) {
+        // Descriptor sets still in flight keep the old view, each frame switches over in updateTextureDescriptor
+        textureResidentLevel = residentLevel;
+        retiredTextureViews.push_back(textureImageView);
+        createTextureImageView();
+
+        const Ktx2Level& level = streamingTexture->level(residentLevel);
+        std::cout << "Texture level " << residentLevel << " (" << level.width << "x" << level.height << ") resident after "
+            << millisecondsSince(streamingStart) << " ms" << std::endl;
+    }
+
+    if (textureResidentLevel == 0 && streamingCopies.empty()) {
+        finishTextureStreaming();
+    }
+}
+
+
+// Layout change, copy and layout change for one level, on the transfer queue with its own fence.
+// The image is shared concurrently, and the graphics queue only samples the level after this fence was seen on the host
+void Application::submitStreamingCopy(uint32_t level) {
+    StreamingCopy copy{ level, VK_NULL_HANDLE, VK_NULL_HANDLE };
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = transferCommandPool;
+    allocInfo.commandBufferCount = 1;
+    vkAllocateCommandBuffers(device, &allocInfo, &copy.commandBuffer);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(copy.commandBuffer, &beginInfo);
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = textureImage;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(copy.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    const Ktx2Level& source = streamingTexture->level(level);
+    VkBufferImageCopy region{};
+    region.bufferOffset = streamingOffsets[level];
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+    region.imageExtent = { source.width, source.height, 1 };
+    vkCmdCopyBufferToImage(copy.commandBuffer, streamingStagingBuffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // A transfer-only queue has no fragment stage to name, the fence covers the rest
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(copy.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    vkEndCommandBuffer(copy.commandBuffer);
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device, &fenceInfo, nullptr, &copy.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create streaming fence!");
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &copy.commandBuffer;
+    if (vkQueueSubmit(transferQueue, 1, &submitInfo, copy.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit texture streaming copy!");
+    }
+    streamingCopies.push_back(copy);
+}
+
+
+// Points this frame's descriptor set at the current view. Called after the frame's fence, when nothing uses the set
+void Application::updateTextureDescriptor(uint32_t frame) {
+    if (frameTextureViews[frame] == textureImageView) return;
+    writeTextureDescriptors(frame);
+
+    std::erase_if(retiredTextureViews, [&](VkImageView view) {
+        if (std::find(frameTextureViews.begin(), frameTextureViews.end(), view) != frameTextureViews.end()) return false;
+        vkDestroyImageView(device, view, nullptr);
+        return true;
+    });
+}
+
+
+// Everything is resident: the staging memory, the thread and the mapping are not needed any more
+void Application::finishTextureStreaming() {
+    textureResidentMilliseconds = millisecondsSince(launchTime);
+    cleanupTextureStreaming();
+}
+
+
+void Application::cleanupTextureStreaming() {
+    streamingStop = true;
+    if (streamingThread.joinable()) {
+        streamingThread.join();
+    }
+    stagedLevels.clear();
+
+    // Only at shutdown are copies still pending, after vkDeviceWaitIdle
+    for (const StreamingCopy& copy : streamingCopies) {
+        vkDestroyFence(device, copy.fence, nullptr);
+    }
+    streamingCopies.clear();
+    if (transferCommandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(device, transferCommandPool, nullptr);
+        transferCommandPool = VK_NULL_HANDLE;
+    }
+
+    if (streamingStagingBuffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, streamingStagingBuffer, nullptr);
+        freeMemory(streamingStagingBufferMemory);
+        streamingStagingBuffer = VK_NULL_HANDLE;
+        streamingStagingData = nullptr;
+    }
+    streamingTexture.reset();
+}
+
+
+void Application::printTextureStreamingStats() {
+    std::cout << "First frame after " << firstFrameMilliseconds << " ms";
+    if (textureResidentMilliseconds > 0.0) {
+        std::cout << ", texture fully resident after " << textureResidentMilliseconds << " ms";
+    }
+    else if (streamingTexture) {
+        std::cout << ", texture still streaming (level " << textureResidentLevel << " resident)";
+    }
+    std::cout << std::endl;
+
+    for (size_t i = 0; i < residentLevelFrames.size(); i++) {
+        if (residentLevelFrames[i] > 0) {
+            std::cout << "Texture level " << i << " finest resident for " << residentLevelFrames[i] << " frames" << std::endl;
+        }
+    }
+}
\ No newline at end of file
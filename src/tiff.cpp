@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include "tiff.h"
+
+
+// Baseline and tiled TIFF tags, from the TIFF 6.0 spec
+const uint16_t TAG_IMAGE_WIDTH = 256;
+const uint16_t TAG_IMAGE_LENGTH = 257;
+const uint16_t TAG_BITS_PER_SAMPLE = 258;
+const uint16_t TAG_COMPRESSION = 259;
+const uint16_t TAG_PHOTOMETRIC = 262;
+const uint16_t TAG_STRIP_OFFSETS = 273;
+const uint16_t TAG_SAMPLES_PER_PIXEL = 277;
+const uint16_t TAG_ROWS_PER_STRIP = 278;
+const uint16_t TAG_PLANAR_CONFIGURATION = 284;
+const uint16_t TAG_TILE_WIDTH = 322;
+const uint16_t TAG_TILE_LENGTH = 323;
+const uint16_t TAG_TILE_OFFSETS = 324;
+const uint16_t TAG_SAMPLE_FORMAT = 339;
+
+const uint16_t TYPE_BYTE = 1;
+const uint16_t TYPE_SHORT = 3;
+const uint16_t TYPE_LONG = 4;
+const uint16_t TYPE_LONG8 = 16; // BigTIFF
+const uint16_t TYPE_IFD8 = 18;
+
+const uint32_t PHOTOMETRIC_BLACK_IS_ZERO = 1;
+const uint32_t PHOTOMETRIC_RGB = 2;
+
+
+static uint32_t typeSize(uint16_t type) {
+    switch (type) {
+    case TYPE_BYTE: return 1;
+    case TYPE_SHORT: return 2;
+    case TYPE_LONG: return 4;
+    case TYPE_LONG8: case TYPE_IFD8: return 8;
+    default: return 0;
+    }
+}
+
+
+bool isTiffPath(const std::string& path) {
+    std::string extension = path.substr((std::min)(path.size(), path.find_last_of('.')));
+    for (auto& c : extension) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    return extension == ".tif" || extension == ".tiff";
+}
+
+
+uint64_t TiffFile::readUnsigned(const uint8_t* p, uint32_t size) const {
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        value |= uint64_t(p[bigEndian ? size - 1 - i : i]) << (8 * i);
+    }
+    return value;
+}
+
+
+void TiffFile::readAt(uint64_t offset, void* data, size_t size) {
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+    if (!file) {
+        throw std::runtime_error("failed to read TIFF, the file is cut short!");
+    }
+    totalRead += size;
+}
+
+
+// The values of an IFD entry. They sit in the entry itself when they fit, otherwise it holds their offset
+std::vector<uint64_t> TiffFile::readField(uint16_t type, uint64_t count, uint64_t valuePosition) {
+    uint32_t size = typeSize(type);
+    if (size == 0) return {};
+    uint32_t inlineBytes = bigTiff ? 8 : 4;
+
+    uint64_t offset = valuePosition;
+    if (count * size > inlineBytes) {
+        uint8_t offsetBytes[8];
+        readAt(valuePosition, offsetBytes, inlineBytes);
+        offset = readUnsigned(offsetBytes, inlineBytes);
+    }
+    std::vector<uint8_t> bytes(count * size);
+    readAt(offset, bytes.data(), bytes.size());
+
+    std::vector<uint64_t> values(count);
+    for (uint64_t i = 0; i < count; i++) {
+        values[i] = readUnsigned(bytes.data() + i * size, size);
+    }
+    return values;
+}
+
+
+bool TiffFile::open(const std::string& path) {
+    close();
+    file.open(path, std::ios::binary);
+    if (!file) return false;
+
+    uint8_t header[16];
+    readAt(0, header, 8);
+    if (memcmp(header, "II", 2) != 0 && memcmp(header, "MM", 2) != 0) {
+        throw std::runtime_error("failed to read TIFF, bad byte order mark!");
+    }
+    bigEndian = header[0] == 'M';
+    uint64_t version = readUnsigned(header + 2, 2);
+    bigTiff = version == 43;
+    if (version != 42 && !bigTiff) {
+        throw std::runtime_error("failed to read TIFF, unknown version!");
+    }
+    uint64_t ifdOffset = readUnsigned(header + 4, 4);
+    if (bigTiff) {
+        readAt(8, header + 8, 8);
+        ifdOffset = readUnsigned(header + 8, 8);
+    }
+
+    // Only the first image directory, the full resolution one. Later ones are overviews
+    uint8_t countBytes[8];
+    readAt(ifdOffset, countBytes, bigTiff ? 8 : 2);
+    uint64_t entryCount = readUnsigned(countBytes, bigTiff ? 8 : 2);
+    uint32_t entrySize = bigTiff ? 20 : 12;
+    uint64_t firstEntry = ifdOffset + (bigTiff ? 8 : 2);
+
+    uint32_t compression = 1, photometric = PHOTOMETRIC_RGB, planar = 1, sampleFormat = 1;
+    std::vector<uint64_t> bitsPerSample;
+    for (uint64_t i = 0; i < entryCount; i++) {
+        uint8_t entry[20];
+        uint64_t entryOffset = firstEntry + i * entrySize;
+        readAt(entryOffset, entry, entrySize);
+        uint16_t tag = static_cast<uint16_t>(readUnsigned(entry, 2));
+        uint16_t type = static_cast<uint16_t>(readUnsigned(entry + 2, 2));
+        uint64_t count = readUnsigned(entry + 4, bigTiff ? 8 : 4);
+        uint64_t valuePosition = entryOffset + (bigTiff ? 12 : 8);
+
+        switch (tag) {
+        case TAG_IMAGE_WIDTH: imageWidth = static_cast<uint32_t>(readField(type, 1, valuePosition).at(0)); break;
+        case TAG_IMAGE_LENGTH: imageHeight = static_cast<uint32_t>(readField(type, 1, valuePosition).at(0)); break;
+        case TAG_BITS_PER_SAMPLE: bitsPerSample = readField(type, count, valuePosition); break;
+        case TAG_COMPRESSION: compression = static_cast<uint32_t>(readField(type, 1, valuePosition).at(0)); break;
+        case TAG_PHOTOMETRIC: photometric = static_cast<uint32_t>(readField(type, 1, valuePosition).at(0)); break;
+        case TAG_SAMPLES_PER_PIXEL: samplesPerPixel = static_cast<uint32_t>(readField(type, 1, valuePosition).at(0)); break;
+        case TAG_ROWS_PER_STRIP: rowsPerStrip = static_cast<uint32_t>(readField(type, 1, valuePosition).at(0)); break;
+        case TAG_PLANAR_CONFIGURATION: planar = static_cast<uint32_t>(readField(type, 1, valuePosition).at(0)); break;
+        case TAG_TILE_WIDTH: tileWidth = static_cast<uint32_t>(readField(type, 1, valuePosition).at(0)); break;
+        case TAG_TILE_LENGTH: tileHeight = static_cast<uint32_t>(readField(type, 1, valuePosition).at(0)); break;
+        case TAG_SAMPLE_FORMAT: sampleFormat = static_cast<uint32_t>(readField(type, 1, valuePosition).at(0)); break;
+        case TAG_TILE_OFFSETS: isTiled = true; [[fallthrough]];
+        case TAG_STRIP_OFFSETS: chunkOffsets = readField(type, count, valuePosition); break;
+        }
+    }
+
+    if (imageWidth == 0 || imageHeight == 0 || chunkOffsets.empty()) {
+        throw std::runtime_error("failed to read TIFF, no image in the first directory!");
+    }
+    if (compression != 1) {
+        throw std::runtime_error("failed to read TIFF, only uncompressed images are supported!");
+    }
+    if (samplesPerPixel < 1 || samplesPerPixel > 4 || planar != 1 || sampleFormat != 1
+        || std::any_of(bitsPerSample.begin(), bitsPerSample.end(), [](uint64_t bits) { return bits != 8; })) {
+        throw std::runtime_error("failed to read TIFF, only interleaved 8 bit samples (1 to 4 of them) are supported!");
+    }
+    if (photometric != (samplesPerPixel >= 3 ? PHOTOMETRIC_RGB : PHOTOMETRIC_BLACK_IS_ZERO)) {
+        throw std::runtime_error("failed to read TIFF, only grey and RGB images are supported!");
+    }
+
+    if (isTiled) {
+        if (tileWidth == 0 || tileHeight == 0) {
+            throw std::runtime_error("failed to read TIFF, tiles without a size!");
+        }
+        chunkWidth = tileWidth;
+        chunkHeight = tileHeight;
+    }
+    else {
+        rowsPerStrip = rowsPerStrip == 0 ? imageHeight : (std::min)(rowsPerStrip, imageHeight); // missing means one strip
+        chunkWidth = imageWidth;
+        chunkHeight = static_cast<uint32_t>(std::clamp<uint64_t>(TIFF_BAND_BYTES / (uint64_t(imageWidth) * 4), 1, imageHeight));
+    }
+    uint64_t chunkCount = isTiled ? uint64_t(regionsX()) * regionsY() : (imageHeight + rowsPerStrip - 1) / rowsPerStrip;
+    if (chunkOffsets.size() < chunkCount) {
+        throw std::runtime_error("failed to read TIFF, missing tile or strip offsets!");
+    }
+    return true;
+}
+
+
+void TiffFile::close() {
+    file.close();
+    file.clear();
+    chunkOffsets.clear();
+    imageWidth = imageHeight = samplesPerPixel = 0;
+    tileWidth = tileHeight = rowsPerStrip = 0;
+    isTiled = false;
+    totalRead = 0;
+}
+
+
+// Grey, grey + alpha and RGB to RGBA8
+void TiffFile::expand(const uint8_t* source, uint8_t* rgba, size_t texels) const {
+    for (size_t i = 0; i < texels; i++) {
+        const uint8_t* s = source + i * samplesPerPixel;
+        uint8_t* d = rgba + i * 4;
+        switch (samplesPerPixel) {
+        case 1: d[0] = d[1] = d[2] = s[0]; d[3] = 255; break;
+        case 2: d[0] = d[1] = d[2] = s[0]; d[3] = s[1]; break;
+        case 3: d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = 255; break;
+        default: memcpy(d, s, 4); break;
+        }
+    }
+}
+
+
+void TiffFile::readRegion(uint32_t x, uint32_t y, uint8_t* rgba) {
+    // RGBA is read straight into place, anything else goes through samples and gets expanded
+    size_t regionBytes = size_t(chunkWidth) * chunkHeight * samplesPerPixel;
+    if (samplesPerPixel != 4 && samples.size() < regionBytes) samples.resize(regionBytes);
+    uint8_t* destination = samplesPerPixel == 4 ? rgba : samples.data();
+
+    // A tile is stored whole, edge tiles included
+    if (isTiled) {
+        readAt(chunkOffsets[size_t(y) * regionsX() + x], destination, regionBytes);
+        if (samplesPerPixel != 4) expand(samples.data(), rgba, size_t(chunkWidth) * chunkHeight);
+        return;
+    }
+
+    // A band of rows: the runs of it that share a strip are contiguous in the file
+    size_t rowBytes = size_t(imageWidth) * samplesPerPixel;
+    uint32_t firstRow = y * chunkHeight, endRow = (std::min)(firstRow + chunkHeight, imageHeight);
+    for (uint32_t row = firstRow; row < endRow;) {
+        uint32_t strip = row / rowsPerStrip;
+        uint32_t runEnd = (std::min)(endRow, (strip + 1) * rowsPerStrip);
+        readAt(chunkOffsets[strip] + uint64_t(row - strip * rowsPerStrip) * rowBytes, destination + (row - firstRow) * rowBytes,
+            (runEnd - row) * rowBytes);
+        row = runEnd;
+    }
+    if (samplesPerPixel != 4) expand(samples.data(), rgba, size_t(imageWidth) * (endRow - firstRow));
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+const uint64_t TIFF_BAND_BYTES = 4 * 1024 * 1024; // RGBA8 bytes of a region of a TIFF stored in strips
+
+
+bool isTiffPath(const std::string& path); // .tif or .tiff, in any case
+
+
+// An uncompressed 8 bit TIFF (classic or BigTIFF, either byte order, tiled or in strips) read a region at a time, so only
+// a region of it is ever in memory, however big the image. Grey, grey + alpha, RGB and RGBA, interleaved samples only.
+// That covers what GDAL and friends write for orthophotos with COMPRESS=NONE, TILED=YES
+class TiffFile {
+public:
+    bool open(const std::string& path); // false if missing, throws if it is not a TIFF we can read
+    void close();
+
+    uint32_t width() const { return imageWidth; }
+    uint32_t height() const { return imageHeight; }
+    bool tiled() const { return isTiled; }
+
+    // What readRegion hands out: the file's tiles, or bands of whole rows about TIFF_BAND_BYTES in size for strips.
+    // Regions at the right and bottom edges are cut off by the image
+    uint32_t regionWidth() const { return chunkWidth; }
+    uint32_t regionHeight() const { return chunkHeight; }
+    uint32_t regionsX() const { return (imageWidth + chunkWidth - 1) / chunkWidth; }
+    uint32_t regionsY() const { return (imageHeight + chunkHeight - 1) / chunkHeight; }
+
+    // Region (x, y) as RGBA8, regionWidth() texels per row, into regionWidth() * regionHeight() * 4 bytes. What lies past the
+    // image edge is left undefined. Throws if the file is cut short
+    void readRegion(uint32_t x, uint32_t y, uint8_t* rgba);
+    uint64_t bytesRead() const { return totalRead; }
+
+private:
+    uint64_t readUnsigned(const uint8_t* p, uint32_t size) const;
+    std::vector<uint64_t> readField(uint16_t type, uint64_t count, uint64_t valuePosition);
+    void readAt(uint64_t offset, void* data, size_t size);
+    void expand(const uint8_t* samples, uint8_t* rgba, size_t texels) const;
+
+    std::ifstream file;
+    bool bigEndian = false;
+    bool bigTiff = false;
+    uint32_t imageWidth = 0;
+    uint32_t imageHeight = 0;
+    uint32_t samplesPerPixel = 0;
+    bool isTiled = false;
+    uint32_t chunkWidth = 0;
+    uint32_t chunkHeight = 0;
+    uint32_t tileWidth = 0; // as stored, strips are rowsPerStrip rows of the full width
+    uint32_t tileHeight = 0;
+    uint32_t rowsPerStrip = 0;
+    std::vector<uint64_t> chunkOffsets; // TileOffsets or StripOffsets
+    std::vector<uint8_t> samples; // a region as stored, when it is not RGBA already
+    uint64_t totalRead = 0;
+};
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "application.h"
+#include "tiff.h"
+
+
+// A .tif/.tiff texture, however big: regions are read straight into the staging ring and copied to their place in level 0
+// while the next ones are read. The mips are then built on the GPU from level 0, so the host never holds more than the
+// ring, whatever the image's size. RGBA8, like --blit-mipmaps
+void Application::createTextureImageTiled(TiffFile& tiff) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    if ((std::max)(tiff.width(), tiff.height()) > properties.limits.maxImageDimension2D) {
+        throw std::runtime_error("failed to create texture image, " + std::to_string(tiff.width()) + "x" + std::to_string(tiff.height())
+            + " is over the device's maxImageDimension2D!");
+    }
+
+    textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    textureExtent = { tiff.width(), tiff.height() };
+    mipLevels = static_cast<uint32_t>(std::floor(std::log2((std::max)(tiff.width(), tiff.height())))) + 1;
+    textureResidentLevel = 0;
+
+    // Same choice of mip builder as createTextureImageRgba8, except there is no CPU chain to fall back on
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, textureFormat, &formatProperties);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    bool blitSupported = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+    bool computeMips = isComputeDownsampleSupported() && (options.mipDownsampler == "compute" || !blitSupported);
+    if (!computeMips && !blitSupported) {
+        throw std::runtime_error("failed to find a way to generate mipmaps!");
+    }
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (computeMips) usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    VkImageCreateFlags flags = computeMips ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT : 0;
+    textureViewUsage = computeMips ? VK_IMAGE_USAGE_SAMPLED_BIT : 0;
+    createImage(tiff.width(), tiff.height(), mipLevels, VK_SAMPLE_COUNT_1_BIT, textureFormat, VK_IMAGE_TILING_OPTIMAL, usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory, {}, flags);
+    transitionImageLayout(textureImage, textureFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+
+    // A slice of the staging ring per region, and its copy. The ring waits for old copies when it is full, so the host
+    // never holds more than the ring and a region
+    VkDeviceSize regionBytes = VkDeviceSize(tiff.regionWidth()) * tiff.regionHeight() * 4;
+    if (stagingRingSize > 0 && regionBytes > stagingRingSize) {
+        throw std::runtime_error("failed to create texture image, a " + std::to_string(regionBytes / (1024 * 1024))
+            + " MB TIFF tile or strip does not fit the staging ring, see --staging-ring!");
+    }
+    auto readStart = Clock::now();
+    double readMilliseconds = 0.0;
+    uint32_t regionCount = tiff.regionsX() * tiff.regionsY();
+    uint32_t firstSubmit = stagingStats.submits;
+    for (uint32_t i = 0; i < regionCount; i++) {
+        uint32_t x = i % tiff.regionsX(), y = i / tiff.regionsX();
+        StagingSlice slice = reserveStaging(regionBytes);
+        auto regionReadStart = Clock::now();
+        tiff.readRegion(x, y, slice.data);
+        readMilliseconds += millisecondsSince(regionReadStart);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = slice.offset;
+        region.bufferRowLength = tiff.regionWidth();
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageOffset = { static_cast<int32_t>(x * tiff.regionWidth()), static_cast<int32_t>(y * tiff.regionHeight()), 0 };
+        region.imageExtent = { (std::min)(tiff.regionWidth(), tiff.width() - x * tiff.regionWidth()),
+            (std::min)(tiff.regionHeight(), tiff.height() - y * tiff.regionHeight()), 1 };
+        vkCmdCopyBufferToImage(stagingCommands(), slice.buffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+    submitStaging();
+    uint32_t batches = stagingStats.submits - firstSubmit;
+    stagingStats.bytes += regionBytes * regionCount;
+    stagingStats.uploadMilliseconds += millisecondsSince(readStart);
+    startupTimings.add("createTextureImage (tiles)", millisecondsSince(readStart));
+
+    auto mipStart = Clock::now();
+    if (computeMips) {
+        generateMipmapsCompute(textureImage, static_cast<int32_t>(tiff.width()), static_cast<int32_t>(tiff.height()), mipLevels, true);
+    }
+    else {
+        generateMipmaps(textureImage, textureFormat, static_cast<int32_t>(tiff.width()), static_cast<int32_t>(tiff.height()), mipLevels);
+    }
+    startupTimings.add(computeMips ? "generateMipmaps (compute)" : "generateMipmaps (blit)", millisecondsSince(mipStart));
+
+    std::cout << "Texture tiles: " << regionCount << " " << (tiff.tiled() ? "tiles" : "bands") << " of " << tiff.regionWidth() << "x"
+        << tiff.regionHeight() << " in " << batches << " batches of copies, "
+        << tiff.bytesRead() / (1024.0 * 1024.0) << " MB read in " << readMilliseconds << " ms" << std::endl;
+}
\ No newline at end of file
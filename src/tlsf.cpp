@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <bit>
+#include "tlsf.h"
+
+
+// Size class of a block: the power of two below its size picks the first level, the next TLSF_SL_BITS bits under that
+// the second. Sizes under 1 << TLSF_SL_BITS get a list each in the first level
+static void mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel) {
+    if (size < (1u << TLSF_SL_BITS)) {
+        firstLevel = 0;
+        secondLevel = static_cast<uint32_t>(size);
+        return;
+    }
+    uint32_t log = 63 - std::countl_zero(size);
+    firstLevel = log - TLSF_SL_BITS + 1;
+    secondLevel = static_cast<uint32_t>(size >> (log - TLSF_SL_BITS)) ^ (1u << TLSF_SL_BITS);
+}
+
+
+void TlsfHeap::reset(uint64_t capacity) {
+    blocks.clear();
+    unusedBlocks.clear();
+    firstLevelMap = 0;
+    std::fill(std::begin(secondLevelMap), std::end(secondLevelMap), 0);
+    total = available = capacity;
+    allocations = 0;
+    if (capacity > 0) {
+        insertFree(newBlock(0, capacity));
+    }
+}
+
+
+uint32_t TlsfHeap::newBlock(uint64_t offset, uint64_t size) {
+    uint32_t block;
+    if (!unusedBlocks.empty()) {
+        block = unusedBlocks.back();
+        unusedBlocks.pop_back();
+    }
+    else {
+        block = static_cast<uint32_t>(blocks.size());
+        blocks.emplace_back();
+    }
+    blocks[block] = { offset, size, TLSF_NONE, TLSF_NONE, TLSF_NONE, TLSF_NONE, true };
+    return block;
+}
+
+
+void TlsfHeap::insertFree(uint32_t block) {
+    uint32_t fl, sl;
+    mapping(blocks[block].size, fl, sl);
+    uint32_t head = (secondLevelMap[fl] & (1u << sl)) ? freeLists[fl][sl] : TLSF_NONE;
+    blocks[block].free = true;
+    blocks[block].prevFree = TLSF_NONE;
+    blocks[block].nextFree = head;
+    if (head != TLSF_NONE) blocks[head].prevFree = block;
+    freeLists[fl][sl] = block;
+    secondLevelMap[fl] |= 1u << sl;
+    firstLevelMap |= uint64_t(1) << fl;
+}
+
+
+void TlsfHeap::removeFree(uint32_t block) {
+    Block& b = blocks[block];
+    if (b.prevFree != TLSF_NONE) blocks[b.prevFree].nextFree = b.nextFree;
+    if (b.nextFree != TLSF_NONE) blocks[b.nextFree].prevFree = b.prevFree;
+    if (b.prevFree == TLSF_NONE) {
+        uint32_t fl, sl;
+        mapping(b.size, fl, sl);
+        freeLists[fl][sl] = b.nextFree;
+        if (b.nextFree == TLSF_NONE) {
+            secondLevelMap[fl] &= ~(1u << sl);
+            if (secondLevelMap[fl] == 0) firstLevelMap &= ~(uint64_t(1) << fl);
+        }
+    }
+    b.free = false;
+}
+
+
+// Rounds size up to the next class first, so whatever heads the list that is found fits without looking further
+uint32_t TlsfHeap::findFree(uint64_t size) const {
+    if (size >= (1u << TLSF_SL_BITS)) {
+        uint32_t log = 63 - std::countl_zero(size);
+        uint64_t round = (uint64_t(1) << (log - TLSF_SL_BITS)) - 1;
+        if (size > UINT64_MAX - round) return TLSF_NONE;
+        size += round;
+    }
+    uint32_t fl, sl;
+    mapping(size, fl, sl);
+
+    uint32_t secondMap = secondLevelMap[fl] & (~0u << sl);
+    if (secondMap == 0) {
+        uint64_t firstMap = fl + 1 < 64 ? firstLevelMap & (~uint64_t(0) << (fl + 1)) : 0;
+        if (firstMap == 0) return TLSF_NONE;
+        fl = std::countr_zero(firstMap);
+        secondMap = secondLevelMap[fl];
+    }
+    return freeLists[fl][std::countr_zero(secondMap)];
+}
+
+
+void TlsfHeap::split(uint32_t block, uint64_t size) {
+    uint32_t rest = newBlock(blocks[block].offset + size, blocks[block].size - size);
+    blocks[block].size = size;
+    blocks[rest].prevPhysical = block;
+    blocks[rest].nextPhysical = blocks[block].nextPhysical;
+    if (blocks[rest].nextPhysical != TLSF_NONE) blocks[blocks[rest].nextPhysical].prevPhysical = rest;
+    blocks[block].nextPhysical = rest;
+    insertFree(rest);
+}
+
+
+void TlsfHeap::merge(uint32_t block, uint32_t next) {
+    blocks[block].size += blocks[next].size;
+    blocks[block].nextPhysical = blocks[next].nextPhysical;
+    if (blocks[block].nextPhysical != TLSF_NONE) blocks[blocks[block].nextPhysical].prevPhysical = block;
+    unusedBlocks.push_back(next);
+}
+
+
+uint32_t TlsfHeap::allocate(uint64_t size, uint64_t alignment, uint64_t& offset) {
+    size = (std::max)(size, uint64_t(1));
+    alignment = (std::max)(alignment, uint64_t(1));
+    if (size > total) return TLSF_NONE;
+    uint32_t block = findFree(size + alignment - 1); // fits whatever the offset it starts at
+    if (block == TLSF_NONE) return TLSF_NONE;
+    removeFree(block);
+
+    // The padding up to the alignment stays free as a block of its own. Its physical neighbour before is in use, free
+    // neighbours are always merged
+    uint64_t padding = (alignment - blocks[block].offset % alignment) % alignment;
+    if (padding > 0) {
+        split(block, padding);
+        uint32_t aligned = blocks[block].nextPhysical;
+        removeFree(aligned);
+        insertFree(block);
+        block = aligned;
+    }
+    if (blocks[block].size > size) {
+        split(block, size);
+    }
+
+    blocks[block].free = false;
+    available -= size;
+    allocations++;
+    offset = blocks[block].offset;
+    return block;
+}
+
+
+void TlsfHeap::free(uint32_t allocation) {
+    uint32_t block = allocation;
+    available += blocks[block].size;
+    allocations--;
+
+    uint32_t next = blocks[block].nextPhysical;
+    if (next != TLSF_NONE && blocks[next].free) {
+        removeFree(next);
+        merge(block, next);
+    }
+    uint32_t prev = blocks[block].prevPhysical;
+    if (prev != TLSF_NONE && blocks[prev].free) {
+        removeFree(prev);
+        merge(prev, block);
+        block = prev;
+    }
+    insertFree(block);
+}
+
+
+// The highest non-empty list holds the biggest blocks, but not sorted, so that one list gets walked
+uint64_t TlsfHeap::largestFree() const {
+    if (firstLevelMap == 0) return 0;
+    uint32_t fl = 63 - std::countl_zero(firstLevelMap);
+    uint32_t sl = 31 - std::countl_zero(secondLevelMap[fl]);
+    uint64_t largest = 0;
+    for (uint32_t block = freeLists[fl][sl]; block != TLSF_NONE; block = blocks[block].nextFree) {
+        largest = (std::max)(largest, blocks[block].size);
+    }
+    return largest;
+}
\ No newline at end of file
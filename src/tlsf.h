@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+
+const uint32_t TLSF_SL_BITS = 4; // 16 lists per power of two: a found block is at most 1/16 bigger than asked for
+const uint32_t TLSF_FL_COUNT = 64 - TLSF_SL_BITS + 1;
+const uint32_t TLSF_NONE = UINT32_MAX;
+
+
+// Two-level segregated fit over [0, capacity): allocate and free are O(1), two bitmap scans and a few list links, and
+// free neighbours merge at once. Keeps only offsets, the memory itself is somewhere else (a VkDeviceMemory block)
+class TlsfHeap {
+public:
+    void reset(uint64_t capacity);
+
+    uint32_t allocate(uint64_t size, uint64_t alignment, uint64_t& offset); // TLSF_NONE if nothing free is big enough
+    void free(uint32_t allocation);
+
+    uint64_t capacity() const { return total; }
+    uint64_t freeBytes() const { return available; }
+    uint64_t largestFree() const;
+    uint32_t allocationCount() const { return allocations; }
+
+private:
+    struct Block {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t prevPhysical; // neighbours in address order, TLSF_NONE at the ends
+        uint32_t nextPhysical;
+        uint32_t prevFree; // in its size class' free list, when free
+        uint32_t nextFree;
+        bool free;
+    };
+
+    uint32_t newBlock(uint64_t offset, uint64_t size);
+    void insertFree(uint32_t block);
+    void removeFree(uint32_t block);
+    uint32_t findFree(uint64_t size) const;
+    void split(uint32_t block, uint64_t size); // the rest after size becomes a free block of its own
+    void merge(uint32_t block, uint32_t next); // next goes into block
+
+    std::vector<Block> blocks;
+    std::vector<uint32_t> unusedBlocks; // slots of blocks merged away, for newBlock to reuse
+    uint64_t firstLevelMap = 0;
+    uint32_t secondLevelMap[TLSF_FL_COUNT] = {};
+    uint32_t freeLists[TLSF_FL_COUNT][1 << TLSF_SL_BITS];
+    uint64_t total = 0;
+    uint64_t available = 0;
+    uint32_t allocations = 0;
+};
\ No newline at end of file
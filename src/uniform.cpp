@@ -2,17 +2,23 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE // OpenGL [-1, 1], Vulkan [0, 1]
 #include <glm/gtc/matrix_transform.hpp>
 #include <chrono>
+#include <cmath>
 #include <stdexcept>
+#include <algorithm>
 #include <array>
+#include <vector>
 #include "application.h"
+#include "bindless.h"
 #include "uniform.h"
 #include "command.h"
+#include "options.h"
+#include "mesh.h"
 
 
 void Application::createDescriptorSetLayout() {
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0; // binding=0 in shader
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = frameUniformDescriptorType(); // dynamic, it moves through the frame arena
     uboLayoutBinding.descriptorCount = 1; // if array of uniforms, then > 1. Eg skeletal joint transform
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // vertex uniform
     uboLayoutBinding.pImmutableSamplers = nullptr; // Optional. Image sampling-related
@@ -24,31 +30,61 @@ void Application::createDescriptorSetLayout() {
     samplerLayoutBinding.pImmutableSamplers = nullptr;
     samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; // texture sampler in Fragment shader. But can also be used in vertex shader to deform vertices of height map
 
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+    std::vector<VkDescriptorSetLayoutBinding> bindings = { uboLayoutBinding, samplerLayoutBinding };
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-    layoutInfo.pBindings = bindings.data();
 
-    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create descriptor set layout!");
+    // Bindless: binding 1 is a big array of images, of which only the materials' slots are ever written, and new ones can be
+    // written while the set is bound. The samplers are a separate small table at binding 2
+    std::vector<VkDescriptorBindingFlagsEXT> bindingFlags;
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+    if (bindlessTextures) {
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        bindings[1].descriptorCount = bindlessTextureCapacity;
+
+        VkDescriptorSetLayoutBinding samplerTableBinding{};
+        samplerTableBinding.binding = 2;
+        samplerTableBinding.descriptorCount = BINDLESS_SAMPLER_COUNT;
+        samplerTableBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        samplerTableBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        bindings.push_back(samplerTableBinding);
+
+        bindingFlags = { 0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT, 0 };
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+        bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
     }
-}
-
 
-void Application::createUniformBuffers() {
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+    // Virtual texture: binding 1 is the page cache, the page table and the feedback buffer come after the sampler table's slot
+    if (virtualTexturing) {
+        VkDescriptorSetLayoutBinding pageTableBinding{};
+        pageTableBinding.binding = 3;
+        pageTableBinding.descriptorCount = 1;
+        pageTableBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        pageTableBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        bindings.push_back(pageTableBinding);
+
+        VkDescriptorSetLayoutBinding feedbackBinding = pageTableBinding;
+        feedbackBinding.binding = 4;
+        bindings.push_back(feedbackBinding);
+    }
 
-    uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    // Material textures: binding 1 is the group's array, and this says where each texture is in it
+    if (materialTexturing) {
+        VkDescriptorSetLayoutBinding regionBinding{};
+        regionBinding.binding = 5;
+        regionBinding.descriptorCount = 1;
+        regionBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        regionBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        bindings.push_back(regionBinding);
+    }
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        // Persistent mapping, mapped for the whole app lifetime. More optimal.
-        createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            uniformBuffers[i], uniformBuffersMemory[i]);
-        vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor set layout!");
     }
 }
 
@@ -59,37 +95,87 @@ void Application::updateUniformBuffer(uint32_t currentImage) {
     auto currentTime = std::chrono::high_resolution_clock::now();
     float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
+    // --camera-path: time comes from the frame count, so every run sees the same views whatever its frame rate
+    if (options.cameraPath) {
+        time = frameNumber / 60.0f;
+    }
+
     UniformBufferObject ubo{};
     // rotate about z-axis, 90deg per second
     ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
     // Camera pos, target pos, up vector
-    ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::vec3 eye(2.0f, 2.0f, 2.0f);
+    if (options.cameraDistance > 0.0f) {
+        eye = glm::normalize(eye) * options.cameraDistance;
+    }
+    if (options.cameraPath) {
+        // Dolly from twice the distance in to a fifth of it and back every 20 seconds, close enough for the finest mips
+        float dolly = 0.5f + 0.5f * std::cos(time / 20.0f * glm::radians(360.0f));
+        eye *= glm::mix(0.2f, 2.0f, dolly);
+    }
+    ubo.view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
     // 45deg FOV-y, AR, Near, Far
-    ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f);
+    float fovY = glm::radians(45.0f);
+    float farPlane = (std::max)(10.0f, glm::length(eye) * 2.0f);
+    ubo.proj = glm::perspective(fovY, swapChainExtent.width / (float)swapChainExtent.height, 0.1f, farPlane);
+
+    // Distance from the eye to the model's bounding sphere, for the LOD
+    glm::vec3 center = glm::vec3(ubo.model * glm::vec4((model.bounds.min + model.bounds.max) * 0.5f, 1.0f));
+    float radius = glm::length(model.bounds.max - model.bounds.min) * 0.5f;
+    selectLod(glm::length(eye - center) - radius, fovY);
 
     // OpenGL: x-right, y-up, z-back. Vulkan: x-right, y-down, z-front
     // TODO: Some reason why this is a bad hack: https://johannesugb.github.io/gpu-programming/why-do-opengl-proj-matrices-fail-in-vulkan/
     ubo.proj[1][1] *= -1;
 
-    // Better to use push constants for this
-    memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+    FrameAllocation uniforms = allocateFrameData(currentImage, sizeof(ubo));
+    memcpy(uniforms.data, &ubo, sizeof(ubo));
+    frameUniformOffset = uniforms.offset;
+
+    // Bindless sets cannot have dynamic descriptors, so the frame's (idle since its fence) get pointed at the new block
+    if (bindlessTextures) {
+        VkDescriptorBufferInfo bufferInfo{ frameArenaBuffer, uniforms.offset, sizeof(UniformBufferObject) };
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = materialDescriptorSet(currentImage, 0);
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+    }
 }
 
 
+// A set per frame in flight. Without bindless that is a set per material per frame (per texture group with material
+// textures), each pointing at the frame's uniforms in the frame arena
 void Application::createDescriptorPool() {
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    uint32_t setCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * descriptorSetsPerFrame();
+    std::vector<VkDescriptorPoolSize> poolSizes(2);
+    poolSizes[0].type = frameUniformDescriptorType();
+    poolSizes[0].descriptorCount = setCount;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[1].descriptorCount = setCount;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    if (bindlessTextures) {
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        poolSizes[1].descriptorCount = setCount * bindlessTextureCapacity;
+        poolSizes.push_back({ VK_DESCRIPTOR_TYPE_SAMPLER, setCount * BINDLESS_SAMPLER_COUNT });
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    }
+    if (virtualTexturing) {
+        poolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, setCount * 2 });
+    }
+    if (materialTexturing) {
+        poolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, setCount });
+    }
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolInfo.maxSets = setCount;
 
     if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) { // VK_ERROR_POOL_OUT_OF_MEMORY
         throw std::runtime_error("failed to create descriptor pool!");
@@ -98,50 +184,128 @@ void Application::createDescriptorPool() {
 
 
 void Application::createDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+    uint32_t setsPerFrame = descriptorSetsPerFrame();
+    uint32_t setCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * setsPerFrame;
+    std::vector<VkDescriptorSetLayout> layouts(setCount, descriptorSetLayout);
 
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT); // One DSet for each frame
-    allocInfo.pSetLayouts = layouts.data(); // same layout for both sets
+    allocInfo.descriptorSetCount = setCount; // One DSet for each frame (and material, or texture group)
+    allocInfo.pSetLayouts = layouts.data(); // same layout for all sets
 
-    descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    descriptorSets.resize(setCount);
     if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate descriptor sets!");
     }
 
+    std::vector<VkDescriptorImageInfo> samplerInfos(BINDLESS_SAMPLER_COUNT);
+    samplerInfos[0].sampler = textureSampler;
+    samplerInfos[1].sampler = nearestSampler;
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    frameTextureViews.assign(MAX_FRAMES_IN_FLIGHT, textureImageView);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i];
-        bufferInfo.offset = 0;
+        bufferInfo.buffer = frameArenaBuffer;
+        bufferInfo.offset = 0; // plus the dynamic offset of the frame's block when bound, or rewritten each frame if bindless
         bufferInfo.range = sizeof(UniformBufferObject);
 
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = textureImageView;
-        imageInfo.sampler = textureSampler;
+        // The frame's own page table and feedback buffer, if virtual
+        std::vector<VkDescriptorBufferInfo> virtualBufferInfos(2);
+        if (virtualTexturing) {
+            virtualBufferInfos[0] = { pageTableBuffers[i], 0, VK_WHOLE_SIZE };
+            virtualBufferInfos[1] = { feedbackBuffers[i], 0, VK_WHOLE_SIZE };
+        }
+
+        std::vector<VkWriteDescriptorSet> descriptorWrites;
+        for (uint32_t set = 0; set < setsPerFrame; set++) {
+            VkWriteDescriptorSet descriptorWrite{};
+            descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrite.dstSet = descriptorSets[i * setsPerFrame + set];
+            descriptorWrite.dstBinding = 0;
+            descriptorWrite.dstArrayElement = 0;
+            descriptorWrite.descriptorType = frameUniformDescriptorType();
+            descriptorWrite.descriptorCount = 1;
+            descriptorWrite.pBufferInfo = &bufferInfo;
+            descriptorWrites.push_back(descriptorWrite);
+
+            for (uint32_t j = 0; virtualTexturing && j < 2; j++) {
+                descriptorWrite.dstBinding = 3 + j;
+                descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrite.pBufferInfo = &virtualBufferInfos[j];
+                descriptorWrites.push_back(descriptorWrite);
+            }
+        }
+
+        if (bindlessTextures) {
+            VkWriteDescriptorSet descriptorWrite{};
+            descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrite.dstSet = descriptorSets[i];
+            descriptorWrite.dstBinding = 2;
+            descriptorWrite.dstArrayElement = 0;
+            descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+            descriptorWrite.descriptorCount = BINDLESS_SAMPLER_COUNT;
+            descriptorWrite.pImageInfo = samplerInfos.data();
+            descriptorWrites.push_back(descriptorWrite);
+        }
+
+        // no copy DSets, which allow copy to one another
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        writeTextureDescriptors(i);
+        writeRegionDescriptors(i);
+    }
+}
+
 
+VkDescriptorSet Application::materialDescriptorSet(uint32_t frame, uint32_t material) {
+    return descriptorSets[frame * descriptorSetsPerFrame() + materialSetIndex(material)];
+}
 
-        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
 
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
+// Points every material of a frame at the current texture view. Bindless, those are slots [0, materialCount) of the frame's
+// table, otherwise the sampler binding of each material's set. With material textures each set gets its group's array
+void Application::writeTextureDescriptors(uint32_t frame) {
+    uint32_t setsPerFrame = descriptorSetsPerFrame();
+    std::vector<VkDescriptorImageInfo> imageInfos(bindlessTextures ? materialCount : setsPerFrame);
+    for (uint32_t i = 0; i < imageInfos.size(); i++) {
+        imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfos[i].imageView = materialTexturing ? textureGroupViews[i] : textureImageView;
+        imageInfos[i].sampler = materialTexturing ? textureGroupSamplers[i] : textureSampler; // ignored by SAMPLED_IMAGE
+    }
+
+    std::vector<VkWriteDescriptorSet> descriptorWrites;
+    for (uint32_t set = 0; set < setsPerFrame; set++) {
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = descriptorSets[frame * setsPerFrame + set];
+        descriptorWrite.dstBinding = 1;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = bindlessTextures ? VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = bindlessTextures ? materialCount : 1;
+        descriptorWrite.pImageInfo = &imageInfos[set];
+        descriptorWrites.push_back(descriptorWrite);
+    }
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    frameTextureViews[frame] = textureImageView;
+}
 
-        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].dstSet = descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pImageInfo = &imageInfo;
 
-        vkUpdateDescriptorSets(device, 2, descriptorWrites.data(), 0, nullptr); // no copy DSets, which allow copy to one another
+// With material textures, where in its group each texture is. Again when defragmentation has moved the buffer
+void Application::writeRegionDescriptors(uint32_t frame) {
+    if (!materialTexturing) return;
+    uint32_t setsPerFrame = descriptorSetsPerFrame();
+    VkDescriptorBufferInfo regionInfo{ textureRegionBuffer, 0, VK_WHOLE_SIZE };
+    std::vector<VkWriteDescriptorSet> descriptorWrites;
+    for (uint32_t set = 0; set < setsPerFrame; set++) {
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = descriptorSets[frame * setsPerFrame + set];
+        descriptorWrite.dstBinding = 5;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &regionInfo;
+        descriptorWrites.push_back(descriptorWrite);
     }
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
\ No newline at end of file
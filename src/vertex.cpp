@@ -1,9 +1,9 @@
-#include <stdexcept>
+#include <algorithm>
+#include <limits>
 #include "vertex.h"
 
 
-std::vector<Vertex> vertices;
-std::vector<uint32_t> indices;
+DequantizeConstants vertexDequantize{};
 
 
 VkVertexInputBindingDescription Vertex::getBindingDescription() {
@@ -37,52 +37,72 @@ std::array<VkVertexInputAttributeDescription, 3> Vertex::getAttributeDescription
 }
 
 
-void Application::createVertexBuffer() {
-    uint64_t size = sizeof(vertices[0]) * vertices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+VkVertexInputBindingDescription PackedVertex::getBindingDescription() {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(PackedVertex);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return bindingDescription;
+}
 
-    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // source
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingBufferMemory);
 
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data); // offset 0, size
-    memcpy(data, vertices.data(), (size_t) size);
-    vkUnmapMemory(device, stagingBufferMemory);
+std::array<VkVertexInputAttributeDescription, 2> PackedVertex::getAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
 
-    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, // destination
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory); // device-local memory
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM; // shader gets 0..1 floats
+    attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
 
-    // vertex data is now being loaded from high performance memory.
-    copyBuffer(stagingBuffer, vertexBuffer, size);
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R16G16_UNORM;
+    attributeDescriptions[1].offset = offsetof(PackedVertex, texCoord);
 
-    // Cleanup staging stuff
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    return attributeDescriptions;
 }
 
 
-void Application::createIndexBuffer() {
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingBufferMemory);
+static uint16_t quantizeUnorm16(float value, float min, float extent) {
+    if (extent <= 0.0f) return 0; // flat axis, everything sits at the offset
+    float t = std::clamp((value - min) / extent, 0.0f, 1.0f);
+    return static_cast<uint16_t>(t * 65535.0f + 0.5f);
+}
 
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t) bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
 
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, // INDEX!
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+DequantizeConstants computeDequantize(std::span<const Vertex> vertices, const Bounds& bounds) {
+    // Texcoords can leave 0..1 (tiling), so they get bounds of their own too
+    glm::vec2 uvMin(0.0f), uvMax(0.0f);
+    if (!vertices.empty()) {
+        uvMin = glm::vec2(std::numeric_limits<float>::max());
+        uvMax = glm::vec2(std::numeric_limits<float>::lowest());
+        for (const auto& vertex : vertices) {
+            uvMin = glm::min(uvMin, vertex.texCoord);
+            uvMax = glm::max(uvMax, vertex.texCoord);
+        }
+    }
+
+    DequantizeConstants constants{};
+    constants.positionOffset = glm::vec4(bounds.min, 0.0f);
+    constants.positionScale = glm::vec4(bounds.max - bounds.min, 0.0f);
+    constants.texCoordOffsetScale = glm::vec4(uvMin, uvMax - uvMin);
+    return constants;
+}
 
-    copyBuffer(stagingBuffer, indexBuffer, bufferSize);
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+void packVertices(std::span<const Vertex> vertices, const DequantizeConstants& constants, PackedVertex* packed) {
+    glm::vec3 posMin(constants.positionOffset), posExtent(constants.positionScale);
+    glm::vec2 uvMin(constants.texCoordOffsetScale.x, constants.texCoordOffsetScale.y);
+    glm::vec2 uvExtent(constants.texCoordOffsetScale.z, constants.texCoordOffsetScale.w);
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex& vertex = vertices[i];
+        PackedVertex& out = packed[i];
+        for (int axis = 0; axis < 3; axis++) {
+            out.pos[axis] = quantizeUnorm16(vertex.pos[axis], posMin[axis], posExtent[axis]);
+        }
+        out.pos[3] = 0;
+        out.texCoord[0] = quantizeUnorm16(vertex.texCoord.x, uvMin.x, uvExtent.x);
+        out.texCoord[1] = quantizeUnorm16(vertex.texCoord.y, uvMin.y, uvExtent.y);
+    }
 }
\ No newline at end of file
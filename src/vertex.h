@@ -1,9 +1,10 @@
 #pragma once
 #include <glm/glm.hpp>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 #include <array>
-#include "application.h"
+#include <cstring>
+#include <span>
+#include <vulkan/vulkan.h>
+#include "hash.h"
 
 struct Vertex {
 	glm::vec3 pos;
@@ -20,16 +21,69 @@ struct Vertex {
     }
 };
 
+static_assert(sizeof(Vertex) == 32, "hashVertex assumes 8 tightly packed floats");
+
+// Mixes all 32 bytes, unlike xor-ing the per-member glm hashes, which collides badly on grid-aligned positions.
+// -0.0f is folded into 0.0f so vertices that compare equal also hash equal.
+inline uint64_t hashVertex(const Vertex& vertex) {
+    uint32_t bits[8];
+    memcpy(bits, &vertex, sizeof(bits));
+
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < 8; i += 2) {
+        uint64_t lo = bits[i] == 0x80000000u ? 0 : bits[i];
+        uint64_t hi = bits[i + 1] == 0x80000000u ? 0 : bits[i + 1];
+        h = mix64(h ^ (lo | hi << 32));
+    }
+    return h;
+}
+
 namespace std {
     template<> struct hash<Vertex> {
         size_t operator()(Vertex const& vertex) const {
-            return ((hash<glm::vec3>()(vertex.pos) ^
-                (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-                (hash<glm::vec2>()(vertex.texCoord) << 1);
+            return static_cast<size_t>(hashVertex(vertex));
         }
     };
 }
 
 
-extern std::vector<Vertex> vertices;
-extern std::vector<uint32_t> indices;
\ No newline at end of file
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+
+// One level of detail, a range of the mesh's indices drawn against the shared vertex buffer. Level 0 is the full mesh
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error; // model space, how far this level may be off the full mesh
+};
+
+const uint32_t MAX_LODS = 4; // full, 50%, 25%, 12.5%
+
+
+// 12 byte alternative to Vertex (--packed-vertices). Positions and texcoords are unorm16 relative to the mesh's
+// own bounds, and there is no color, since it was always white. shader_packed.vert undoes the quantization.
+struct PackedVertex {
+    uint16_t pos[4]; // xyz, w is padding (R16G16B16 is rarely supported as a vertex format)
+    uint16_t texCoord[2];
+
+    static VkVertexInputBindingDescription getBindingDescription();
+
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions();
+};
+
+// Push constants of shader_packed.vert: value = offset + scale * unorm
+struct DequantizeConstants {
+    glm::vec4 positionOffset;
+    glm::vec4 positionScale;
+    glm::vec4 texCoordOffsetScale; // xy offset, zw scale
+};
+
+// Quantization ranges for a whole mesh, then packing any slice of it, so an upload can go a chunk at a time
+DequantizeConstants computeDequantize(std::span<const Vertex> vertices, const Bounds& bounds);
+void packVertices(std::span<const Vertex> vertices, const DequantizeConstants& constants, PackedVertex* packed);
+
+
+extern DequantizeConstants vertexDequantize; // only meaningful with --packed-vertices
\ No newline at end of file
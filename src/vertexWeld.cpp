@@ -0,0 +1,40 @@
+#include "vertexWeld.h"
+
+
+void WeldTable::reserve(size_t count) {
+    size_t capacity = 16;
+    while (capacity * 3 < count * 4) capacity *= 2; // keep the load at or below 3/4, probes stay short
+    if (capacity > slots.size()) {
+        rehash(capacity);
+    }
+}
+
+
+void WeldTable::rehash(size_t capacity) {
+    std::vector<Slot> old(capacity, Slot{ 0, EMPTY });
+    old.swap(slots);
+
+    size_t mask = slots.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.id == EMPTY) continue;
+        size_t i = slot.tag & mask;
+        while (slots[i].id != EMPTY) i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+}
+
+
+VertexWelder::VertexWelder(std::vector<Vertex>& vertices, size_t expectedCount) : vertices(vertices) {
+    table.reserve(expectedCount);
+}
+
+
+uint32_t VertexWelder::add(const Vertex& vertex) {
+    // One probe sequence for both the lookup and the insert
+    uint32_t index = table.findOrInsert(hashVertex(vertex), static_cast<uint32_t>(vertices.size()),
+        [&](uint32_t other) { return vertices[other] == vertex; });
+    if (index == vertices.size()) {
+        vertices.push_back(vertex);
+    }
+    return index;
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+#include <stdexcept>
+#include <vector>
+#include "parallel.h"
+#include "vertex.h"
+
+
+// Flat open-addressing set of ids (eg indices into a vertex array), keyed by a 64-bit hash.
+// One 8-byte slot per entry and no node allocations; the caller supplies equality, so the table never stores keys.
+class WeldTable {
+public:
+    // Sizes the table so count entries fit without growing
+    void reserve(size_t count);
+
+    // Returns the id of an entry with this hash that equal(id) accepts, or inserts id and returns it
+    template<typename Equal>
+    uint32_t findOrInsert(uint64_t hash, uint32_t id, Equal&& equal) {
+        if ((used + 1) * 4 > slots.size() * 3) {
+            rehash((std::max)(slots.size() * 2, size_t(16)));
+        }
+
+        uint32_t tag = static_cast<uint32_t>(hash);
+        size_t mask = slots.size() - 1;
+        for (size_t i = tag & mask; ; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (slot.id == EMPTY) {
+                slot = { tag, id };
+                used++;
+                return id;
+            }
+            if (slot.tag == tag && equal(slot.id)) {
+                return slot.id;
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        uint32_t tag; // low hash bits, also the home slot, so growing never needs the keys
+        uint32_t id;
+    };
+    static const uint32_t EMPTY = UINT32_MAX;
+
+    void rehash(size_t capacity);
+
+    std::vector<Slot> slots;
+    size_t used = 0;
+};
+
+
+// Appends vertex to vertices unless an equal one is already there, returns its index
+class VertexWelder {
+public:
+    VertexWelder(std::vector<Vertex>& vertices, size_t expectedCount);
+    uint32_t add(const Vertex& vertex);
+
+private:
+    std::vector<Vertex>& vertices;
+    WeldTable table;
+};
+
+
+// Same result as VertexWelder::add(corner(i)) for i = 0..count-1, but sharded across threads.
+// Every shard owns a slice of the hash space and walks the corners in order, so the first corner it
+// keeps for a vertex is also the first in the stream and vertex order stays identical to the serial weld.
+template<typename CornerFn>
+void weldParallel(size_t count, CornerFn&& corner, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    if (count >= UINT32_MAX) {
+        throw std::runtime_error("too many vertices to weld!");
+    }
+    const size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<uint64_t> hashes(count);
+    parallelFor((count + BLOCK_SIZE - 1) / BLOCK_SIZE, [&](size_t block) {
+        size_t end = (std::min)(count, (block + 1) * BLOCK_SIZE);
+        for (size_t i = block * BLOCK_SIZE; i < end; i++) {
+            hashes[i] = hashVertex(corner(i));
+        }
+    });
+
+    // First pass stores, for every corner, the corner that first had its value. Top hash bits pick the shard,
+    // the table uses the low ones, so the shards stay evenly loaded
+    size_t base = indices.size();
+    indices.resize(base + count);
+    uint32_t* first = indices.data() + base;
+
+    size_t shardCount = (count < BLOCK_SIZE) ? 1 : workerCount();
+    parallelFor(shardCount, [&](size_t shard) {
+        WeldTable table;
+        table.reserve(count / shardCount + count / (shardCount * 8) + 16);
+
+        for (size_t i = 0; i < count; i++) {
+            if (((hashes[i] >> 32) * shardCount) >> 32 != shard) continue;
+            Vertex vertex = corner(i);
+            first[i] = table.findOrInsert(hashes[i], static_cast<uint32_t>(i), [&](uint32_t other) { return corner(other) == vertex; });
+        }
+    });
+
+    // Then number the first occurrences in order. Earlier corners are already renumbered when a later one looks them up
+    for (size_t i = 0; i < count; i++) {
+        if (first[i] == i) {
+            first[i] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(corner(i));
+        }
+        else {
+            first[i] = first[first[i]];
+        }
+    }
+}
\ No newline at end of file
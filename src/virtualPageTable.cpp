@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "virtualTexture.h"
+
+
+void VirtualPageTable::reset(uint32_t width, uint32_t height, uint32_t levelCount, uint32_t slotsPerRow) {
+    textureWidth = width;
+    textureHeight = height;
+    levels.clear();
+    uint32_t pages = 0;
+    for (uint32_t i = 0; i < (std::min)(levelCount, VIRTUAL_MAX_LEVELS); i++) {
+        uint32_t levelWidth = (std::max)(width >> i, 1u), levelHeight = (std::max)(height >> i, 1u);
+        Level level{ pages, (levelWidth + VIRTUAL_PAGE_PAYLOAD - 1) / VIRTUAL_PAGE_PAYLOAD, (levelHeight + VIRTUAL_PAGE_PAYLOAD - 1) / VIRTUAL_PAGE_PAYLOAD };
+        levels.push_back(level);
+        pages += level.pagesX * level.pagesY;
+    }
+    pageSlots.assign(pages, NONE);
+    rowSlots = slotsPerRow;
+    slots.assign(size_t(slotsPerRow) * slotsPerRow, Slot());
+    resident = 0;
+}
+
+
+void VirtualPageTable::pagePosition(uint32_t page, uint32_t& level, uint32_t& x, uint32_t& y) const {
+    level = 0;
+    while (level + 1 < levels.size() && levels[level + 1].firstPage <= page) level++;
+    uint32_t index = page - levels[level].firstPage;
+    x = index % levels[level].pagesX;
+    y = index / levels[level].pagesX;
+}
+
+
+uint32_t VirtualPageTable::ancestor(uint32_t page, uint32_t ancestorLevel) const {
+    uint32_t level, x, y;
+    pagePosition(page, level, x, y);
+    uint32_t shift = ancestorLevel - level;
+    const Level& coarse = levels[ancestorLevel];
+    return pageId(ancestorLevel, (std::min)(x >> shift, coarse.pagesX - 1), (std::min)(y >> shift, coarse.pagesY - 1));
+}
+
+
+void VirtualPageTable::touch(uint32_t page, uint64_t frame) {
+    uint32_t level, x, y;
+    pagePosition(page, level, x, y);
+    for (; level < levels.size(); level++) {
+        uint32_t standIn = ancestor(page, level);
+        if (pageSlots[standIn] != NONE) slots[pageSlots[standIn]].lastUsed = frame;
+    }
+}
+
+
+// A linear scan. There are at most 256 x 256 slots and only a few pages get mapped per frame
+uint32_t VirtualPageTable::map(uint32_t page, uint64_t frame, uint32_t& evicted) {
+    uint32_t best = NONE;
+    for (uint32_t i = 0; i < slots.size(); i++) {
+        const Slot& slot = slots[i];
+        if (slot.page == NONE) {
+            best = i;
+            break;
+        }
+        if (slot.pinned || slot.lastUsed >= frame) continue;
+        if (best == NONE || slot.lastUsed < slots[best].lastUsed) best = i;
+    }
+    if (best == NONE) return NONE;
+
+    evicted = slots[best].page;
+    if (evicted != NONE) {
+        pageSlots[evicted] = NONE;
+        resident--;
+    }
+    slots[best] = { page, frame, false };
+    pageSlots[page] = best;
+    resident++;
+    return best;
+}
+
+
+void VirtualPageTable::pin(uint32_t page) {
+    if (pageSlots[page] != NONE) slots[pageSlots[page]].pinned = true;
+}
+
+
+void VirtualPageTable::writeHeader(VirtualTextureHeader& header) const {
+    header = VirtualTextureHeader{};
+    header.width = textureWidth;
+    header.height = textureHeight;
+    header.levelCount = levelCount();
+    header.slotsPerRow = rowSlots;
+    for (uint32_t i = 0; i < levels.size(); i++) {
+        header.levelFirstPage[i] = levels[i].firstPage;
+        header.levelPagesX[i] = levels[i].pagesX;
+        header.levelPagesY[i] = levels[i].pagesY;
+    }
+}
+
+
+// Every page gets the slot of its first resident ancestor, itself included. Nothing has to be written for the pages that
+// are missing, the fragment shader falls back to coarser texels on its own
+void VirtualPageTable::writeEntries(uint32_t* entries) const {
+    for (uint32_t page = 0; page < pageCount(); page++) {
+        uint32_t level, x, y;
+        pagePosition(page, level, x, y);
+        entries[page] = 0;
+        for (; level < levels.size(); level++) {
+            uint32_t slot = pageSlots[ancestor(page, level)];
+            if (slot != NONE) {
+                entries[page] = (slot % rowSlots) | (slot / rowSlots) << 8 | level << 16 | VIRTUAL_ENTRY_VALID;
+                break;
+            }
+        }
+    }
+}
+
+
+uint32_t virtualPageBytes(VkFormat format, bool decode) {
+    BlockFormat block;
+    bool srgb;
+    if (decode || !blockFormatOf(format, block, srgb)) {
+        return VIRTUAL_PAGE_SIZE * VIRTUAL_PAGE_SIZE * 4;
+    }
+    return static_cast<uint32_t>(compressedSize(block, VIRTUAL_PAGE_SIZE, VIRTUAL_PAGE_SIZE));
+}
+
+
+static uint32_t wrapIndex(int64_t index, uint32_t count) {
+    int64_t wrapped = index % count;
+    return static_cast<uint32_t>(wrapped < 0 ? wrapped + count : wrapped);
+}
+
+
+// The level's block page texels [texel, texel + blockSize) are a copy of once wrapped, NONE where they wrap across the
+// level's edge or into the padding of its last block, which happens when a side is not a multiple of the block size
+static uint32_t sourceBlock(int64_t texel, uint32_t size, uint32_t blockSize) {
+    uint32_t wrapped = wrapIndex(texel, size);
+    return wrapped % blockSize == 0 && wrapped + blockSize <= size ? wrapped / blockSize : VirtualPageTable::NONE;
+}
+
+
+// The 4x4 texels of a page block that is none of the level's, decoded one by one from where they wrap to
+static void gatherWrappedTexels(const Ktx2Level& level, BlockFormat block, uint32_t levelBlocksX, int64_t texelX, int64_t texelY, uint8_t texels[64]) {
+    uint32_t bytes = blockBytes(block);
+    uint8_t decoded[64];
+    size_t decodedIndex = SIZE_MAX;
+    for (uint32_t y = 0; y < 4; y++) {
+        uint32_t sy = wrapIndex(texelY + y, level.height);
+        for (uint32_t x = 0; x < 4; x++) {
+            uint32_t sx = wrapIndex(texelX + x, level.width);
+            size_t index = size_t(sy / 4) * levelBlocksX + sx / 4;
+            if (index != decodedIndex) {
+                decompressImage(block, level.data.data() + index * bytes, 4, 4, decoded);
+                decodedIndex = index;
+            }
+            memcpy(texels + (y * 4 + x) * 4, decoded + ((sy % 4) * 4 + sx % 4) * 4, 4);
+        }
+    }
+}
+
+
+// Works in blocks (a texel for RGBA8), which page and border sizes are multiples of, so compressed pages are cut without
+// re-encoding. The wrap is in texels though, as the shader's fract(uv): on a level whose side is not a multiple of 4 the
+// few blocks across its edge are put together texel by texel, and encoded again unless the page gets decoded anyway
+void extractVirtualPage(const Ktx2Level& level, VkFormat format, bool decode, uint32_t x, uint32_t y, uint8_t* destination) {
+    BlockFormat block;
+    bool srgb;
+    bool compressed = blockFormatOf(format, block, srgb);
+    uint32_t blockSize = compressed ? 4 : 1;
+    uint32_t bytes = compressed ? blockBytes(block) : 4;
+    uint32_t levelBlocksX = (level.width + blockSize - 1) / blockSize, levelBlocksY = (level.height + blockSize - 1) / blockSize;
+    if (level.data.size() < size_t(levelBlocksX) * levelBlocksY * bytes) {
+        throw std::runtime_error("failed to load texture page, truncated KTX2 level!");
+    }
+
+    static thread_local std::vector<uint8_t> blocks;
+    uint32_t pageBlocks = VIRTUAL_PAGE_SIZE / blockSize;
+    uint8_t* target = destination;
+    if (compressed && decode) {
+        blocks.resize(size_t(pageBlocks) * pageBlocks * bytes);
+        target = blocks.data();
+    }
+
+    // Border included, so the first row and column come from the previous page, or the far edge of the level. Per block
+    // row and column of the page, the level's block it copies, NONE where it straddles the wrap
+    int64_t originX = int64_t(x) * VIRTUAL_PAGE_PAYLOAD - VIRTUAL_PAGE_BORDER;
+    int64_t originY = int64_t(y) * VIRTUAL_PAGE_PAYLOAD - VIRTUAL_PAGE_BORDER;
+    uint32_t sourceColumns[VIRTUAL_PAGE_SIZE];
+    uint32_t sourceRows[VIRTUAL_PAGE_SIZE];
+    for (uint32_t i = 0; i < pageBlocks; i++) {
+        sourceColumns[i] = sourceBlock(originX + int64_t(i) * blockSize, level.width, blockSize);
+        sourceRows[i] = sourceBlock(originY + int64_t(i) * blockSize, level.height, blockSize);
+    }
+
+    for (uint32_t row = 0; row < pageBlocks; row++) {
+        if (sourceRows[row] == VirtualPageTable::NONE) continue;
+        const uint8_t* source = level.data.data() + size_t(sourceRows[row]) * levelBlocksX * bytes;
+        uint8_t* out = target + size_t(row) * pageBlocks * bytes;
+        for (uint32_t column = 0; column < pageBlocks;) {
+            if (sourceColumns[column] == VirtualPageTable::NONE) {
+                column++;
+                continue;
+            }
+            // Each row is at most a few runs of the level's row
+            uint32_t run = 1;
+            while (column + run < pageBlocks && sourceColumns[column + run] == sourceColumns[column] + run) run++;
+            memcpy(out + size_t(column) * bytes, source + size_t(sourceColumns[column]) * bytes, size_t(run) * bytes);
+            column += run;
+        }
+    }
+
+    if (compressed && decode) {
+        decompressImage(block, blocks.data(), VIRTUAL_PAGE_SIZE, VIRTUAL_PAGE_SIZE, destination);
+    }
+
+    // Only BCn levels have blocks that straddle the wrap, RGBA8 ones never get here
+    for (uint32_t row = 0; row < pageBlocks; row++) {
+        for (uint32_t column = 0; column < pageBlocks; column++) {
+            if (sourceRows[row] != VirtualPageTable::NONE && sourceColumns[column] != VirtualPageTable::NONE) continue;
+            uint8_t texels[64];
+            gatherWrappedTexels(level, block, levelBlocksX, originX + int64_t(column) * 4, originY + int64_t(row) * 4, texels);
+            if (!decode) {
+                compressImage(block, texels, 4, 4, destination + (size_t(row) * pageBlocks + column) * bytes);
+                continue;
+            }
+            for (uint32_t texelRow = 0; texelRow < 4; texelRow++) {
+                memcpy(destination + ((size_t(row) * 4 + texelRow) * VIRTUAL_PAGE_SIZE + column * 4) * 4, texels + texelRow * 16, 16);
+            }
+        }
+    }
+}
\ No newline at end of file
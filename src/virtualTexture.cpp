@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include "application.h"
+#include "blockCompress.h"
+#include "command.h"
+#include "texture.h"
+#include "virtualTexture.h"
+
+
+static VkBufferImageCopy pageCopyRegion(uint32_t slot, uint32_t slotsPerRow, VkDeviceSize bufferOffset) {
+    VkBufferImageCopy region{};
+    region.bufferOffset = bufferOffset;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { int32_t(slot % slotsPerRow * VIRTUAL_PAGE_SIZE), int32_t(slot / slotsPerRow * VIRTUAL_PAGE_SIZE), 0 };
+    region.imageExtent = { VIRTUAL_PAGE_SIZE, VIRTUAL_PAGE_SIZE, 1 };
+    return region;
+}
+
+
+// The cache is a single-level image of N x N page slots, and takes textureImage's place. The mip tail (the levels that fit
+// in one page) goes in before the first frame and stays, everything finer is loaded page by page when a frame asks for it
+void Application::createVirtualTexture(std::unique_ptr<Ktx2File> ktx) {
+    virtualTexture = std::move(ktx);
+    virtualSourceFormat = virtualTexture->format();
+    textureExtent = { virtualTexture->width(), virtualTexture->height() };
+    mipLevels = 1;
+    textureResidentLevel = 0;
+
+    BlockFormat block;
+    bool srgb;
+    textureDecodeToRgba8 = blockFormatOf(virtualSourceFormat, block, srgb) && !isTextureFormatSupported(virtualSourceFormat);
+    if (textureDecodeToRgba8) {
+        std::cout << "compressed texture not supported by the device, decoding pages to RGBA8" << std::endl;
+    }
+    textureFormat = textureDecodeToRgba8 ? (srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM) : virtualSourceFormat;
+    virtualPageSize = virtualPageBytes(virtualSourceFormat, textureDecodeToRgba8);
+
+    // At most what one image dimension (and an entry's 8 bit slot coordinates) can hold, at least the tail and a few more
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint32_t slotsPerRow = (std::min)({ options.virtualTexturePages, VIRTUAL_MAX_SLOTS_PER_ROW, properties.limits.maxImageDimension2D / VIRTUAL_PAGE_SIZE });
+    virtualPages.reset(textureExtent.width, textureExtent.height, virtualTexture->levelCount(), slotsPerRow);
+    std::vector<uint32_t> tail;
+    for (uint32_t level = 0; level < virtualPages.levelCount(); level++) {
+        if (virtualPages.levelPagesX(level) == 1 && virtualPages.levelPagesY(level) == 1) {
+            tail.push_back(virtualPages.pageId(level, 0, 0));
+        }
+    }
+    if (virtualPages.slotCount() < tail.size() + 4) {
+        while (slotsPerRow * slotsPerRow < tail.size() + 4) slotsPerRow++;
+        std::cout << "--virtual-texture " << options.virtualTexturePages << " has no room beside the mip tail, using " << slotsPerRow << std::endl;
+        virtualPages.reset(textureExtent.width, textureExtent.height, virtualTexture->levelCount(), slotsPerRow);
+    }
+
+    createImage(slotsPerRow * VIRTUAL_PAGE_SIZE, slotsPerRow * VIRTUAL_PAGE_SIZE, 1, VK_SAMPLE_COUNT_1_BIT, textureFormat, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+
+    // The tail pages stay, each through a slice of the staging ring
+    transitionImageLayout(textureImage, textureFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
+    for (uint32_t page : tail) {
+        uint32_t evicted;
+        uint32_t slot = virtualPages.map(page, 0, evicted);
+        virtualPages.pin(page);
+        uint32_t level, x, y;
+        virtualPages.pagePosition(page, level, x, y);
+        StagingSlice slice = reserveStaging(virtualPageSize);
+        extractVirtualPage(virtualTexture->level(level), virtualSourceFormat, textureDecodeToRgba8, x, y, slice.data);
+        VkBufferImageCopy region = pageCopyRegion(slot, slotsPerRow, slice.offset);
+        vkCmdCopyBufferToImage(stagingCommands(), slice.buffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+    stagingStats.bytes += VkDeviceSize(virtualPageSize) * tail.size();
+    transitionImageLayout(textureImage, textureFormat, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+
+    // A page table and a feedback buffer per frame in flight, each frame reads and writes only its own
+    VkDeviceSize tableSize = sizeof(VirtualTextureHeader) + VkDeviceSize(virtualPages.pageCount()) * sizeof(uint32_t);
+    VkDeviceSize feedbackSize = VkDeviceSize(virtualPages.pageCount()) * sizeof(uint32_t);
+    pageTableBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    pageTableBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    pageTableBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    feedbackBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    feedbackBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    feedbackBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(tableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            pageTableBuffers[i], pageTableBuffersMemory[i]);
+        pageTableBuffersMapped[i] = pageTableBuffersMemory[i].mapped;
+        virtualPages.writeHeader(*static_cast<VirtualTextureHeader*>(pageTableBuffersMapped[i]));
+
+        // Read back by the CPU every frame, so cached memory where there is any
+        try {
+            createBuffer(feedbackSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                feedbackBuffers[i], feedbackBuffersMemory[i]);
+        }
+        catch (const std::runtime_error&) {
+            createBuffer(feedbackSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                feedbackBuffers[i], feedbackBuffersMemory[i]);
+        }
+        feedbackBuffersMapped[i] = feedbackBuffersMemory[i].mapped;
+        memset(feedbackBuffersMapped[i], 0, feedbackSize);
+    }
+    pageTableVersion = 1;
+    pageTableVersions.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+    VkDeviceSize stagingSize = VkDeviceSize(virtualPageSize) * VIRTUAL_STAGING_PAGES;
+    createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        pageStagingBuffer, pageStagingBufferMemory);
+    pageStagingData = static_cast<uint8_t*>(pageStagingBufferMemory.mapped);
+    freeStagingPages.clear();
+    for (uint32_t i = 0; i < VIRTUAL_STAGING_PAGES; i++) freeStagingPages.push_back(i);
+    frameStagingPages.assign(MAX_FRAMES_IN_FLIGHT, {});
+    pageQueued.assign(virtualPages.pageCount(), false);
+
+    pageLoaderStop = false;
+    pageLoaderThread = std::thread(&Application::loadVirtualPages, this);
+}
+
+
+// The loader thread. Cuts requested pages out of the mapped file into free staging pages, so the page faults (the actual
+// reading) and any decoding stay off the frame's thread
+void Application::loadVirtualPages() {
+    std::unique_lock<std::mutex> lock(pageLoaderMutex);
+    while (true) {
+        pageLoaderWake.wait(lock, [this] { return pageLoaderStop || (!pageRequests.empty() && !freeStagingPages.empty()); });
+        if (pageLoaderStop) return;
+        uint32_t page = pageRequests.front();
+        pageRequests.pop_front();
+        uint32_t stagingPage = freeStagingPages.back();
+        freeStagingPages.pop_back();
+        lock.unlock();
+
+        uint32_t level, x, y;
+        virtualPages.pagePosition(page, level, x, y); // only reads the page layout, which never changes after createVirtualTexture
+        extractVirtualPage(virtualTexture->level(level), virtualSourceFormat, textureDecodeToRgba8, x, y,
+            pageStagingData + size_t(stagingPage) * virtualPageSize);
+
+        lock.lock();
+        loadedPages.push_back({ page, stagingPage });
+    }
+}
+
+
+// Once per frame on the main thread, after the frame's fence. What the frame asked for last time goes to the loader, loaded
+// pages get slots (the copies are recorded at the start of this frame) and the frame's page table catches up
+void Application::updateVirtualTexture(uint32_t frame) {
+    if (!virtualTexturing) return;
+
+    // Pages the frame sampled. Resident ones just count as used now, the rest are requested. Scanning the whole buffer is
+    // cheap next to a frame, it is 4 bytes a page
+    uint32_t* feedback = static_cast<uint32_t*>(feedbackBuffersMapped[frame]);
+    std::vector<uint32_t> misses;
+    for (uint32_t page = 0; page < virtualPages.pageCount(); page++) {
+        if (feedback[page] == 0) continue;
+        feedback[page] = 0;
+        virtualPages.touch(page, frameNumber);
+        if (!virtualPages.isResident(page) && !pageQueued[page]) {
+            pageQueued[page] = true;
+            misses.push_back(page);
+        }
+    }
+    pagesRequested += misses.size();
+
+    std::vector<std::pair<uint32_t, uint32_t>> ready;
+    {
+        std::lock_guard<std::mutex> lock(pageLoaderMutex);
+        // Staging this frame's previous copies read from is free again
+        freeStagingPages.insert(freeStagingPages.end(), frameStagingPages[frame].begin(), frameStagingPages[frame].end());
+        frameStagingPages[frame].clear();
+
+        // Newest requests first, and within a frame coarse before fine (coarser levels have the higher page numbers). What
+        // falls off the back was asked for frames ago and may be out of view by now, it gets asked for again if not
+        pageRequests.insert(pageRequests.begin(), misses.rbegin(), misses.rend());
+        while (pageRequests.size() > VIRTUAL_MAX_QUEUED) {
+            pageQueued[pageRequests.back()] = false;
+            pageRequests.pop_back();
+            pagesDropped++;
+        }
+
+        size_t count = (std::min)(loadedPages.size(), size_t(VIRTUAL_UPLOADS_PER_FRAME));
+        ready.assign(loadedPages.begin(), loadedPages.begin() + count);
+        loadedPages.erase(loadedPages.begin(), loadedPages.begin() + count);
+    }
+
+    pageCopies.clear();
+    std::vector<uint32_t> unused;
+    for (auto [page, stagingPage] : ready) {
+        pageQueued[page] = false;
+        uint32_t evicted;
+        uint32_t slot = virtualPages.map(page, frameNumber, evicted);
+        if (slot == VirtualPageTable::NONE) { // every slot was sampled this frame, the cache is too small for the view
+            unused.push_back(stagingPage);
+            pagesDropped++;
+            continue;
+        }
+        if (evicted != VirtualPageTable::NONE) pagesEvicted++;
+        pageCopies.push_back(pageCopyRegion(slot, virtualPages.slotsPerRow(), VkDeviceSize(stagingPage) * virtualPageSize));
+        frameStagingPages[frame].push_back(stagingPage);
+        pagesUploaded++;
+    }
+    if (!unused.empty()) {
+        std::lock_guard<std::mutex> lock(pageLoaderMutex);
+        freeStagingPages.insert(freeStagingPages.end(), unused.begin(), unused.end());
+    }
+    pageLoaderWake.notify_one();
+    if (!pageCopies.empty()) pageTableVersion++;
+
+    // A different pixel of each square writes feedback every frame, 29 is coprime to 64 so all of them take turns
+    auto* header = static_cast<VirtualTextureHeader*>(pageTableBuffersMapped[frame]);
+    uint32_t pixel = static_cast<uint32_t>(frameNumber * 29 % (VIRTUAL_FEEDBACK_STRIDE * VIRTUAL_FEEDBACK_STRIDE));
+    header->feedbackPixel = pixel % VIRTUAL_FEEDBACK_STRIDE | (pixel / VIRTUAL_FEEDBACK_STRIDE) << 8;
+    if (pageTableVersions[frame] != pageTableVersion) {
+        virtualPages.writeEntries(reinterpret_cast<uint32_t*>(header + 1));
+        pageTableVersions[frame] = pageTableVersion;
+    }
+}
+
+
+// Before the render pass. Copying in the frame's own command buffer keeps the frame from waiting on a separate submit, and
+// the barrier orders it after the earlier frames that still sample the old contents of the slots
+void Application::recordVirtualTextureUploads(VkCommandBuffer commandBuffer) {
+    if (pageCopies.empty()) return;
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = textureImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdCopyBufferToImage(commandBuffer, pageStagingBuffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(pageCopies.size()), pageCopies.data());
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+
+// After the render pass: the fragment shader's feedback writes have to be made visible to the host reading them
+void Application::recordVirtualTextureFeedback(VkCommandBuffer commandBuffer) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+
+void Application::cleanupVirtualTexture() {
+    if (!virtualTexturing) return;
+    {
+        std::lock_guard<std::mutex> lock(pageLoaderMutex);
+        pageLoaderStop = true;
+    }
+    pageLoaderWake.notify_all();
+    if (pageLoaderThread.joinable()) pageLoaderThread.join();
+
+    for (size_t i = 0; i < pageTableBuffers.size(); i++) {
+        vkDestroyBuffer(device, pageTableBuffers[i], nullptr);
+        freeMemory(pageTableBuffersMemory[i]);
+        vkDestroyBuffer(device, feedbackBuffers[i], nullptr);
+        freeMemory(feedbackBuffersMemory[i]);
+    }
+    vkDestroyBuffer(device, pageStagingBuffer, nullptr);
+    freeMemory(pageStagingBufferMemory);
+    virtualTexture.reset();
+}
+
+
+void Application::printVirtualTextureStats() {
+    if (!virtualTexturing) return;
+    std::cout << "Virtual texture: " << virtualPages.pageCount() << " pages, " << virtualPages.residentCount() << " resident in "
+        << virtualPages.slotCount() << " slots (" << virtualPages.slotsPerRow() * VIRTUAL_PAGE_SIZE << " texels square), "
+        << pagesRequested << " requested, " << pagesUploaded << " uploaded, " << pagesEvicted << " evicted, "
+        << pagesDropped << " dropped" << std::endl;
+}
\ No newline at end of file
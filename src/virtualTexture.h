@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ktx2.h"
+
+
+// --virtual-texture: every mip level is cut into pages, and only the pages the frames actually sample are kept, in a physical
+// cache of page-sized slots. A page table maps each page to the slot holding it, or to its closest coarser page that is.
+// In texels. shader_virtual.frag has its own copy of these
+const uint32_t VIRTUAL_PAGE_SIZE = 128; // one slot of the cache
+const uint32_t VIRTUAL_PAGE_BORDER = 4; // neighbouring texels on every side (one BCn block), so filtering never leaves the slot
+const uint32_t VIRTUAL_PAGE_PAYLOAD = VIRTUAL_PAGE_SIZE - 2 * VIRTUAL_PAGE_BORDER; // texels of the level a page covers
+const uint32_t VIRTUAL_MAX_LEVELS = 16;
+const uint32_t VIRTUAL_MAX_SLOTS_PER_ROW = 256; // slot coordinates are 8 bits in a page table entry
+const uint32_t VIRTUAL_FEEDBACK_STRIDE = 8; // one pixel in 8x8 writes its page request, a different one every frame
+const uint32_t VIRTUAL_STAGING_PAGES = 64; // pages the loader can have ready or in flight
+const uint32_t VIRTUAL_UPLOADS_PER_FRAME = 16; // copies recorded into one frame, the rest wait for the next
+const uint32_t VIRTUAL_MAX_QUEUED = 256; // requests waiting for the loader, the oldest are dropped past this
+
+// Page table entry: slot x | slot y << 8 | level of the page in the slot << 16, with the valid bit set
+const uint32_t VIRTUAL_ENTRY_VALID = 1u << 31;
+
+// Start of the page table buffer (std430, so only uints), followed by an entry per page. Pages are numbered level by level,
+// row-major within a level
+struct VirtualTextureHeader {
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t slotsPerRow;
+    uint32_t feedbackPixel; // x | y << 8, which pixel of every stride x stride square writes feedback this frame
+    uint32_t padding[3];
+    uint32_t levelFirstPage[VIRTUAL_MAX_LEVELS];
+    uint32_t levelPagesX[VIRTUAL_MAX_LEVELS];
+    uint32_t levelPagesY[VIRTUAL_MAX_LEVELS];
+};
+
+
+// Which page sits in which slot, on the CPU. Slots are recycled least recently used first, except for the pinned ones
+// (the mip tail, so every page always has a resident ancestor to fall back to)
+class VirtualPageTable {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    void reset(uint32_t width, uint32_t height, uint32_t levelCount, uint32_t slotsPerRow);
+
+    uint32_t pageCount() const { return static_cast<uint32_t>(pageSlots.size()); }
+    uint32_t slotCount() const { return static_cast<uint32_t>(slots.size()); }
+    uint32_t slotsPerRow() const { return rowSlots; }
+    uint32_t residentCount() const { return resident; }
+    uint32_t levelCount() const { return static_cast<uint32_t>(levels.size()); }
+    uint32_t levelPagesX(uint32_t level) const { return levels[level].pagesX; }
+    uint32_t levelPagesY(uint32_t level) const { return levels[level].pagesY; }
+
+    uint32_t pageId(uint32_t level, uint32_t x, uint32_t y) const { return levels[level].firstPage + y * levels[level].pagesX + x; }
+    void pagePosition(uint32_t page, uint32_t& level, uint32_t& x, uint32_t& y) const;
+    // The page of a coarser level standing in for this one: its coordinates shifted down, clamped to that level's grid.
+    // The shader works it out the same way
+    uint32_t ancestor(uint32_t page, uint32_t ancestorLevel) const;
+
+    bool isResident(uint32_t page) const { return pageSlots[page] != NONE; }
+    uint32_t slotOf(uint32_t page) const { return pageSlots[page]; }
+
+    // Marks the page, and every resident ancestor it might fall back to, as used in this frame
+    void touch(uint32_t page, uint64_t frame);
+    // Gives the page a slot: a free one, else the least recently used page's that was not used this frame. NONE if there
+    // is no such slot. evicted is the page that lost its slot, NONE if it was free
+    uint32_t map(uint32_t page, uint64_t frame, uint32_t& evicted);
+    void pin(uint32_t page); // once mapped, never evicted
+
+    void writeHeader(VirtualTextureHeader& header) const;
+    void writeEntries(uint32_t* entries) const; // pageCount() of them
+
+private:
+    struct Level {
+        uint32_t firstPage;
+        uint32_t pagesX;
+        uint32_t pagesY;
+    };
+    struct Slot {
+        uint32_t page = NONE;
+        uint64_t lastUsed = 0;
+        bool pinned = false;
+    };
+    std::vector<Level> levels;
+    std::vector<uint32_t> pageSlots; // NONE if not resident
+    std::vector<Slot> slots;
+    uint32_t rowSlots = 0;
+    uint32_t resident = 0;
+    uint32_t textureWidth = 0;
+    uint32_t textureHeight = 0;
+};
+
+
+// Bytes one page takes in staging: VIRTUAL_PAGE_SIZE squared in the file's format, or RGBA8 when decoded
+uint32_t virtualPageBytes(VkFormat format, bool decode);
+
+// Copies page (x, y) of a level with its border, wrapping around the level's edges like the REPEAT sampler would, and decodes
+// it to RGBA8 if asked to. Safe to call from any thread
+void extractVirtualPage(const Ktx2Level& level, VkFormat format, bool decode, uint32_t x, uint32_t y, uint8_t* destination);
\ No newline at end of file